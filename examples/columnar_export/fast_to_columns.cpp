@@ -0,0 +1,144 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <mfast.h>
+#include <mfast/columnar_writer.h>
+#include <mfast/coder/fast_decoder.h>
+#include <mfast/coder/dynamic_templates_description.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/exception/diagnostic_information.hpp>
+
+const char usage[] =
+  "Decode a FAST capture and write one columnar table per template.\n\n"
+  "  -t file     : Template file (required)\n"
+  "  -f file     : FAST Message file (required)\n"
+  "  -o prefix   : Prefix of the output files (default: the message file name followed by '.')\n"
+  "  -chunk n    : Number of rows per chunk (default 65536)\n"
+  "  -threads n  : Number of writer threads (default 2)\n"
+  "  -hfix n     : Skip n byte header before each message\n\n";
+
+
+int read_file(const char* filename, std::vector<char>& contents)
+{
+  std::FILE*fp = std::fopen(filename, "rb");
+  if (fp)
+  {
+    std::fseek(fp, 0, SEEK_END);
+    contents.resize(std::ftell(fp));
+    std::rewind(fp);
+    std::fread(&contents[0], 1, contents.size(), fp);
+    std::fclose(fp);
+    return 0;
+  }
+  std::cerr << "File read error : " << filename << "\n";
+  return -1;
+}
+
+int main(int argc, const char** argv)
+{
+  std::vector<char> template_contents;
+  const char* message_file = 0;
+  std::string prefix;
+  std::size_t chunk_rows = 65536;
+  std::size_t num_threads = 2;
+  std::size_t skip_header_bytes = 0;
+
+  int i = 1;
+  int parse_status = 0;
+  while (i < argc && parse_status == 0) {
+    const char* arg = argv[i++];
+
+    if (std::strcmp(arg, "-t") == 0) {
+      parse_status = read_file(argv[i++], template_contents);
+    }
+    else if (std::strcmp(arg, "-f") == 0) {
+      if (prefix.empty())
+        prefix = std::string(argv[i]) + ".";
+      message_file = argv[i++];
+    }
+    else if (std::strcmp(arg, "-o") == 0) {
+      prefix = argv[i++];
+    }
+    else if (std::strcmp(arg, "-chunk") == 0) {
+      chunk_rows = atoi(argv[i++]);
+      if (chunk_rows == 0) {
+        std::cerr << "Invalid argument for '-chunk'\n";
+        parse_status = -1;
+      }
+    }
+    else if (std::strcmp(arg, "-threads") == 0) {
+      num_threads = atoi(argv[i++]);
+    }
+    else if (std::strcmp(arg, "-hfix") == 0) {
+      skip_header_bytes = atoi(argv[i++]);
+    }
+  }
+
+  if (parse_status != 0 || template_contents.size() == 0 || message_file == 0) {
+    std::cout << '\n' << usage;
+    return -1;
+  }
+
+  try {
+    // map the capture instead of reading it, so that the memory stays bounded by the chunks
+    // being written rather than growing with the size of the capture
+    boost::interprocess::file_mapping capture(message_file, boost::interprocess::read_only);
+    boost::interprocess::mapped_region region(capture, boost::interprocess::read_only);
+    const char *first = static_cast<const char*>(region.get_address()) + skip_header_bytes;
+    const char *last = static_cast<const char*>(region.get_address()) + region.get_size();
+
+    mfast::dynamic_templates_description description(&template_contents[0]);
+
+    mfast::malloc_allocator alloc;
+    mfast::fast_decoder coder(&alloc);
+    const mfast::templates_description* descriptions[] = { &description };
+    coder.include(descriptions);
+
+    mfast::columnar_exporter exporter(prefix, chunk_rows, num_threads);
+
+    std::size_t num_messages = 0;
+    bool first_message = true;
+    while (first < last) {
+      mfast::message_cref msg = coder.decode(first, last, first_message);
+      exporter.append(msg);
+      ++num_messages;
+      first_message = false;
+      first += skip_header_bytes;
+    }
+    exporter.finish();
+
+    std::cout << num_messages << " messages written to " << exporter.num_tables() << " tables\n";
+  }
+  catch (boost::exception& e) {
+    std::cerr << boost::diagnostic_information(e);
+    return -1;
+  }
+  catch (std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,360 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <mfast.h>
+#include <mfast/coder/fast_decoder.h>
+#include <mfast/coder/dynamic_templates_description.h>
+#include <mfast/json/json_encoder.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/exception/diagnostic_information.hpp>
+
+const char usage[] =
+  "Decode a FAST capture and write the messages as newline delimited JSON.\n\n"
+  "  -t file     : Template file (required)\n"
+  "  -f file     : FAST Message file (required)\n"
+  "  -o file     : Output file (default: standard output)\n"
+  "  -threads n  : Number of formatting threads (default 2); 0 formats in the decoding thread\n"
+  "  -batch n    : Number of messages handed to a formatting thread at once (default 64)\n"
+  "  -queue n    : Number of batches in flight (default: twice the number of threads)\n"
+  "  -hfix n     : Skip n byte header before each message\n\n";
+
+
+int read_file(const char* filename, std::vector<char>& contents)
+{
+  std::FILE*fp = std::fopen(filename, "rb");
+  if (fp)
+  {
+    std::fseek(fp, 0, SEEK_END);
+    contents.resize(std::ftell(fp));
+    std::rewind(fp);
+    std::fread(&contents[0], 1, contents.size(), fp);
+    std::fclose(fp);
+    return 0;
+  }
+  std::cerr << "File read error : " << filename << "\n";
+  return -1;
+}
+
+// The messages decoded by the decoding thread between two hand-offs to the formatting
+// threads, and their JSON text once formatted.
+struct batch
+{
+  batch()
+    : writer(true)
+    , formatted(false)
+  {
+  }
+
+  std::vector<mfast::message_cref> messages;
+  std::vector<mfast::fast_decoder::generation_handle> generations;
+  mfast::json::json_writer writer;
+  bool formatted;
+};
+
+// Formats the batches of the decoding thread in a pool of threads and writes them in the
+// order they were decoded.
+//
+// The decoder keeps every message of a batch in its own generation of message storage until
+// the batch is formatted, so the number of generations must be at least the number of
+// messages in all batches. The batches and their JSON buffers are reused, so the memory
+// stays bounded by the number of batches once they have reached their working size.
+class ndjson_converter
+{
+  public:
+    ndjson_converter(mfast::fast_decoder& decoder,
+                     std::FILE*           output,
+                     std::size_t          num_threads,
+                     std::size_t          num_batches)
+      : decoder_(decoder)
+      , output_(output)
+      , batches_(new batch[num_batches])
+      , done_(false)
+      , write_failed_(false)
+    {
+      for (std::size_t i = 0; i < num_batches; ++i)
+        free_.push_back(&batches_[i]);
+      for (std::size_t i = 0; i < num_threads; ++i)
+        workers_.create_thread(boost::bind(&ndjson_converter::format, this));
+      writer_thread_ = boost::thread(boost::bind(&ndjson_converter::write, this));
+    }
+
+    ~ndjson_converter()
+    {
+      finish();
+    }
+
+    // Return a batch to be filled, waiting until one has been written.
+    batch* acquire()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      while (free_.empty())
+        batch_written_.wait(lock);
+      batch* b = free_.front();
+      free_.pop_front();
+      b->messages.clear();
+      b->generations.clear();
+      b->writer.clear();
+      b->formatted = false;
+      return b;
+    }
+
+    void submit(batch* b)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      pending_.push_back(b);
+      in_order_.push_back(b);
+      work_available_.notify_one();
+    }
+
+    // Write the batches in flight and stop the threads.
+    void finish()
+    {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        if (done_)
+          return;
+        done_ = true;
+        work_available_.notify_all();
+        batch_formatted_.notify_all();
+      }
+      workers_.join_all();
+      writer_thread_.join();
+    }
+
+    bool write_failed() const
+    {
+      return write_failed_;
+    }
+
+  private:
+    void format()
+    {
+      for (;;) {
+        batch* b;
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          while (pending_.empty() && !done_)
+            work_available_.wait(lock);
+          if (pending_.empty())
+            return;
+          b = pending_.front();
+          pending_.pop_front();
+        }
+
+        for (std::size_t i = 0; i < b->messages.size(); ++i) {
+          b->writer.write(b->messages[i]);
+          decoder_.release(b->generations[i]);
+        }
+
+        boost::mutex::scoped_lock lock(mutex_);
+        b->formatted = true;
+        batch_formatted_.notify_all();
+      }
+    }
+
+    void write()
+    {
+      for (;;) {
+        batch* b;
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          while (!(in_order_.size() && in_order_.front()->formatted) && !(done_ && in_order_.empty()))
+            batch_formatted_.wait(lock);
+          if (in_order_.empty())
+            return;
+          b = in_order_.front();
+          in_order_.pop_front();
+        }
+
+        if (std::fwrite(b->writer.data(), 1, b->writer.size(), output_) != b->writer.size())
+          write_failed_ = true;
+
+        boost::mutex::scoped_lock lock(mutex_);
+        free_.push_back(b);
+        batch_written_.notify_one();
+      }
+    }
+
+    mfast::fast_decoder& decoder_;
+    std::FILE* output_;
+    boost::scoped_array<batch> batches_;
+    std::deque<batch*> free_;
+    std::deque<batch*> pending_;  // waiting for a formatting thread
+    std::deque<batch*> in_order_; // submitted and not yet written, in the decoding order
+    boost::thread_group workers_;
+    boost::thread writer_thread_;
+    boost::mutex mutex_;
+    boost::condition_variable work_available_;
+    boost::condition_variable batch_formatted_;
+    boost::condition_variable batch_written_;
+    bool done_;
+    bool write_failed_;
+};
+
+int main(int argc, const char** argv)
+{
+  std::vector<char> template_contents;
+  const char* message_file = 0;
+  const char* output_file = 0;
+  std::size_t num_threads = 2;
+  std::size_t batch_size = 64;
+  std::size_t num_batches = 0;
+  std::size_t skip_header_bytes = 0;
+
+  int i = 1;
+  int parse_status = 0;
+  while (i < argc && parse_status == 0) {
+    const char* arg = argv[i++];
+
+    if (std::strcmp(arg, "-t") == 0) {
+      parse_status = read_file(argv[i++], template_contents);
+    }
+    else if (std::strcmp(arg, "-f") == 0) {
+      message_file = argv[i++];
+    }
+    else if (std::strcmp(arg, "-o") == 0) {
+      output_file = argv[i++];
+    }
+    else if (std::strcmp(arg, "-threads") == 0) {
+      num_threads = atoi(argv[i++]);
+    }
+    else if (std::strcmp(arg, "-batch") == 0) {
+      batch_size = atoi(argv[i++]);
+      if (batch_size == 0) {
+        std::cerr << "Invalid argument for '-batch'\n";
+        parse_status = -1;
+      }
+    }
+    else if (std::strcmp(arg, "-queue") == 0) {
+      num_batches = atoi(argv[i++]);
+      if (num_batches == 0) {
+        std::cerr << "Invalid argument for '-queue'\n";
+        parse_status = -1;
+      }
+    }
+    else if (std::strcmp(arg, "-hfix") == 0) {
+      skip_header_bytes = atoi(argv[i++]);
+    }
+  }
+
+  if (parse_status != 0 || template_contents.size() == 0 || message_file == 0) {
+    std::cout << '\n' << usage;
+    return -1;
+  }
+
+  if (num_batches == 0)
+    num_batches = num_threads ? 2 * num_threads : 1;
+
+  std::FILE* output = output_file ? std::fopen(output_file, "wb") : stdout;
+  if (output == 0) {
+    std::cerr << "File open error : " << output_file << "\n";
+    return -1;
+  }
+
+  int status = 0;
+  try {
+    // map the capture instead of reading it, so that its size is not limited by the memory
+    boost::interprocess::file_mapping capture(message_file, boost::interprocess::read_only);
+    boost::interprocess::mapped_region region(capture, boost::interprocess::read_only);
+    const char *first = static_cast<const char*>(region.get_address()) + skip_header_bytes;
+    const char *last = static_cast<const char*>(region.get_address()) + region.get_size();
+
+    mfast::dynamic_templates_description description(&template_contents[0]);
+
+    mfast::fast_decoder coder;
+    if (num_threads)
+      coder.use_generations(batch_size * num_batches);
+    const mfast::templates_description* descriptions[] = { &description };
+    coder.include(descriptions);
+
+    std::size_t num_messages = 0;
+    bool first_message = true;
+
+    if (num_threads == 0) {
+      mfast::json::json_writer writer(true);
+      while (first < last) {
+        writer.clear();
+        for (std::size_t n = 0; n < batch_size && first < last; ++n) {
+          writer.write(coder.decode(first, last, first_message));
+          first_message = false;
+          first += skip_header_bytes;
+          ++num_messages;
+        }
+        if (std::fwrite(writer.data(), 1, writer.size(), output) != writer.size())
+          BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error("output write error")));
+      }
+    }
+    else {
+      ndjson_converter converter(coder, output, num_threads, num_batches);
+      batch* b = 0;
+      try {
+        while (first < last) {
+          b = converter.acquire();
+          for (std::size_t n = 0; n < batch_size && first < last; ++n) {
+            mfast::fast_decoder::generation_handle generation;
+            b->messages.push_back(coder.decode(first, last, first_message, generation));
+            b->generations.push_back(generation);
+            first_message = false;
+            first += skip_header_bytes;
+          }
+          num_messages += b->messages.size();
+          converter.submit(b);
+          b = 0;
+        }
+      }
+      catch (...) {
+        // write the messages decoded before the error
+        if (b && b->messages.size())
+          converter.submit(b);
+        converter.finish();
+        throw;
+      }
+      converter.finish();
+      if (converter.write_failed())
+        BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error("output write error")));
+    }
+
+    std::cerr << num_messages << " messages converted\n";
+  }
+  catch (boost::exception& e) {
+    std::cerr << boost::diagnostic_information(e);
+    status = -1;
+  }
+  catch (std::exception& e) {
+    std::cerr << e.what() << "\n";
+    status = -1;
+  }
+
+  if (output != stdout)
+    std::fclose(output);
+  return status;
+}
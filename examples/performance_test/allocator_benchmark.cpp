@@ -0,0 +1,160 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <mfast/malloc_allocator.h>
+#include <mfast/pool_allocator.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <pthread.h>
+
+#include <boost/date_time/microsec_time_clock.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+const char usage[] =
+  "  -t n        : number of threads (default 4)\n"
+  "  -n n        : number of blocks allocated by each thread per round (default 10000)\n"
+  "  -c count    : repeat the test 'count' times (default 100)\n\n";
+
+// Sizes of the storage arrays of groups and sequence elements with 1 to 16 fields,
+// plus a few string/vector buffers.
+const std::size_t block_sizes[] = {
+  16, 32, 48, 64, 80, 96, 128, 160, 192, 256, 64, 128, 512, 32, 1024, 16
+};
+
+const std::size_t num_block_sizes = sizeof(block_sizes)/sizeof(block_sizes[0]);
+
+struct job
+{
+  mfast::allocator*   alloc;
+  std::vector<void*>* allocate_into;
+  std::vector<void*>* deallocate_from;
+  std::size_t         repeat_count;
+};
+
+// Each round, a thread allocates its own blocks and deallocates half of them; the other half
+// is handed to the neighbouring thread which deallocates it in the next phase.
+extern "C" void* allocate_blocks(void* arg)
+{
+  job* j = static_cast<job*>(arg);
+  std::vector<void*>& blocks = *j->allocate_into;
+  for (std::size_t r = 0; r < j->repeat_count; ++r) {
+    for (std::size_t i = 0; i < blocks.size(); ++i) {
+      std::size_t size = block_sizes[i % num_block_sizes];
+      blocks[i] = j->alloc->allocate(size);
+      std::memset(blocks[i], 0, size);
+    }
+    for (std::size_t i = 0; i < blocks.size(); i += 2) {
+      j->alloc->deallocate(blocks[i], block_sizes[i % num_block_sizes]);
+    }
+    if (r+1 < j->repeat_count) {
+      for (std::size_t i = 1; i < blocks.size(); i += 2) {
+        j->alloc->deallocate(blocks[i], block_sizes[i % num_block_sizes]);
+      }
+    }
+  }
+  return 0;
+}
+
+extern "C" void* deallocate_blocks(void* arg)
+{
+  job* j = static_cast<job*>(arg);
+  std::vector<void*>& blocks = *j->deallocate_from;
+  for (std::size_t i = 1; i < blocks.size(); i += 2) {
+    j->alloc->deallocate(blocks[i], block_sizes[i % num_block_sizes]);
+  }
+  return 0;
+}
+
+long run(mfast::allocator* alloc, std::size_t num_threads, std::size_t num_blocks, std::size_t repeat_count)
+{
+  std::vector<std::vector<void*> > blocks(num_threads, std::vector<void*>(num_blocks));
+  std::vector<job> jobs(num_threads);
+  std::vector<pthread_t> threads(num_threads);
+
+  for (std::size_t i = 0; i < num_threads; ++i) {
+    jobs[i].alloc = alloc;
+    jobs[i].allocate_into = &blocks[i];
+    jobs[i].deallocate_from = &blocks[(i+1) % num_threads];
+    jobs[i].repeat_count = repeat_count;
+  }
+
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+  for (std::size_t i = 0; i < num_threads; ++i)
+    pthread_create(&threads[i], 0, &allocate_blocks, &jobs[i]);
+  for (std::size_t i = 0; i < num_threads; ++i)
+    pthread_join(threads[i], 0);
+
+  for (std::size_t i = 0; i < num_threads; ++i)
+    pthread_create(&threads[i], 0, &deallocate_blocks, &jobs[i]);
+  for (std::size_t i = 0; i < num_threads; ++i)
+    pthread_join(threads[i], 0);
+
+  boost::posix_time::ptime stop = boost::posix_time::microsec_clock::universal_time();
+  return static_cast<long>((stop - start).total_milliseconds());
+}
+
+int main(int argc, const char** argv)
+{
+  std::size_t num_threads = 4;
+  std::size_t num_blocks = 10000;
+  std::size_t repeat_count = 100;
+
+  int i = 1;
+  int parse_status = 0;
+  while (i < argc && parse_status == 0) {
+    const char* arg = argv[i++];
+    std::size_t* target = 0;
+
+    if (std::strcmp(arg, "-t") == 0) {
+      target = &num_threads;
+    }
+    else if (std::strcmp(arg, "-n") == 0) {
+      target = &num_blocks;
+    }
+    else if (std::strcmp(arg, "-c") == 0) {
+      target = &repeat_count;
+    }
+    else {
+      parse_status = -1;
+    }
+
+    if (target) {
+      if (i < argc)
+        *target = atoi(argv[i++]);
+      if (*target == 0) {
+        std::cerr << "Invalid argument for '" << arg << "'\n";
+        parse_status = -1;
+      }
+    }
+  }
+
+  if (parse_status != 0) {
+    std::cout << '\n' << usage;
+    return -1;
+  }
+
+  mfast::pool_allocator pool_alloc;
+
+  std::cout << "malloc_allocator : " << run(mfast::malloc_allocator::instance(), num_threads, num_blocks, repeat_count) << " msec\n";
+  std::cout << "pool_allocator   : " << run(&pool_alloc, num_threads, num_blocks, repeat_count) << " msec\n";
+  return 0;
+}
@@ -0,0 +1,137 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <mfast.h>
+#include <mfast/json/json_encoder.h>
+#include <mfast/json/json_decoder.h>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <boost/date_time/microsec_time_clock.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/exception/diagnostic_information.hpp>
+
+#include "test3.h"
+
+const char usage[] =
+  "  -c count    : decode, encode and write each message 'count' times (default 1000000)\n\n";
+
+const char product_json[] =
+  "{\"id\":1,\"name\":\"Foo\",\"price\":123,\"tags\":[\"Bar with \\\"quote\\\"\",\"Eek with \\\\\"],"
+  "\"stock\":{\"warehouse\":300,\"retail\":20}}";
+
+const char person_json[] =
+  "{\"firstName\":\"John\",\"lastName\":\"Smith\",\"age\":25,"
+  "\"phoneNumbers\":[{\"type\":\"home\",\"number\":\"212 555-1234\"},{\"type\":\"fax\",\"number\":\"646 555-4567\"}],"
+  "\"emails\":[],\"login\":{\"userName\":\"John\",\"password\":\"J0hnsm1th\"},"
+  "\"bankAccounts\":[{\"number\":12345678,\"routingNumber\":87654321}]}";
+
+void report(const char* name, std::size_t bytes, std::size_t repeat_count, long usec)
+{
+  std::cout << name << " : " << usec / 1000 << " msec, ";
+  if (usec > 0) {
+    std::cout << (repeat_count * 1000000.0 / usec) << " msg/sec, "
+              << (static_cast<double>(bytes) * repeat_count / usec) << " MB/sec";
+  }
+  std::cout << "\n";
+}
+
+long elapsed_usec(const boost::posix_time::ptime& start)
+{
+  boost::posix_time::ptime stop = boost::posix_time::microsec_clock::universal_time();
+  return static_cast<long>((stop - start).total_microseconds());
+}
+
+// Time decoding @a json into @a msg and encoding it back to a stream and to a json_writer;
+// the message, the decoder and the writer are reused across iterations as a feed handler would.
+void run(const char* name, const char* json, const mfast::aggregate_mref& msg, std::size_t repeat_count)
+{
+  const std::size_t len = std::strlen(json);
+  mfast::json::json_decoder decoder;
+
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  for (std::size_t i = 0; i < repeat_count; ++i)
+    decoder.decode(json, json + len, msg);
+  report((std::string(name) + " decode").c_str(), len, repeat_count, elapsed_usec(start));
+
+  std::stringstream strm;
+  start = boost::posix_time::microsec_clock::universal_time();
+  for (std::size_t i = 0; i < repeat_count; ++i) {
+    strm.str(std::string());
+    mfast::json::encode(strm, msg);
+  }
+  report((std::string(name) + " encode").c_str(), len, repeat_count, elapsed_usec(start));
+
+  mfast::json::json_writer writer;
+  start = boost::posix_time::microsec_clock::universal_time();
+  for (std::size_t i = 0; i < repeat_count; ++i) {
+    writer.clear();
+    writer.write(msg);
+  }
+  report((std::string(name) + " write ").c_str(), len, repeat_count, elapsed_usec(start));
+
+  if (strm.str() != json || std::string(writer.data(), writer.size()) != json)
+    std::cerr << name << " does not round trip:\n" << strm.str() << "\n";
+}
+
+int main(int argc, const char** argv)
+{
+  std::size_t repeat_count = 1000000;
+
+  int i = 1;
+  int parse_status = 0;
+  while (i < argc && parse_status == 0) {
+    const char* arg = argv[i++];
+
+    if (std::strcmp(arg, "-c") == 0 && i < argc) {
+      repeat_count = atoi(argv[i++]);
+      if (repeat_count == 0) {
+        std::cerr << "Invalid argument for '-c'\n";
+        parse_status = -1;
+      }
+    }
+    else {
+      parse_status = -1;
+    }
+  }
+
+  if (parse_status != 0) {
+    std::cout << '\n' << usage;
+    return -1;
+  }
+
+  try {
+    test3::Product product;
+    run("Product", product_json, product.mref(), repeat_count);
+
+    test3::Person person;
+    test3::Person_mref person_ref = person.mref();
+    person_ref.set_login().as<test3::LoginAccount>();
+    person_ref.set_bankAccounts().resize(1);
+    person_ref.set_bankAccounts()[0].as<test3::BankAccount>();
+    run("Person ", person_json, person_ref, repeat_count);
+  }
+  catch (boost::exception& e) {
+    std::cerr << boost::diagnostic_information(e);
+    return -1;
+  }
+  return 0;
+}
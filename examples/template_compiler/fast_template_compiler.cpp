@@ -0,0 +1,125 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <mfast.h>
+#include <mfast/coder/dynamic_templates_description.h>
+#include <mfast/coder/binary_templates_description.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/exception/diagnostic_information.hpp>
+
+const char usage[] =
+  "Precompile a FAST template file into the binary format loaded by binary_templates_description.\n\n"
+  "  -t file     : Template file (required)\n"
+  "  -o file     : Output file (default: the template file name followed by '.mft')\n"
+  "  -bench n    : Load the templates n times from XML and from the output file and report the time\n\n";
+
+
+int read_file(const char* filename, std::vector<char>& contents)
+{
+  std::FILE*fp = std::fopen(filename, "rb");
+  if (fp)
+  {
+    std::fseek(fp, 0, SEEK_END);
+    contents.resize(std::ftell(fp));
+    std::rewind(fp);
+    std::fread(&contents[0], 1, contents.size(), fp);
+    std::fclose(fp);
+    // dynamic_templates_description takes a null terminated string
+    contents.push_back('\0');
+    return 0;
+  }
+  std::cerr << "File read error : " << filename << "\n";
+  return -1;
+}
+
+int main(int argc, const char** argv)
+{
+  std::vector<char> template_contents;
+  std::string output_file;
+  int bench_count = 0;
+
+  int i = 1;
+  int parse_status = 0;
+  while (i < argc && parse_status == 0) {
+    const char* arg = argv[i++];
+
+    if (std::strcmp(arg, "-t") == 0) {
+      if (output_file.empty())
+        output_file = std::string(argv[i]) + ".mft";
+      parse_status = read_file(argv[i++], template_contents);
+    }
+    else if (std::strcmp(arg, "-o") == 0) {
+      output_file = argv[i++];
+    }
+    else if (std::strcmp(arg, "-bench") == 0) {
+      bench_count = atoi(argv[i++]);
+    }
+  }
+
+  if (parse_status != 0 || template_contents.size() == 0) {
+    std::cout << '\n' << usage;
+    return -1;
+  }
+
+  try {
+    mfast::dynamic_templates_description description(&template_contents[0]);
+
+    std::ofstream output(output_file.c_str(), std::ios::binary);
+    mfast::write_binary_templates(output, description);
+    output.close();
+    if (!output) {
+      std::cerr << "File write error : " << output_file << "\n";
+      return -1;
+    }
+
+    // load the output once to make sure it is readable
+    mfast::binary_templates_description loaded(output_file.c_str());
+    std::cout << loaded.size() << " templates written to " << output_file << "\n";
+
+    if (bench_count > 0) {
+      using namespace boost::posix_time;
+
+      ptime start = microsec_clock::universal_time();
+      for (int n = 0; n < bench_count; ++n) {
+        mfast::dynamic_templates_description xml_description(&template_contents[0]);
+      }
+      ptime xml_end = microsec_clock::universal_time();
+      for (int n = 0; n < bench_count; ++n) {
+        mfast::binary_templates_description binary_description(output_file.c_str());
+      }
+      ptime binary_end = microsec_clock::universal_time();
+
+      std::cout << "XML load    : " << (xml_end - start).total_microseconds() / bench_count << " usec\n"
+                << "binary load : " << (binary_end - xml_end).total_microseconds() / bench_count << " usec\n";
+    }
+  }
+  catch (boost::exception& e) {
+    std::cerr << boost::diagnostic_information(e);
+    return -1;
+  }
+
+  return 0;
+}
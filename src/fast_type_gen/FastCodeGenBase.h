@@ -22,7 +22,10 @@
 #include "../fastxml/FastXMLVisitor.h"
 #include <map>
 #include <string>
+#include <istream>
+#include <ostream>
 #include <boost/exception/all.hpp>
+#include <boost/lexical_cast.hpp>
 
 class file_open_error
   : public virtual boost::exception, public virtual std::exception
@@ -60,6 +63,48 @@ public:
   }
 };
 
+/// A decimal initial value of a template, read with boost::lexical_cast and written as the
+/// mantissa and exponent arguments of decimal_value_storage.
+struct decimal_value {
+  int64_t mantissa;
+  int32_t exponent;
+};
+
+inline std::ostream&
+operator << (std::ostream & out, const decimal_value& in)
+{
+  out << in.mantissa << "LL, " << in.exponent;
+  return out;
+}
+
+inline std::istream &
+operator>>(std::istream &source, decimal_value& result)
+{
+  std::string decimal_string;
+  source >> decimal_string;
+
+  std::size_t float_pos = decimal_string.find_first_of('.');
+  std::size_t nonzero_pos = decimal_string.find_last_not_of(".0");
+
+  if (float_pos == std::string::npos || nonzero_pos < float_pos) {
+    // this is an integer
+    if (float_pos != std::string::npos) {
+      decimal_string = decimal_string.substr(0, float_pos);
+      nonzero_pos = decimal_string.find_last_not_of('0');
+    }
+    if (nonzero_pos == std::string::npos)
+      nonzero_pos = 0;
+    result.exponent = decimal_string.size()-1 - nonzero_pos;
+    result.mantissa = boost::lexical_cast<int64_t>(decimal_string.substr(0, nonzero_pos+1));
+  }
+  else {
+    decimal_string = decimal_string.substr(0, nonzero_pos+1);
+    result.exponent = float_pos - decimal_string.size() +1;
+    result.mantissa = boost::lexical_cast<int64_t>(decimal_string.erase(float_pos, 1));
+  }
+  return source;
+}
+
 typedef std::map<std::string, std::string> templates_registry_t;
 
 #endif /* end of include guard: FASTCODEGEN_H_RV7SDOTE */
@@ -0,0 +1,250 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+#include "FastXML2Flat.h"
+#include <cstdlib>
+
+FastXML2Flat::FastXML2Flat(const char*           filebase,
+                           templates_registry_t& registry)
+  : FastCodeGenBase(filebase, "_flat.h")
+  , has_templateRef_(false)
+  , registry_(registry)
+{
+}
+
+bool FastXML2Flat::VisitEnter( const XMLDocument& /*doc*/)
+{
+  std::string filebase_upper = boost::to_upper_copy(filebase_);
+
+  out_<< "#ifndef __" << filebase_upper << "_FLAT_H__\n"
+      << "#define __" << filebase_upper << "_FLAT_H__\n"
+      << "\n"
+      << "#include \"" << filebase_ << ".h\"\n"
+      << "#include <mfast/flat_layout.h>\n"
+      << "#include <cstddef>\n\n"
+      << "namespace " << filebase_ << "\n{\n";
+  return out_.good();
+}
+
+bool FastXML2Flat::VisitExit( const XMLDocument& /*doc*/ )
+{
+  std::string filebase_upper = boost::to_upper_copy(filebase_);
+
+  out_<< "}\n\n"
+      << "#endif //__" << filebase_upper << "_FLAT_H__\n";
+  return out_.good();
+}
+
+std::string FastXML2Flat::indent_str() const
+{
+  return std::string(2*(scopes_.size()-1), ' ');
+}
+
+void FastXML2Flat::enter_struct(const std::string& struct_name)
+{
+  scopes_.push_back(struct_scope());
+  scopes_.back().name_ = struct_name;
+  scopes_.back().num_fields_ = 0;
+}
+
+std::string FastXML2Flat::exit_struct(const char* id)
+{
+  const struct_scope& scope = scopes_.back();
+  std::string ind = indent_str();
+  std::stringstream strm;
+
+  strm << "\n"
+       << ind << "struct " << scope.name_ << "\n"
+       << ind << "{\n";
+  if (id) {
+    strm << ind << "  enum {\n"
+         << ind << "    the_id = " << id << "\n"
+         << ind << "  };\n";
+  }
+  // the presence bits are placed first so that the struct never starts with padding
+  strm << ind << "  uint8_t presence_[" << (scope.num_fields_ > 0 ? (scope.num_fields_+7)/8 : 1) << "];\n"
+       << scope.members_
+       << scope.accessors_
+       << "\n"
+       << ind << "  static const mfast::flat_layout& layout()\n"
+       << ind << "  {\n";
+  if (scope.num_fields_ > 0) {
+    strm << ind << "    static const mfast::flat_field_layout fields[] = {\n"
+         << scope.fields_
+         << ind << "    };\n";
+  }
+  strm << ind << "    static const mfast::flat_layout the_layout = {\n"
+       << ind << "      " << (id ? id : "0") << ", sizeof(" << scope.name_ << "), offsetof("
+       << scope.name_ << ", presence_), " << scope.num_fields_ << ", "
+       << (scope.num_fields_ > 0 ? "fields" : "0") << "\n"
+       << ind << "    };\n"
+       << ind << "    return the_layout;\n"
+       << ind << "  }\n"
+       << ind << "};\n";
+
+  scopes_.pop_back();
+  return strm.str();
+}
+
+void FastXML2Flat::add_field(const XMLElement&  element,
+                             const std::string& cpp_type,
+                             const std::string& name_attr,
+                             std::size_t        capacity,
+                             const std::string& element_layout)
+{
+  if (scopes_.empty())
+    return;
+
+  struct_scope& scope = scopes_.back();
+  std::string ind = indent_str();
+  std::size_t index = scope.num_fields_++;
+
+  scope.members_ += ind + "  " + cpp_type + " " + name_attr + ";\n";
+
+  std::stringstream strm;
+  strm << ind << "      { offsetof(" << scope.name_ << ", " << name_attr << "), " << capacity << ", "
+       << (element_layout.empty() ? "0" : element_layout.c_str()) << " },\n";
+  scope.fields_ += strm.str();
+
+  if (strcmp(get_optional_attr(element, "presence", "mandatory"), "optional") == 0 ) {
+    strm.str("");
+    strm << "\n"
+         << ind << "  bool has_" << name_attr << "() const\n"
+         << ind << "  {\n"
+         << ind << "    return mfast::flat_is_present(presence_, " << index << ");\n"
+         << ind << "  }\n";
+    scope.accessors_ += strm.str();
+  }
+}
+
+bool FastXML2Flat::VisitEnterTemplate (const XMLElement & /*element*/,
+                                       const std::string& name_attr,
+                                       std::size_t /* index */)
+{
+  has_templateRef_ = false;
+  enter_struct(name_attr + "_flat");
+  return true;
+}
+
+bool FastXML2Flat::VisitExitTemplate (const XMLElement & element,
+                                      const std::string& name_attr,
+                                      std::size_t /* numFields */,
+                                      std::size_t /* index */)
+{
+  std::string content = exit_struct(get_optional_attr(element, "id", "0"));
+
+  if (has_templateRef_) {
+    out_ << "\n// " << name_attr << "_flat is not generated because " << name_attr << " contains templateRef\n";
+  }
+  else {
+    out_ << content;
+  }
+  return out_.good();
+}
+
+bool FastXML2Flat::VisitEnterGroup (const XMLElement & /*element*/,
+                                    const std::string& name_attr,
+                                    std::size_t /* index */)
+{
+  enter_struct(name_attr + "_flat");
+  return true;
+}
+
+bool FastXML2Flat::VisitExitGroup (const XMLElement & element,
+                                   const std::string& name_attr,
+                                   std::size_t /* numFields */,
+                                   std::size_t /* index */)
+{
+  std::string struct_name = name_attr + "_flat";
+  std::string content = exit_struct(0);
+  if (!scopes_.empty()) {
+    scopes_.back().members_ += content;
+    add_field(element, struct_name, name_attr, 0, "&" + struct_name + "::layout()");
+  }
+  return true;
+}
+
+bool FastXML2Flat::VisitEnterSequence (const XMLElement & /*element*/,
+                                       const std::string& name_attr,
+                                       std::size_t /* index */)
+{
+  enter_struct(name_attr + "_element_flat");
+  return true;
+}
+
+bool FastXML2Flat::VisitExitSequence (const XMLElement & element,
+                                      const std::string& name_attr,
+                                      std::size_t /* numFields */,
+                                      std::size_t /* index */)
+{
+  std::string struct_name = name_attr + "_element_flat";
+  std::string content = exit_struct(0);
+  if (!scopes_.empty()) {
+    std::size_t capacity = std::atoi(get_optional_attr(element, "capacity", "16"));
+    std::stringstream cpp_type;
+    cpp_type << "mfast::flat_sequence<" << struct_name << ", " << capacity << ">";
+    scopes_.back().members_ += content;
+    add_field(element, cpp_type.str(), name_attr, capacity, "&" + struct_name + "::layout()");
+  }
+  return true;
+}
+
+bool FastXML2Flat::VisitString (const XMLElement & element, const std::string& name_attr, std::size_t /* index */)
+{
+  std::size_t capacity = std::atoi(get_optional_attr(element, "capacity", "32"));
+  std::stringstream cpp_type;
+  cpp_type << "mfast::flat_string<" << capacity << ">";
+  add_field(element, cpp_type.str(), name_attr, capacity, "");
+  return true;
+}
+
+bool FastXML2Flat::VisitInteger (const XMLElement & element,
+                                 int                bits,
+                                 const std::string& name_attr,
+                                 std::size_t /* index */)
+{
+  char buf[12];
+  TIXML_SNPRINTF(buf, 12, "uint%d_t",bits);
+  const char* cpp_type = (element.Name()[0] == 'u') ? buf : buf+1;
+  add_field(element, cpp_type, name_attr, 0, "");
+  return true;
+}
+
+bool FastXML2Flat::VisitDecimal (const XMLElement & element, const std::string& name_attr, std::size_t /* index */)
+{
+  add_field(element, "mfast::flat_decimal", name_attr, 0, "");
+  return true;
+}
+
+bool FastXML2Flat::VisitByteVector (const XMLElement & element, const std::string& name_attr, std::size_t index)
+{
+  return VisitString(element, name_attr, index);
+}
+
+bool FastXML2Flat::VisitTemplateRef(const XMLElement & /* element */, const std::string& /* name_attr */, std::size_t /* index */)
+{
+  has_templateRef_ = true;
+  return true;
+}
+
+bool FastXML2Flat::VisitEnterDefine(const XMLElement &, const std::string& )
+{
+  // the flat structs are only generated for templates
+  return false;
+}
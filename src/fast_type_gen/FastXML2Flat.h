@@ -0,0 +1,90 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef FASTXML2FLAT_H_K2VJ8QXN
+#define FASTXML2FLAT_H_K2VJ8QXN
+
+#include "FastCodeGenBase.h"
+#include <boost/algorithm/string.hpp>
+
+/// Generates the <filebase>_flat.h header with a flat POD struct for each template.
+///
+/// A flat struct stores integers as fixed width members, decimals as mfast::flat_decimal,
+/// strings and byte vectors inline as mfast::flat_string and sequences inline as mfast::flat_sequence.
+/// The capacity of a string, byte vector or sequence is taken from the non-standard "capacity"
+/// attribute of its element. Templates containing a templateRef are not supported.
+class FastXML2Flat
+  : public FastCodeGenBase
+{
+  public:
+    FastXML2Flat(const char* filebase, templates_registry_t& registry);
+
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Woverloaded-virtual"
+#endif
+
+    /// Visit a document.
+    virtual bool VisitEnter( const XMLDocument& /*doc*/ );
+    /// Visit a document.
+    virtual bool VisitExit( const XMLDocument& /*doc*/ );
+
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+    virtual bool  VisitEnterTemplate (const XMLElement & element, const std::string& name_attr, std::size_t index);
+    virtual bool  VisitExitTemplate (const XMLElement & element, const std::string& name_attr, std::size_t numFields, std::size_t index);
+    virtual bool  VisitEnterGroup (const XMLElement & element, const std::string& name_attr, std::size_t index);
+    virtual bool  VisitExitGroup (const XMLElement & element, const std::string& name_attr, std::size_t numFields, std::size_t index);
+    virtual bool  VisitEnterSequence (const XMLElement & element, const std::string& name_attr, std::size_t index);
+    virtual bool  VisitExitSequence (const XMLElement & element, const std::string& name_attr, std::size_t numFields, std::size_t index);
+
+    virtual bool VisitString (const XMLElement & element, const std::string& name_attr, std::size_t index);
+    virtual bool VisitInteger (const XMLElement & element, int bits, const std::string& name_attr, std::size_t index);
+    virtual bool VisitDecimal (const XMLElement & element, const std::string& name_attr, std::size_t index);
+    virtual bool VisitByteVector (const XMLElement & element, const std::string& name_attr, std::size_t index);
+    virtual bool VisitTemplateRef(const XMLElement & element, const std::string& name_attr, std::size_t index);
+
+    virtual bool VisitEnterDefine(const XMLElement & /* element */, const std::string& /* name_attr */);
+
+  private:
+    struct struct_scope
+    {
+      std::string name_;
+      std::string members_;
+      std::string accessors_;
+      std::string fields_;
+      std::size_t num_fields_;
+    };
+
+    std::string indent_str() const;
+    void enter_struct(const std::string& struct_name);
+    std::string exit_struct(const char* id);
+    void add_field(const XMLElement&  element,
+                   const std::string& cpp_type,
+                   const std::string& name_attr,
+                   std::size_t        capacity,
+                   const std::string& element_layout);
+
+    std::vector<struct_scope> scopes_;
+    bool has_templateRef_;
+    templates_registry_t& registry_;
+};
+
+#endif /* end of include guard: FASTXML2FLAT_H_K2VJ8QXN */
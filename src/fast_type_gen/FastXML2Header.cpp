@@ -17,6 +17,8 @@
 //     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include "FastXML2Header.h"
+#include <cstring>
+#include <sstream>
 
 
 
@@ -73,6 +75,128 @@ void FastXML2Header::restore_scope(const std::string& name_attr)
 
 }
 
+void FastXML2Header::add_field_visit(const XMLElement& element,
+                                     const std::string& name,
+                                     bool               is_composite)
+{
+  bool is_optional = strcmp(get_optional_attr(element, "presence", "mandatory"), "optional") == 0;
+  const char* args = is_composite ? "(), 0);" : "());";
+
+  if (is_optional) {
+    cref_visits_.back().push_back("if (Visitor::visit_absent || get_" + name + "().present())");
+    cref_visits_.back().push_back("  v.visit(get_" + name + args);
+  }
+  else {
+    cref_visits_.back().push_back("v.visit(get_" + name + args);
+  }
+
+  // mandatory constant fields have no setter
+  if (is_mandatory_constant(element))
+    return;
+
+  if (is_optional) {
+    mref_visits_.back().push_back("if (Visitor::visit_absent || set_" + name + "().present())");
+    mref_visits_.back().push_back("  v.visit(set_" + name + args);
+  }
+  else {
+    mref_visits_.back().push_back("v.visit(set_" + name + args);
+  }
+}
+
+void FastXML2Header::add_field_constants(const XMLElement& element,
+                                         const std::string& name,
+                                         std::size_t        index,
+                                         const char*        field_type)
+{
+  const char* presence = get_optional_attr(element, "presence", "mandatory");
+
+  // a decimal with separate mantissa and exponent operators has the field type
+  // field_type_exponent and its operator is the one of the exponent
+  const XMLElement* exponent_element = 0;
+  const XMLElement* mantissa_element = 0;
+  if (strcmp(field_type, "decimal") == 0) {
+    exponent_element = element.FirstChildElement("exponent");
+    mantissa_element = element.FirstChildElement("mantissa");
+  }
+
+  if (exponent_element || mantissa_element) {
+    const XMLElement* exponent_op = exponent_element ? fieldOpElement(*exponent_element) : 0;
+    const XMLElement* mantissa_op = mantissa_element ? fieldOpElement(*mantissa_element) : 0;
+    std::string initial_exponent = exponent_op ? get_optional_attr(*exponent_op, "value", "") : "";
+    std::string initial_mantissa = mantissa_op ? get_optional_attr(*mantissa_op, "value", "") : "";
+
+    header_cref_ << indent << "typedef mfast::split_decimal_field_constants<" << index
+                 << ", mfast::operator_" << (exponent_op ? exponent_op->Name() : "none")
+                 << ", mfast::presence_" << presence
+                 << ", mfast::operator_" << (mantissa_op ? mantissa_op->Name() : "none");
+    if (initial_exponent.size() || initial_mantissa.size()) {
+      header_cref_ << ", " << (initial_exponent.size() ? "true, " + initial_exponent : "false, 0")
+                   << ", " << (initial_mantissa.size() ? "true, " + initial_mantissa + "LL" : "false, 0");
+    }
+    header_cref_ << "> " << name << "_field;\n";
+    return;
+  }
+
+  const XMLElement* op_element = fieldOpElement(element);
+  std::string op_name = op_element ? op_element->Name() : "none";
+  std::string initial_value = op_element ? get_optional_attr(*op_element, "value", "") : "";
+
+  std::stringstream args;
+  args << index << ", mfast::field_type_" << field_type
+       << ", mfast::operator_" << op_name
+       << ", mfast::presence_" << presence;
+
+  std::stringstream constants;
+  constants << "mfast::field_constants<" << args.str() << ">";
+
+  if (initial_value.size()) {
+    if (strcmp(field_type, "decimal") == 0) {
+      try {
+        constants.str("");
+        constants << "mfast::decimal_field_constants<" << index
+                  << ", mfast::operator_" << op_name
+                  << ", mfast::presence_" << presence
+                  << ", " << boost::lexical_cast<decimal_value>(initial_value) << ">";
+      }
+      catch (boost::bad_lexical_cast&) {
+        // reported by the source generator
+      }
+    }
+    else if (strstr(field_type, "int") != 0) {
+      bool is_unsigned = field_type[0] == 'u';
+      bool is_64 = strstr(field_type, "64") != 0;
+      constants.str("");
+      constants << "mfast::int_field_constants<" << args.str() << ", " << field_type << "_t, "
+                << initial_value << (is_unsigned ? "U" : "") << (is_64 ? "LL" : "") << ">";
+    }
+  }
+
+  header_cref_ << indent << "typedef " << constants.str() << " " << name << "_field;\n";
+}
+
+static void write_for_each_field(indented_stringstream& os, const std::vector<std::string>& visits)
+{
+  os << "\n"
+     << indent << "/// Visit the fields in order with their generated reference types; primitive fields\n"
+     << indent << "/// are passed to v.visit(ref) and composite fields to v.visit(ref, 0). Absent optional\n"
+     << indent << "/// fields are skipped unless Visitor::visit_absent is non-zero.\n"
+     << indent << "template <typename Visitor>\n"
+     << indent << "void for_each_field(Visitor&" << (visits.empty() ? "" : " v") << ") const\n"
+     << indent << "{\n";
+  for (std::size_t i = 0; i < visits.size(); ++i) {
+    os << indent << "  " << visits[i] << "\n";
+  }
+  os << indent << "}\n";
+}
+
+void FastXML2Header::write_field_visits()
+{
+  write_for_each_field(header_cref_, cref_visits_.back());
+  write_for_each_field(header_mref_, mref_visits_.back());
+  cref_visits_.pop_back();
+  mref_visits_.pop_back();
+}
+
 /// Visit a document.
 bool FastXML2Header::VisitEnter( const XMLDocument& doc)
 {
@@ -132,6 +256,8 @@ bool FastXML2Header::VisitEnterTemplate (const XMLElement & /*element*/,
   cref_scope_ << name_attr << "_cref::";
   header_cref_.inc_indent(2);
   header_mref_.inc_indent(2);
+  cref_visits_.push_back(std::vector<std::string>());
+  mref_visits_.push_back(std::vector<std::string>());
 
   return true;
 }
@@ -141,6 +267,7 @@ bool FastXML2Header::VisitExitTemplate (const XMLElement & element,
                                         std::size_t        numFields,
                                         std::size_t /* index */)
 {
+  write_field_visits();
   header_cref_.dec_indent(2);
   header_mref_.dec_indent(2);
 
@@ -232,6 +359,8 @@ bool FastXML2Header::VisitEnterGroup (const XMLElement & element,
     cref_scope_ << name << "_cref::";
     header_cref_.inc_indent(2);
     header_mref_.inc_indent(2);
+    cref_visits_.push_back(std::vector<std::string>());
+    mref_visits_.push_back(std::vector<std::string>());
     return true;
   }
   return false;
@@ -240,14 +369,16 @@ bool FastXML2Header::VisitEnterGroup (const XMLElement & element,
 bool FastXML2Header::VisitExitGroup (const XMLElement & element,
                                      const std::string& name_attr,
                                      std::size_t /* numFields */,
-                                     std::size_t /* index */)
+                                     std::size_t        index)
 {
   const XMLElement* child = only_child_templateRef(element);
   if (child == 0) {
+    write_field_visits();
     header_cref_.dec_indent(2);
     header_mref_.dec_indent(2);
 
     header_cref_ << indent << "};\n\n";
+    add_field_constants(element, name_attr, index, "group");
     header_cref_ << indent << name_attr << "_cref get_" << name_attr << "() const;\n";
 
     header_mref_ << indent << "};\n\n";
@@ -268,6 +399,7 @@ bool FastXML2Header::VisitExitGroup (const XMLElement & element,
       }
     }
 
+    add_field_constants(element, name_attr, index, "group");
     if (strcmp(get_optional_attr(element, "presence", "mandatory"), "optional") == 0 ) {
       
       header_cref_ << indent << "typedef mfast::make_optional_cref<" << qulified_name << "_cref> " << name_attr << "_cref;\n"
@@ -283,6 +415,7 @@ bool FastXML2Header::VisitExitGroup (const XMLElement & element,
                    << indent << name_attr << "_mref set_" << name_attr << "() const;\n";
     }
   }
+  add_field_visit(element, name_attr, true);
   return true;
 }
 
@@ -321,6 +454,8 @@ bool FastXML2Header::VisitEnterSequence (const XMLElement & element,
 
     header_cref_.inc_indent(2);
     header_mref_.inc_indent(2);
+    cref_visits_.push_back(std::vector<std::string>());
+    mref_visits_.push_back(std::vector<std::string>());
     return true;
   }
   return false;
@@ -329,14 +464,17 @@ bool FastXML2Header::VisitEnterSequence (const XMLElement & element,
 bool FastXML2Header::VisitExitSequence (const XMLElement & element,
                                         const std::string& name_attr,
                                         std::size_t /* numFields */,
-                                        std::size_t /* index */)
+                                        std::size_t        index)
 {
   const XMLElement* child = only_child(element);
   if (child == 0) {
+    write_field_visits();
     header_cref_.dec_indent(2);
     header_mref_.dec_indent(2);
 
-    header_cref_ << indent << "};\n\n"
+    header_cref_ << indent << "};\n\n";
+    add_field_constants(element, name_attr, index, "sequence");
+    header_cref_
                  << indent << "typedef mfast::make_sequence_cref<" << name_attr << "_element_cref> " << name_attr << "_cref;\n"
                  << indent << name_attr << "_cref get_" << name_attr << "() const;\n";
 
@@ -401,18 +539,22 @@ bool FastXML2Header::VisitExitSequence (const XMLElement & element,
     }
 
 
+    add_field_constants(element, name_attr, index, "sequence");
     header_cref_ << indent << name_attr << "_cref get_" << name_attr << "() const;\n";
     header_mref_ << indent << name_attr << "_mref set_" << name_attr << "() const;\n";
   }
+  add_field_visit(element, name_attr, true);
   return true;
 }
 
 bool FastXML2Header::VisitEnterSimpleValue (const XMLElement & element,
                                             const char*        cpp_type,
                                             const std::string& name_attr,
-                                            std::size_t /* index */)
+                                            std::size_t        index)
 {
+  add_field_constants(element, name_attr, index, cpp_type);
   header_cref_ << indent << "mfast::"<< cpp_type << "_cref get_" << name_attr << "() const;\n";
+  add_field_visit(element, name_attr, false);
   if (!is_mandatory_constant(element)) {
     header_mref_ << indent << "mfast::"<< cpp_type << "_mref set_" << name_attr << "() const;\n";
   }
@@ -464,12 +606,18 @@ bool FastXML2Header::VisitTemplateRef(const XMLElement & element, const std::str
     if (itr != registry_.end()) {
       qulified_name = itr->second + "::" + name_attr;
     }
+    add_field_constants(element, name_attr, index, "templateref");
     header_cref_ << indent << qulified_name << "_cref get_" << name_attr << "() const;\n";
     header_mref_ << indent << qulified_name << "_mref set_" << name_attr << "() const;\n";
+    add_field_visit(element, name_attr, true);
   }
   else {
+    std::stringstream name;
+    name << "nested_message" << index;
+    add_field_constants(element, name.str(), index, "templateref");
     header_cref_ << indent << "mfast::nested_message_cref get_nested_message" << index << "() const;\n";
     header_mref_ << indent << "mfast::nested_message_mref set_nested_message" << index << "() const;\n";
+    add_field_visit(element, name.str(), true);
   }
   return true;
 }
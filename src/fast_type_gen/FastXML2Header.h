@@ -21,6 +21,7 @@
 
 #include "FastCodeGenBase.h"
 #include "indented_ostream.h"
+#include <vector>
 #include <boost/algorithm/string.hpp>
 
 
@@ -64,6 +65,20 @@ class FastXML2Header
   private:
     void restore_scope(const std::string& name_attr);
 
+    /// Record the visit of a field in for_each_field() of the enclosing cref and mref classes.
+    /// @param name The suffix of the get_ and set_ member functions of the field.
+    void add_field_visit(const XMLElement& element, const std::string& name, bool is_composite);
+
+    /// Write for_each_field() of the innermost cref and mref classes and close its scope.
+    void write_field_visits();
+
+    /// Declare the mfast::field_constants of a field as <name>_field in the innermost cref class.
+    /// @param field_type The field_type_enum_t value of the field without the "field_type_" prefix.
+    void add_field_constants(const XMLElement& element,
+                             const std::string& name,
+                             std::size_t        index,
+                             const char*        field_type);
+
     bool VisitEnterSimpleValue (const XMLElement & element,
                                 const char*        cpp_type,
                                 const std::string& name_attr,
@@ -74,6 +89,9 @@ class FastXML2Header
     ind_stream header_cref_;
     ind_stream header_mref_;
     std::stringstream cref_scope_;
+    // the field visits of the enclosing cref and mref classes, innermost last
+    std::vector<std::vector<std::string> > cref_visits_;
+    std::vector<std::vector<std::string> > mref_visits_;
     templates_registry_t& registry_;
     std::string defined_name_;
 };
@@ -21,15 +21,6 @@
 #include <boost/algorithm/string.hpp>
 namespace {
 
-struct cstr_compare
-{
-  bool operator()(const char* lhs, const char* rhs) const
-  {
-    return strcmp(lhs, rhs) < 0;
-  }
-
-};
-
 struct map_value_type
 {
   const char* first;
@@ -48,46 +39,6 @@ struct is_space {
 
 };
 
-struct decimal_value {
-  int64_t mantissa;
-  int32_t exponent;
-};
-
-inline std::ostream&
-operator << (std::ostream & out, const decimal_value& in)
-{
-  out << in.mantissa << "LL, " << in.exponent;
-  return out;
-}
-
-std::istream &
-operator>>(std::istream &source, decimal_value& result)
-{
-  std::string decimal_string;
-  source >> decimal_string;
-
-  std::size_t float_pos = decimal_string.find_first_of('.');
-  std::size_t nonzero_pos = decimal_string.find_last_not_of(".0");
-
-  if (float_pos == std::string::npos || nonzero_pos < float_pos) {
-    // this is an integer
-    if (float_pos != std::string::npos) {
-      decimal_string = decimal_string.substr(0, float_pos);
-      nonzero_pos = decimal_string.find_last_not_of('0');
-    }
-    if (nonzero_pos == std::string::npos)
-      nonzero_pos = 0;
-    result.exponent = decimal_string.size()-1 - nonzero_pos;
-    result.mantissa = boost::lexical_cast<int64_t>(decimal_string.substr(0, nonzero_pos+1));
-  }
-  else {
-    decimal_string = decimal_string.substr(0, nonzero_pos+1);
-    result.exponent = float_pos - decimal_string.size() +1;
-    result.mantissa = boost::lexical_cast<int64_t>(decimal_string.erase(float_pos, 1));
-  }
-  return source;
-}
-
 class XMLFormatError
   : public std::exception
 {
@@ -183,23 +134,6 @@ bool FastXML2Source::VisitExitTemplates (const XMLElement& element,
   return out_.good();
 }
 
-const XMLElement* FastXML2Source::fieldOpElement(const XMLElement & element)
-{
-  static const char* field_op_names[] = {
-    "constant","default","copy","increment","delta","tail"
-  };
-
-  static std::set<const char*, cstr_compare> field_op_set (field_op_names, field_op_names + 6);
-
-  for (const XMLElement* child = element.FirstChildElement(); child != 0; child = child->NextSiblingElement())
-  {
-    if (field_op_set.count(child->Name())) {
-      return child;
-    }
-  }
-  return 0;
-}
-
 void FastXML2Source::add_to_instruction_list(const std::string & name_attr)
 {
   std::stringstream strm;
@@ -207,7 +141,7 @@ void FastXML2Source::add_to_instruction_list(const std::string & name_attr)
   subinstructions_list_.back() += strm.str();
 }
 
-bool FastXML2Source::output_typeref(const XMLElement & element)
+bool FastXML2Source::output_typeref(const XMLElement & element, const char* capacity)
 {
   std::string typeRef_name;
   std::string typeRef_ns;
@@ -218,8 +152,14 @@ bool FastXML2Source::output_typeref(const XMLElement & element)
     typeRef_ns = get_optional_attr(*typeRefElem, "ns", "");
   }
 
-  out_ << "  \"" << typeRef_name << "\", // typeRef name \n"
-       << "  \"" << typeRef_ns << "\"); // typeRef ns \n\n";
+  out_ << "  \"" << typeRef_name << "\", // typeRef name \n";
+  if (capacity) {
+    out_ << "  \"" << typeRef_ns << "\", // typeRef ns \n"
+         << "  " << capacity << "); // capacity\n\n";
+  }
+  else {
+    out_ << "  \"" << typeRef_ns << "\"); // typeRef ns \n\n";
+  }
   return out_.good();
 }
 
@@ -455,7 +395,7 @@ bool FastXML2Source::VisitExitSequence (const XMLElement & element,
        << subinstruction_arg
        << "  "<< lengthInstruction << ", // length\n";
   restore_scope(name_attr);
-  return output_typeref(element);
+  return output_typeref(element, get_optional_attr(element, "capacity", 0));
 }
 
 bool FastXML2Source::get_field_attributes(const XMLElement & element,
@@ -492,6 +432,24 @@ bool FastXML2Source::get_field_attributes(const XMLElement & element,
   return false;
 }
 
+void FastXML2Source::output_length(const XMLElement & element, const char* capacity)
+{
+  const char* terminator = capacity ? "," : ");";
+  const XMLElement* length_element = element.FirstChildElement("length");
+  if (length_element) {
+    out_ << "  " << get_optional_attr(*length_element, "id", "0") << ", // length id\n"
+         << "  \"" <<  get_optional_attr(*length_element, "name", "") << "\", // length name\n"
+         << "  \"" << get_optional_attr(*length_element, "ns", "") << "\"" << terminator << " // length ns\n";
+  }
+  else {
+    out_ << "0,\"\",\"\"" << terminator << " // no length element\n";
+  }
+
+  if (capacity)
+    out_ << "  " << capacity << "); // capacity\n";
+  out_ << "\n";
+}
+
 bool FastXML2Source::VisitString (const XMLElement & element,
                                   const std::string& name_attr,
                                   std::size_t        index)
@@ -521,17 +479,14 @@ bool FastXML2Source::VisitString (const XMLElement & element,
     out_ << "  "<< "string_value_storage()";
   }
 
+  const char* capacity = get_optional_attr(element, "capacity", 0);
   if (charset == "unicode") {
     out_ << ", // initial value\n";
-    const XMLElement* length_element = element.FirstChildElement("length");
-    if (length_element) {
-      out_ << "  " << get_optional_attr(*length_element, "id", "0") << ", // length id\n"
-           << "  \"" <<  get_optional_attr(*length_element, "name", "") << "\", // length name\n"
-           << "  \"" << get_optional_attr(*length_element, "ns", "") << "\"); // length ns\n\n";
-    }
-    else {
-      out_ << "0,\"\",\"\"); // no length element\n\n";
-    }
+    output_length(element, capacity);
+  }
+  else if (capacity) {
+    out_ << ", // initial value\n"
+         << "  " << capacity << "); // capacity\n\n";
   }
   else {
     out_ << "); // initial value\n\n";
@@ -731,17 +686,7 @@ bool FastXML2Source::VisitByteVector (const XMLElement & element,
   }
 
   out_ << ", // initial_value\n";
-
-  const XMLElement* length_element = element.FirstChildElement("length");
-  if (length_element) {
-    out_ << "  " << get_optional_attr(*length_element, "id", "0") << ", // length id\n"
-         << "  \"" <<  get_optional_attr(*length_element, "name", "") << "\", // length name\n"
-         << "  \"" << get_optional_attr(*length_element, "ns", "") << "\"); // length ns\n\n";
-
-  }
-  else {
-    out_ << "0,\"\",\"\"); // no length element\n\n";
-  }
+  output_length(element, get_optional_attr(element, "capacity", 0));
 
   add_to_instruction_list(name_attr);
   return out_.good();
@@ -87,8 +87,12 @@ class FastXML2Source
 
   private:
 
-    bool output_typeref(const XMLElement & element);
-    const XMLElement* fieldOpElement(const XMLElement & element);
+    /// Write the typeRef arguments of a group or sequence instruction and close its constructor call,
+    /// after the @a capacity argument if it is not null.
+    bool output_typeref(const XMLElement & element, const char* capacity = 0);
+    /// Write the length arguments of a unicode string or byte vector instruction and close its
+    /// constructor call, after the @a capacity argument if it is not null.
+    void output_length(const XMLElement & element, const char* capacity);
     bool get_field_attributes(const XMLElement & element,
                               const std::string& name_attr,
                               std::string&       fieldOpName,
@@ -22,6 +22,7 @@
 #include "FastXML2Header.h"
 #include "FastXML2Inline.h"
 #include "FastXML2Source.h"
+#include "FastXML2Flat.h"
 #include <boost/filesystem.hpp>
 using namespace boost::filesystem;
 
@@ -54,6 +55,9 @@ int main(int argc, const char** argv)
 
       FastXML2Source source_producer(filebase.c_str(),registry);
       doc.Accept(&source_producer);
+
+      FastXML2Flat flat_producer(filebase.c_str(),registry);
+      doc.Accept(&flat_producer);
     }
   }
   catch( boost::exception & e ) {
@@ -39,6 +39,22 @@ bool FastXMLVisitor::is_mandatory_constant(const XMLElement & element)
   return false;
 }
 
+const XMLElement* FastXMLVisitor::fieldOpElement(const XMLElement & element) const
+{
+  static const char* field_op_names[] = {
+    "constant","default","copy","increment","delta","tail"
+  };
+
+  for (const XMLElement* child = element.FirstChildElement(); child != 0; child = child->NextSiblingElement())
+  {
+    for (std::size_t i = 0; i < sizeof(field_op_names)/sizeof(field_op_names[0]); ++i) {
+      if (strcmp(child->Name(), field_op_names[i]) == 0)
+        return child;
+    }
+  }
+  return 0;
+}
+
 FastXMLVisitor::FastXMLVisitor()
 {
   num_fields_.push_back(0);
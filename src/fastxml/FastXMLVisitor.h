@@ -48,6 +48,9 @@ class FastXMLVisitor
     void save_context(const XMLElement & element);
     const char* get_optional_attr(const XMLElement & element, const char* attr_name, const char* default_value) const;
     bool is_mandatory_constant(const XMLElement & element);
+
+    // returns the field operator element of a field element, or 0 if it has no operator.
+    const XMLElement* fieldOpElement(const XMLElement & element) const;
     
     // if element has only a child except the length element, the child is returned; otherwise, it return 0.
     const XMLElement* only_child(const XMLElement & element);
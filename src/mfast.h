@@ -19,6 +19,9 @@
 #ifndef MFAST_H_4EMINVTV
 #define MFAST_H_4EMINVTV
 #include <mfast/field_instruction.h>
+#include <mfast/field_constants.h>
+#include <mfast/text_format.h>
+#include <mfast/fixed_decimal.h>
 #include <mfast/decimal_ref.h>
 #include <mfast/int_ref.h>
 #include <mfast/string_ref.h>
@@ -28,6 +31,13 @@
 #include <mfast/malloc_allocator.h>
 #include <mfast/field_visitor.h>
 #include <mfast/arena_allocator.h>
+#include <mfast/pool_allocator.h>
+#include <mfast/allocator_policy.h>
+#include <mfast/flat_layout.h>
+#include <mfast/message_snapshot.h>
+#include <mfast/shm_ring.h>
+#include <mfast/columnar.h>
+#include <mfast/columnar_writer.h>
 #include <mfast/field_comparator.h>
 #include <mfast/composite_field.h>
 #endif /* end of include guard: MFAST_H_4EMINVTV */
@@ -34,6 +34,60 @@ class unbouned_templateref_error
 
 };
 
+/// A field resolved by name or id in an aggregate instruction.
+///
+/// Resolving a field once and keeping the handle moves the lookup out of the message
+/// processing loop. A handle can only be used with aggregates of the instruction it
+/// was resolved from.
+class field_handle
+{
+  public:
+    field_handle()
+      : instruction_(0)
+      , index_(-1)
+    {
+    }
+
+    field_handle(const group_field_instruction* instruction, int index)
+      : instruction_(instruction)
+      , index_(index)
+    {
+    }
+
+    /// Returns false if the field was not found.
+    bool found() const
+    {
+      return index_ >= 0;
+    }
+
+    const group_field_instruction* instruction() const
+    {
+      return instruction_;
+    }
+
+    std::size_t index() const
+    {
+      assert(found());
+      return static_cast<std::size_t>(index_);
+    }
+
+    /// Resolve the field with the specified name in @a instruction.
+    static field_handle with_name(const group_field_instruction* instruction, const char* name)
+    {
+      return field_handle(instruction, instruction->find_subinstruction_index_by_name(name));
+    }
+
+    /// Resolve the field with the specified id in @a instruction.
+    static field_handle with_id(const group_field_instruction* instruction, uint32_t id)
+    {
+      return field_handle(instruction, instruction->find_subinstruction_index_by_id(id));
+    }
+
+  private:
+    const group_field_instruction* instruction_;
+    int index_;
+};
+
 class aggregate_cref
 {
   public:
@@ -51,12 +105,20 @@ class aggregate_cref
 
     field_cref operator[](size_t index) const;
 
+    /// Returns the field resolved by @a handle, which must be found and be
+    /// resolved from the instruction of this aggregate.
+    field_cref operator[](const field_handle& handle) const;
+
     /// return -1 if no such field is found
     int field_index_with_id(std::size_t id) const;
 
     /// return -1 if no such field is found
     int field_index_with_name(const char* name) const;
 
+    field_handle field_handle_with_id(std::size_t id) const;
+
+    field_handle field_handle_with_name(const char* name) const;
+
     const group_field_instruction* instruction() const;
 
     const field_instruction* subinstruction(size_t index) const;
@@ -105,6 +167,8 @@ class make_aggregate_mref
 
     field_mref operator[](size_t index) const;
 
+    field_mref operator[](const field_handle& handle) const;
+
     mfast::allocator* allocator() const;
 
 
@@ -282,6 +346,13 @@ aggregate_cref::operator[](size_t index) const
   return field_cref(&storage_array_[index],subinstruction(index));
 }
 
+inline field_cref
+aggregate_cref::operator[](const field_handle& handle) const
+{
+  assert(handle.instruction() == instruction());
+  return (*this)[handle.index()];
+}
+
 inline const group_field_instruction*
 aggregate_cref::instruction() const
 {
@@ -314,6 +385,18 @@ aggregate_cref::field_index_with_name(const char* name) const
   return instruction()->find_subinstruction_index_by_name(name);
 }
 
+inline field_handle
+aggregate_cref::field_handle_with_id(std::size_t id) const
+{
+  return field_handle::with_id(instruction(), static_cast<uint32_t>(id));
+}
+
+inline field_handle
+aggregate_cref::field_handle_with_name(const char* name) const
+{
+  return field_handle::with_name(instruction(), name);
+}
+
 ///////////////////////////////////////////////////////
 
 template <typename ConstRef>
@@ -361,6 +444,14 @@ make_aggregate_mref<ConstRef>::operator[](size_t index) const
                     this->instruction()->subinstruction(index));
 }
 
+template <typename ConstRef>
+inline field_mref
+make_aggregate_mref<ConstRef>::operator[](const field_handle& handle) const
+{
+  assert(handle.instruction() == this->instruction());
+  return (*this)[handle.index()];
+}
+
 template <typename ConstRef>
 inline mfast::allocator*
 make_aggregate_mref<ConstRef>::allocator() const
@@ -29,6 +29,11 @@ namespace mfast {
 class MFAST_EXPORT allocator
 {
   public:
+    allocator()
+      : type_tag_(0)
+    {
+    }
+
     /// Allocate exactly n bytes for the memory that is not subjected to regrow
     ///
     /// @param n The amount of memory in bytes to be allocated.
@@ -61,6 +66,24 @@ class MFAST_EXPORT allocator
     ///
     /// @return true if successful.
     virtual bool reset();
+
+    /// Returns the tag identifying the concrete allocator class, or 0 if it has none.
+    ///
+    /// allocator_policy compares it with the tag of the allocator class it is instantiated
+    /// with to call that class without virtual dispatch.
+    const void* type_tag() const
+    {
+      return type_tag_;
+    }
+
+  protected:
+    explicit allocator(const void* type_tag)
+      : type_tag_(type_tag)
+    {
+    }
+
+  private:
+    const void* type_tag_;
 };
 
 }
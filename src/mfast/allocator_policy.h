@@ -0,0 +1,75 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef ALLOCATOR_POLICY_H_Q8VZ3N1K
+#define ALLOCATOR_POLICY_H_Q8VZ3N1K
+
+#include <cstddef>
+#include "mfast/allocator.h"
+#include "mfast/arena_allocator.h"
+
+namespace mfast {
+
+/// A compile-time policy for obtaining memory from an allocator on the hot paths of the
+/// mutable references.
+///
+/// When the type_tag() of the allocator is Allocator::class_tag, the request is forwarded
+/// with a qualified (non-virtual) call so that an allocator defining its fast path inline,
+/// such as arena_allocator, gets it inlined at the call site. Any other allocator is called
+/// through the virtual allocator interface.
+template <typename Allocator>
+struct allocator_policy
+{
+  static void* allocate(allocator* alloc, std::size_t n)
+  {
+    if (alloc->type_tag() == &Allocator::class_tag)
+      return static_cast<Allocator*>(alloc)->Allocator::allocate(n);
+    return alloc->allocate(n);
+  }
+
+  static std::size_t reallocate(allocator* alloc, void*& pointer, std::size_t old_size, std::size_t new_size)
+  {
+    if (alloc->type_tag() == &Allocator::class_tag)
+      return static_cast<Allocator*>(alloc)->Allocator::reallocate(pointer, old_size, new_size);
+    return alloc->reallocate(pointer, old_size, new_size);
+  }
+};
+
+/// The runtime-polymorphic policy; every request goes through the virtual allocator interface.
+template <>
+struct allocator_policy<allocator>
+{
+  static void* allocate(allocator* alloc, std::size_t n)
+  {
+    return alloc->allocate(n);
+  }
+
+  static std::size_t reallocate(allocator* alloc, void*& pointer, std::size_t old_size, std::size_t new_size)
+  {
+    return alloc->reallocate(pointer, old_size, new_size);
+  }
+};
+
+/// The policy used by the mutable references and the field instructions when they allocate
+/// storage for strings, byte vectors, sequences and groups; arena_allocator bump allocation
+/// is inlined into those paths.
+typedef allocator_policy<arena_allocator> default_allocator_policy;
+
+}
+
+#endif /* end of include guard: ALLOCATOR_POLICY_H_Q8VZ3N1K */
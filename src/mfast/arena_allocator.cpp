@@ -18,8 +18,19 @@
 //
 #include "arena_allocator.h"
 #include <cstring>
+#include <cstdlib>
 #include <algorithm>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define MFAST_ARENA_USE_MMAP
+#endif
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
 namespace mfast {
   
 inline std::size_t align(std::size_t n, std::size_t x)
@@ -28,12 +39,140 @@ inline std::size_t align(std::size_t n, std::size_t x)
   return (n + y) & ~y; 
 }
 
+#ifdef MFAST_ARENA_USE_MMAP
+const std::size_t huge_page_size = 2*1024*1024;
+#endif
+
+#if defined(__linux__) && defined(SYS_mbind)
+// Set the preferred node of the pages in [addr, addr+len) without depending on libnuma.
+// MPOL_PREFERRED still falls back to other nodes when the preferred one runs out of memory.
+static void bind_to_numa_node(void* addr, std::size_t len, int node)
+{
+  const int mpol_preferred = 1;
+  const std::size_t bits_per_word = 8*sizeof(unsigned long);
+  unsigned long nodemask[4] = { 0, 0, 0, 0 };
+  if (node < 0 || static_cast<std::size_t>(node) >= 4*bits_per_word)
+    return;
+  nodemask[node/bits_per_word] = 1UL << (node % bits_per_word);
+  // binding is only a placement hint; ignore the failure on kernels without NUMA support
+  syscall(SYS_mbind, addr, len, mpol_preferred, nodemask, 4*bits_per_word+1, 0);
+}
+#endif
+
+int arena_allocator::numa_node_of_current_thread()
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+  unsigned cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, 0) == 0)
+    return static_cast<int>(node);
+#endif
+  return -1;
+}
+
+const char arena_allocator::class_tag = 0;
+
+arena_allocator::arena_allocator()
+  : allocator(&class_tag)
+  , free_list_head_(0)
+  , chunk_size_(default_chunk_size)
+  , use_huge_pages_(false)
+  , numa_node_(-1)
+  , allocated_bytes_(0)
+  , peak_allocated_bytes_(0)
+  , reserved_bytes_(0)
+  , num_chunks_(0)
+  , num_resets_(0)
+{
+  current_list_head_ = new_chunk(default_chunk_size, 0);
+}
+
+arena_allocator::arena_allocator(std::size_t chunk_size,
+                                 std::size_t initial_size,
+                                 bool        use_huge_pages,
+                                 int         numa_node)
+  : allocator(&class_tag)
+  , free_list_head_(0)
+  , chunk_size_(align(std::max<std::size_t>(chunk_size, 256), sizeof(uint64_t)))
+  , use_huge_pages_(use_huge_pages)
+  , numa_node_(numa_node)
+  , allocated_bytes_(0)
+  , peak_allocated_bytes_(0)
+  , reserved_bytes_(0)
+  , num_chunks_(0)
+  , num_resets_(0)
+{
+  current_list_head_ = new_chunk(align(std::max(initial_size, chunk_size_), chunk_size_), 0);
+  if (initial_size) {
+    // touch the reserved memory so that the pages are faulted in now rather than
+    // on the first messages
+    std::memset(current_list_head_->start_, 0, current_list_head_->size());
+  }
+}
+
+arena_allocator::memory_chunk*
+arena_allocator::new_chunk(std::size_t size, memory_chunk* next)
+{
+  void* block = 0;
+  std::size_t mapped_size = 0;
+
+#ifdef MFAST_ARENA_USE_MMAP
+  if (use_huge_pages_ || numa_node_ >= 0) {
+    // the chunk must come from mmap() so that its pages are not touched before being bound
+    mapped_size = align(size, use_huge_pages_ ? huge_page_size : 4096);
+# ifdef MAP_HUGETLB
+    if (use_huge_pages_) {
+      block = mmap(0, mapped_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+      if (block == MAP_FAILED)
+        block = 0;
+    }
+# endif
+    if (block == 0) {
+      // no preallocated huge pages; ask for transparent huge pages instead
+      block = mmap(0, mapped_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+      if (block == MAP_FAILED)
+        block = 0;
+# ifdef MADV_HUGEPAGE
+      else if (use_huge_pages_)
+        madvise(block, mapped_size, MADV_HUGEPAGE);
+# endif
+    }
+    if (block) {
+      size = mapped_size;
+# if defined(__linux__) && defined(SYS_mbind)
+      if (numa_node_ >= 0)
+        bind_to_numa_node(block, mapped_size, numa_node_);
+# endif
+    }
+    else {
+      mapped_size = 0;
+    }
+  }
+#endif
+
+  if (block == 0) {
+    block = std::malloc(size);
+    if (block == 0)
+      throw std::bad_alloc();
+  }
+
+  reserved_bytes_ += size;
+  ++num_chunks_;
+  return new (block) memory_chunk(size, next, mapped_size);
+}
+
 void arena_allocator::free_list(memory_chunk_base* head)
 {
   memory_chunk_base* tmp;
   while ( head ) {
     tmp = head->next_;
-    free(head);
+#ifdef MFAST_ARENA_USE_MMAP
+    if (head->mapped_size_) {
+      munmap(head, head->mapped_size_);
+      head = tmp;
+      continue;
+    }
+#endif
+    std::free(head);
     head = tmp;
   };
 }
@@ -44,55 +183,40 @@ arena_allocator::~arena_allocator()
   free_list(free_list_head_);
 }
 
-void* arena_allocator::allocate(std::size_t n)
+void* arena_allocator::allocate_from_new_chunk(std::size_t n)
 {
-  // align n to the multiple of pointer
-  n = align(n, sizeof(void*));
+  // current block does not have enough memory
 
-  if (current_list_head_->size() < n) {
-    // current block does not have enough memory
+  if (free_list_head_ && free_list_head_->size() >= n ) {
+    // The head of free_list is big enough,
+    // move the head of free_listto become the head of current_list
+    memory_chunk_base* tmp = free_list_head_;
+    free_list_head_ = static_cast<memory_chunk*>(free_list_head_->next_);
 
-    if (free_list_head_ && free_list_head_->size() >= n ) {
-      // The head of free_list is big enough,
-      // move the head of free_listto become the head of current_list
-      memory_chunk_base* tmp = free_list_head_;
-      free_list_head_ = static_cast<memory_chunk*>(free_list_head_->next_);
-
-      tmp->next_ = current_list_head_;
-      current_list_head_ = static_cast<memory_chunk*>(tmp);
-    }
-    else {
-      if (current_list_head_->size()  >= 64) {
-        // if current block is have plenty of free space, move it to the free_list
-        memory_chunk_base* tmp_current_list_head_head = current_list_head_->next_;
-        current_list_head_->next_ = free_list_head_;
-        free_list_head_ = static_cast<memory_chunk*>(current_list_head_);
-        current_list_head_ = static_cast<memory_chunk*>(tmp_current_list_head_head);
-      }
-      // allocate new memory chunk from the system
-      std::size_t new_chunk_size = align(n+ sizeof(memory_chunk) - sizeof(uint64_t), // minimum size for the new block
-                                         default_chunk_size); // make the size multiple of default_chunk_size
-
-      void* block = malloc(new_chunk_size);
-      current_list_head_ = new (block) memory_chunk(new_chunk_size, current_list_head_);
+    tmp->next_ = current_list_head_;
+    current_list_head_ = static_cast<memory_chunk*>(tmp);
+  }
+  else {
+    if (current_list_head_->size()  >= 64) {
+      // if current block is have plenty of free space, move it to the free_list
+      memory_chunk_base* tmp_current_list_head_head = current_list_head_->next_;
+      current_list_head_->next_ = free_list_head_;
+      free_list_head_ = static_cast<memory_chunk*>(current_list_head_);
+      current_list_head_ = static_cast<memory_chunk*>(tmp_current_list_head_head);
     }
+    // allocate new memory chunk from the system
+    std::size_t new_chunk_size = align(n+ sizeof(memory_chunk) - sizeof(uint64_t), // minimum size for the new block
+                                       chunk_size_); // make the size multiple of chunk_size_
+
+    current_list_head_ = new_chunk(new_chunk_size, current_list_head_);
   }
+
   char* result = current_list_head_->start_;
   current_list_head_->start_ += n;
+  allocated_bytes_ += n;
   return result;
 }
 
-std::size_t
-arena_allocator::reallocate(void*& pointer, std::size_t old_size, std::size_t new_size)
-{
-  // make the new_size at least 64 bytes
-  new_size = align(static_cast<std::size_t>(new_size)*2, 64);
-  void* old_pointer = pointer;
-  pointer = this->allocate(new_size);
-  std::memcpy(pointer, old_pointer, old_size);
-  return new_size;
-}
-
 
 bool arena_allocator::reset()
 {
@@ -110,9 +234,35 @@ bool arena_allocator::reset()
   // only keeps the head of current_list_head_ list, the reset of the current_list moves to the free_list
   current_list_head_->next_ = 0;
   current_list_head_->start_ = reinterpret_cast<char*>(current_list_head_->user_memory);
+
+  peak_allocated_bytes_ = std::max(peak_allocated_bytes_, allocated_bytes_);
+  allocated_bytes_ = 0;
+  ++num_resets_;
   return true;
 }
 
+arena_allocator::statistics
+arena_allocator::stats() const
+{
+  statistics result;
+  result.allocated_bytes = allocated_bytes_;
+  result.peak_allocated_bytes = std::max(peak_allocated_bytes_, allocated_bytes_);
+  result.reserved_bytes = reserved_bytes_;
+  result.num_chunks = num_chunks_;
+  result.num_resets = num_resets_;
+  return result;
+}
+
+bool arena_allocator::owns(const void* pointer) const
+{
+  const char* p = static_cast<const char*>(pointer);
+  for (const memory_chunk_base* chunk = current_list_head_; chunk != 0; chunk = chunk->next_) {
+    if (p >= reinterpret_cast<const char*>(chunk->user_memory) && p < chunk->start_)
+      return true;
+  }
+  return false;
+}
+
 void  arena_allocator::deallocate(void* /* pointer */, std::size_t)
 {
 }
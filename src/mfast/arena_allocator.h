@@ -23,6 +23,7 @@
 #include <stdint.h>
 #include <cassert>
 #include <cstddef>
+#include <cstring>
 #include "allocator.h"
 namespace mfast {
 
@@ -32,9 +33,44 @@ class MFAST_EXPORT arena_allocator
   : public allocator
 {
 public:
+  /// Memory usage counters of an arena_allocator.
+  struct statistics
+  {
+    /// The number of bytes allocated since the last reset().
+    std::size_t allocated_bytes;
+    /// The largest number of bytes allocated between two consecutive reset() calls.
+    std::size_t peak_allocated_bytes;
+    /// The number of bytes of all memory chunks obtained from the system.
+    std::size_t reserved_bytes;
+    /// The number of memory chunks obtained from the system.
+    std::size_t num_chunks;
+    /// The number of times reset() has been called.
+    std::size_t num_resets;
+  };
+
   arena_allocator();
+
+  /// Construct an arena_allocator with explicit memory chunk settings.
+  ///
+  /// @param chunk_size The size in bytes of memory chunks obtained from the system; larger
+  ///                   requests get a chunk rounded up to a multiple of @a chunk_size.
+  /// @param initial_size The number of bytes to obtain and touch at construction time so that
+  ///                     early allocations do not trigger system calls or page faults.
+  /// @param use_huge_pages Back memory chunks with huge pages. On Linux, MAP_HUGETLB is tried
+  ///                       first, then transparent huge pages via madvise(). Falls back to
+  ///                       malloc() when neither is available.
+  /// @param numa_node The NUMA node memory chunks should be placed on. On Linux, the chunks are
+  ///                  bound to the node with mbind() before they are touched; elsewhere, or
+  ///                  when @a numa_node is negative, placement follows the first-touch policy.
+  explicit arena_allocator(std::size_t chunk_size,
+                           std::size_t initial_size = 0,
+                           bool        use_huge_pages = false,
+                           int         numa_node = -1);
   ~arena_allocator();
 
+  /// Returns the NUMA node of the CPU the calling thread is running on, or -1 if unknown.
+  static int numa_node_of_current_thread();
+
   virtual void* allocate(std::size_t n);
   virtual std::size_t reallocate(void*& pointer, std::size_t old_size, std::size_t new_size);
 
@@ -42,6 +78,15 @@ public:
   virtual bool reset();
   virtual void deallocate(void* pointer, std::size_t);
 
+  /// Returns the memory usage counters.
+  statistics stats() const;
+
+  /// Returns true if @a pointer lies in a memory block allocated since the last reset().
+  bool owns(const void* pointer) const;
+
+  /// The type_tag() of every arena_allocator. Classes derived from arena_allocator carry it
+  /// as well and therefore must not override allocate() or reallocate().
+  static const char class_tag;
 
 
 private:
@@ -50,6 +95,7 @@ private:
     memory_chunk_base* next_;
     char* end_;
     char* start_;
+    std::size_t mapped_size_; // non-zero if the chunk is obtained from mmap()
     uint64_t user_memory[1];
   };
   
@@ -62,9 +108,10 @@ private:
     : memory_chunk_base 
   {
  
-    memory_chunk(std::size_t size, memory_chunk* next)
+    memory_chunk(std::size_t size, memory_chunk* next, std::size_t mapped_size)
     {
       next_ = next;
+      mapped_size_ = mapped_size;
       end_ = reinterpret_cast<char*>(this) + size;
       start_ = reinterpret_cast<char*>(user_memory);
       assert(size % sizeof(uint64_t) == 0);
@@ -76,6 +123,9 @@ private:
   };
 
   void free_list(memory_chunk_base* list);
+  memory_chunk* new_chunk(std::size_t size, memory_chunk* next);
+  // Called by allocate() when the head of current_list cannot hold @a n bytes.
+  void* allocate_from_new_chunk(std::size_t n);
 
   // We maintian two singlely linked list of memory chunks : current_list and free_list.
   // The head of current_list is where new smaller memory blocks are allocated from. The
@@ -84,7 +134,16 @@ private:
   // from if the available size of the head of current_list is not enough.
   memory_chunk* current_list_head_;
   memory_chunk* free_list_head_;
-  
+
+  std::size_t chunk_size_;
+  bool use_huge_pages_;
+  int numa_node_;
+  std::size_t allocated_bytes_;
+  std::size_t peak_allocated_bytes_;
+  std::size_t reserved_bytes_;
+  std::size_t num_chunks_;
+  std::size_t num_resets_;
+
 public:
   enum {
     default_chunk_size=4096,
@@ -92,12 +151,33 @@ public:
   };
 };
 
-inline
-arena_allocator::arena_allocator()
-  : free_list_head_(0)
+// allocate() and reallocate() are defined inline so that callers which know the
+// allocator is an arena_allocator (e.g. through default_allocator_policy) get the
+// pointer bump inlined instead of a virtual call.
+
+inline void* arena_allocator::allocate(std::size_t n)
+{
+  // align n to the multiple of pointer
+  n = (n + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+
+  if (current_list_head_->size() < n)
+    return allocate_from_new_chunk(n);
+
+  char* result = current_list_head_->start_;
+  current_list_head_->start_ += n;
+  allocated_bytes_ += n;
+  return result;
+}
+
+inline std::size_t
+arena_allocator::reallocate(void*& pointer, std::size_t old_size, std::size_t new_size)
 {
-  void* block = malloc(default_chunk_size);
-  current_list_head_ = new (block) memory_chunk(default_chunk_size, 0);
+  // make the new_size at least 64 bytes
+  new_size = (new_size*2 + 63) & ~static_cast<std::size_t>(63);
+  void* old_pointer = pointer;
+  pointer = this->arena_allocator::allocate(new_size);
+  std::memcpy(pointer, old_pointer, old_size);
+  return new_size;
 }
 
 }
@@ -0,0 +1,66 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef ALLOCATION_TRACKING_HOOK_H_Q4JX9B2E
+#define ALLOCATION_TRACKING_HOOK_H_Q4JX9B2E
+
+#include "fast_decoder.h"
+#include "mfast/tracking_allocator.h"
+
+namespace mfast
+{
+
+/// A decoder_hook which attributes the requests to a tracking_allocator to the template and
+/// field being decoded.
+///
+/// Usage:
+///   tracking_allocator alloc(malloc_allocator::instance());
+///   allocation_tracking_hook hook(&alloc);
+///   fast_decoder decoder(&alloc);
+///   decoder.hook(&hook);
+///   ...
+///   alloc.report(std::cout);
+class allocation_tracking_hook
+  : public decoder_hook
+{
+  public:
+    explicit allocation_tracking_hook(tracking_allocator* alloc)
+      : alloc_(alloc)
+      , template_(0)
+    {
+    }
+
+    virtual void template_begin(const template_instruction* instruction)
+    {
+      template_ = instruction;
+      alloc_->context(instruction, 0);
+    }
+
+    virtual void field_begin(const field_instruction* instruction)
+    {
+      alloc_->context(template_, instruction);
+    }
+
+  private:
+    tracking_allocator* alloc_;
+    const template_instruction* template_;
+};
+
+}
+
+#endif /* end of include guard: ALLOCATION_TRACKING_HOOK_H_Q4JX9B2E */
@@ -0,0 +1,692 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include "binary_templates_description.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define MFAST_HAS_MMAP
+#endif
+
+namespace mfast
+{
+
+namespace {
+
+const char binary_templates_magic[8] = { 'M', 'F', 'T', 'P', 'L', '1', '\0', '\0' };
+
+// the length of a null string pointer, as opposed to an empty string
+const uint32_t null_string_length = 0xFFFFFFFFU;
+
+class binary_templates_writer
+  : public field_instruction_visitor
+{
+  public:
+    binary_templates_writer(std::ostream& os)
+      : os_(os)
+    {
+    }
+
+    void put_u8(uint8_t v)
+    {
+      os_.put(static_cast<char>(v));
+    }
+
+    void put_u16(uint16_t v)
+    {
+      os_.write(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+
+    void put_u32(uint32_t v)
+    {
+      os_.write(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+
+    void put_string(const char* str)
+    {
+      if (str == 0) {
+        put_u32(null_string_length);
+        return;
+      }
+      uint32_t len = static_cast<uint32_t>(std::strlen(str));
+      put_u32(len);
+      os_.write(str, len + 1);
+    }
+
+    // numeric values are stored as they are; they contain no pointers
+    void put_numeric_value(const value_storage& v)
+    {
+      os_.write(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+
+    // len_ of the string or byte vector, followed by its content and a null terminator
+    void put_array_value(const value_storage& v)
+    {
+      put_u32(v.of_array.len_);
+      if (v.of_array.len_ > 0) {
+        os_.write(static_cast<const char*>(v.of_array.content_), v.array_length());
+        os_.put('\0');
+      }
+    }
+
+    void put_context(const op_context_t* context)
+    {
+      put_u8(context != 0);
+      if (context) {
+        put_string(context->key_);
+        put_string(context->ns_);
+        put_string(context->dictionary_);
+      }
+    }
+
+    void put_field(const field_instruction* inst, field_type_enum_t field_type)
+    {
+      put_u8(static_cast<uint8_t>(field_type));
+      put_u16(inst->field_index());
+      put_u8(static_cast<uint8_t>(inst->field_operator()));
+      put_u8(inst->optional());
+      put_u32(inst->id());
+      put_string(inst->name());
+      put_string(inst->ns());
+    }
+
+    void put_aggregate(const aggregate_instruction_base* inst)
+    {
+      put_string(inst->dictionary_);
+      put_string(inst->typeref_name_);
+      put_string(inst->typeref_ns_);
+      put_u32(inst->subinstructions_count());
+      for (uint32_t i = 0; i < inst->subinstructions_count(); ++i)
+        inst->subinstruction(i)->accept(*this, 0);
+    }
+
+    template <typename IntegerInstruction>
+    void put_integer(const IntegerInstruction* inst)
+    {
+      put_field(inst, inst->field_type());
+      put_context(inst->op_context());
+      put_numeric_value(inst->initial_value());
+    }
+
+    virtual void visit(const int32_field_instruction* inst, void*)
+    {
+      put_integer(inst);
+    }
+
+    virtual void visit(const uint32_field_instruction* inst, void*)
+    {
+      put_integer(inst);
+    }
+
+    virtual void visit(const int64_field_instruction* inst, void*)
+    {
+      put_integer(inst);
+    }
+
+    virtual void visit(const uint64_field_instruction* inst, void*)
+    {
+      put_integer(inst);
+    }
+
+    virtual void visit(const decimal_field_instruction* inst, void*)
+    {
+      put_integer(inst);
+      if (inst->field_type() == field_type_exponent) {
+        const mantissa_field_instruction* mantissa = inst->mantissa_instruction();
+        put_u8(static_cast<uint8_t>(mantissa->field_operator()));
+        put_context(mantissa->op_context());
+        put_numeric_value(mantissa->initial_value());
+      }
+    }
+
+    void put_string_field(const string_field_instruction* inst)
+    {
+      put_field(inst, inst->field_type());
+      put_context(inst->op_context());
+      put_array_value(inst->initial_value());
+      put_u32(inst->capacity());
+    }
+
+    virtual void visit(const ascii_field_instruction* inst, void*)
+    {
+      put_string_field(inst);
+    }
+
+    virtual void visit(const unicode_field_instruction* inst, void*)
+    {
+      put_string_field(inst);
+      put_u32(inst->length_id());
+      put_string(inst->length_name());
+      put_string(inst->length_ns());
+    }
+
+    virtual void visit(const byte_vector_field_instruction* inst, void*)
+    {
+      put_string_field(inst);
+      put_u32(inst->length_id());
+      put_string(inst->length_name());
+      put_string(inst->length_ns());
+    }
+
+    virtual void visit(const group_field_instruction* inst, void*)
+    {
+      put_field(inst, field_type_group);
+      put_aggregate(inst);
+    }
+
+    virtual void visit(const sequence_field_instruction* inst, void*)
+    {
+      put_field(inst, field_type_sequence);
+      put_u32(inst->capacity());
+      inst->length_instruction()->accept(*this, 0);
+      put_aggregate(inst);
+    }
+
+    virtual void visit(const template_instruction* inst, void*)
+    {
+      put_field(inst, field_type_template);
+      put_string(inst->template_ns());
+      put_u8(inst->has_reset_attribute());
+      put_aggregate(inst);
+    }
+
+    virtual void visit(const templateref_instruction* inst, void*)
+    {
+      put_field(inst, field_type_templateref);
+    }
+
+  private:
+    std::ostream& os_;
+};
+
+// Reads the records written by binary_templates_writer and constructs the instructions in
+// an arena; strings are used in place.
+class binary_templates_reader
+{
+  public:
+    binary_templates_reader(const char* data, std::size_t size, arena_allocator* alloc)
+      : cur_(data)
+      , last_(data + size)
+      , alloc_(alloc)
+    {
+    }
+
+    bool at_end() const
+    {
+      return cur_ == last_;
+    }
+
+    const char* get(std::size_t n)
+    {
+      if (static_cast<std::size_t>(last_ - cur_) < n)
+        BOOST_THROW_EXCEPTION(binary_templates_error("truncated precompiled templates"));
+      const char* result = cur_;
+      cur_ += n;
+      return result;
+    }
+
+    uint8_t get_u8()
+    {
+      return static_cast<uint8_t>(*get(1));
+    }
+
+    uint16_t get_u16()
+    {
+      uint16_t v;
+      std::memcpy(&v, get(sizeof(v)), sizeof(v));
+      return v;
+    }
+
+    uint32_t get_u32()
+    {
+      uint32_t v;
+      std::memcpy(&v, get(sizeof(v)), sizeof(v));
+      return v;
+    }
+
+    const char* get_string()
+    {
+      uint32_t len = get_u32();
+      if (len == null_string_length)
+        return 0;
+      const char* str = get(static_cast<std::size_t>(len) + 1);
+      if (str[len] != '\0')
+        BOOST_THROW_EXCEPTION(binary_templates_error("malformed string in precompiled templates"));
+      return str;
+    }
+
+    value_storage get_numeric_value()
+    {
+      value_storage v;
+      std::memcpy(&v, get(sizeof(v)), sizeof(v));
+      return v;
+    }
+
+    string_value_storage get_array_value()
+    {
+      string_value_storage v;
+      uint32_t len = get_u32();
+      if (len > 0) {
+        const char* content = get(len);
+        if (content[len-1] != '\0')
+          BOOST_THROW_EXCEPTION(binary_templates_error("malformed string in precompiled templates"));
+        v = string_value_storage(content, len-1);
+      }
+      return v;
+    }
+
+    const op_context_t* get_context()
+    {
+      if (get_u8() == 0)
+        return 0;
+      op_context_t* context = new (*alloc_)op_context_t;
+      context->key_ = get_string();
+      context->ns_ = get_string();
+      context->dictionary_ = get_string();
+      return context;
+    }
+
+    struct field_attributes
+    {
+      field_type_enum_t field_type;
+      uint16_t field_index;
+      operator_enum_t field_operator;
+      presence_enum_t presence;
+      uint32_t id;
+      const char* name;
+      const char* ns;
+    };
+
+    field_attributes get_field()
+    {
+      field_attributes attr;
+      attr.field_type = static_cast<field_type_enum_t>(get_u8());
+      attr.field_index = get_u16();
+      attr.field_operator = get_operator();
+      attr.presence = get_u8() ? presence_optional : presence_mandatory;
+      attr.id = get_u32();
+      attr.name = get_string();
+      attr.ns = get_string();
+      return attr;
+    }
+
+    operator_enum_t get_operator()
+    {
+      uint8_t op = get_u8();
+      if (op > operator_tail)
+        BOOST_THROW_EXCEPTION(binary_templates_error("invalid field operator in precompiled templates"));
+      return static_cast<operator_enum_t>(op);
+    }
+
+    template <typename T>
+    field_instruction* get_integer(const field_attributes& attr)
+    {
+      const op_context_t* context = get_context();
+      int_value_storage<T> initial_value;
+      initial_value.storage_ = get_numeric_value();
+      return new (*alloc_)typename instruction_trait<T>::type(attr.field_index,
+                                                              attr.field_operator,
+                                                              attr.presence,
+                                                              attr.id,
+                                                              attr.name,
+                                                              attr.ns,
+                                                              context,
+                                                              initial_value);
+    }
+
+    field_instruction* get_decimal(const field_attributes& attr)
+    {
+      const op_context_t* context = get_context();
+      decimal_value_storage initial_value;
+      initial_value.storage_ = get_numeric_value();
+
+      if (attr.field_type == field_type_decimal) {
+        return new (*alloc_)decimal_field_instruction(attr.field_index,
+                                                      attr.field_operator,
+                                                      attr.presence,
+                                                      attr.id,
+                                                      attr.name,
+                                                      attr.ns,
+                                                      context,
+                                                      initial_value);
+      }
+
+      operator_enum_t mantissa_operator = get_operator();
+      const op_context_t* mantissa_context = get_context();
+      int_value_storage<int64_t> mantissa_initial_value;
+      mantissa_initial_value.storage_ = get_numeric_value();
+      mantissa_field_instruction* mantissa_instruction =
+        new (*alloc_)mantissa_field_instruction(mantissa_operator,
+                                                mantissa_context,
+                                                mantissa_initial_value);
+
+      return new (*alloc_)decimal_field_instruction(attr.field_index,
+                                                    attr.field_operator,
+                                                    attr.presence,
+                                                    attr.id,
+                                                    attr.name,
+                                                    attr.ns,
+                                                    context,
+                                                    mantissa_instruction,
+                                                    initial_value);
+    }
+
+    field_instruction* get_string_field(const field_attributes& attr)
+    {
+      const op_context_t* context = get_context();
+      string_value_storage initial_value = get_array_value();
+      uint32_t capacity = get_u32();
+
+      if (attr.field_type == field_type_ascii_string) {
+        return new (*alloc_)ascii_field_instruction(attr.field_index,
+                                                    attr.field_operator,
+                                                    attr.presence,
+                                                    attr.id,
+                                                    attr.name,
+                                                    attr.ns,
+                                                    context,
+                                                    initial_value,
+                                                    capacity);
+      }
+
+      uint32_t length_id = get_u32();
+      const char* length_name = get_string();
+      const char* length_ns = get_string();
+
+      if (attr.field_type == field_type_unicode_string) {
+        return new (*alloc_)unicode_field_instruction(attr.field_index,
+                                                      attr.field_operator,
+                                                      attr.presence,
+                                                      attr.id,
+                                                      attr.name,
+                                                      attr.ns,
+                                                      context,
+                                                      initial_value,
+                                                      length_id,
+                                                      length_name,
+                                                      length_ns,
+                                                      capacity);
+      }
+
+      byte_vector_value_storage byte_vector_initial_value;
+      byte_vector_initial_value.storage_ = initial_value.storage_;
+      return new (*alloc_)byte_vector_field_instruction(attr.field_index,
+                                                        attr.field_operator,
+                                                        attr.presence,
+                                                        attr.id,
+                                                        attr.name,
+                                                        attr.ns,
+                                                        context,
+                                                        byte_vector_initial_value,
+                                                        length_id,
+                                                        length_name,
+                                                        length_ns,
+                                                        capacity);
+    }
+
+    struct aggregate_attributes
+    {
+      const char* dictionary;
+      const char* typeref_name;
+      const char* typeref_ns;
+      const_instruction_ptr_t* subinstructions;
+      uint32_t subinstructions_count;
+    };
+
+    aggregate_attributes get_aggregate()
+    {
+      aggregate_attributes attr;
+      attr.dictionary = get_string();
+      attr.typeref_name = get_string();
+      attr.typeref_ns = get_string();
+      attr.subinstructions_count = get_u32();
+      // every record takes more than one byte; this rejects absurd counts before allocating
+      if (attr.subinstructions_count > static_cast<std::size_t>(last_ - cur_))
+        BOOST_THROW_EXCEPTION(binary_templates_error("truncated precompiled templates"));
+      attr.subinstructions = new (*alloc_)const_instruction_ptr_t[attr.subinstructions_count];
+      for (uint32_t i = 0; i < attr.subinstructions_count; ++i)
+        attr.subinstructions[i] = get_instruction();
+      return attr;
+    }
+
+    field_instruction* get_group(const field_attributes& attr)
+    {
+      aggregate_attributes aggregate = get_aggregate();
+      group_field_instruction* instruction =
+        new (*alloc_)group_field_instruction(attr.field_index,
+                                             attr.presence,
+                                             attr.id,
+                                             attr.name,
+                                             attr.ns,
+                                             aggregate.dictionary,
+                                             aggregate.subinstructions,
+                                             aggregate.subinstructions_count,
+                                             aggregate.typeref_name,
+                                             aggregate.typeref_ns);
+      instruction->build_subinstruction_index(alloc_);
+      return instruction;
+    }
+
+    field_instruction* get_sequence(const field_attributes& attr)
+    {
+      uint32_t capacity = get_u32();
+      field_attributes length_attr = get_field();
+      if (length_attr.field_type != field_type_uint32)
+        BOOST_THROW_EXCEPTION(binary_templates_error("invalid sequence length in precompiled templates"));
+      uint32_field_instruction* length_instruction =
+        static_cast<uint32_field_instruction*>(get_integer<uint32_t>(length_attr));
+
+      aggregate_attributes aggregate = get_aggregate();
+      sequence_field_instruction* instruction =
+        new (*alloc_)sequence_field_instruction(attr.field_index,
+                                                attr.presence,
+                                                attr.id,
+                                                attr.name,
+                                                attr.ns,
+                                                aggregate.dictionary,
+                                                aggregate.subinstructions,
+                                                aggregate.subinstructions_count,
+                                                length_instruction,
+                                                aggregate.typeref_name,
+                                                aggregate.typeref_ns,
+                                                capacity);
+      instruction->build_subinstruction_index(alloc_);
+      return instruction;
+    }
+
+    template_instruction* get_template()
+    {
+      field_attributes attr = get_field();
+      if (attr.field_type != field_type_template)
+        BOOST_THROW_EXCEPTION(binary_templates_error("invalid template record in precompiled templates"));
+      const char* template_ns = get_string();
+      bool reset = get_u8() != 0;
+      aggregate_attributes aggregate = get_aggregate();
+      template_instruction* instruction =
+        new (*alloc_)template_instruction(attr.id,
+                                          attr.name,
+                                          attr.ns,
+                                          template_ns,
+                                          aggregate.dictionary,
+                                          aggregate.subinstructions,
+                                          aggregate.subinstructions_count,
+                                          reset,
+                                          aggregate.typeref_name,
+                                          aggregate.typeref_ns);
+      instruction->build_subinstruction_index(alloc_);
+      return instruction;
+    }
+
+    field_instruction* get_instruction()
+    {
+      field_attributes attr = get_field();
+      switch (attr.field_type) {
+        case field_type_int32:
+          return get_integer<int32_t>(attr);
+        case field_type_uint32:
+          return get_integer<uint32_t>(attr);
+        case field_type_int64:
+          return get_integer<int64_t>(attr);
+        case field_type_uint64:
+          return get_integer<uint64_t>(attr);
+        case field_type_decimal:
+        case field_type_exponent:
+          return get_decimal(attr);
+        case field_type_ascii_string:
+        case field_type_unicode_string:
+        case field_type_byte_vector:
+          return get_string_field(attr);
+        case field_type_group:
+          return get_group(attr);
+        case field_type_sequence:
+          return get_sequence(attr);
+        case field_type_templateref:
+          if (attr.name && attr.name[0])
+            return new (*alloc_)templateref_instruction(attr.field_index, attr.name, attr.ns);
+          return new (*alloc_)templateref_instruction(attr.field_index, attr.presence);
+        default:
+          BOOST_THROW_EXCEPTION(binary_templates_error("invalid instruction record in precompiled templates"));
+      }
+    }
+
+  private:
+    const char* cur_;
+    const char* last_;
+    arena_allocator* alloc_;
+};
+
+void throw_file_error(const char* filename, const char* api)
+{
+  int error = errno;
+  BOOST_THROW_EXCEPTION(binary_templates_error("unable to read the precompiled templates")
+                        << boost::errinfo_file_name(filename)
+                        << boost::errinfo_api_function(api)
+                        << boost::errinfo_errno(error));
+}
+
+}
+
+void write_binary_templates(std::ostream& os, const templates_description& description)
+{
+  binary_templates_writer writer(os);
+  os.write(binary_templates_magic, sizeof(binary_templates_magic));
+  writer.put_string(description.ns());
+  writer.put_string(description.template_ns());
+  writer.put_string(description.dictionary());
+  writer.put_u32(description.size());
+  for (uint32_t i = 0; i < description.size(); ++i)
+    description[i]->accept(writer, 0);
+}
+
+binary_templates_description::binary_templates_description(const char* data, std::size_t size)
+  : mapping_(0)
+  , mapping_size_(0)
+{
+  load(data, size);
+}
+
+binary_templates_description::binary_templates_description(const char* filename)
+  : mapping_(0)
+  , mapping_size_(0)
+{
+#ifdef MFAST_HAS_MMAP
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1)
+    throw_file_error(filename, "open");
+
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    throw_file_error(filename, "fstat");
+  }
+
+  mapping_size_ = static_cast<std::size_t>(st.st_size);
+  if (mapping_size_ > 0) {
+    void* addr = mmap(0, mapping_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      close(fd);
+      throw_file_error(filename, "mmap");
+    }
+    mapping_ = addr;
+  }
+  close(fd);
+
+  try {
+    load(static_cast<const char*>(mapping_), mapping_size_);
+  }
+  catch (...) {
+    if (mapping_)
+      munmap(mapping_, mapping_size_);
+    throw;
+  }
+#else
+  std::FILE* fp = std::fopen(filename, "rb");
+  if (fp == 0)
+    throw_file_error(filename, "fopen");
+
+  std::fseek(fp, 0, SEEK_END);
+  std::size_t size = static_cast<std::size_t>(std::ftell(fp));
+  std::rewind(fp);
+  // without mmap, the content is kept in the arena together with the instructions
+  char* content = static_cast<char*>(alloc_.allocate(size ? size : 1));
+  std::size_t read_size = std::fread(content, 1, size, fp);
+  std::fclose(fp);
+  if (read_size != size)
+    throw_file_error(filename, "fread");
+
+  load(content, size);
+#endif
+}
+
+binary_templates_description::~binary_templates_description()
+{
+#ifdef MFAST_HAS_MMAP
+  if (mapping_)
+    munmap(mapping_, mapping_size_);
+#endif
+}
+
+void binary_templates_description::load(const char* data, std::size_t size)
+{
+  binary_templates_reader reader(data, size, &alloc_);
+  if (std::memcmp(reader.get(sizeof(binary_templates_magic)), binary_templates_magic, sizeof(binary_templates_magic)) != 0)
+    BOOST_THROW_EXCEPTION(binary_templates_error("not in the precompiled template format"));
+
+  ns_ = reader.get_string();
+  template_ns_ = reader.get_string();
+  dictionary_ = reader.get_string();
+  instructions_count_ = reader.get_u32();
+  if (instructions_count_ > size)
+    BOOST_THROW_EXCEPTION(binary_templates_error("truncated precompiled templates"));
+
+  const template_instruction** instructions = new (alloc_)const template_instruction*[instructions_count_];
+  for (uint32_t i = 0; i < instructions_count_; ++i)
+    instructions[i] = reader.get_template();
+  instructions_ = instructions;
+
+  if (!reader.at_end())
+    BOOST_THROW_EXCEPTION(binary_templates_error("trailing data after precompiled templates"));
+}
+
+}
@@ -0,0 +1,101 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef BINARY_TEMPLATES_DESCRIPTION_H_T7QW2MXE
+#define BINARY_TEMPLATES_DESCRIPTION_H_T7QW2MXE
+
+#include <cstddef>
+#include <ostream>
+#include <exception>
+#include <boost/exception/all.hpp>
+#include "mfast_coder_export.h"
+
+#include "mfast/field_instruction.h"
+#include "mfast/arena_allocator.h"
+
+namespace mfast
+{
+
+/// Thrown when precompiled templates cannot be read or are malformed.
+///
+/// For a file, its name is attached as boost::errinfo_file_name, and the failing system
+/// call and errno as boost::errinfo_api_function and boost::errinfo_errno when available.
+class MFAST_CODER_EXPORT binary_templates_error
+  : public virtual boost::exception, public virtual std::exception
+{
+  public:
+    binary_templates_error(const char* reason)
+      : reason_(reason)
+    {
+    }
+
+    virtual const char* what() const throw()
+    {
+      return reason_;
+    }
+
+  private:
+    const char* reason_;
+};
+
+/// Write @a description in the precompiled template format read by binary_templates_description.
+///
+/// The format is a depth-first dump of the instructions in the native byte order: the magic
+/// "MFTPL1\0\0", the namespace, template namespace and dictionary of the description, the
+/// number of templates and then one record per instruction. A record starts with the
+/// field_type_enum_t of the instruction, followed by its attributes; the records of the
+/// subinstructions follow the record of their group, sequence or template. Strings are
+/// stored as their length, their characters and a null terminator, so that the loader can
+/// use them in place.
+MFAST_CODER_EXPORT void write_binary_templates(std::ostream&                os,
+                                               const templates_description& description);
+
+/// Templates loaded from the precompiled format written by write_binary_templates().
+///
+/// Loading does not parse XML or convert any text; the instructions are constructed directly
+/// from the records and refer to the names and initial values of strings in place.
+class MFAST_CODER_EXPORT binary_templates_description
+  : public templates_description
+{
+  public:
+    /// Load the templates from the @a size bytes at @a data, which must outlive this object.
+    /// @throws binary_templates_error if the data is not in the precompiled template format.
+    binary_templates_description(const char* data, std::size_t size);
+
+    /// Map the file @a filename and load the templates from it; the file stays mapped
+    /// until this object is destroyed.
+    /// @throws binary_templates_error if the file cannot be read or is not in the
+    ///         precompiled template format.
+    explicit binary_templates_description(const char* filename);
+
+    ~binary_templates_description();
+
+  private:
+    binary_templates_description(const binary_templates_description&);
+    binary_templates_description& operator = (const binary_templates_description&);
+
+    void load(const char* data, std::size_t size);
+
+    arena_allocator alloc_;
+    void* mapping_;
+    std::size_t mapping_size_;
+};
+
+}
+
+#endif /* end of include guard: BINARY_TEMPLATES_DESCRIPTION_H_T7QW2MXE */
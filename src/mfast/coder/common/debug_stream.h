@@ -32,6 +32,11 @@ struct debug_stream {
   void set(std::ostream*) {
   }
 
+  bool enabled() const
+  {
+    return false;
+  }
+
 
   template <class T>
   const debug_stream& operator<<(const T&) const
@@ -66,6 +71,11 @@ class debug_stream
       os_ = os;
     }
 
+    bool enabled() const
+    {
+      return os_ != 0;
+    }
+
     template <class T>
     const debug_stream& operator<<(const T& t ) const
     {
@@ -106,6 +106,34 @@ std::string qualified_name(const char* ns, const char* name)
   return result;
 }
 
+void match_dictionary_entries(const dictionary_index_t& from,
+                              const dictionary_index_t& to,
+                              dictionary_transfer_t&    result)
+{
+  // both indices are sorted by the qualified key
+  dictionary_index_t::const_iterator from_itr = from.begin();
+  dictionary_index_t::const_iterator to_itr = to.begin();
+  while (from_itr != from.end() && to_itr != to.end()) {
+    if (from_itr->first < to_itr->first) {
+      ++from_itr;
+    }
+    else if (to_itr->first < from_itr->first) {
+      ++to_itr;
+    }
+    else {
+      if (from_itr->second.field_type_ == to_itr->second.field_type_) {
+        dictionary_transfer_entry entry;
+        entry.field_type_ = to_itr->second.field_type_;
+        entry.from_ = from_itr->second.storage_;
+        entry.to_ = to_itr->second.storage_;
+        result.push_back(entry);
+      }
+      ++from_itr;
+      ++to_itr;
+    }
+  }
+}
+
 dictionary_builder::dictionary_builder(dictionary_resetter&        resetter,
                                        template_id_map_t&          templates_map,
                                        arena_allocator*            allocator,
@@ -169,6 +197,7 @@ void dictionary_builder::build_group(const field_instruction*          fi,
   }
 
   dest->set_subinstructions(subinstructions, instructions_count);
+  dest->build_subinstruction_index(alloc_);
 
   current_type_ = inherited_type;
   current_ns_ = inherited_ns;
@@ -236,6 +265,7 @@ void dictionary_builder::visit(const group_field_instruction* src_inst, void* de
       if (itr != template_name_map_.end()) {
         dest->set_subinstructions(itr->second->subinstructions(),
                                   itr->second->subinstructions_count());
+        dest->build_subinstruction_index(alloc_);
 
       }
       else {
@@ -261,7 +291,8 @@ void dictionary_builder::visit(const sequence_field_instruction* src_inst, void*
       template_name_map_t::iterator itr = template_name_map_.find( qualified_name(sub_inst->ns(), sub_inst->name()) );
       if (itr != template_name_map_.end()) {
         dest->set_subinstructions(itr->second->subinstructions(),
-                                  itr->second->subinstructions_count());        
+                                  itr->second->subinstructions_count());
+        dest->build_subinstruction_index(alloc_);
       }
       else {
         BOOST_THROW_EXCEPTION(template_not_found_error(sub_inst->name(), current_template_.c_str()));
@@ -344,7 +375,7 @@ dictionary_builder::get_dictionary_storage(const char*         key,
   qualified_key += "::";
   qualified_key += qualified_name(ns, key);
 
-  indexer_t::iterator itr = indexer_.find(qualified_key);
+  dictionary_index_t::iterator itr = indexer_.find(qualified_key);
 
   if (itr != indexer_.end()) {
     if (itr->second.field_type_ == field_type)
@@ -354,7 +385,7 @@ dictionary_builder::get_dictionary_storage(const char*         key,
   }
 
   // std::cout << "adding dictionary key=" << qualified_key << "\n";
-  indexer_value_type& v = indexer_[qualified_key];
+  dictionary_entry& v = indexer_[qualified_key];
   v.field_type_ = field_type;
   v.storage_ = candidate_storage;
   resetter_.push_back(candidate_storage);
@@ -83,6 +83,11 @@ class dictionary_value_destroyer
       return impl_.size();
     }
 
+    value_storage* operator[](std::size_t index) const
+    {
+      return impl_[index];
+    }
+
   private:
     allocator* alloc_;
     std::vector<value_storage*> impl_;
@@ -92,6 +97,92 @@ class dictionary_value_destroyer
 typedef std::map<uint32_t, template_instruction*> template_id_map_t;
 
 
+struct dictionary_entry
+{
+  field_type_enum_t field_type_;
+  value_storage*  storage_;
+};
+
+// maps the qualified key of each dictionary entry to its storage
+typedef std::map<std::string, dictionary_entry> dictionary_index_t;
+
+// A pair of entries with the same qualified key and field type in two dictionaries; used
+// to carry the dictionary values over when the templates of a coder are replaced.
+struct dictionary_transfer_entry
+{
+  field_type_enum_t field_type_;
+  const value_storage* from_;
+  value_storage* to_;
+};
+
+typedef std::vector<dictionary_transfer_entry> dictionary_transfer_t;
+
+// append the entries of @a to which have a counterpart in @a from to @a result
+void match_dictionary_entries(const dictionary_index_t& from,
+                              const dictionary_index_t& to,
+                              dictionary_transfer_t&    result);
+
+inline bool is_array_field_type(field_type_enum_t field_type)
+{
+  return field_type == field_type_ascii_string ||
+         field_type == field_type_unicode_string ||
+         field_type == field_type_byte_vector;
+}
+
+
+// One step of a compiled template: the field at index_ in the storage of its aggregate.
+//
+// function_ is the coder function for the field type and the field operator of a scalar
+// field, and 0 for a group, sequence or templateRef. The ops of the fields of a group follow
+// the op of the group; a sequence is followed by the op of its length and the ops of the
+// fields of an element. length_ is the number of these ops, so that the op of the next field
+// is at this + length_ + 1.
+template <typename Function>
+struct field_op
+{
+  Function function_;
+  const field_instruction* instruction_;
+  uint32_t index_;
+  uint32_t length_;
+};
+
+// The scalar field types are the ones up to field_type_byte_vector.
+const std::size_t scalar_field_types_count = field_type_byte_vector + 1;
+
+// Append the ops of the fields of @a instruction to @a program, taking the functions of
+// scalar fields from @a functions, which is indexed by the field type and the field operator.
+template <typename Function>
+void compile_fields(const group_field_instruction*    instruction,
+                    const Function                    (&functions)[scalar_field_types_count][operators_count],
+                    std::vector<field_op<Function> >& program)
+{
+  for (uint32_t i = 0; i < instruction->subinstructions_count(); ++i) {
+    const field_instruction* subinstruction = instruction->subinstruction(i);
+    field_type_enum_t field_type = subinstruction->field_type();
+    std::size_t pos = program.size();
+
+    field_op<Function> op = { 0, subinstruction, i, 0 };
+    if (field_type < scalar_field_types_count)
+      op.function_ = functions[field_type][subinstruction->field_operator()];
+    program.push_back(op);
+
+    if (field_type == field_type_sequence) {
+      const uint32_field_instruction* length_instruction =
+        static_cast<const sequence_field_instruction*>(subinstruction)->length_instruction();
+      field_op<Function> length_op = {
+        functions[field_type_uint32][length_instruction->field_operator()], length_instruction, 0, 0
+      };
+      program.push_back(length_op);
+    }
+
+    if (field_type == field_type_group || field_type == field_type_sequence) {
+      compile_fields(static_cast<const group_field_instruction*>(subinstruction), functions, program);
+      program[pos].length_ = static_cast<uint32_t>(program.size() - pos - 1);
+    }
+  }
+}
+
+
 class dictionary_builder
   : private field_instruction_visitor
 {
@@ -104,6 +195,11 @@ class dictionary_builder
 
     void build(const templates_description* def);
 
+    const dictionary_index_t& dictionary() const
+    {
+      return indexer_;
+    }
+
   private:
 
     virtual void visit(const int32_field_instruction*, void*);
@@ -133,15 +229,8 @@ class dictionary_builder
 
     template_instruction* find_template(uint32_t template_id);
 
-    struct indexer_value_type
-    {
-      field_type_enum_t field_type_;
-      value_storage*  storage_;
-    };
-
     dictionary_resetter& resetter_;
-    typedef std::map<std::string, indexer_value_type>  indexer_t;
-    indexer_t indexer_;
+    dictionary_index_t indexer_;
     arena_allocator* alloc_;
     std::string current_template_;
     std::string current_type_;
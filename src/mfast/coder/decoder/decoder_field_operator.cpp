@@ -801,4 +801,50 @@ decoder_operators[] = {
   &decoder_detail::increment_operator_instance,
   &decoder_detail::tail_operator_instance
 };
+
+namespace decoder_detail {
+
+// The qualified call is not virtual; the operator is stateless, so constructing it costs nothing.
+template <typename MRef, typename Operator>
+void decode_field(const field_instruction* instruction,
+                  value_storage*           storage,
+                  allocator*               alloc,
+                  fast_istream&            stream,
+                  decoder_presence_map&    pmap)
+{
+  MRef mref(alloc, storage, static_cast<typename MRef::instruction_cptr>(instruction));
+  Operator field_operator;
+  field_operator.Operator::decode(mref, stream, pmap);
+}
+
+}
+
+#define MFAST_DECODE_FIELD_FUNCTIONS(MRef, IncrementOperator, TailOperator)      \
+  {                                                                               \
+    &decoder_detail::decode_field<MRef, decoder_detail::no_operator>,             \
+    &decoder_detail::decode_field<MRef, decoder_detail::constant_operator>,       \
+    &decoder_detail::decode_field<MRef, decoder_detail::delta_operator>,          \
+    &decoder_detail::decode_field<MRef, decoder_detail::default_operator>,        \
+    &decoder_detail::decode_field<MRef, decoder_detail::copy_operator>,           \
+    &decoder_detail::decode_field<MRef, IncrementOperator>,                       \
+    &decoder_detail::decode_field<MRef, TailOperator>                             \
+  }
+
+// The increment operator only applies to integers and the tail operator to strings and byte
+// vectors; the other combinations do nothing, as their decoder_field_operator counterparts.
+const decode_field_function
+decode_field_functions[field_type_byte_vector+1][operators_count] = {
+  MFAST_DECODE_FIELD_FUNCTIONS(int32_mref, decoder_detail::increment_operator, decoder_field_operator),
+  MFAST_DECODE_FIELD_FUNCTIONS(uint32_mref, decoder_detail::increment_operator, decoder_field_operator),
+  MFAST_DECODE_FIELD_FUNCTIONS(int64_mref, decoder_detail::increment_operator, decoder_field_operator),
+  MFAST_DECODE_FIELD_FUNCTIONS(uint64_mref, decoder_detail::increment_operator, decoder_field_operator),
+  MFAST_DECODE_FIELD_FUNCTIONS(decimal_mref, decoder_field_operator, decoder_field_operator),
+  MFAST_DECODE_FIELD_FUNCTIONS(decimal_mref, decoder_field_operator, decoder_field_operator),
+  MFAST_DECODE_FIELD_FUNCTIONS(ascii_string_mref, decoder_field_operator, decoder_detail::tail_operator),
+  MFAST_DECODE_FIELD_FUNCTIONS(unicode_string_mref, decoder_field_operator, decoder_detail::tail_operator),
+  MFAST_DECODE_FIELD_FUNCTIONS(byte_vector_mref, decoder_field_operator, decoder_detail::tail_operator)
+};
+
+#undef MFAST_DECODE_FIELD_FUNCTIONS
+
 }
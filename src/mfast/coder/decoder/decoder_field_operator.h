@@ -58,5 +58,17 @@ class decoder_field_operator
 
 extern const decoder_field_operator* const decoder_operators[operators_count];
 
+// Decode the scalar field of @a instruction into @a storage with the field operator of the
+// instruction. Unlike decoder_operators, the field type and the operator are resolved when
+// the function is selected, so the operator is called without any virtual dispatch.
+typedef void (*decode_field_function)(const field_instruction* instruction,
+                                      value_storage*           storage,
+                                      allocator*               alloc,
+                                      fast_istream&            stream,
+                                      decoder_presence_map&    pmap);
+
+// indexed by the field type and the field operator; see compile_fields()
+extern const decode_field_function decode_field_functions[field_type_byte_vector+1][operators_count];
+
 }
 #endif /* end of include guard: DECODER_FIELD_OPERATOR_H_NHLHKGSN */
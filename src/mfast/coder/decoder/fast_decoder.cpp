@@ -17,6 +17,8 @@
 //     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <boost/container/map.hpp>
+#include <boost/atomic.hpp>
+#include <vector>
 #include "../fast_decoder.h"
 
 #include "mfast/field_visitor.h"
@@ -24,6 +26,7 @@
 #include "mfast/malloc_allocator.h"
 #include "mfast/output.h"
 #include "mfast/composite_field.h"
+#include "mfast/flat_layout.h"
 #include "../common/exceptions.h"
 #include "../common/debug_stream.h"
 #include "../common/dictionary_builder.h"
@@ -37,6 +40,94 @@ namespace mfast {
 
 typedef boost::container::map<uint32_t, message_type> message_map_t;
 
+// The fields of a template compiled by compile_fields(); see fast_decoder_impl::decode_fields().
+typedef field_op<decode_field_function> decoder_op;
+typedef std::vector<decoder_op> decoder_program;
+typedef std::map<uint32_t, decoder_program> decoder_program_map_t;
+
+// The template instructions of a decoder along with their dictionary, built by
+// fast_decoder::include() or fast_decoder::update(). A set built by update() is linked to
+// the set it replaces as next_, and the decoding thread switches to it between messages.
+struct decoder_templates
+{
+  arena_allocator alloc_;                   // alloc_ MUST be constructed before the other members
+  dictionary_resetter resetter_;
+  dictionary_value_destroyer array_values_; // dictionary entries of string and byte vector fields;
+                                            // must be destroyed before alloc_
+  std::vector<std::vector<char> > detached_values_;
+  std::map<const value_storage*, std::size_t> array_value_indices_; // into array_values_
+  template_id_map_t templates_map_;
+  decoder_program_map_t programs_;
+  dictionary_index_t dictionary_;
+  dictionary_transfer_t transfer_;          // from the set replaced by this one
+  std::vector<std::vector<char> > transferred_values_;
+  boost::atomic<decoder_templates*> next_;
+
+  explicit decoder_templates(int numa_node)
+    : alloc_(arena_allocator::default_chunk_size, 0, false, numa_node)
+    , array_values_(malloc_allocator::instance())
+    , next_(0)
+  {
+  }
+};
+
+// One generation of message storage used by fast_decoder::use_generations().
+struct message_generation
+{
+  arena_allocator alloc_;     // alloc_ MUST be constructed before messages_,
+  message_map_t messages_;    // Do not change the order of the two
+  const decoder_templates* templates_; // the templates messages_ is built for
+  message_type* last_message_;
+  std::vector<value_storage*> dictionary_values_; // dictionary values which may refer to alloc_
+  boost::atomic<bool> in_use_;
+
+  message_generation(std::size_t chunk_size, int numa_node)
+    : alloc_(chunk_size, 0, false, numa_node)
+    , templates_(0)
+    , last_message_(0)
+    , in_use_(false)
+  {
+  }
+
+  ~message_generation()
+  {
+    reset_messages();
+  }
+
+  // Invalidate the storage of all messages; must be called before any of them is decoded again.
+  void reset_messages()
+  {
+    alloc_.reset();
+    message_map_t::iterator itr;
+    for (itr = messages_.begin(); itr!= messages_.end(); ++itr) {
+      itr->second.reset();
+    }
+    last_message_ = 0;
+  }
+
+  // Only the message decoded last holds storage from alloc_; reset it alone.
+  void recycle()
+  {
+    alloc_.reset();
+    if (last_message_) {
+      last_message_->reset();
+      last_message_ = 0;
+    }
+  }
+
+  // Replace the messages with the ones of @a templates; the generation must be recycled.
+  void build_messages(const decoder_templates* templates)
+  {
+    messages_.clear();
+    template_id_map_t::const_iterator it = templates->templates_map_.begin();
+    for (; it != templates->templates_map_.end(); ++it) {
+      messages_.emplace(it->first, std::make_pair(static_cast<allocator*>(&alloc_), it->second));
+    }
+    reset_messages();
+    templates_ = templates;
+  }
+};
+
 struct fast_decoder_impl
 {
 
@@ -45,13 +136,22 @@ struct fast_decoder_impl
   };
 
   fast_istream strm_;
-  dictionary_resetter resetter_;
 
-  arena_allocator template_alloc_;  // template_alloc MUST be constructed before template_messages,
-  message_map_t template_messages_; // Do not change the order of the two
+  decoder_templates* templates_;    // the templates in effect
+  decoder_templates* newest_;       // the templates built by the last include() or update()
+  std::vector<decoder_templates*> retired_; // replaced templates still used by a generation
+  message_map_t template_messages_; // must be cleared before templates_ is deleted
 
   allocator* message_alloc_;
+  message_map_t* messages_;         // points to template_messages_ or the messages of current_generation_
   message_type* active_message_;
+  const template_instruction* program_instruction_; // the template of active_program_
+  const decoder_program* active_program_;
+
+  message_generation** generations_;
+  std::size_t generations_count_;
+  std::size_t next_generation_;
+  message_generation* current_generation_;
   bool force_reset_;
   debug_stream debug_;
   decoder_presence_map* current_;
@@ -60,6 +160,31 @@ struct fast_decoder_impl
   fast_decoder_impl();
   ~fast_decoder_impl();
   void reset_messages();
+  void build_messages();
+  void find_active_message(bool active, uint32_t template_id);
+  void check_update();
+  void switch_templates();
+  void transfer_dictionary(decoder_templates* templates);
+  void release_retired_templates();
+  std::size_t acquire_generation();
+  void detach_dictionary(message_generation* generation);
+  void track_dictionary_value(const field_instruction* instruction, const void* content);
+  template <typename MRef>
+  void track_dictionary_value(const MRef&)
+  {
+  }
+  void track_dictionary_value(const ascii_string_mref& mref)
+  {
+    track_dictionary_value(mref.instruction(), mref.data());
+  }
+  void track_dictionary_value(const unicode_string_mref& mref)
+  {
+    track_dictionary_value(mref.instruction(), mref.data());
+  }
+  void track_dictionary_value(const byte_vector_mref& mref)
+  {
+    track_dictionary_value(mref.instruction(), mref.data());
+  }
   decoder_presence_map& current_pmap();
 
 
@@ -96,14 +221,68 @@ struct fast_decoder_impl
   void visit(nested_message_mref& mref, int);
   void visit(sequence_element_mref& mref, int);
 
+  message_type*  decode_segment_preamble(fast_istreambuf& sb, decoder_presence_map& pmap);
   message_type*  decode_segment(fast_istreambuf& sb);
+  const decoder_program& program_of(const template_instruction* instruction);
+  void decode_fields(const decoder_op* first,
+                     const decoder_op* last,
+                     value_storage*    storage,
+                     allocator*        alloc);
+  void decode_group(const decoder_op* op, value_storage* storage, allocator* alloc);
+  void decode_sequence(const decoder_op* op, value_storage* storage, allocator* alloc);
+  void decode_flat_segment(fast_istreambuf& sb, const flat_layout& layout, char* dest);
+  void decode_flat_fields(const group_field_instruction* instruction,
+                          value_storage*                 storage,
+                          allocator*                     alloc,
+                          const flat_layout&             layout,
+                          char*                          dest);
+  template <typename MRef>
+  bool decode_flat_int(const field_instruction* instruction, char* dest);
+  template <typename MRef>
+  bool decode_flat_string(const field_instruction* instruction,
+                          value_storage*           storage,
+                          allocator*               alloc,
+                          const flat_field_layout& field_layout,
+                          char*                    dest);
+  bool decode_flat_group(const group_field_instruction* instruction,
+                         value_storage*                 storage,
+                         allocator*                     alloc,
+                         const flat_field_layout&       field_layout,
+                         char*                          dest);
+  bool decode_flat_sequence(const sequence_field_instruction* instruction,
+                            value_storage*                    storage,
+                            allocator*                        alloc,
+                            const flat_field_layout&          field_layout,
+                            char*                             dest);
+  decoder_templates* build_templates(const templates_description** descriptions,
+                                     std::size_t                   description_count,
+                                     const decoder_templates*      previous);
+  void build(const templates_description** descriptions, std::size_t description_count);
+  void build_deferred();
+
+  bool defer_build_;
+  int numa_node_;                   // of the generations and the templates; -1 for first touch
+  std::vector<const templates_description*> deferred_descriptions_;
+  decoder_hook* hook_;
 };
 
 
 inline
 fast_decoder_impl::fast_decoder_impl()
   : strm_(0)
+  , templates_(0)
+  , newest_(0)
+  , messages_(&template_messages_)
+  , program_instruction_(0)
+  , active_program_(0)
+  , generations_(0)
+  , generations_count_(0)
+  , next_generation_(0)
+  , current_generation_(0)
   , warning_log_(0)
+  , defer_build_(false)
+  , numa_node_(-1)
+  , hook_(0)
 {
 }
 
@@ -120,6 +299,185 @@ void fast_decoder_impl::reset_messages()
 fast_decoder_impl::~fast_decoder_impl()
 {
   reset_messages();
+  template_messages_.clear();
+  for (std::size_t i = 0; i < generations_count_; ++i)
+    delete generations_[i];
+  delete [] generations_;
+
+  // the templates in effect and the ones pending after them
+  while (templates_) {
+    decoder_templates* next = templates_->next_.load(boost::memory_order_acquire);
+    delete templates_;
+    templates_ = next;
+  }
+  for (std::size_t i = 0; i < retired_.size(); ++i)
+    delete retired_[i];
+}
+
+void fast_decoder_impl::build_messages()
+{
+  template_id_map_t::const_iterator it = templates_->templates_map_.begin();
+  for (; it != templates_->templates_map_.end(); ++it) {
+    template_messages_.emplace(it->first, std::make_pair(message_alloc_, it->second));
+  }
+}
+
+// Point active_message_ to the message of @a template_id in messages_ if @a active, or to
+// the only message if there is just one template.
+void fast_decoder_impl::find_active_message(bool active, uint32_t template_id)
+{
+  message_map_t::iterator itr = active ? messages_->find(template_id) : messages_->end();
+  if (itr != messages_->end())
+    active_message_ = &itr->second;
+  else if (messages_->size() == 1)
+    active_message_ = &messages_->begin()->second;
+  else
+    active_message_ = 0;
+}
+
+inline void
+fast_decoder_impl::check_update()
+{
+  if (templates_->next_.load(boost::memory_order_acquire))
+    switch_templates();
+}
+
+// Switch to the templates built by update(); called by the decoding thread between messages.
+void
+fast_decoder_impl::switch_templates()
+{
+  std::vector<decoder_templates*> replaced;
+  decoder_templates* next;
+  while ((next = templates_->next_.load(boost::memory_order_acquire)) != 0) {
+    transfer_dictionary(next);
+    replaced.push_back(templates_);
+    templates_ = next;
+  }
+  program_instruction_ = 0;
+
+  // the dictionary values of the generations belong to the replaced templates; the values
+  // in effect were transferred to buffers owned by the new templates
+  for (std::size_t i = 0; i < generations_count_; ++i)
+    generations_[i]->dictionary_values_.clear();
+
+  bool active = active_message_ != 0;
+  uint32_t active_id = active ? active_message_->instruction()->id() : 0;
+  reset_messages();
+  template_messages_.clear();
+  build_messages();
+
+  if (generations_count_) {
+    // the messages of each generation are replaced when the generation is acquired again;
+    // until then, the replaced templates may still be used by a held message
+    retired_.insert(retired_.end(), replaced.begin(), replaced.end());
+    if (active && templates_->templates_map_.count(active_id) == 0)
+      active_message_ = 0;
+  }
+  else {
+    find_active_message(active, active_id);
+    for (std::size_t i = 0; i < replaced.size(); ++i)
+      delete replaced[i];
+  }
+}
+
+// Copy the dictionary values of the templates in effect to the matching entries of
+// @a templates. String and byte vector values are copied to buffers owned by @a templates,
+// since they may point to message storage which is about to be reused.
+void
+fast_decoder_impl::transfer_dictionary(decoder_templates* templates)
+{
+  for (std::size_t i = 0; i < templates->transfer_.size(); ++i) {
+    const dictionary_transfer_entry& entry = templates->transfer_[i];
+    *entry.to_ = *entry.from_;
+    if (is_array_field_type(entry.field_type_) && entry.from_->is_defined() && !entry.from_->is_empty()) {
+      const char* content = static_cast<const char*>(entry.from_->of_array.content_);
+      std::vector<char>& buffer = templates->transferred_values_[i];
+      buffer.assign(content, content + entry.from_->array_length());
+      buffer.push_back('\0');
+      entry.to_->of_array.content_ = &buffer[0];
+      entry.to_->of_array.capacity_ = 0;
+    }
+  }
+}
+
+// Delete the replaced templates once every generation has been rebuilt with the templates in effect.
+void
+fast_decoder_impl::release_retired_templates()
+{
+  for (std::size_t i = 0; i < generations_count_; ++i) {
+    if (generations_[i]->templates_ != templates_)
+      return;
+  }
+  for (std::size_t i = 0; i < retired_.size(); ++i)
+    delete retired_[i];
+  retired_.clear();
+}
+
+// The dictionary keeps shallow copies of string and byte vector values which point to the
+// storage of the message they were decoded into. Before the arena of a generation is reset,
+// copy the values still pointing into it to buffers owned by the decoder.
+void
+fast_decoder_impl::detach_dictionary(message_generation* generation)
+{
+  // only the values saved while decoding into the generation can refer to it; a value
+  // which was saved again since then refers to another generation and is left alone
+  for (std::size_t i = 0; i < generation->dictionary_values_.size(); ++i) {
+    value_storage* value = generation->dictionary_values_[i];
+    if (value->is_defined() && !value->is_empty() && generation->alloc_.owns(value->of_array.content_)) {
+      const char* content = static_cast<const char*>(value->of_array.content_);
+      std::vector<char>& buffer = templates_->detached_values_[templates_->array_value_indices_.find(value)->second];
+      buffer.assign(content, content + value->array_length());
+      buffer.push_back('\0');
+      value->of_array.content_ = &buffer[0];
+      value->of_array.capacity_ = 0;
+    }
+  }
+  generation->dictionary_values_.clear();
+}
+
+// The decoder saves strings and byte vectors to the dictionary by reference; in generation
+// mode, remember the dictionary value of @a instruction when it refers to the storage of the
+// current generation, so that detach_dictionary() only has to visit the values which do.
+inline void
+fast_decoder_impl::track_dictionary_value(const field_instruction* instruction, const void* content)
+{
+  if (current_generation_ && content) {
+    value_storage& previous =
+      const_cast<string_field_instruction*>(static_cast<const string_field_instruction*>(instruction))->prev_value();
+    if (previous.of_array.content_ == content)
+      current_generation_->dictionary_values_.push_back(&previous);
+  }
+}
+
+std::size_t
+fast_decoder_impl::acquire_generation()
+{
+  for (std::size_t i = 0; i < generations_count_; ++i) {
+    std::size_t index = (next_generation_ + i) % generations_count_;
+    message_generation* generation = generations_[index];
+    if (!generation->in_use_.load(boost::memory_order_acquire)) {
+      generation->in_use_.store(true, boost::memory_order_relaxed);
+      detach_dictionary(generation);
+      generation->recycle();
+
+      bool active = active_message_ != 0;
+      uint32_t active_id = active ? active_message_->instruction()->id() : 0;
+      if (generation->templates_ != templates_)
+        generation->build_messages(templates_);
+
+      // the active message may be implied by the previous message; find the
+      // corresponding message of this generation
+      messages_ = &generation->messages_;
+      find_active_message(active, active_id);
+      current_generation_ = generation;
+      next_generation_ = index + 1;
+
+      if (!retired_.empty())
+        release_retired_templates();
+      return index;
+    }
+  }
+  BOOST_THROW_EXCEPTION(generation_unavailable_error());
 }
 
 inline decoder_presence_map&
@@ -135,11 +493,15 @@ fast_decoder_impl::visit(SimpleMRef& mref)
   debug_ << "   decoding " << mref.name() << ": pmap -> " << current_pmap() << "\n"
          << "               stream -> " << strm_ << "\n";
 
+  if (hook_)
+    hook_->field_begin(mref.instruction());
+
   const decoder_field_operator* field_operator
     = decoder_operators[mref.instruction()->field_operator()];
   field_operator->decode(mref,
                          strm_,
                          current_pmap());
+  track_dictionary_value(mref);
 
   if (mref.present())
     debug_ << "   decoded " << mref.name() << " = " << mref << "\n";
@@ -152,6 +514,9 @@ fast_decoder_impl::visit(group_mref& mref, int)
 {
   debug_ << "decoding group " << mref.name();
 
+  if (hook_)
+    hook_->field_begin(mref.instruction());
+
   // If a group field is optional, it will occupy a single bit in the presence map.
   // The contents of the group may appear in the stream iff the bit is set.
   if (mref.optional())
@@ -192,6 +557,9 @@ fast_decoder_impl::visit(sequence_mref& mref, int)
   this->visit(length_mref);
 
 
+  if (hook_)
+    hook_->field_begin(mref.instruction());
+
   if (length_mref.present()) {
     debug_ << "  decoded sequence length " << length_mref.value() << "\n";
     mref.resize(length_mref.value());
@@ -229,6 +597,9 @@ fast_decoder_impl::visit(nested_message_mref& mref, int)
   pmap_state state;
   message_type* saved_active_message = active_message_;
 
+  if (hook_)
+    hook_->field_begin(mref.instruction());
+
   if (mref.is_static()) {
     debug_ << "decoding template " << mref.name()  << " ...\n";
   }
@@ -248,8 +619,8 @@ fast_decoder_impl::visit(nested_message_mref& mref, int)
       debug_ << "   decoded template id -> " << template_id << "\n";
 
       // find the message with corresponding template id
-      message_map_t::iterator itr = template_messages_.find(template_id);
-      if (itr != template_messages_.end())
+      message_map_t::iterator itr = messages_->find(template_id);
+      if (itr != messages_->end())
       {
         active_message_ = &itr->second;
       }
@@ -268,12 +639,11 @@ fast_decoder_impl::visit(nested_message_mref& mref, int)
 }
 
 message_type*
-fast_decoder_impl::decode_segment(fast_istreambuf& sb)
+fast_decoder_impl::decode_segment_preamble(fast_istreambuf& sb, decoder_presence_map& pmap)
 {
 
   strm_.reset(&sb);
 
-  decoder_presence_map pmap;
   this->current_ = &pmap;
   strm_.decode(pmap);
 
@@ -289,8 +659,8 @@ fast_decoder_impl::decode_segment(fast_istreambuf& sb)
     debug_ << "decoded template id = " << template_id << "\n";
 
     // find the message with corresponding template id
-    message_map_t::iterator itr = template_messages_.find(template_id);
-    if (itr != template_messages_.end())
+    message_map_t::iterator itr = messages_->find(template_id);
+    if (itr != messages_->end())
     {
       active_message_ = &itr->second;
     }
@@ -299,8 +669,13 @@ fast_decoder_impl::decode_segment(fast_istreambuf& sb)
     }
   }
 
+  else if (active_message_ == 0) {
+    // the template id may only be omitted when it is implied by the previous message
+    BOOST_THROW_EXCEPTION(fast_dynamic_error("D9"));
+  }
+
   if (force_reset_ || active_message_->instruction()->has_reset_attribute()) {
-    resetter_.reset();
+    templates_->resetter_.reset();
     reset_messages();
   }
 
@@ -308,11 +683,384 @@ fast_decoder_impl::decode_segment(fast_istreambuf& sb)
   // because after the accept_mutator(), the active_message_
   // may change because of the decoding of dynamic template reference
   message_type* message = active_message_;
+  if (current_generation_)
+    current_generation_->last_message_ = message;
+  if (hook_)
+    hook_->template_begin(message->instruction());
   message->ensure_valid();
-  message->ref().accept_mutator(*this);
   return message;
 }
 
+message_type*
+fast_decoder_impl::decode_segment(fast_istreambuf& sb)
+{
+  decoder_presence_map pmap;
+  message_type* message = decode_segment_preamble(sb, pmap);
+
+  if (hook_ || debug_.enabled()) {
+    message->ref().accept_mutator(*this);
+  }
+  else {
+    const decoder_program& program = program_of(message->instruction());
+    if (!program.empty())
+      decode_fields(&program[0],
+                    &program[0] + program.size(),
+                    message->my_storage_.of_group.content_,
+                    message->alloc_);
+  }
+  return message;
+}
+
+inline const decoder_program&
+fast_decoder_impl::program_of(const template_instruction* instruction)
+{
+  if (instruction != program_instruction_) {
+    active_program_ = &templates_->programs_.find(instruction->id())->second;
+    program_instruction_ = instruction;
+  }
+  return *active_program_;
+}
+
+// Decode the fields of an aggregate with the ops in [first, last), which are compiled from the
+// aggregate; this is what accept_mutator() does for the visitor, but without dispatching
+// on the field type and the field operator of each field.
+void
+fast_decoder_impl::decode_fields(const decoder_op* first,
+                                 const decoder_op* last,
+                                 value_storage*    storage,
+                                 allocator*        alloc)
+{
+  for (const decoder_op* op = first; op != last; op += op->length_ + 1) {
+    value_storage* field_storage = storage + op->index_;
+
+    if (op->function_) {
+      op->function_(op->instruction_, field_storage, alloc, strm_, current_pmap());
+      if (current_generation_ && is_array_field_type(op->instruction_->field_type()))
+        track_dictionary_value(op->instruction_, field_storage->of_array.content_);
+    }
+    else if (op->instruction_->field_type() == field_type_group) {
+      decode_group(op, field_storage, alloc);
+    }
+    else if (op->instruction_->field_type() == field_type_sequence) {
+      decode_sequence(op, field_storage, alloc);
+    }
+    else {
+      // templateRef: the target of a dynamic one is only known after its template id is decoded
+      nested_message_mref mref(alloc,
+                               field_storage,
+                               static_cast<const templateref_instruction*>(op->instruction_));
+      this->visit(mref, 0);
+    }
+  }
+}
+
+// see visit(group_mref&, int)
+void
+fast_decoder_impl::decode_group(const decoder_op* op, value_storage* storage, allocator* alloc)
+{
+  const group_field_instruction* instruction = static_cast<const group_field_instruction*>(op->instruction_);
+
+  if (instruction->optional() && !current_pmap().is_next_bit_set()) {
+    group_mref(alloc, storage, instruction).as_absent();
+    return;
+  }
+
+  pmap_state state;
+  if (instruction->segment_pmap_size() > 0)
+    decode_pmap(state);
+
+  decode_fields(op + 1, op + 1 + op->length_, storage->of_group.content_, alloc);
+
+  restore_pmap(state);
+}
+
+// see visit(sequence_mref&, int); the op after the one of the sequence is the op of its length
+void
+fast_decoder_impl::decode_sequence(const decoder_op* op, value_storage* storage, allocator* alloc)
+{
+  const sequence_field_instruction* instruction = static_cast<const sequence_field_instruction*>(op->instruction_);
+  const decoder_op* length_op = op + 1;
+
+  value_storage length_storage;
+  length_op->function_(length_op->instruction_, &length_storage, 0, strm_, current_pmap());
+  uint32_mref length_mref(0, &length_storage, instruction->length_instruction());
+
+  sequence_mref mref(alloc, storage, instruction);
+  if (!length_mref.present()) {
+    mref.as_absent();
+    return;
+  }
+
+  uint32_t length = length_mref.value();
+  mref.resize(length);
+
+  value_storage* element_storage = static_cast<value_storage*>(storage->of_array.content_);
+  for (uint32_t i = 0; i < length; ++i) {
+    pmap_state state;
+    if (instruction->segment_pmap_size() > 0)
+      decode_pmap(state);
+
+    decode_fields(op + 2,
+                  op + 1 + op->length_,
+                  element_storage + i*instruction->subinstructions_count(),
+                  alloc);
+    restore_pmap(state);
+  }
+}
+
+// Integer and decimal fields are decoded into a temporary value_storage because
+// the dictionary keeps them by value.
+template <typename MRef>
+inline bool
+fast_decoder_impl::decode_flat_int(const field_instruction* instruction, char* dest)
+{
+  value_storage storage;
+  MRef mref(0, &storage, static_cast<typename MRef::instruction_cptr>(instruction));
+  this->visit(mref);
+  if (mref.present())
+    *reinterpret_cast<typename MRef::value_type*>(dest) = mref.value();
+  return mref.present();
+}
+
+// The dictionary keeps strings and byte vectors by reference; therefore, they are decoded
+// into the storage of the message of the template as the regular decode() does, and then
+// copied into the flat_string.
+template <typename MRef>
+inline bool
+fast_decoder_impl::decode_flat_string(const field_instruction* instruction,
+                                      value_storage*           storage,
+                                      allocator*               alloc,
+                                      const flat_field_layout& field_layout,
+                                      char*                    dest)
+{
+  MRef mref(alloc, storage, static_cast<typename MRef::instruction_cptr>(instruction));
+  this->visit(mref);
+  if (!mref.present())
+    return false;
+
+  std::size_t len = mref.size();
+  if (len > field_layout.capacity)
+    BOOST_THROW_EXCEPTION(flat_capacity_error() << referenced_by_info(instruction->name()));
+  *reinterpret_cast<uint32_t*>(dest) = static_cast<uint32_t>(len);
+  if (len)
+    std::memcpy(dest + sizeof(uint32_t), mref.data(), len);
+  return true;
+}
+
+bool
+fast_decoder_impl::decode_flat_group(const group_field_instruction* instruction,
+                                     value_storage*                 storage,
+                                     allocator*                     alloc,
+                                     const flat_field_layout&       field_layout,
+                                     char*                          dest)
+{
+  if (hook_)
+    hook_->field_begin(instruction);
+
+  if (instruction->optional() && !current_pmap().is_next_bit_set())
+    return false;
+
+  pmap_state state;
+  if (instruction->segment_pmap_size() > 0)
+    decode_pmap(state);
+
+  decode_flat_fields(instruction, storage->of_group.content_, alloc, *field_layout.element, dest);
+
+  restore_pmap(state);
+  return true;
+}
+
+bool
+fast_decoder_impl::decode_flat_sequence(const sequence_field_instruction* instruction,
+                                        value_storage*                    storage,
+                                        allocator*                        alloc,
+                                        const flat_field_layout&          field_layout,
+                                        char*                             dest)
+{
+  value_storage length_storage;
+  uint32_mref length_mref(0, &length_storage, instruction->length_instruction());
+  this->visit(length_mref);
+
+  if (hook_)
+    hook_->field_begin(instruction);
+
+  if (!length_mref.present())
+    return false;
+
+  uint32_t length = length_mref.value();
+  if (length > field_layout.capacity)
+    BOOST_THROW_EXCEPTION(flat_capacity_error() << referenced_by_info(instruction->name()));
+
+  sequence_mref mref(alloc, storage, instruction);
+  mref.resize(length);
+
+  const flat_layout& element_layout = *field_layout.element;
+  value_storage* element_storage = static_cast<value_storage*>(storage->of_array.content_);
+  for (uint32_t i = 0; i < length; ++i) {
+    pmap_state state;
+    if (instruction->segment_pmap_size() > 0)
+      decode_pmap(state);
+
+    decode_flat_fields(instruction,
+                       element_storage + i*instruction->subinstructions_count(),
+                       alloc,
+                       element_layout,
+                       dest + i*element_layout.size);
+    restore_pmap(state);
+  }
+  // flat_sequence places the length after the elements
+  *reinterpret_cast<uint32_t*>(dest + field_layout.capacity*element_layout.size) = length;
+  return true;
+}
+
+void
+fast_decoder_impl::decode_flat_fields(const group_field_instruction* instruction,
+                                      value_storage*                 storage,
+                                      allocator*                     alloc,
+                                      const flat_layout&             layout,
+                                      char*                          dest)
+{
+  assert(layout.num_fields == instruction->subinstructions_count());
+  uint8_t* presence = reinterpret_cast<uint8_t*>(dest + layout.presence_offset);
+
+  for (std::size_t i = 0; i < layout.num_fields; ++i) {
+    const field_instruction* subinstruction = instruction->subinstruction(i);
+    const flat_field_layout& field_layout = layout.fields[i];
+    char* field_dest = dest + field_layout.offset;
+    bool present = false;
+
+    switch (subinstruction->field_type()) {
+      case field_type_int32:
+        present = decode_flat_int<int32_mref>(subinstruction, field_dest);
+        break;
+      case field_type_uint32:
+        present = decode_flat_int<uint32_mref>(subinstruction, field_dest);
+        break;
+      case field_type_int64:
+        present = decode_flat_int<int64_mref>(subinstruction, field_dest);
+        break;
+      case field_type_uint64:
+        present = decode_flat_int<uint64_mref>(subinstruction, field_dest);
+        break;
+      case field_type_decimal:
+      case field_type_exponent:
+        {
+          value_storage decimal_storage;
+          decimal_mref mref(0, &decimal_storage, static_cast<const decimal_field_instruction*>(subinstruction));
+          this->visit(mref);
+          present = mref.present();
+          if (present) {
+            flat_decimal* value = reinterpret_cast<flat_decimal*>(field_dest);
+            value->mantissa = mref.mantissa();
+            value->exponent = mref.exponent();
+          }
+        }
+        break;
+      case field_type_ascii_string:
+        present = decode_flat_string<ascii_string_mref>(subinstruction, storage+i, alloc, field_layout, field_dest);
+        break;
+      case field_type_unicode_string:
+        present = decode_flat_string<unicode_string_mref>(subinstruction, storage+i, alloc, field_layout, field_dest);
+        break;
+      case field_type_byte_vector:
+        present = decode_flat_string<byte_vector_mref>(subinstruction, storage+i, alloc, field_layout, field_dest);
+        break;
+      case field_type_group:
+        present = decode_flat_group(static_cast<const group_field_instruction*>(subinstruction),
+                                    storage+i, alloc, field_layout, field_dest);
+        break;
+      case field_type_sequence:
+        present = decode_flat_sequence(static_cast<const sequence_field_instruction*>(subinstruction),
+                                       storage+i, alloc, field_layout, field_dest);
+        break;
+      default:
+        // fast_type_gen does not generate flat layouts for templates with templateRef
+        assert(false);
+        break;
+    }
+    flat_present(presence, i, present);
+  }
+}
+
+void
+fast_decoder_impl::decode_flat_segment(fast_istreambuf& sb, const flat_layout& layout, char* dest)
+{
+  decoder_presence_map pmap;
+  message_type* message = decode_segment_preamble(sb, pmap);
+
+  if (message->instruction()->id() != layout.id)
+    BOOST_THROW_EXCEPTION(flat_layout_mismatch_error() << template_id_info(message->instruction()->id()));
+
+  decode_flat_fields(message->instruction(),
+                     message->my_storage_.of_group.content_,
+                     message->alloc_,
+                     layout,
+                     dest);
+}
+
+decoder_templates*
+fast_decoder_impl::build_templates(const templates_description** descriptions,
+                                   std::size_t                   description_count,
+                                   const decoder_templates*      previous)
+{
+  decoder_templates* templates = new decoder_templates(numa_node_);
+  try {
+    dictionary_builder builder(templates->resetter_,
+                               templates->templates_map_,
+                               &templates->alloc_,
+                               &templates->array_values_);
+
+    for (std::size_t i = 0; i < description_count; ++i)
+      builder.build(descriptions[i]);
+
+    template_id_map_t::const_iterator it = templates->templates_map_.begin();
+    for (; it != templates->templates_map_.end(); ++it)
+      compile_fields(it->second, decode_field_functions, templates->programs_[it->first]);
+
+    templates->dictionary_ = builder.dictionary();
+    templates->detached_values_.resize(templates->array_values_.size());
+    for (std::size_t i = 0; i < templates->array_values_.size(); ++i)
+      templates->array_value_indices_[templates->array_values_[i]] = i;
+    if (previous) {
+      match_dictionary_entries(previous->dictionary_, templates->dictionary_, templates->transfer_);
+      templates->transferred_values_.resize(templates->transfer_.size());
+    }
+  }
+  catch (...) {
+    delete templates;
+    throw;
+  }
+  return templates;
+}
+
+void
+fast_decoder_impl::build(const templates_description** descriptions, std::size_t description_count)
+{
+  templates_ = newest_ = build_templates(descriptions, description_count, 0);
+
+  // Given the template definitions, we need to create another map for
+  // mapping each template id to a fully constructed message. The messages
+  // of the generations are built when the generations are acquired.
+  build_messages();
+
+  if (template_messages_.size()==1) {
+    active_message_ = &(template_messages_.begin()->second);
+  }
+  else {
+    active_message_ = 0;
+  }
+}
+
+void
+fast_decoder_impl::build_deferred()
+{
+  if (!deferred_descriptions_.empty()) {
+    std::vector<const templates_description*> descriptions;
+    descriptions.swap(deferred_descriptions_);
+    build(&descriptions[0], descriptions.size());
+  }
+}
+
 fast_decoder::fast_decoder(allocator* alloc)
   : impl_(new fast_decoder_impl)
 {
@@ -325,32 +1073,60 @@ fast_decoder::~fast_decoder()
 }
 
 void
-fast_decoder::include(const templates_description** descriptions, std::size_t description_count)
+fast_decoder::use_generations(std::size_t count, std::size_t chunk_size)
 {
-  template_id_map_t templates_map;
-  dictionary_builder builder(impl_->resetter_,templates_map,  &impl_->template_alloc_);
+  assert(count > 0 && impl_->generations_ == 0);
+  impl_->generations_ = new message_generation*[count];
+  for (std::size_t i = 0; i < count; ++i)
+    impl_->generations_[i] = new message_generation(chunk_size, impl_->numa_node_);
+  impl_->generations_count_ = count;
+}
 
-  for (std::size_t i = 0; i < description_count; ++i)
-    builder.build(descriptions[i]);
+void
+fast_decoder::defer_build(bool v)
+{
+  impl_->defer_build_ = v;
+}
 
-  // Given the template definitions, we need to create another map for
-  // mapping each template id to a fully constructed message.
-  template_id_map_t::const_iterator it = templates_map.begin();
-  for (; it != templates_map.end(); ++it) {
-    impl_->template_messages_.emplace(it->first, std::make_pair(impl_->message_alloc_, it->second));
-  }
+void
+fast_decoder::numa_node(int node)
+{
+  impl_->numa_node_ = node;
+}
 
-  if (impl_->template_messages_.size()==1) {
-    impl_->active_message_ = &(impl_->template_messages_.begin()->second);
-  }
-  else {
-    impl_->active_message_ = 0;
+void
+fast_decoder::include(const templates_description** descriptions, std::size_t description_count)
+{
+  if (impl_->defer_build_) {
+    impl_->deferred_descriptions_.assign(descriptions, descriptions + description_count);
+    return;
   }
+  impl_->build(descriptions, description_count);
+}
+
+void
+fast_decoder::update(const templates_description** descriptions, std::size_t description_count)
+{
+  assert(impl_->newest_);
+  decoder_templates* templates = impl_->build_templates(descriptions, description_count, impl_->newest_);
+  impl_->newest_->next_.store(templates, boost::memory_order_release);
+  impl_->newest_ = templates;
 }
 
 message_cref
 fast_decoder::decode(const char*& first, const char* last, bool force_reset)
 {
+  impl_->build_deferred();
+
+  if (impl_->generations_count_) {
+    // the message stays valid until its generation is reused
+    generation_handle generation;
+    message_cref result = decode(first, last, force_reset, generation);
+    release(generation);
+    return result;
+  }
+
+  impl_->check_update();
   assert(first < last);
   fast_istreambuf sb(first, last-first);
   impl_->force_reset_ = force_reset;
@@ -359,6 +1135,73 @@ fast_decoder::decode(const char*& first, const char* last, bool force_reset)
   return result;
 }
 
+message_cref
+fast_decoder::decode(const char*&       first,
+                     const char*        last,
+                     bool               force_reset,
+                     generation_handle& generation)
+{
+  assert(first < last);
+  assert(impl_->generations_count_ > 0);
+
+  impl_->build_deferred();
+  impl_->check_update();
+  generation = impl_->acquire_generation();
+  try {
+    fast_istreambuf sb(first, last-first);
+    impl_->force_reset_ = force_reset;
+    message_cref result = impl_->decode_segment(sb)->cref();
+    first = sb.gptr();
+    return result;
+  }
+  catch (...) {
+    release(generation);
+    throw;
+  }
+}
+
+void
+fast_decoder::decode_flat(const char*&       first,
+                          const char*        last,
+                          const flat_layout& layout,
+                          void*              dest,
+                          bool               force_reset)
+{
+  assert(first < last);
+  assert(impl_->generations_count_ == 0);
+
+  impl_->build_deferred();
+  impl_->check_update();
+  fast_istreambuf sb(first, last-first);
+  impl_->force_reset_ = force_reset;
+  impl_->decode_flat_segment(sb, layout, static_cast<char*>(dest));
+  first = sb.gptr();
+}
+
+void
+fast_decoder::release(generation_handle generation)
+{
+  assert(generation < impl_->generations_count_);
+  impl_->generations_[generation]->in_use_.store(false, boost::memory_order_release);
+}
+
+std::size_t
+fast_decoder::free_generations() const
+{
+  std::size_t result = 0;
+  for (std::size_t i = 0; i < impl_->generations_count_; ++i) {
+    if (!impl_->generations_[i]->in_use_.load(boost::memory_order_acquire))
+      ++result;
+  }
+  return result;
+}
+
+void
+fast_decoder::hook(decoder_hook* h)
+{
+  impl_->hook_ = h;
+}
+
 void
 fast_decoder::debug_log(std::ostream* log)
 {
@@ -128,6 +128,11 @@ class templates_loader
       return boost::lexical_cast<uint32_t>(get_optional_attr(element, "id", "0"));
     }
 
+    uint32_t get_capacity(const XMLElement & element)
+    {
+      return boost::lexical_cast<uint32_t>(get_optional_attr(element, "capacity", "0"));
+    }
+
     presence_enum_t get_presence(const XMLElement & element)
     {
       const char* presence_str = get_optional_attr(element, "presence", "");
@@ -282,6 +287,7 @@ class templates_loader
         get_typeRef_name(element),
         get_typeRef_ns(element)
         );
+      instruction->build_subinstruction_index(alloc_);
       stack_.pop_back();
       current().push_back(instruction);
       return true;
@@ -346,6 +352,7 @@ class templates_loader
         get_typeRef_ns(element)
         );
 
+      instruction->build_subinstruction_index(alloc_);
       stack_.pop_back();
       current().push_back(instruction);
       return true;
@@ -407,8 +414,10 @@ class templates_loader
         current().size(),
         length_instruction,
         get_typeRef_name(element),
-        get_typeRef_ns(element));
+        get_typeRef_ns(element),
+        get_capacity(element));
 
+      instruction->build_subinstruction_index(alloc_);
       stack_.pop_back();
       current().push_back(instruction);
       return true;
@@ -583,7 +592,8 @@ class templates_loader
           new_string(name_attr.c_str()),
           get_ns(element),
           opContext,
-          initial_value
+          initial_value,
+          get_capacity(element)
           );
 
       }
@@ -611,7 +621,8 @@ class templates_loader
           initial_value,
           length_id,
           length_name,
-          length_ns
+          length_ns,
+          get_capacity(element)
           );
       }
 
@@ -703,7 +714,8 @@ class templates_loader
         initial_value,
         length_id,
         length_name,
-        length_ns
+        length_ns,
+        get_capacity(element)
         );
 
       current().push_back(instruction);
@@ -872,4 +872,48 @@ encoder_operators[] = {
   &encoder_detail::tail_operator_instance
 };
 
+namespace encoder_detail {
+
+// The qualified call is not virtual; the operator is stateless, so constructing it costs nothing.
+template <typename CRef, typename Operator>
+void encode_field(const field_instruction* instruction,
+                  const value_storage*     storage,
+                  fast_ostream&            stream,
+                  encoder_presence_map&    pmap)
+{
+  CRef cref(storage, static_cast<typename CRef::instruction_cptr>(instruction));
+  Operator field_operator;
+  field_operator.Operator::encode(cref, stream, pmap);
+}
+
+}
+
+#define MFAST_ENCODE_FIELD_FUNCTIONS(CRef, IncrementOperator, TailOperator)      \
+  {                                                                               \
+    &encoder_detail::encode_field<CRef, encoder_detail::no_operator>,             \
+    &encoder_detail::encode_field<CRef, encoder_detail::constant_operator>,       \
+    &encoder_detail::encode_field<CRef, encoder_detail::delta_operator>,          \
+    &encoder_detail::encode_field<CRef, encoder_detail::default_operator>,        \
+    &encoder_detail::encode_field<CRef, encoder_detail::copy_operator>,           \
+    &encoder_detail::encode_field<CRef, IncrementOperator>,                       \
+    &encoder_detail::encode_field<CRef, TailOperator>                             \
+  }
+
+// The increment operator only applies to integers and the tail operator to strings and byte
+// vectors; the other combinations do nothing, as their encoder_field_operator counterparts.
+const encode_field_function
+encode_field_functions[field_type_byte_vector+1][operators_count] = {
+  MFAST_ENCODE_FIELD_FUNCTIONS(int32_cref, encoder_detail::increment_operator, encoder_field_operator),
+  MFAST_ENCODE_FIELD_FUNCTIONS(uint32_cref, encoder_detail::increment_operator, encoder_field_operator),
+  MFAST_ENCODE_FIELD_FUNCTIONS(int64_cref, encoder_detail::increment_operator, encoder_field_operator),
+  MFAST_ENCODE_FIELD_FUNCTIONS(uint64_cref, encoder_detail::increment_operator, encoder_field_operator),
+  MFAST_ENCODE_FIELD_FUNCTIONS(decimal_cref, encoder_field_operator, encoder_field_operator),
+  MFAST_ENCODE_FIELD_FUNCTIONS(decimal_cref, encoder_field_operator, encoder_field_operator),
+  MFAST_ENCODE_FIELD_FUNCTIONS(ascii_string_cref, encoder_field_operator, encoder_detail::tail_operator),
+  MFAST_ENCODE_FIELD_FUNCTIONS(unicode_string_cref, encoder_field_operator, encoder_detail::tail_operator),
+  MFAST_ENCODE_FIELD_FUNCTIONS(byte_vector_cref, encoder_field_operator, encoder_detail::tail_operator)
+};
+
+#undef MFAST_ENCODE_FIELD_FUNCTIONS
+
 }
@@ -59,6 +59,17 @@ class encoder_field_operator
 
 extern const encoder_field_operator* const encoder_operators[operators_count];
 
+// Encode the scalar field of @a instruction in @a storage with the field operator of the
+// instruction. Unlike encoder_operators, the field type and the operator are resolved when
+// the function is selected, so the operator is called without any virtual dispatch.
+typedef void (*encode_field_function)(const field_instruction* instruction,
+                                      const value_storage*     storage,
+                                      fast_ostream&            stream,
+                                      encoder_presence_map&    pmap);
+
+// indexed by the field type and the field operator; see compile_fields()
+extern const encode_field_function encode_field_functions[field_type_byte_vector+1][operators_count];
+
 }
 
 #endif /* end of include guard: ENCODER_FIELD_OPERATOR_H_MNM3YM8X */
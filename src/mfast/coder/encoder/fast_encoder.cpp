@@ -18,9 +18,14 @@
 //
 
 
+#include <boost/atomic.hpp>
+#include <cstring>
+#include <set>
+#include <vector>
 #include "mfast/field_visitor.h"
 #include "mfast/sequence_ref.h"
 #include "mfast/malloc_allocator.h"
+#include "mfast/flat_layout.h"
 #include "../fast_encoder.h"
 #include "../common/dictionary_builder.h"
 #include "../common/exceptions.h"
@@ -33,6 +38,31 @@
 namespace mfast
 {
 
+// The fields of a template compiled by compile_fields(); see fast_encoder_impl::encode_fields().
+typedef field_op<encode_field_function> encoder_op;
+typedef std::vector<encoder_op> encoder_program;
+typedef std::map<uint32_t, encoder_program> encoder_program_map_t;
+
+// The template instructions of an encoder along with their dictionary, built by
+// fast_encoder::include() or fast_encoder::update(). A set built by update() is linked to
+// the set it replaces as next_, and the encoding thread switches to it between messages.
+struct encoder_templates
+{
+  arena_allocator alloc_;                       // alloc_ MUST be constructed before the other members
+  dictionary_resetter resetter_;
+  dictionary_value_destroyer value_destroyer_;  // must be destroyed before alloc_
+  template_id_map_t templates_map_;
+  encoder_program_map_t programs_;
+  dictionary_index_t dictionary_;
+  dictionary_transfer_t transfer_;              // from the set replaced by this one
+  boost::atomic<encoder_templates*> next_;
+
+  explicit encoder_templates(allocator* value_alloc)
+    : value_destroyer_(value_alloc)
+    , next_(0)
+  {
+  }
+};
 
 struct fast_encoder_impl
   : detail::field_storage_helper
@@ -43,19 +73,31 @@ struct fast_encoder_impl
   };
   
   fast_ostream strm_;
-  dictionary_resetter resetter_;
-  dictionary_value_destroyer value_destroyer_;
+  allocator* alloc_;
 
-  arena_allocator template_alloc_;
+  encoder_templates* templates_;    // the templates in effect
+  encoder_templates* newest_;       // the templates built by the last include() or update()
+  encoder_templates* retired_;      // the templates replaced by the last switch, kept for the
+                                    // instructions returned by template_with_id() before it
 
   int64_t active_message_id_;
   encoder_presence_map* current_;
-  template_id_map_t templates_map_;
+  const template_instruction* program_instruction_; // the template of active_program_
+  const encoder_program* active_program_;
+  const template_instruction* checked_instruction_; // the last message instruction in checked_
+  std::set<const template_instruction*> checked_;   // message instructions laid out as the
+                                                    // templates in effect
 
 
   fast_encoder_impl(allocator* alloc);
   ~fast_encoder_impl();
   encoder_presence_map& current_pmap();
+  encoder_templates* build_templates(const templates_description** descriptions,
+                                     std::size_t                   description_count,
+                                     const encoder_templates*      previous);
+  void check_update();
+  void switch_templates();
+  void transfer_dictionary(encoder_templates* templates);
   
   
   struct pmap_state
@@ -94,20 +136,141 @@ struct fast_encoder_impl
   void visit(sequence_element_cref& cref, int);
   void visit(nested_message_cref&, int);
 
+  void check_layout(const template_instruction* instruction);
   template_instruction*  encode_segment_preemble(uint32_t template_id, bool force_reset);
   void encode_segment(const message_cref& cref, fast_ostreambuf& sb, bool force_reset);
+  const encoder_program& program_of(const template_instruction* instruction);
+  void encode_fields(const encoder_op*    first,
+                     const encoder_op*    last,
+                     const value_storage* storage);
+  void encode_group(const encoder_op* op, const value_storage* storage);
+  void encode_sequence(const encoder_op* op, const value_storage* storage);
+
+  void encode_flat_segment(const flat_layout& layout, const char* src, fast_ostreambuf& sb, bool force_reset);
+  void encode_flat_fields(const group_field_instruction* instruction,
+                          const flat_layout&             layout,
+                          const char*                    src);
+  template <typename MRef>
+  void encode_flat_int(const field_instruction* instruction, const char* src, bool present);
+  template <typename CRef>
+  void encode_flat_string(const field_instruction* instruction, const char* src, bool present);
+  void encode_flat_group(const group_field_instruction* instruction,
+                         const flat_field_layout&       field_layout,
+                         const char*                    src,
+                         bool                           present);
+  void encode_flat_sequence(const sequence_field_instruction* instruction,
+                            const flat_field_layout&          field_layout,
+                            const char*                       src,
+                            bool                              present);
 };
 
 inline
 fast_encoder_impl::fast_encoder_impl(allocator* alloc)
   : strm_(alloc)
-  , value_destroyer_(alloc)
+  , alloc_(alloc)
+  , templates_(0)
+  , newest_(0)
+  , retired_(0)
   , active_message_id_(-1)
+  , program_instruction_(0)
+  , active_program_(0)
+  , checked_instruction_(0)
 {
 }
 
 fast_encoder_impl::~fast_encoder_impl()
 {
+  // the templates in effect and the ones pending after them
+  while (templates_) {
+    encoder_templates* next = templates_->next_.load(boost::memory_order_acquire);
+    delete templates_;
+    templates_ = next;
+  }
+  delete retired_;
+}
+
+encoder_templates*
+fast_encoder_impl::build_templates(const templates_description** descriptions,
+                                   std::size_t                   description_count,
+                                   const encoder_templates*      previous)
+{
+  encoder_templates* templates = new encoder_templates(alloc_);
+  try {
+    dictionary_builder builder(templates->resetter_,
+                               templates->templates_map_,
+                               &templates->alloc_,
+                               &templates->value_destroyer_);
+
+    for (std::size_t i = 0; i < description_count; ++i)
+      builder.build(descriptions[i]);
+
+    template_id_map_t::const_iterator it = templates->templates_map_.begin();
+    for (; it != templates->templates_map_.end(); ++it)
+      compile_fields(it->second, encode_field_functions, templates->programs_[it->first]);
+
+    templates->dictionary_ = builder.dictionary();
+    if (previous)
+      match_dictionary_entries(previous->dictionary_, templates->dictionary_, templates->transfer_);
+  }
+  catch (...) {
+    delete templates;
+    throw;
+  }
+  return templates;
+}
+
+inline void
+fast_encoder_impl::check_update()
+{
+  if (templates_->next_.load(boost::memory_order_acquire))
+    switch_templates();
+}
+
+// Switch to the templates built by update(); called by the encoding thread between messages.
+void
+fast_encoder_impl::switch_templates()
+{
+  // Only the templates in effect until now can have had their instructions returned by
+  // template_with_id(); the ones between them and the newest were never in effect.
+  encoder_templates* previous = templates_;
+  encoder_templates* next;
+  while ((next = templates_->next_.load(boost::memory_order_acquire)) != 0) {
+    transfer_dictionary(next);
+    if (templates_ != previous)
+      delete templates_;
+    templates_ = next;
+  }
+  delete retired_;
+  retired_ = previous;
+  program_instruction_ = 0;
+  checked_instruction_ = 0;
+  checked_.clear();
+
+  if (templates_->templates_map_.size() == 1)
+    active_message_id_ = templates_->templates_map_.begin()->first;
+  else if (templates_->templates_map_.count(static_cast<uint32_t>(active_message_id_)) == 0)
+    active_message_id_ = -1;
+}
+
+// Copy the dictionary values of the templates in effect to the matching entries of @a templates.
+void
+fast_encoder_impl::transfer_dictionary(encoder_templates* templates)
+{
+  for (std::size_t i = 0; i < templates->transfer_.size(); ++i) {
+    const dictionary_transfer_entry& entry = templates->transfer_[i];
+    *entry.to_ = *entry.from_;
+    if (is_array_field_type(entry.field_type_)) {
+      // the previous values of strings and byte vectors are owned by the dictionary
+      entry.to_->of_array.content_ = 0;
+      entry.to_->of_array.capacity_ = 0;
+      if (entry.from_->is_defined() && !entry.from_->is_empty()) {
+        std::size_t len = entry.from_->array_length();
+        entry.to_->of_array.capacity_ = alloc_->reallocate(entry.to_->of_array.content_, 0, len+1);
+        std::memcpy(entry.to_->of_array.content_, entry.from_->of_array.content_, len);
+        static_cast<char*>(entry.to_->of_array.content_)[len] = '\0';
+      }
+    }
+  }
 }
 
 inline encoder_presence_map&
@@ -201,6 +364,7 @@ fast_encoder_impl::visit(nested_message_cref& cref, int)
     // we have to replace the target instruction in cref so that the previous values of
     // the inner fields can be accessed.
     const template_instruction*& target_inst = detail::field_storage_helper::storage_of(cref).of_templateref.of_instruction.instruction_;
+    check_layout(target_inst);
     target_inst = encode_segment_preemble(target_inst->id(), false);
   }
   
@@ -210,13 +374,55 @@ fast_encoder_impl::visit(nested_message_cref& cref, int)
   active_message_id_ = saved_message_id;
 }
 
+namespace {
+
+// Returns whether the fields of @a lhs and @a rhs have the same types, so that the storage of
+// an aggregate built with one can be encoded with the other.
+bool same_layout(const group_field_instruction* lhs, const group_field_instruction* rhs)
+{
+  if (lhs == rhs)
+    return true;
+  if (lhs->subinstructions_count() != rhs->subinstructions_count())
+    return false;
+  for (uint32_t i = 0; i < lhs->subinstructions_count(); ++i) {
+    const field_instruction* l = lhs->subinstruction(i);
+    const field_instruction* r = rhs->subinstruction(i);
+    if (l->field_type() != r->field_type())
+      return false;
+    if ((l->field_type() == field_type_group || l->field_type() == field_type_sequence) &&
+        !same_layout(static_cast<const group_field_instruction*>(l),
+                     static_cast<const group_field_instruction*>(r)))
+      return false;
+  }
+  return true;
+}
+
+}
+
+// Throw unless the storage of a message built with @a instruction can be encoded with the
+// template of the same id in effect, which may have been replaced by update() since.
+inline void
+fast_encoder_impl::check_layout(const template_instruction* instruction)
+{
+  if (instruction == checked_instruction_)
+    return;
+  if (checked_.count(instruction) == 0) {
+    template_id_map_t::const_iterator itr = templates_->templates_map_.find(instruction->id());
+    if (itr != templates_->templates_map_.end() && !same_layout(instruction, itr->second))
+      BOOST_THROW_EXCEPTION(fast_dynamic_error("D9") << template_id_info(instruction->id()));
+    // an unknown id is reported by encode_segment_preemble()
+    checked_.insert(instruction);
+  }
+  checked_instruction_ = instruction;
+}
+
 template_instruction*
 fast_encoder_impl::encode_segment_preemble(uint32_t template_id, bool force_reset)
 {
   template_instruction* instruction;
-  template_id_map_t::iterator itr = templates_map_.find(template_id);
+  template_id_map_t::iterator itr = templates_->templates_map_.find(template_id);
 
-  if (itr != templates_map_.end()) {
+  if (itr != templates_->templates_map_.end()) {
     instruction = itr->second;
     current_pmap().init(&this->strm_, instruction->segment_pmap_size());
   }
@@ -225,7 +431,7 @@ fast_encoder_impl::encode_segment_preemble(uint32_t template_id, bool force_rese
   }
 
   if ( force_reset ||  instruction->has_reset_attribute())
-    resetter_.reset();
+    templates_->resetter_.reset();
   
   
   bool need_encode_template_id = (active_message_id_ != template_id);
@@ -242,15 +448,285 @@ fast_encoder_impl::encode_segment_preemble(uint32_t template_id, bool force_rese
 void
 fast_encoder_impl::encode_segment(const message_cref& cref, fast_ostreambuf& sb, bool force_reset)
 {
+  check_update();
   this->strm_.rdbuf(&sb);
 
   encoder_presence_map pmap;
   this->current_ = &pmap;
 
+  check_layout(cref.instruction());
   template_instruction* instruction = encode_segment_preemble(cref.id(), force_reset);
 
-  aggregate_cref message(cref.field_storage(0), instruction);
-  message.accept_accessor(*this);
+  const encoder_program& program = program_of(instruction);
+  if (!program.empty())
+    encode_fields(&program[0], &program[0] + program.size(), cref.field_storage(0));
+
+  pmap.commit();
+}
+
+inline const encoder_program&
+fast_encoder_impl::program_of(const template_instruction* instruction)
+{
+  if (instruction != program_instruction_) {
+    active_program_ = &templates_->programs_.find(instruction->id())->second;
+    program_instruction_ = instruction;
+  }
+  return *active_program_;
+}
+
+// Encode the fields of an aggregate with the ops in [first, last), which are compiled from the
+// aggregate; this is what accept_accessor() does for the visitor, but without dispatching
+// on the field type and the field operator of each field.
+void
+fast_encoder_impl::encode_fields(const encoder_op*    first,
+                                 const encoder_op*    last,
+                                 const value_storage* storage)
+{
+  for (const encoder_op* op = first; op != last; op += op->length_ + 1) {
+    const value_storage* field_storage = storage + op->index_;
+
+    if (op->function_) {
+      op->function_(op->instruction_, field_storage, strm_, current_pmap());
+    }
+    else if (op->instruction_->field_type() == field_type_group) {
+      encode_group(op, field_storage);
+    }
+    else if (op->instruction_->field_type() == field_type_sequence) {
+      encode_sequence(op, field_storage);
+    }
+    else {
+      nested_message_cref cref(field_storage, static_cast<const templateref_instruction*>(op->instruction_));
+      this->visit(cref, 0);
+    }
+  }
+}
+
+// see visit(group_cref&, int)
+void
+fast_encoder_impl::encode_group(const encoder_op* op, const value_storage* storage)
+{
+  group_cref cref(storage, static_cast<const group_field_instruction*>(op->instruction_));
+
+  if (cref.optional())
+  {
+    current_pmap().set_next_bit(cref.present());
+
+    if (cref.absent())
+      return;
+  }
+
+  pmap_state state;
+
+  if (cref.instruction()->segment_pmap_size() > 0) {
+    setup_pmap(state, cref.instruction()->segment_pmap_size() );
+  }
+
+  encode_fields(op + 1, op + 1 + op->length_, storage->of_group.content_);
+
+  commit_pmap(state);
+}
+
+// see visit(sequence_cref&, int); the op after the one of the sequence is the op of its length
+void
+fast_encoder_impl::encode_sequence(const encoder_op* op, const value_storage* storage)
+{
+  const sequence_field_instruction* instruction = static_cast<const sequence_field_instruction*>(op->instruction_);
+  const encoder_op* length_op = op + 1;
+  sequence_cref cref(storage, instruction);
+
+  value_storage length_storage;
+  uint32_mref length_mref(0, &length_storage, instruction->length_instruction());
+
+  if (cref.present())
+    length_mref.as(cref.size());
+  else
+    length_mref.as_absent();
+
+  length_op->function_(length_op->instruction_, &length_storage, strm_, current_pmap());
+
+  if (!length_mref.present())
+    return;
+
+  const value_storage* element_storage = static_cast<const value_storage*>(storage->of_array.content_);
+  for (std::size_t i = 0; i < cref.size(); ++i) {
+    pmap_state state;
+    if (instruction->segment_pmap_size() > 0)
+    {
+      setup_pmap(state, instruction->segment_pmap_size());
+    }
+    encode_fields(op + 2,
+                  op + 1 + op->length_,
+                  element_storage + i*instruction->subinstructions_count());
+    commit_pmap(state);
+  }
+}
+
+// The flat values are wrapped in temporary value_storage so that the
+// regular field operators can be applied to them.
+template <typename MRef>
+inline void
+fast_encoder_impl::encode_flat_int(const field_instruction* instruction, const char* src, bool present)
+{
+  value_storage storage;
+  MRef mref(0, &storage, static_cast<typename MRef::instruction_cptr>(instruction));
+  if (present)
+    mref.as(*reinterpret_cast<const typename MRef::value_type*>(src));
+  else
+    mref.as_absent();
+  this->visit(mref);
+}
+
+template <typename CRef>
+inline void
+fast_encoder_impl::encode_flat_string(const field_instruction* instruction, const char* src, bool present)
+{
+  value_storage storage;
+  if (present) {
+    // the content is not owned by the storage; the len_ counts the terminating null
+    storage.of_array.len_ = *reinterpret_cast<const uint32_t*>(src) + 1;
+    storage.of_array.capacity_ = 0;
+    storage.of_array.content_ = const_cast<char*>(src + sizeof(uint32_t));
+  }
+  CRef cref(&storage, static_cast<typename CRef::instruction_cptr>(instruction));
+  this->visit(cref);
+}
+
+void
+fast_encoder_impl::encode_flat_group(const group_field_instruction* instruction,
+                                     const flat_field_layout&       field_layout,
+                                     const char*                    src,
+                                     bool                           present)
+{
+  if (instruction->optional())
+  {
+    current_pmap().set_next_bit(present);
+    if (!present)
+      return;
+  }
+
+  pmap_state state;
+  if (instruction->segment_pmap_size() > 0)
+    setup_pmap(state, instruction->segment_pmap_size());
+
+  encode_flat_fields(instruction, *field_layout.element, src);
+
+  commit_pmap(state);
+}
+
+void
+fast_encoder_impl::encode_flat_sequence(const sequence_field_instruction* instruction,
+                                        const flat_field_layout&          field_layout,
+                                        const char*                       src,
+                                        bool                              present)
+{
+  const flat_layout& element_layout = *field_layout.element;
+  // flat_sequence places the length after the elements
+  uint32_t length = *reinterpret_cast<const uint32_t*>(src + field_layout.capacity*element_layout.size);
+
+  value_storage storage;
+  uint32_mref length_mref(0, &storage, instruction->length_instruction());
+
+  if (present)
+    length_mref.as(length);
+  else
+    length_mref.as_absent();
+
+  this->visit(length_mref);
+
+  if (!length_mref.present())
+    return;
+
+  for (uint32_t i = 0; i < length; ++i) {
+    pmap_state state;
+    if (instruction->segment_pmap_size() > 0)
+      setup_pmap(state, instruction->segment_pmap_size());
+
+    encode_flat_fields(instruction, element_layout, src + i*element_layout.size);
+    commit_pmap(state);
+  }
+}
+
+void
+fast_encoder_impl::encode_flat_fields(const group_field_instruction* instruction,
+                                      const flat_layout&             layout,
+                                      const char*                    src)
+{
+  assert(layout.num_fields == instruction->subinstructions_count());
+  const uint8_t* presence = reinterpret_cast<const uint8_t*>(src + layout.presence_offset);
+
+  for (std::size_t i = 0; i < layout.num_fields; ++i) {
+    const field_instruction* subinstruction = instruction->subinstruction(i);
+    const flat_field_layout& field_layout = layout.fields[i];
+    const char* field_src = src + field_layout.offset;
+    bool present = flat_is_present(presence, i) || !subinstruction->optional();
+
+    switch (subinstruction->field_type()) {
+      case field_type_int32:
+        encode_flat_int<int32_mref>(subinstruction, field_src, present);
+        break;
+      case field_type_uint32:
+        encode_flat_int<uint32_mref>(subinstruction, field_src, present);
+        break;
+      case field_type_int64:
+        encode_flat_int<int64_mref>(subinstruction, field_src, present);
+        break;
+      case field_type_uint64:
+        encode_flat_int<uint64_mref>(subinstruction, field_src, present);
+        break;
+      case field_type_decimal:
+      case field_type_exponent:
+        {
+          value_storage storage;
+          decimal_mref mref(0, &storage, static_cast<const decimal_field_instruction*>(subinstruction));
+          if (present) {
+            const flat_decimal* value = reinterpret_cast<const flat_decimal*>(field_src);
+            mref.as(value->mantissa, value->exponent);
+          }
+          else {
+            mref.as_absent();
+          }
+          this->visit(mref);
+        }
+        break;
+      case field_type_ascii_string:
+        encode_flat_string<ascii_string_cref>(subinstruction, field_src, present);
+        break;
+      case field_type_unicode_string:
+        encode_flat_string<unicode_string_cref>(subinstruction, field_src, present);
+        break;
+      case field_type_byte_vector:
+        encode_flat_string<byte_vector_cref>(subinstruction, field_src, present);
+        break;
+      case field_type_group:
+        encode_flat_group(static_cast<const group_field_instruction*>(subinstruction),
+                          field_layout, field_src, present);
+        break;
+      case field_type_sequence:
+        encode_flat_sequence(static_cast<const sequence_field_instruction*>(subinstruction),
+                             field_layout, field_src, present);
+        break;
+      default:
+        // fast_type_gen does not generate flat layouts for templates with templateRef
+        assert(false);
+        break;
+    }
+  }
+}
+
+void
+fast_encoder_impl::encode_flat_segment(const flat_layout& layout,
+                                       const char*        src,
+                                       fast_ostreambuf&   sb,
+                                       bool               force_reset)
+{
+  check_update();
+  this->strm_.rdbuf(&sb);
+
+  encoder_presence_map pmap;
+  this->current_ = &pmap;
+
+  template_instruction* instruction = encode_segment_preemble(layout.id, force_reset);
+  encode_flat_fields(instruction, layout, src);
 
   pmap.commit();
 }
@@ -268,19 +744,22 @@ fast_encoder::~fast_encoder()
 void
 fast_encoder::include(const templates_description** descriptions, std::size_t description_count)
 {
-  dictionary_builder builder(impl_->resetter_,
-                             impl_->templates_map_,
-                             &impl_->template_alloc_,
-                             &impl_->value_destroyer_);
-
-  for (std::size_t i = 0; i < description_count; ++i)
-    builder.build(descriptions[i]);
+  impl_->templates_ = impl_->newest_ = impl_->build_templates(descriptions, description_count, 0);
 
-  if (impl_->templates_map_.size() ==1 ) {
-    impl_->active_message_id_ = impl_->templates_map_.begin()->first;
+  if (impl_->templates_->templates_map_.size() ==1 ) {
+    impl_->active_message_id_ = impl_->templates_->templates_map_.begin()->first;
   }
 }
 
+void
+fast_encoder::update(const templates_description** descriptions, std::size_t description_count)
+{
+  assert(impl_->newest_);
+  encoder_templates* templates = impl_->build_templates(descriptions, description_count, impl_->newest_);
+  impl_->newest_->next_.store(templates, boost::memory_order_release);
+  impl_->newest_ = templates;
+}
+
 std::size_t
 fast_encoder::encode(const message_cref& message,
                 char*               buffer,
@@ -304,13 +783,39 @@ fast_encoder::encode(const message_cref& message,
   buffer.resize(sb.length());
 }
 
+std::size_t
+fast_encoder::encode_flat(const flat_layout& layout,
+                          const void*        message,
+                          char*              buffer,
+                          std::size_t        buffer_size,
+                          bool               force_reset)
+{
+  assert(buffer_size > 0);
+
+  fast_ostreambuf sb(buffer, buffer_size);
+  impl_->encode_flat_segment(layout, static_cast<const char*>(message), sb, force_reset);
+  return sb.length();
+}
+
+void
+fast_encoder::encode_flat(const flat_layout& layout,
+                          const void*        message,
+                          std::vector<char>& buffer,
+                          bool               force_reset)
+{
+  resizable_fast_ostreambuf sb(buffer);
+  impl_->encode_flat_segment(layout, static_cast<const char*>(message), sb, force_reset);
+  buffer.resize(sb.length());
+}
+
 const template_instruction*
 fast_encoder::template_with_id(uint32_t id)
 {
   template_instruction* instruction =0;
-  template_id_map_t::iterator itr = impl_->templates_map_.find(id);
+  impl_->check_update();
+  template_id_map_t::iterator itr = impl_->templates_->templates_map_.find(id);
 
-  if (itr != impl_->templates_map_.end()) {
+  if (itr != impl_->templates_->templates_map_.end()) {
     instruction = itr->second;
   }
   return instruction;
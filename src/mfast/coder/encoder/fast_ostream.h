@@ -23,6 +23,16 @@
 #include "mfast/field_instruction.h"
 #include "../common/codec_helper.h"
 #include "fast_ostreambuf.h"
+#include <cstring>
+
+// Integers are encoded with a single word store on little endian targets
+// where the compiler provides the byte swap builtin.
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#  define MFAST_STOP_BIT_WORD_STORE
+#  ifdef __BMI2__
+#    include <immintrin.h>
+#  endif
+#endif
 
 namespace mfast {
 
@@ -155,6 +165,57 @@ inline bool encode_max_value(int8_t&, fast_ostreambuf*)
   return false;
 }
 
+// Returns the number of bits needed to represent v, counting at least one bit.
+inline unsigned significant_bits(uint64_t v)
+{
+#if defined(__GNUC__)
+  return 64 - __builtin_clzll(v | 1);
+#else
+  unsigned n = 1;
+  while (v >>= 1)
+    ++n;
+  return n;
+#endif
+}
+
+// Returns the number of bytes used by the stop bit encoding of value. For
+// signed integers one extra bit is counted so that the highest 7-bit group
+// always carries the sign, which replaces the \x00 or \x7F padding byte.
+template <typename T>
+inline typename boost::enable_if<boost::is_signed<T>, unsigned>::type
+stop_bit_encoded_length(T value)
+{
+  int64_t v = value;
+  return (significant_bits(static_cast<uint64_t>(v ^ (v >> 63))) + 7) / 7;
+}
+
+template <typename T>
+inline typename boost::enable_if<boost::is_unsigned<T>, unsigned>::type
+stop_bit_encoded_length(T value)
+{
+  return (significant_bits(value) + 6) / 7;
+}
+
+#ifdef MFAST_STOP_BIT_WORD_STORE
+// Moves each of the lowest eight 7-bit groups of v into its own byte, with
+// the least significant group in the least significant byte.
+inline uint64_t spread_7bit_groups(uint64_t v)
+{
+#ifdef __BMI2__
+  return _pdep_u64(v, UINT64_C(0x7F7F7F7F7F7F7F7F));
+#else
+  return  (v        & UINT64_C(0x000000000000007F))
+        | ((v << 1) & UINT64_C(0x0000000000007F00))
+        | ((v << 2) & UINT64_C(0x00000000007F0000))
+        | ((v << 3) & UINT64_C(0x000000007F000000))
+        | ((v << 4) & UINT64_C(0x0000007F00000000))
+        | ((v << 5) & UINT64_C(0x00007F0000000000))
+        | ((v << 6) & UINT64_C(0x007F000000000000))
+        | ((v << 7) & UINT64_C(0x7F00000000000000));
+#endif
+}
+#endif
+
 }
 
 template <typename IntType>
@@ -177,39 +238,29 @@ void fast_ostream::encode(IntType value, bool nullable, bool is_null)
     return;
   }
 
-  bool positive = detail::is_positive(value);
-  // padding_mask is used to pad highest 7 bits to 1 when t is negative after t is shift by 7
-  // this ensure that t has no significat bits at the highest 7 bits after shifting
-  const IntType padding_mask = (static_cast<IntType>( value > 0 ? 0 : 0xFE ) << (sizeof(IntType) -1)*8);
-  const IntType no_significant_bits = (value > 0 ? 0 : -1);
-
-  const unsigned max_encoded_length= sizeof(IntType)*8/7+1;
-  char buffer[max_encoded_length];
-  int i = max_encoded_length-1;
-
-  for (; i >= 0 && value != no_significant_bits; --i) {
-    buffer[i] = value & static_cast<IntType>(0x7F);
-    value = (value >> 7) | padding_mask;
+  const unsigned len = detail::stop_bit_encoded_length(value);
+  fast_ostreambuf* buf = rdbuf();
+
+#ifdef MFAST_STOP_BIT_WORD_STORE
+  if (len <= 8 && buf->available() >= 8) {
+    // Spread the 7-bit groups into a word, put the most significant group
+    // first and write all of them with a single unaligned store; only the
+    // first len bytes are committed.
+    uint64_t word = __builtin_bswap64(detail::spread_7bit_groups(static_cast<uint64_t>(value)));
+    word = (word >> (64 - 8*len)) | (UINT64_C(0x80) << 8*(len-1));
+    std::memcpy(buf->pptr(), &word, sizeof(word));
+    buf->pbump(len);
+    return;
   }
+#endif
 
-  ++i;
-
-  if (boost::is_signed<IntType>::value) {
-    if (positive) {
-      // check if the sign bit is on
-      if (buffer[i] & 0x40 ) {
-        // signed bit is on and this is positive integer, we need to pad an extra byte \x00 in the front
-        buffer[--i] = '\x00';
-      }
-    }
-    else if ((buffer[i] & 0x40) == 0) {
-      // this is negative integer and yet the sign bit is off, we need to pad an extra byte \x7F in the front
-      buffer[--i] = '\x7F';
-    }
+  char buffer[sizeof(IntType)*8/7+1];
+  for (int i = len-1; i >= 0; --i) {
+    buffer[i] = static_cast<char>(value & 0x7F);
+    value >>= 7;
   }
-
-  buffer[max_encoded_length-1] |= 0x80; // stop bit
-  rdbuf()->sputn(buffer+i, max_encoded_length-i);
+  buffer[len-1] |= 0x80; // stop bit
+  buf->sputn(buffer, len);
 }
 
 inline void
@@ -53,6 +53,13 @@ class fast_ostreambuf
     virtual void write_bytes_at(const char* data, std::size_t n, std::size_t offset, bool shrink);
 
     const char* pbase() const { return pbase_; }
+
+    /// Returns the number of bytes which can be written without overflow.
+    std::size_t available() const { return epptr_ - pptr_; }
+    /// Returns the current put pointer.
+    char* pptr() { return pptr_; }
+    /// Advances the put pointer by n bytes which have been written directly.
+    void pbump(std::size_t n) { pptr_ += n; }
   protected:
     virtual void overflow(std::size_t n);
     void setp(char* pbase, char* pptr, char* epptr);
@@ -21,6 +21,10 @@
 #include "mfast_coder_export.h"
 #include "mfast/message_ref.h"
 #include "mfast/malloc_allocator.h"
+#include "mfast/arena_allocator.h"
+#include "mfast/flat_layout.h"
+#include <exception>
+#include <boost/exception/all.hpp>
 
 
 namespace mfast
@@ -28,14 +32,59 @@ namespace mfast
 
 struct fast_decoder_impl;
 
+/// Thrown by fast_decoder::decode() when every message generation is still held by the application.
+class MFAST_CODER_EXPORT generation_unavailable_error
+  : public virtual boost::exception, public virtual std::exception
+{
+  public:
+    virtual const char* what() const throw()
+    {
+      return "no free message generation";
+    }
+
+};
+
+/// An interface for observing what a fast_decoder is working on.
+class MFAST_CODER_EXPORT decoder_hook
+{
+  public:
+    virtual ~decoder_hook()
+    {
+    }
+
+    /// Called when the template of a message is known and before any of its fields is decoded.
+    virtual void template_begin(const template_instruction* instruction)=0;
+
+    /// Called before a field, group, sequence or templateRef is decoded.
+    virtual void field_begin(const field_instruction* instruction)=0;
+};
+
 ///
 class MFAST_CODER_EXPORT fast_decoder
 {
   public:
+    /// Identifies the generation of message storage a decoded message lives in.
+    typedef std::size_t generation_handle;
+
     /// Construct a decode using a specified memory allocator
     fast_decoder(allocator* alloc=  malloc_allocator::instance());
     ~fast_decoder();
 
+    /// Keep @a count generations of message storage instead of a single one.
+    ///
+    /// Each generation owns an arena_allocator and its own set of messages, and decoding
+    /// always targets a generation which is not held by the application. A message returned
+    /// by decode() with a generation handle stays valid until the handle is passed to
+    /// release(), so that up to @a count decoded messages can be in flight without copying.
+    /// The allocator passed to the constructor is not used for messages in this mode.
+    ///
+    /// This member function must be called before include().
+    ///
+    /// @param count Number of generations; must be at least 1.
+    /// @param chunk_size The chunk size of the arena_allocator of each generation.
+    void use_generations(std::size_t count,
+                         std::size_t chunk_size = arena_allocator::default_chunk_size);
+
     /// Import templates descriptions into the decoder.
     ///
     /// Notice that this decoder object does neither copy or hold the ownership of the passed
@@ -44,7 +93,7 @@ class MFAST_CODER_EXPORT fast_decoder
     ///
     /// In addition, this memeber function should only be invoked once during the lifetime
     /// of a decoder object. Repetitive invoking the member function would produce undefined
-    /// behavior.
+    /// behavior; use update() to replace the templates afterwards.
     ///
     /// @param descriptions The array of templates_description pointers to be loaded.
     /// @param description_count Number of elements in @a descriptions array.
@@ -55,6 +104,50 @@ class MFAST_CODER_EXPORT fast_decoder
     {
       include(descriptions, N);
     }
+
+    /// Replace the templates of the decoder while it is running.
+    ///
+    /// The new templates and their dictionary are built on the calling thread, which may be
+    /// another thread than the decoding one, and take effect at the start of the next
+    /// decode(); a message being decoded is finished with the previous templates. The value
+    /// of each dictionary entry whose key and type are the same in both template sets is
+    /// carried over, so that unchanged templates continue from their previous values; the
+    /// other entries start undefined.
+    ///
+    /// Must be called after include() has built the templates, i.e. after the first decode()
+    /// with defer_build(). Calls to update() must not overlap each other. As with include(),
+    /// the descriptions must outlive the decoder. With use_generations(), the previous
+    /// templates are released once every generation has been decoded into again.
+    ///
+    /// @param descriptions The array of templates_description pointers to be loaded.
+    /// @param description_count Number of elements in @a descriptions array.
+    void update(const templates_description** descriptions, std::size_t description_count);
+
+    template<int N>
+    void update(const templates_description* (&descriptions)[N])
+    {
+      update(descriptions, N);
+    }
+
+    /// Defer the work of include() until the first decode().
+    ///
+    /// include() copies the template instructions, allocates the dictionary and constructs
+    /// the messages, which first-touches their memory from the calling thread. When the
+    /// decoder runs on another thread, possibly on another NUMA node, call this member
+    /// function before include() so that the memory is touched by the decoding thread instead.
+    /// The descriptions passed to include() must then remain valid until the first decode().
+    void defer_build(bool v);
+
+    /// Place the storage of the generations and of the templates on NUMA node @a node.
+    ///
+    /// The arena_allocator of each generation and the one holding the template instructions
+    /// and their dictionary are bound to @a node as described for arena_allocator; a negative
+    /// @a node, the default, leaves the placement to the first-touch policy. Use
+    /// arena_allocator::numa_node_of_current_thread() on the decoding thread to obtain its node.
+    /// The allocator passed to the constructor is not affected.
+    ///
+    /// This member function must be called before use_generations() and include().
+    void numa_node(int node);
     /// Decode a  message.
     // message_cref decode(fast_istreambuf& sb, bool force_reset = false);
     
@@ -66,6 +159,66 @@ class MFAST_CODER_EXPORT fast_decoder
     /// @param[in] force_reset Force the decoder to reset and discard all exisiting history values.
     message_cref decode(const char*& first, const char* last, bool force_reset = false);
 
+    /// Decode a message into a free generation of message storage.
+    ///
+    /// The returned message is valid until @a generation is released. Only available
+    /// after use_generations() has been called.
+    ///
+    /// @param[in,out] first The initial position of the buffer to be decoded. After decoding
+    ///                the parameter is set to position of the first unconsumed data byte.
+    /// @param[in] last The last position of the buffer to be decoded.
+    /// @param[in] force_reset Force the decoder to reset and discard all exisiting history values.
+    /// @param[out] generation The generation holding the decoded message.
+    /// @throws generation_unavailable_error if all generations are held.
+    message_cref decode(const char*&       first,
+                        const char*        last,
+                        bool               force_reset,
+                        generation_handle& generation);
+
+    /// Decode a message directly into a flat struct described by @a layout.
+    ///
+    /// The dictionary is maintained as by decode(); the message storage of the template is
+    /// only touched for string and byte vector fields. Not available with use_generations().
+    ///
+    /// @param[in,out] first The initial position of the buffer to be decoded. After decoding
+    ///                the parameter is set to position of the first unconsumed data byte.
+    /// @param[in] last The last position of the buffer to be decoded.
+    /// @param[in] layout The layout of the struct pointed by @a dest.
+    /// @param[out] dest The struct to be filled.
+    /// @param[in] force_reset Force the decoder to reset and discard all exisiting history values.
+    /// @throws flat_layout_mismatch_error if the decoded template is not the one of @a layout.
+    /// @throws flat_capacity_error if a string or sequence exceeds its capacity in @a dest.
+    void decode_flat(const char*&       first,
+                     const char*        last,
+                     const flat_layout& layout,
+                     void*              dest,
+                     bool               force_reset = false);
+
+    /// Decode a message into a struct generated by fast_type_gen in the _flat.h header.
+    template <typename FlatMessage>
+    void decode_flat(const char*& first,
+                     const char*  last,
+                     FlatMessage& dest,
+                     bool         force_reset = false)
+    {
+      decode_flat(first, last, FlatMessage::layout(), &dest, force_reset);
+    }
+
+    /// Return a generation obtained from decode() so that its storage can be reused.
+    ///
+    /// This member function may be called from a thread other than the decoding thread.
+    void release(generation_handle generation);
+
+    /// Returns the number of generations which are not held by the application.
+    std::size_t free_generations() const;
+
+    /// Install a hook which is notified of the template and field being decoded; 0 removes it.
+    ///
+    /// Templates are compiled into a linear array of field operations when they are included,
+    /// and decode() runs that array; while a hook or a debug log is installed, the messages
+    /// are decoded by visiting their fields instead, which is slower.
+    void hook(decoder_hook* h);
+
     void debug_log(std::ostream* os);    
     void warning_log(std::ostream* os);
 
@@ -23,6 +23,7 @@
 #include "mfast_coder_export.h"
 #include "mfast/message_ref.h"
 #include "mfast/malloc_allocator.h"
+#include "mfast/flat_layout.h"
 
 #include <vector>
 
@@ -47,7 +48,7 @@ class MFAST_CODER_EXPORT fast_encoder
     ///
     /// In addition, this memeber function should only be invoked once during the lifetime
     /// of a encoder object. Repetitive invoking the member function would produce undefined
-    /// behavior.
+    /// behavior; use update() to replace the templates afterwards.
     ///
     /// @param descriptions The array of templates_description pointers to be loaded.
     /// @param description_count Number of elements in @a descriptions array.
@@ -59,6 +60,35 @@ class MFAST_CODER_EXPORT fast_encoder
       include(descriptions, N);
     }
 
+    /// Replace the templates of the encoder while it is running.
+    ///
+    /// The new templates and their dictionary are built on the calling thread, which may be
+    /// another thread than the encoding one, and take effect at the start of the next
+    /// encode() or template_with_id(). The value of each dictionary entry whose key and type
+    /// are the same in both template sets is carried over, so that unchanged templates
+    /// continue from their previous values; the other entries start undefined.
+    ///
+    /// Must be called after include(), and calls to update() must not overlap each other.
+    /// As with include(), the descriptions must outlive the encoder. The instructions of the
+    /// templates replaced by an update are kept until the next update takes effect, so a
+    /// message built with them must be destroyed before then. Such a message is encoded with
+    /// the template of the same id in effect, which requires the fields of both templates to
+    /// have the same types; otherwise encode() throws fast_dynamic_error.
+    ///
+    /// @param descriptions The array of templates_description pointers to be loaded.
+    /// @param description_count Number of elements in @a descriptions array.
+    void update(const templates_description** descriptions, std::size_t description_count);
+
+    template<int N>
+    void update(const templates_description* (&descriptions)[N])
+    {
+      update(descriptions, N);
+    }
+
+    /// Returns the instruction of the template with @a id, or 0 if there is no such template.
+    ///
+    /// Must be called on the encoding thread, since it switches to the templates passed to
+    /// update() as encode() does.
     const template_instruction* template_with_id(uint32_t id);
     /// Encode a  message into FAST byte stream.
     ///
@@ -83,6 +113,45 @@ class MFAST_CODER_EXPORT fast_encoder
                 std::vector<char>&  buffer,
                 bool                force_reset = false);
               
+    /// Encode a flat struct described by @a layout into FAST byte stream.
+    ///
+    /// @param[in] layout The layout of the struct pointed by @a message.
+    /// @param[in] message The struct to be encoded.
+    /// @param[in] buffer The start position for the encoded FAST stream to be written to.
+    /// @param[in] buffer_size The capacity of @a buffer.
+    /// @param[in] force_reset Force the encoder to reset and discard all exisiting history values.
+    ///
+    /// @returns The size of the encoded byte stream.
+    std::size_t encode_flat(const flat_layout& layout,
+                            const void*        message,
+                            char*              buffer,
+                            std::size_t        buffer_size,
+                            bool               force_reset = false);
+
+    /// Encode a flat struct described by @a layout and append the encoded stream to \a buffer.
+    void encode_flat(const flat_layout& layout,
+                     const void*        message,
+                     std::vector<char>& buffer,
+                     bool               force_reset = false);
+
+    /// Encode a struct generated by fast_type_gen in the _flat.h header.
+    template <typename FlatMessage>
+    std::size_t encode_flat(const FlatMessage& message,
+                            char*              buffer,
+                            std::size_t        buffer_size,
+                            bool               force_reset = false)
+    {
+      return encode_flat(FlatMessage::layout(), &message, buffer, buffer_size, force_reset);
+    }
+
+    template <typename FlatMessage>
+    void encode_flat(const FlatMessage& message,
+                     std::vector<char>& buffer,
+                     bool               force_reset = false)
+    {
+      encode_flat(FlatMessage::layout(), &message, buffer, force_reset);
+    }
+
     /// Instruct the encoder whether the overlong presence map is allowed.
     ///
     /// Overlong presence map is allowed by default for better performance. 
@@ -0,0 +1,246 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cstring>
+#include "mfast/columnar.h"
+
+namespace mfast {
+
+namespace {
+
+std::size_t value_size_of(field_type_enum_t type)
+{
+  switch (type) {
+    case field_type_int32:
+    case field_type_uint32:
+    case field_type_sequence:
+      return 4;
+    case field_type_int64:
+    case field_type_uint64:
+    case field_type_decimal:
+    case field_type_exponent:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+}
+
+column::column(const field_instruction* instruction)
+  : instruction_(instruction)
+  , field_type_(instruction->field_type())
+  , optional_(instruction->optional())
+  , value_size_(value_size_of(instruction->field_type()))
+  , size_(0)
+  , null_count_(0)
+  , offsets_(1, 0)
+{
+}
+
+void column::clear()
+{
+  size_ = 0;
+  null_count_ = 0;
+  validity_.clear();
+  values_.clear();
+  exponents_.clear();
+  offsets_.resize(1);
+  chars_.clear();
+}
+
+void column::set_present(std::size_t row, bool present)
+{
+  if (present)
+    validity_[row >> 3] |= static_cast<uint8_t>(1U << (row & 7));
+  else
+    ++null_count_;
+}
+
+void column::append(const value_storage* first, std::size_t stride, std::size_t count)
+{
+  validity_.resize((size_ + count + 7) / 8, 0);
+  if (value_size_)
+    values_.resize(((size_ + count) * value_size_ + 7) / 8);
+
+  switch (field_type()) {
+    case field_type_int32:
+      append_values<int32_t>(first, stride, count);
+      break;
+    case field_type_uint32:
+      append_values<uint32_t>(first, stride, count);
+      break;
+    case field_type_int64:
+      append_values<int64_t>(first, stride, count);
+      break;
+    case field_type_uint64:
+      append_values<uint64_t>(first, stride, count);
+      break;
+    case field_type_decimal:
+    case field_type_exponent:
+      append_decimals(first, stride, count);
+      break;
+    case field_type_ascii_string:
+    case field_type_unicode_string:
+    case field_type_byte_vector:
+      append_strings(first, stride, count);
+      break;
+    case field_type_sequence:
+      append_sequences(first, stride, count);
+      break;
+    default:
+      append_presences(first, stride, count);
+      break;
+  }
+  size_ += count;
+}
+
+template <typename T>
+void column::append_values(const value_storage* first, std::size_t stride, std::size_t count)
+{
+  T* dest = reinterpret_cast<T*>(&values_[0]) + size_;
+  for (std::size_t i = 0; i < count; ++i, first += stride) {
+    bool present = !optional_ || first->of_uint.present_;
+    dest[i] = present ? first->get<T>() : T();
+    set_present(size_ + i, present);
+  }
+}
+
+void column::append_decimals(const value_storage* first, std::size_t stride, std::size_t count)
+{
+  int64_t* mantissas = reinterpret_cast<int64_t*>(&values_[0]) + size_;
+  exponents_.resize(size_ + count);
+  int8_t* exponents = &exponents_[size_];
+  for (std::size_t i = 0; i < count; ++i, first += stride) {
+    bool present = !optional_ || first->of_decimal.present_;
+    mantissas[i] = present ? first->of_decimal.mantissa_ : 0;
+    exponents[i] = present ? first->of_decimal.exponent_ : 0;
+    set_present(size_ + i, present);
+  }
+}
+
+void column::append_strings(const value_storage* first, std::size_t stride, std::size_t count)
+{
+  std::size_t total = chars_.size();
+  const value_storage* p = first;
+  for (std::size_t i = 0; i < count; ++i, p += stride)
+    total += p->array_length();
+  chars_.reserve(total);
+
+  offsets_.resize(size_ + count + 1);
+  for (std::size_t i = 0; i < count; ++i, first += stride) {
+    std::size_t n = first->array_length();
+    if (n) {
+      const char* content = static_cast<const char*>(first->of_array.content_);
+      chars_.insert(chars_.end(), content, content + n);
+    }
+    offsets_[size_ + i + 1] = static_cast<uint32_t>(chars_.size());
+    set_present(size_ + i, !first->is_empty());
+  }
+}
+
+void column::append_sequences(const value_storage* first, std::size_t stride, std::size_t count)
+{
+  uint32_t* lengths = reinterpret_cast<uint32_t*>(&values_[0]) + size_;
+  for (std::size_t i = 0; i < count; ++i, first += stride) {
+    lengths[i] = first->array_length();
+    set_present(size_ + i, !first->is_empty());
+  }
+}
+
+void column::append_presences(const value_storage* first, std::size_t stride, std::size_t count)
+{
+  for (std::size_t i = 0; i < count; ++i, first += stride) {
+    bool present;
+    if (field_type() == field_type_templateref)
+      present = first->of_templateref.content_ != 0;
+    else
+      present = !optional_ || first->of_group.present_;
+    set_present(size_ + i, present);
+  }
+}
+
+column_batch::column_batch(const group_field_instruction* instruction)
+  : instruction_(instruction)
+  , num_rows_(0)
+{
+  columns_.reserve(instruction->subinstructions_count());
+  for (uint32_t i = 0; i < instruction->subinstructions_count(); ++i)
+    columns_.push_back(column(instruction->subinstruction(i)));
+}
+
+void column_batch::append_rows(const value_storage* storage_array, std::size_t count)
+{
+  // transpose one field at a time so that each column is written sequentially
+  const std::size_t width = columns_.size();
+  for (std::size_t i = 0; i < width; ++i)
+    columns_[i].append(storage_array + i, width, count);
+  num_rows_ += count;
+}
+
+void column_batch::append(const aggregate_cref& row)
+{
+  assert(row.num_fields() == columns_.size());
+  if (columns_.empty())
+    ++num_rows_;
+  else
+    append_rows(row.field_storage(0), 1);
+}
+
+void column_batch::append(const sequence_cref& sequence)
+{
+  assert(sequence.num_fields() == columns_.size());
+  std::size_t count = sequence.size();
+  if (count == 0)
+    return;
+  if (columns_.empty())
+    num_rows_ += count;
+  else
+    // the elements of a sequence are stored contiguously
+    append_rows(sequence[0].field_storage(0), count);
+}
+
+bool column_batch::same_layout(const group_field_instruction* instruction) const
+{
+  if (instruction->subinstructions_count() != columns_.size())
+    return false;
+  for (std::size_t i = 0; i < columns_.size(); ++i) {
+    const field_instruction* subinstruction = instruction->subinstruction(i);
+    if (subinstruction->field_type() != columns_[i].field_type() ||
+        subinstruction->optional() != columns_[i].optional())
+      return false;
+  }
+  return true;
+}
+
+void column_batch::rebind(const group_field_instruction* instruction)
+{
+  assert(same_layout(instruction));
+  instruction_ = instruction;
+  for (std::size_t i = 0; i < columns_.size(); ++i)
+    columns_[i].instruction_ = instruction->subinstruction(i);
+}
+
+void column_batch::clear()
+{
+  num_rows_ = 0;
+  for (std::size_t i = 0; i < columns_.size(); ++i)
+    columns_[i].clear();
+}
+
+}
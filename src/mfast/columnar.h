@@ -0,0 +1,230 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef COLUMNAR_H_T2JV8QHN
+#define COLUMNAR_H_T2JV8QHN
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+#include "mfast/mfast_export.h"
+#include "mfast/field_instruction.h"
+#include "mfast/message_ref.h"
+#include "mfast/sequence_ref.h"
+#include "mfast/fixed_decimal.h"
+
+namespace mfast {
+
+/// The values of one field across all the rows of a column_batch.
+///
+/// The values are stored contiguously by field type:
+///   - int32, uint32, int64 and uint64 fields in an array of the field type, see values();
+///   - decimal fields, including the ones with separate exponent and mantissa operators, in
+///     an array of mantissas and an array of exponents;
+///   - string and byte vector fields as size()+1 offsets into a single character array;
+///   - sequence fields as an uint32_t array of sequence lengths, which is the number of rows
+///     each element contributes to a column_batch of the sequence;
+///   - group and nested message fields only record their presence.
+/// The value of an absent field is 0, or an empty string.
+///
+/// The presence of the fields is kept in a bitmap where bit (i % 8) of byte (i / 8) is set
+/// if the field of row i is present, which is the validity bitmap layout of Apache Arrow.
+class MFAST_EXPORT column
+{
+  public:
+    column(const field_instruction* instruction);
+
+    const field_instruction* instruction() const
+    {
+      return instruction_;
+    }
+
+    field_type_enum_t field_type() const
+    {
+      return field_type_;
+    }
+
+    bool optional() const
+    {
+      return optional_;
+    }
+
+    const char* name() const
+    {
+      return instruction_->name();
+    }
+
+    /// The number of rows.
+    std::size_t size() const
+    {
+      return size_;
+    }
+
+    /// The number of rows whose field is absent.
+    std::size_t null_count() const
+    {
+      return null_count_;
+    }
+
+    bool is_null(std::size_t row) const
+    {
+      assert(row < size_);
+      return (validity_[row >> 3] & (1U << (row & 7))) == 0;
+    }
+
+    /// The presence bitmap; it has (size()+7)/8 bytes.
+    const uint8_t* null_bitmap() const
+    {
+      return validity_.empty() ? 0 : &validity_[0];
+    }
+
+    /// The values of an integer or sequence column; @a T must match the field type.
+    template <typename T>
+    const T* values() const
+    {
+      assert(sizeof(T) == value_size_);
+      return values_.empty() ? 0 : reinterpret_cast<const T*>(&values_[0]);
+    }
+
+    /// The mantissas of a decimal column.
+    const int64_t* mantissas() const
+    {
+      return values<int64_t>();
+    }
+
+    /// The exponents of a decimal column.
+    const int8_t* exponents() const
+    {
+      return exponents_.empty() ? 0 : &exponents_[0];
+    }
+
+    fixed_decimal decimal_value(std::size_t row) const
+    {
+      return fixed_decimal(mantissas()[row], exponents()[row]);
+    }
+
+    /// The offsets of a string or byte vector column; the content of row i is
+    /// [chars() + offsets()[i], chars() + offsets()[i+1]).
+    const uint32_t* offsets() const
+    {
+      return &offsets_[0];
+    }
+
+    /// The concatenated content of a string or byte vector column.
+    const char* chars() const
+    {
+      return chars_.empty() ? 0 : &chars_[0];
+    }
+
+    /// Append the fields of @a count rows; the field of row i is at @a first + i * @a stride.
+    void append(const value_storage* first, std::size_t stride, std::size_t count);
+
+    /// Remove all rows while keeping the allocated memory.
+    void clear();
+
+  private:
+    template <typename T>
+    void append_values(const value_storage* first, std::size_t stride, std::size_t count);
+    void append_decimals(const value_storage* first, std::size_t stride, std::size_t count);
+    void append_strings(const value_storage* first, std::size_t stride, std::size_t count);
+    void append_sequences(const value_storage* first, std::size_t stride, std::size_t count);
+    void append_presences(const value_storage* first, std::size_t stride, std::size_t count);
+    void set_present(std::size_t row, bool present);
+
+    friend class column_batch;
+    const field_instruction* instruction_;
+    field_type_enum_t field_type_;
+    bool optional_;
+    std::size_t value_size_;
+    std::size_t size_;
+    std::size_t null_count_;
+    std::vector<uint8_t> validity_;
+    // uint64_t elements keep the values aligned for every integer type
+    std::vector<uint64_t> values_;
+    std::vector<int8_t> exponents_;
+    std::vector<uint32_t> offsets_;
+    std::vector<char> chars_;
+};
+
+/// Transposes messages, groups or sequence elements of the same instruction into one column
+/// per field (struct of arrays), so that a field can be scanned across many rows with a
+/// contiguous, vectorizable loop instead of striding over the value_storage of every row.
+///
+/// A batch can be cleared and refilled; its memory is only allocated when it grows.
+/// Nested groups and sequences are not transposed into the columns of the batch; use another
+/// column_batch with their instruction to transpose them.
+class MFAST_EXPORT column_batch
+{
+  public:
+    /// @param instruction The template, group or sequence whose fields become the columns.
+    column_batch(const group_field_instruction* instruction);
+
+    const group_field_instruction* instruction() const
+    {
+      return instruction_;
+    }
+
+    std::size_t num_rows() const
+    {
+      return num_rows_;
+    }
+
+    std::size_t num_columns() const
+    {
+      return columns_.size();
+    }
+
+    const column& operator[](std::size_t index) const
+    {
+      return columns_[index];
+    }
+
+    /// return -1 if no such column is found
+    int column_index_with_name(const char* name) const
+    {
+      return instruction_->find_subinstruction_index_by_name(name);
+    }
+
+    /// Append a message, group or sequence element with the instruction of this batch as a row.
+    void append(const aggregate_cref& row);
+
+    /// Append every element of @a sequence as a row.
+    void append(const sequence_cref& sequence);
+
+    /// Returns true if the fields of @a instruction have the types and presences of the columns.
+    bool same_layout(const group_field_instruction* instruction) const;
+
+    /// Append the following rows with @a instruction, which must have the same layout as the
+    /// instruction of the batch, e.g. the instruction of the same template after the templates
+    /// of a decoder have been updated. The rows appended before are kept.
+    void rebind(const group_field_instruction* instruction);
+
+    void clear();
+
+  private:
+    void append_rows(const value_storage* storage_array, std::size_t count);
+
+    const group_field_instruction* instruction_;
+    std::size_t num_rows_;
+    std::vector<column> columns_;
+};
+
+}
+
+#endif /* end of include guard: COLUMNAR_H_T2JV8QHN */
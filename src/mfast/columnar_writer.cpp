@@ -0,0 +1,467 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/exception_ptr.hpp>
+#include "mfast/columnar_writer.h"
+
+namespace mfast {
+
+namespace {
+
+const char padding[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+inline std::size_t padding_of(std::size_t n)
+{
+  return (8 - (n & 7)) & 7;
+}
+
+void write_padded(std::ostream& os, const void* data, std::size_t n)
+{
+  if (n)
+    os.write(static_cast<const char*>(data), n);
+  os.write(padding, padding_of(n));
+}
+
+void write_u64(std::ostream& os, uint64_t v)
+{
+  os.write(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+void write_tag(std::ostream& os, const char* tag, uint32_t v)
+{
+  os.write(tag, 4);
+  os.write(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+// A buffer is written as its length followed by its content padded to 8 bytes.
+void write_buffer(std::ostream& os, const void* data, std::size_t n)
+{
+  write_u64(os, n);
+  write_padded(os, data, n);
+}
+
+void write_string(std::ostream& os, const char* str)
+{
+  std::size_t n = std::strlen(str);
+  write_buffer(os, str, n);
+}
+
+// replace the characters which are not safe in a file name
+std::string file_name_of(const char* name)
+{
+  std::string result(name);
+  for (std::size_t i = 0; i < result.size(); ++i) {
+    char c = result[i];
+    if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+          c == '_' || c == '-' || c == '.'))
+      result[i] = '_';
+  }
+  return result;
+}
+
+}
+
+columnar_table_writer::columnar_table_writer(std::ostream&                  os,
+                                             const std::string&             table_name,
+                                             const group_field_instruction* instruction)
+  : os_(os)
+  , table_name_(table_name)
+  , num_columns_(instruction->subinstructions_count())
+  , num_chunks_(0)
+  , num_rows_(0)
+{
+  os_.write("MFCOL1\0\0", 8);
+  write_string(os_, table_name_.c_str());
+  write_u64(os_, instruction->subinstructions_count());
+  for (uint32_t i = 0; i < instruction->subinstructions_count(); ++i) {
+    const field_instruction* subinstruction = instruction->subinstruction(i);
+    uint32_t type = subinstruction->field_type();
+    uint32_t optional = subinstruction->optional();
+    os_.write(reinterpret_cast<const char*>(&type), sizeof(type));
+    os_.write(reinterpret_cast<const char*>(&optional), sizeof(optional));
+    write_string(os_, subinstruction->name());
+  }
+  if (!os_)
+    BOOST_THROW_EXCEPTION(columnar_io_error());
+}
+
+void columnar_table_writer::write_chunk(const column_batch& chunk)
+{
+  assert(chunk.num_columns() == num_columns_);
+  std::size_t n = chunk.num_rows();
+  write_tag(os_, "CHNK", 0);
+  write_u64(os_, n);
+
+  for (std::size_t i = 0; i < chunk.num_columns(); ++i) {
+    const column& col = chunk[i];
+    write_buffer(os_, col.null_bitmap(), (n + 7) / 8);
+    switch (col.field_type()) {
+      case field_type_int32:
+      case field_type_uint32:
+      case field_type_sequence:
+        write_buffer(os_, col.values<uint32_t>(), n * 4);
+        break;
+      case field_type_int64:
+      case field_type_uint64:
+        write_buffer(os_, col.values<uint64_t>(), n * 8);
+        break;
+      case field_type_decimal:
+      case field_type_exponent:
+        write_buffer(os_, col.mantissas(), n * 8);
+        write_buffer(os_, col.exponents(), n);
+        break;
+      case field_type_ascii_string:
+      case field_type_unicode_string:
+      case field_type_byte_vector:
+        write_buffer(os_, col.offsets(), (n + 1) * 4);
+        write_buffer(os_, col.chars(), col.offsets()[n]);
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (!os_)
+    BOOST_THROW_EXCEPTION(columnar_io_error());
+  ++num_chunks_;
+  num_rows_ += n;
+}
+
+void columnar_table_writer::finish()
+{
+  write_tag(os_, "END\0", static_cast<uint32_t>(num_chunks_));
+  write_u64(os_, num_rows_);
+  os_.flush();
+  if (!os_)
+    BOOST_THROW_EXCEPTION(columnar_io_error());
+}
+
+namespace detail {
+
+inline std::ostream& opened(std::ofstream& file, const std::string& path)
+{
+  if (!file)
+    BOOST_THROW_EXCEPTION(columnar_io_error() << boost::errinfo_file_name(path));
+  return file;
+}
+
+struct columnar_table
+{
+  columnar_table(const std::string&             path,
+                 const std::string&             name,
+                 const group_field_instruction* instruction)
+    : file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc)
+    , writer(opened(file, path), name, instruction)
+    , first(instruction)
+    , second(instruction)
+    , active(&first)
+    , pending(&second)
+    , in_flight(false)
+  {
+  }
+
+  std::ofstream file;
+  columnar_table_writer writer;
+  column_batch first;
+  column_batch second;
+  // rows are appended to active while pending is written by a worker thread
+  column_batch* active;
+  column_batch* pending;
+  bool in_flight;
+  // the child tables of the sequence and group fields, by field index
+  std::vector<std::pair<std::size_t, columnar_table*> > children;
+};
+
+struct columnar_exporter_impl
+{
+  columnar_exporter_impl(const std::string& path_prefix, std::size_t chunk_rows, std::size_t num_threads)
+    : path_prefix_(path_prefix)
+    , chunk_rows_(chunk_rows ? chunk_rows : 1)
+    , stopping_(false)
+  {
+    for (std::size_t i = 0; i < num_threads; ++i)
+      workers_.create_thread(boost::bind(&columnar_exporter_impl::work, this));
+  }
+
+  ~columnar_exporter_impl()
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      stopping_ = true;
+    }
+    work_available_.notify_all();
+    workers_.join_all();
+    for (std::size_t i = 0; i < tables_.size(); ++i)
+      delete tables_[i];
+  }
+
+  columnar_table* create_table(const std::string&             name,
+                               const std::string&             file_base,
+                               const group_field_instruction* instruction)
+  {
+    columnar_table* table = new columnar_table(path_prefix_ + file_base + ".mfc", name, instruction);
+    tables_.push_back(table);
+
+    for (uint32_t i = 0; i < instruction->subinstructions_count(); ++i) {
+      const field_instruction* subinstruction = instruction->subinstruction(i);
+      field_type_enum_t type = subinstruction->field_type();
+      if (type == field_type_sequence || type == field_type_group) {
+        columnar_table* child = create_table(name + "." + subinstruction->name(),
+                                             file_base + "." + file_name_of(subinstruction->name()),
+                                             static_cast<const group_field_instruction*>(subinstruction));
+        table->children.push_back(std::make_pair(static_cast<std::size_t>(i), child));
+      }
+    }
+    return table;
+  }
+
+  // Returns true if the fields of instruction fit the columns of table and its children.
+  static bool same_layout(const columnar_table* table, const group_field_instruction* instruction)
+  {
+    if (!table->active->same_layout(instruction))
+      return false;
+    for (std::size_t c = 0; c < table->children.size(); ++c) {
+      const field_instruction* subinstruction = instruction->subinstruction(table->children[c].first);
+      if (!same_layout(table->children[c].second, static_cast<const group_field_instruction*>(subinstruction)))
+        return false;
+    }
+    return true;
+  }
+
+  // Append the following rows of table and its children with instruction; the previous
+  // instruction is not used again, since it may be gone after an update of the decoder.
+  void rebind(columnar_table* table, const group_field_instruction* instruction)
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      while (table->in_flight)
+        work_done_.wait(lock);
+    }
+    table->active->rebind(instruction);
+    table->pending->rebind(instruction);
+    for (std::size_t c = 0; c < table->children.size(); ++c) {
+      const field_instruction* subinstruction = instruction->subinstruction(table->children[c].first);
+      rebind(table->children[c].second, static_cast<const group_field_instruction*>(subinstruction));
+    }
+  }
+
+  columnar_table* table_of(const template_instruction* instruction)
+  {
+    std::map<uint32_t, std::pair<const template_instruction*, columnar_table*> >::iterator it =
+      template_tables_.find(instruction->id());
+    if (it == template_tables_.end()) {
+      std::stringstream file_base;
+      file_base << file_name_of(instruction->name()) << '-' << instruction->id();
+      columnar_table* table = create_table(instruction->name(), file_base.str(), instruction);
+      template_tables_[instruction->id()] = std::make_pair(instruction, table);
+      return table;
+    }
+
+    columnar_table* table = it->second.second;
+    if (it->second.first != instruction) {
+      if (!same_layout(table, instruction))
+        BOOST_THROW_EXCEPTION(columnar_schema_error());
+      rebind(table, instruction);
+      it->second.first = instruction;
+    }
+    return table;
+  }
+
+  // Append the children of count rows of table which start at storage_array.
+  void append_children(columnar_table* table, const value_storage* storage_array, std::size_t count)
+  {
+    const std::size_t width = table->active->num_columns();
+    for (std::size_t c = 0; c < table->children.size(); ++c) {
+      std::size_t index = table->children[c].first;
+      columnar_table* child = table->children[c].second;
+      const field_instruction* subinstruction = table->active->instruction()->subinstruction(index);
+
+      for (std::size_t r = 0; r < count; ++r) {
+        const value_storage& storage = storage_array[r * width + index];
+        if (subinstruction->field_type() == field_type_sequence) {
+          std::size_t length = storage.array_length();
+          if (length == 0)
+            continue;
+          const sequence_field_instruction* inst = static_cast<const sequence_field_instruction*>(subinstruction);
+          child->active->append(sequence_cref(&storage, inst));
+          const value_storage* elements = static_cast<const value_storage*>(storage.of_array.content_);
+          append_children(child, elements, length);
+        }
+        else if (!subinstruction->optional() || storage.of_group.present_) {
+          const group_field_instruction* inst = static_cast<const group_field_instruction*>(subinstruction);
+          child->active->append(aggregate_cref(storage.of_group.content_, inst));
+          append_children(child, storage.of_group.content_, 1);
+        }
+      }
+      flush_if_full(child);
+    }
+  }
+
+  void append(const message_cref& message)
+  {
+    rethrow_worker_error();
+    columnar_table* table = table_of(message.instruction());
+    table->active->append(message);
+    append_children(table, message.field_storage(0), 1);
+    flush_if_full(table);
+  }
+
+  void flush_if_full(columnar_table* table)
+  {
+    if (table->active->num_rows() >= chunk_rows_)
+      flush(table);
+  }
+
+  void flush(columnar_table* table)
+  {
+    if (workers_.size() == 0) {
+      table->writer.write_chunk(*table->active);
+      table->active->clear();
+      return;
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    // the chunks of a table are written in order, one at a time
+    while (table->in_flight)
+      work_done_.wait(lock);
+    std::swap(table->active, table->pending);
+    table->in_flight = true;
+    queue_.push_back(table);
+    work_available_.notify_one();
+  }
+
+  void work()
+  {
+    for (;;) {
+      columnar_table* table;
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        while (queue_.empty() && !stopping_)
+          work_available_.wait(lock);
+        if (queue_.empty())
+          return;
+        table = queue_.front();
+        queue_.pop_front();
+      }
+
+      boost::exception_ptr error;
+      try {
+        table->writer.write_chunk(*table->pending);
+      }
+      catch (...) {
+        error = boost::current_exception();
+      }
+      table->pending->clear();
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        if (error && !error_)
+          error_ = error;
+        table->in_flight = false;
+      }
+      work_done_.notify_all();
+    }
+  }
+
+  void wait_idle()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    for (std::size_t i = 0; i < tables_.size(); ++i) {
+      while (tables_[i]->in_flight)
+        work_done_.wait(lock);
+    }
+  }
+
+  void rethrow_worker_error()
+  {
+    boost::exception_ptr error;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      error = error_;
+    }
+    if (error)
+      boost::rethrow_exception(error);
+  }
+
+  void finish()
+  {
+    for (std::size_t i = 0; i < tables_.size(); ++i) {
+      if (tables_[i]->active->num_rows())
+        flush(tables_[i]);
+    }
+    wait_idle();
+    rethrow_worker_error();
+    for (std::size_t i = 0; i < tables_.size(); ++i)
+      tables_[i]->writer.finish();
+  }
+
+  std::string path_prefix_;
+  std::size_t chunk_rows_;
+  std::vector<columnar_table*> tables_;
+  // the instruction of the rows and the table of each template id
+  std::map<uint32_t, std::pair<const template_instruction*, columnar_table*> > template_tables_;
+
+  boost::thread_group workers_;
+  boost::mutex mutex_;
+  boost::condition_variable work_available_;
+  boost::condition_variable work_done_;
+  std::deque<columnar_table*> queue_;
+  bool stopping_;
+  boost::exception_ptr error_;
+};
+
+}
+
+columnar_exporter::columnar_exporter(const std::string& path_prefix,
+                                     std::size_t        chunk_rows,
+                                     std::size_t        num_threads)
+  : impl_(new detail::columnar_exporter_impl(path_prefix, chunk_rows, num_threads))
+{
+}
+
+columnar_exporter::~columnar_exporter()
+{
+  delete impl_;
+}
+
+void columnar_exporter::append(const message_cref& message)
+{
+  impl_->append(message);
+}
+
+void columnar_exporter::finish()
+{
+  impl_->finish();
+}
+
+std::size_t columnar_exporter::num_tables() const
+{
+  return impl_->tables_.size();
+}
+
+}
@@ -0,0 +1,165 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef COLUMNAR_WRITER_H_W6CE3NLA
+#define COLUMNAR_WRITER_H_W6CE3NLA
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <exception>
+#include <boost/exception/all.hpp>
+#include "mfast/mfast_export.h"
+#include "mfast/message_ref.h"
+#include "mfast/columnar.h"
+
+namespace mfast {
+
+/// Thrown when a columnar file cannot be created or written.
+///
+/// The name of the file is attached as boost::errinfo_file_name when it is known.
+class MFAST_EXPORT columnar_io_error
+  : public virtual boost::exception, public virtual std::exception
+{
+  public:
+    virtual const char* what() const throw()
+    {
+      return "unable to write the columnar file";
+    }
+
+};
+
+/// Thrown when the fields of an exported template change, e.g. after the templates of the
+/// decoder have been updated, so that its messages no longer fit the columns of its table.
+class MFAST_EXPORT columnar_schema_error
+  : public virtual boost::exception, public virtual std::exception
+{
+  public:
+    virtual const char* what() const throw()
+    {
+      return "the fields of the template do not match its columnar table";
+    }
+
+};
+
+/// Writes a table in the mFAST columnar format, one column_batch at a time.
+///
+/// A columnar file is a sequence of records in the native byte order, padded to 8 bytes:
+///   - the magic "MFCOL1\0\0";
+///   - the schema: the length and the bytes of the table name, the number of columns and,
+///     for every column, its field_type_enum_t, whether it is optional, and its name;
+///   - any number of chunks: the tag "CHNK", the number of rows and, for every column, its
+///     buffers, each written as its byte length followed by its bytes; see column for the
+///     buffers of each field type;
+///   - the tag "END\0", the number of chunks and the total number of rows.
+/// The buffers use the validity bitmap, offset and value layouts of Apache Arrow, so a
+/// chunk maps directly to an Arrow record batch.
+class MFAST_EXPORT columnar_table_writer
+{
+  public:
+    /// Write the magic number and the schema of @a instruction to @a os.
+    columnar_table_writer(std::ostream&                  os,
+                          const std::string&             table_name,
+                          const group_field_instruction* instruction);
+
+    /// Append the rows of @a chunk, which must have the columns of this table.
+    /// @throws columnar_io_error if the stream fails.
+    void write_chunk(const column_batch& chunk);
+
+    /// Write the end record; no more chunks can be written after it.
+    void finish();
+
+    const std::string& table_name() const
+    {
+      return table_name_;
+    }
+
+    std::size_t num_chunks() const
+    {
+      return num_chunks_;
+    }
+
+    uint64_t num_rows() const
+    {
+      return num_rows_;
+    }
+
+  private:
+    std::ostream& os_;
+    std::string table_name_;
+    std::size_t num_columns_;
+    std::size_t num_chunks_;
+    uint64_t num_rows_;
+};
+
+namespace detail {
+struct columnar_exporter_impl;
+}
+
+/// Converts decoded messages into one columnar table per template.
+///
+/// The table of a template is written to "<path_prefix><template name>-<template id>.mfc",
+/// where the characters of the name other than letters, digits, '_', '-' and '.' are
+/// replaced by '_'. The elements of a sequence field and the content of a present group field
+/// go into a child table named "<parent table>.<field name>" and written to
+/// "<parent file>.<field name>.mfc"; the column of the field in the parent table holds the
+/// number of elements, or the presence of the group, which relates the rows of the child
+/// table to the rows of the parent table in order. Nested message fields are not exported.
+///
+/// Tables are kept by template id, so the messages of a template continue in the same table
+/// after the templates of the decoder have been updated, provided its fields are unchanged.
+///
+/// The rows of each table are buffered in chunks of @a chunk_rows rows; a chunk of a child
+/// table may exceed it by the elements of one sequence, which are never split. When a chunk
+/// is full, it is handed to a pool of worker threads which write the chunks of different
+/// tables in parallel while the caller keeps appending; at most two chunks per table are
+/// held in memory.
+class MFAST_EXPORT columnar_exporter
+{
+  public:
+    /// @param num_threads The number of worker threads; 0 writes every chunk in the
+    ///        calling thread.
+    columnar_exporter(const std::string& path_prefix,
+                      std::size_t        chunk_rows = 65536,
+                      std::size_t        num_threads = 1);
+
+    /// Stop the worker threads; call finish() first to complete the files.
+    ~columnar_exporter();
+
+    /// Append @a message as a row of the table of its template.
+    /// @throws columnar_io_error if a file of the table cannot be created or written.
+    /// @throws columnar_schema_error if the template has other fields than when its table
+    ///         was created.
+    void append(const message_cref& message);
+
+    /// Write the remaining rows and the end record of every table.
+    void finish();
+
+    /// The number of tables created so far, including the child tables.
+    std::size_t num_tables() const;
+
+  private:
+    columnar_exporter(const columnar_exporter&);
+    columnar_exporter& operator = (const columnar_exporter&);
+
+    detail::columnar_exporter_impl* impl_;
+};
+
+}
+
+#endif /* end of include guard: COLUMNAR_WRITER_H_W6CE3NLA */
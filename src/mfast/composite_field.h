@@ -75,6 +75,7 @@ class composite_field
     void ensure_valid();
     
     friend struct fast_decoder_impl;
+    friend struct message_generation;
 
     mfast::allocator* alloc_;
     instruction_cptr instruction_;
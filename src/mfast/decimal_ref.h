@@ -24,6 +24,7 @@
 
 #include "mfast/field_ref.h"
 #include "mfast/int_ref.h"
+#include "mfast/fixed_decimal.h"
 
 #include <boost/multiprecision/cpp_dec_float.hpp>
 
@@ -111,7 +112,11 @@ class decimal_cref
   public:
     typedef decimal_field_instruction instruction_type;
     typedef const instruction_type* instruction_cptr;
+#ifdef MFAST_MULTIPRECISION_DECIMAL
     typedef decimal value_type;
+#else
+    typedef fixed_decimal value_type;
+#endif
 
     decimal_cref()
     {
@@ -150,12 +155,19 @@ class decimal_cref
 
     bool is_initial_value() const;
 
+#ifdef MFAST_MULTIPRECISION_DECIMAL
     decimal value() const
     {
       decimal r( mantissa() );
       r *= decimal_backend(1.0, exponent());
       return r;
     }
+#else
+    fixed_decimal value() const
+    {
+      return fixed_decimal(mantissa(), exponent());
+    }
+#endif
 
     instruction_cptr instruction() const
     {
@@ -348,6 +360,11 @@ class decimal_mref
       this->storage()->present(1);
     }
 
+    void as (const fixed_decimal& d) const
+    {
+      as(d.mantissa(), d.exponent());
+    }
+
     void as (decimal d) const
     {
       double m;
@@ -0,0 +1,137 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef FIELD_CONSTANTS_H_K3W8RZ5D
+#define FIELD_CONSTANTS_H_K3W8RZ5D
+
+#include <cstddef>
+#include "mfast/field_instruction.h"
+
+namespace mfast {
+
+/// The properties of a field of a type generated by fast_type_gen as compile-time constants.
+///
+/// The generated cref classes declare one of these for every field, named after the field
+/// with the suffix "_field", so that code written against generated types can select its
+/// path with templates or constant conditions instead of reading the instruction.
+template <std::size_t Index, field_type_enum_t FieldType, operator_enum_t Operator, presence_enum_t Presence>
+struct field_constants
+{
+  /// The position of the field in its template, group or sequence element.
+  static const std::size_t index = Index;
+  static const field_type_enum_t field_type = FieldType;
+  /// For a decimal with separate mantissa and exponent operators, the exponent operator.
+  static const operator_enum_t field_operator = Operator;
+  static const bool optional = (Presence == presence_optional);
+  static const bool has_initial_value = false;
+};
+
+/// The constants of an integer field with an initial value.
+template <std::size_t Index, field_type_enum_t FieldType, operator_enum_t Operator, presence_enum_t Presence,
+          typename T, T InitialValue>
+struct int_field_constants
+  : field_constants<Index, FieldType, Operator, Presence>
+{
+  static const bool has_initial_value = true;
+  static const T initial_value = InitialValue;
+};
+
+/// The constants of a decimal field with an initial value.
+template <std::size_t Index, operator_enum_t Operator, presence_enum_t Presence,
+          int64_t Mantissa, int Exponent>
+struct decimal_field_constants
+  : field_constants<Index, field_type_decimal, Operator, Presence>
+{
+  static const bool has_initial_value = true;
+  static const int64_t initial_mantissa = Mantissa;
+  static const int8_t initial_exponent = Exponent;
+};
+
+/// The constants of a decimal field with separate exponent and mantissa operators, which
+/// has the field type field_type_exponent. The base describes the exponent; its initial
+/// value is given when HasInitialExponent is true and the one of the mantissa when
+/// HasInitialMantissa is true.
+template <std::size_t Index, operator_enum_t ExponentOperator, presence_enum_t Presence,
+          operator_enum_t MantissaOperator,
+          bool HasInitialExponent = false, int InitialExponent = 0,
+          bool HasInitialMantissa = false, int64_t InitialMantissa = 0>
+struct split_decimal_field_constants
+  : field_constants<Index, field_type_exponent, ExponentOperator, Presence>
+{
+  static const bool has_initial_value = HasInitialExponent;
+  static const int8_t initial_exponent = InitialExponent;
+  static const operator_enum_t mantissa_operator = MantissaOperator;
+  static const bool has_initial_mantissa = HasInitialMantissa;
+  static const int64_t initial_mantissa = InitialMantissa;
+};
+
+template <std::size_t Index, field_type_enum_t FieldType, operator_enum_t Operator, presence_enum_t Presence>
+const std::size_t field_constants<Index, FieldType, Operator, Presence>::index;
+
+template <std::size_t Index, field_type_enum_t FieldType, operator_enum_t Operator, presence_enum_t Presence>
+const field_type_enum_t field_constants<Index, FieldType, Operator, Presence>::field_type;
+
+template <std::size_t Index, field_type_enum_t FieldType, operator_enum_t Operator, presence_enum_t Presence>
+const operator_enum_t field_constants<Index, FieldType, Operator, Presence>::field_operator;
+
+template <std::size_t Index, field_type_enum_t FieldType, operator_enum_t Operator, presence_enum_t Presence>
+const bool field_constants<Index, FieldType, Operator, Presence>::optional;
+
+template <std::size_t Index, field_type_enum_t FieldType, operator_enum_t Operator, presence_enum_t Presence>
+const bool field_constants<Index, FieldType, Operator, Presence>::has_initial_value;
+
+template <std::size_t Index, field_type_enum_t FieldType, operator_enum_t Operator, presence_enum_t Presence,
+          typename T, T InitialValue>
+const bool int_field_constants<Index, FieldType, Operator, Presence, T, InitialValue>::has_initial_value;
+
+template <std::size_t Index, field_type_enum_t FieldType, operator_enum_t Operator, presence_enum_t Presence,
+          typename T, T InitialValue>
+const T int_field_constants<Index, FieldType, Operator, Presence, T, InitialValue>::initial_value;
+
+template <std::size_t Index, operator_enum_t Operator, presence_enum_t Presence, int64_t Mantissa, int Exponent>
+const bool decimal_field_constants<Index, Operator, Presence, Mantissa, Exponent>::has_initial_value;
+
+template <std::size_t Index, operator_enum_t Operator, presence_enum_t Presence, int64_t Mantissa, int Exponent>
+const int64_t decimal_field_constants<Index, Operator, Presence, Mantissa, Exponent>::initial_mantissa;
+
+template <std::size_t Index, operator_enum_t Operator, presence_enum_t Presence, int64_t Mantissa, int Exponent>
+const int8_t decimal_field_constants<Index, Operator, Presence, Mantissa, Exponent>::initial_exponent;
+
+template <std::size_t Index, operator_enum_t ExponentOperator, presence_enum_t Presence, operator_enum_t MantissaOperator,
+          bool HasInitialExponent, int InitialExponent, bool HasInitialMantissa, int64_t InitialMantissa>
+const bool split_decimal_field_constants<Index, ExponentOperator, Presence, MantissaOperator, HasInitialExponent, InitialExponent, HasInitialMantissa, InitialMantissa>::has_initial_value;
+
+template <std::size_t Index, operator_enum_t ExponentOperator, presence_enum_t Presence, operator_enum_t MantissaOperator,
+          bool HasInitialExponent, int InitialExponent, bool HasInitialMantissa, int64_t InitialMantissa>
+const int8_t split_decimal_field_constants<Index, ExponentOperator, Presence, MantissaOperator, HasInitialExponent, InitialExponent, HasInitialMantissa, InitialMantissa>::initial_exponent;
+
+template <std::size_t Index, operator_enum_t ExponentOperator, presence_enum_t Presence, operator_enum_t MantissaOperator,
+          bool HasInitialExponent, int InitialExponent, bool HasInitialMantissa, int64_t InitialMantissa>
+const operator_enum_t split_decimal_field_constants<Index, ExponentOperator, Presence, MantissaOperator, HasInitialExponent, InitialExponent, HasInitialMantissa, InitialMantissa>::mantissa_operator;
+
+template <std::size_t Index, operator_enum_t ExponentOperator, presence_enum_t Presence, operator_enum_t MantissaOperator,
+          bool HasInitialExponent, int InitialExponent, bool HasInitialMantissa, int64_t InitialMantissa>
+const bool split_decimal_field_constants<Index, ExponentOperator, Presence, MantissaOperator, HasInitialExponent, InitialExponent, HasInitialMantissa, InitialMantissa>::has_initial_mantissa;
+
+template <std::size_t Index, operator_enum_t ExponentOperator, presence_enum_t Presence, operator_enum_t MantissaOperator,
+          bool HasInitialExponent, int InitialExponent, bool HasInitialMantissa, int64_t InitialMantissa>
+const int64_t split_decimal_field_constants<Index, ExponentOperator, Presence, MantissaOperator, HasInitialExponent, InitialExponent, HasInitialMantissa, InitialMantissa>::initial_mantissa;
+
+}
+
+#endif /* end of include guard: FIELD_CONSTANTS_H_K3W8RZ5D */
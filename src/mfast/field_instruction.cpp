@@ -16,8 +16,10 @@
 //     You should have received a copy of the GNU Lesser General Public License
 //     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
 //
+#include <algorithm>
 #include <cstring>
 #include "mfast/field_instruction.h"
+#include "mfast/allocator_policy.h"
 #include "mfast/allocator.h"
 
 namespace mfast {
@@ -131,11 +133,20 @@ void decimal_field_instruction::accept(field_instruction_visitor& visitor,
 /////////////////////////////////////////////////////////
 
 void string_field_instruction::construct_value(value_storage& storage,
-                                               allocator*       ) const
+                                               allocator*     alloc) const
 {
   storage = initial_value_;
   if (optional())
     storage.of_array.len_ = 0;
+
+  if (capacity_) {
+    // reserve the room for capacity_ characters and the null terminator up front
+    void* content = 0;
+    storage.of_array.capacity_ = default_allocator_policy::reallocate(alloc, content, 0, capacity_+1);
+    if (initial_value_.array_length())
+      memcpy(content, initial_value_.of_array.content_, initial_value_.array_length());
+    storage.of_array.content_ = content;
+  }
 }
 
 void string_field_instruction::destruct_value(value_storage& storage,
@@ -152,7 +163,7 @@ void string_field_instruction::copy_value(const value_storage& src,
 {
   size_t len = src.of_array.len_;
   if (len && src.of_array.content_ != initial_value_.of_array.content_) {
-    dest.of_array.content_ = alloc->allocate(len);
+    dest.of_array.content_ = default_allocator_policy::allocate(alloc, len);
     memcpy(dest.of_array.content_, src.of_array.content_, len);
     dest.of_array.capacity_ = len;
   }
@@ -207,8 +218,73 @@ void aggregate_instruction_base::destruct_group_subfields(value_storage* subfiel
   }
 }
 
+namespace {
+
+// FNV-1a
+inline uint32_t hash_name(const char* name, std::size_t len)
+{
+  uint32_t h = 2166136261U;
+  for (std::size_t i = 0; i < len; ++i) {
+    h ^= static_cast<unsigned char>(name[i]);
+    h *= 16777619U;
+  }
+  return h;
+}
+
+inline bool name_equals(const char* field_name, const char* name, std::size_t len)
+{
+  return std::strncmp(field_name, name, len) == 0 && field_name[len] == '\0';
+}
+
+}
+
+void aggregate_instruction_base::build_subinstruction_index(allocator* alloc)
+{
+  // keep the load factor at most 1/2 so that the probe sequences stay short
+  uint32_t capacity = 2;
+  while (capacity < 2*subinstructions_count_)
+    capacity *= 2;
+
+  index_entry* name_index = static_cast<index_entry*>(alloc->allocate(2*capacity*sizeof(index_entry)));
+  index_entry* id_index = name_index + capacity;
+  for (uint32_t i = 0; i < 2*capacity; ++i)
+    name_index[i].index = -1;
+
+  uint32_t mask = capacity - 1;
+  // Subinstructions are inserted in order and looked up with linear probing, so a lookup
+  // with duplicated names or ids finds the first one, the same as the linear search.
+  for (uint32_t i = 0; i < subinstructions_count_; ++i) {
+    const char* name = subinstructions_[i]->name();
+    uint32_t h = hash_name(name, std::strlen(name));
+    uint32_t slot = h & mask;
+    while (name_index[slot].index != -1)
+      slot = (slot + 1) & mask;
+    name_index[slot].key = h;
+    name_index[slot].index = i;
+
+    uint32_t id = subinstructions_[i]->id();
+    slot = id & mask;
+    while (id_index[slot].index != -1)
+      slot = (slot + 1) & mask;
+    id_index[slot].key = id;
+    id_index[slot].index = i;
+  }
+
+  name_index_ = name_index;
+  id_index_ = id_index;
+  index_mask_ = mask;
+}
+
 int aggregate_instruction_base::find_subinstruction_index_by_id(uint32_t id) const
 {
+  if (id_index_) {
+    for (uint32_t slot = id & index_mask_; id_index_[slot].index != -1; slot = (slot + 1) & index_mask_) {
+      if (id_index_[slot].key == id)
+        return id_index_[slot].index;
+    }
+    return -1;
+  }
+
   for (uint32_t i = 0; i < this->subinstructions_count_; ++i) {
     if (this->subinstructions_[i]->id() == id)
       return i;
@@ -218,8 +294,23 @@ int aggregate_instruction_base::find_subinstruction_index_by_id(uint32_t id) con
 
 int aggregate_instruction_base::find_subinstruction_index_by_name(const char* name) const
 {
+  return find_subinstruction_index_by_name(name, std::strlen(name));
+}
+
+int aggregate_instruction_base::find_subinstruction_index_by_name(const char* name, std::size_t len) const
+{
+  if (name_index_) {
+    uint32_t h = hash_name(name, len);
+    for (uint32_t slot = h & index_mask_; name_index_[slot].index != -1; slot = (slot + 1) & index_mask_) {
+      const index_entry& entry = name_index_[slot];
+      if (entry.key == h && name_equals(this->subinstructions_[entry.index]->name(), name, len))
+        return entry.index;
+    }
+    return -1;
+  }
+
   for (uint32_t i = 0; i < this->subinstructions_count_; ++i) {
-    if (std::strcmp(this->subinstructions_[i]->name(), name) ==0)
+    if (name_equals(this->subinstructions_[i]->name(), name, len))
       return i;
   }
   return -1;
@@ -261,7 +352,7 @@ void group_field_instruction::construct_value(value_storage& storage,
   // group field is never used for a dictionary key; so, we won't use this
   // function for reseting a key and thus no memory deallocation is required.
   storage.of_group.content_ =
-    static_cast<value_storage*>(alloc->allocate( content_allocation_size() ));
+    static_cast<value_storage*>(default_allocator_policy::allocate(alloc, content_allocation_size() ));
   storage.of_group.own_content_ = true;
   construct_group_subfields(storage.of_group.content_,
                             alloc,
@@ -286,7 +377,7 @@ void group_field_instruction::copy_value(const value_storage& src,
   dest.of_group.present_ = src.of_group.present_;
   dest.of_group.own_content_ = true;
   dest.of_group.content_ =
-    static_cast<value_storage*>(alloc->allocate( content_allocation_size() ));
+    static_cast<value_storage*>(default_allocator_policy::allocate(alloc, content_allocation_size() ));
 
   copy_group_subfields(src.of_group.content_, dest.of_group.content_, alloc, &dest);
 }
@@ -327,12 +418,13 @@ void sequence_field_instruction::construct_value(value_storage& storage,
   // len_ == 0 is reserve for null/absent
   uint32_t initial_length = sequence_length_instruction_->initial_value().get<uint32_t>();
   storage.of_array.len_ = optional() ? 0 : initial_length+1;
-  if (sequence_length_instruction_ && initial_length > 0) {
+  std::size_t reserved_length = (std::max)(initial_length, capacity_);
+  if (sequence_length_instruction_ && reserved_length > 0) {
     std::size_t element_size = this->group_content_byte_count();
-    std::size_t reserve_size = initial_length*element_size;
+    std::size_t reserve_size = reserved_length*element_size;
     storage.of_array.content_ = 0;
-    storage.of_array.capacity_ =  alloc->reallocate(storage.of_array.content_, 0, reserve_size)/element_size;
-    construct_sequence_elements(storage,0, initial_length, alloc);
+    storage.of_array.capacity_ =  default_allocator_policy::reallocate(alloc, storage.of_array.content_, 0, reserve_size)/element_size;
+    construct_sequence_elements(storage,0, storage.of_array.capacity_, alloc);
   }
   else {
     storage.of_array.content_ = 0;
@@ -365,7 +457,7 @@ void sequence_field_instruction::copy_value(const value_storage& src,
     std::size_t reserve_size = size*element_size;
 
     dest.of_array.content_ = 0;
-    dest.of_array.capacity_ =  alloc->reallocate(dest.of_array.content_, 0, reserve_size)/element_size;
+    dest.of_array.capacity_ =  default_allocator_policy::reallocate(alloc, dest.of_array.content_, 0, reserve_size)/element_size;
 
     const value_storage* src_elements = static_cast<const value_storage*>(src.of_array.content_);
     value_storage* dest_elements = static_cast<value_storage*>(dest.of_array.content_);
@@ -407,7 +499,7 @@ void template_instruction::construct_value(value_storage& storage,
   else {
     storage.of_group.own_content_ = true;
     fields_storage = static_cast<value_storage*>(
-      alloc->allocate(this->group_content_byte_count()));
+      default_allocator_policy::allocate(alloc, this->group_content_byte_count()));
   }
   storage.of_group.content_ = fields_storage;
 
@@ -428,7 +520,7 @@ void template_instruction::copy_construct_value(value_storage&       storage,
   else {
     storage.of_group.own_content_ = true;
     dest_fields_storage = static_cast<value_storage*>(
-      alloc->allocate(this->group_content_byte_count()));
+      default_allocator_policy::allocate(alloc, this->group_content_byte_count()));
   }
   storage.of_group.content_ = dest_fields_storage;
   copy_group_subfields(src_fields_storage,
@@ -444,7 +536,7 @@ void template_instruction::ensure_valid_storage(value_storage& storage,
     // group field is never used for a dictionary key; so, we won't use this
     // function for reseting a key and thus no memory deallocation is required.
     storage.of_group.content_ =
-      static_cast<value_storage*>(alloc->allocate( this->group_content_byte_count() ));
+      static_cast<value_storage*>(default_allocator_policy::allocate(alloc, this->group_content_byte_count() ));
     memset(storage.of_group.content_, 0, this->group_content_byte_count());
   }
 }
@@ -471,7 +563,7 @@ void templateref_instruction::construct_value(value_storage&        storage,
   storage.of_templateref.of_instruction.instruction_ = from_inst;
   if (from_inst) {
     storage.of_templateref.content_ = static_cast<value_storage*>(
-      alloc->allocate(from_inst->content_allocation_size()));
+      default_allocator_policy::allocate(alloc, from_inst->content_allocation_size()));
 
     if (construct_subfields)
       from_inst->construct_group_subfields(storage.of_templateref.content_, alloc);
@@ -501,7 +593,7 @@ void templateref_instruction::copy_value(const value_storage& src,
   dest.of_templateref.of_instruction.instruction_ = src.of_templateref.of_instruction.instruction_;
   if (src.of_templateref.of_instruction.instruction_) {
     dest.of_templateref.content_ =
-      static_cast<value_storage*>(alloc->allocate( dest.of_templateref.of_instruction.instruction_->content_allocation_size() ));
+      static_cast<value_storage*>(default_allocator_policy::allocate(alloc, dest.of_templateref.of_instruction.instruction_->content_allocation_size() ));
 
     dest.of_templateref.of_instruction.instruction_->copy_group_subfields(
       src.of_templateref.content_,
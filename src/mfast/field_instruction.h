@@ -444,7 +444,8 @@ class MFAST_EXPORT string_field_instruction
                              const char*          name,
                              const char*          ns,
                              const op_context_t*  context,
-                             string_value_storage initial_value)
+                             string_value_storage initial_value,
+                             uint32_t             capacity = 0)
       : field_instruction(field_index, operator_id, field_type, optional,
                           id,
                           name,
@@ -453,6 +454,7 @@ class MFAST_EXPORT string_field_instruction
       , initial_value_(initial_value.storage_)
       , prev_value_(&prev_storage_)
       , initial_or_default_value_(initial_value_.is_empty() ? &default_value_ : &initial_value_)
+      , capacity_(capacity)
     {
       mandatory_no_initial_value_ = !optional && initial_value.storage_.is_empty();
     }
@@ -463,6 +465,7 @@ class MFAST_EXPORT string_field_instruction
       , initial_value_(other.initial_value_)
       , prev_value_(&prev_storage_)
       , initial_or_default_value_(initial_value_.is_empty() ? &default_value_ : &initial_value_)
+      , capacity_(other.capacity_)
     {
     }
 
@@ -503,6 +506,15 @@ class MFAST_EXPORT string_field_instruction
       return *initial_or_default_value_;
     }
 
+    /// Returns the number of characters or bytes reserved for the value when it is constructed,
+    /// taken from the non-standard "capacity" attribute; 0 if none are reserved.
+    ///
+    /// Assigning a value of at most capacity() characters or bytes does not allocate.
+    uint32_t capacity() const
+    {
+      return capacity_;
+    }
+
   protected:
     friend class dictionary_builder;
     const op_context_t* op_context_;
@@ -510,6 +522,7 @@ class MFAST_EXPORT string_field_instruction
     value_storage* prev_value_;
     value_storage prev_storage_;
     const value_storage* initial_or_default_value_;
+    uint32_t capacity_;
     static const value_storage default_value_;
 };
 
@@ -525,13 +538,15 @@ class MFAST_EXPORT ascii_field_instruction
                             const char*          name,
                             const char*          ns,
                             const op_context_t*  context,
-                            string_value_storage initial_value = string_value_storage())
+                            string_value_storage initial_value = string_value_storage(),
+                            uint32_t             capacity = 0)
       : string_field_instruction(field_index,
                                  operator_id,
                                  field_type_ascii_string,
                                  optional,
                                  id, name, ns, context,
-                                 initial_value)
+                                 initial_value,
+                                 capacity)
     {
     }
 
@@ -557,12 +572,14 @@ class MFAST_EXPORT unicode_field_instruction
                               string_value_storage initial_value = string_value_storage(),
                               uint32_t             length_id = 0,
                               const char*          length_name = "",
-                              const char*          length_ns = "")
+                              const char*          length_ns = "",
+                              uint32_t             capacity = 0)
       : string_field_instruction(field_index,
                                  operator_id,
                                  field_type_unicode_string,
                                  optional,
-                                 id, name, ns, context, initial_value)
+                                 id, name, ns, context, initial_value,
+                                 capacity)
       , length_id_(length_id)
       , length_name_(length_name)
       , length_ns_(length_ns)
@@ -616,13 +633,15 @@ class MFAST_EXPORT byte_vector_field_instruction
                                   byte_vector_value_storage initial_value = byte_vector_value_storage(),
                                   uint32_t                  length_id = 0,
                                   const char*               length_name = "",
-                                  const char*               length_ns = "")
+                                  const char*               length_ns = "",
+                                  uint32_t                  capacity = 0)
       : string_field_instruction(field_index,
                                  operator_id,
                                  field_type_byte_vector,
                                  optional,
                                  id, name, ns, value_context,
-                                 initial_value)
+                                 initial_value,
+                                 capacity)
       , length_id_(length_id)
       , length_name_(length_name)
       , length_ns_(length_ns)
@@ -673,6 +692,9 @@ struct MFAST_EXPORT aggregate_instruction_base
     , typeref_name_(typeref_name)
     , typeref_ns_(typeref_ns)
     , segment_pmap_size_(0)
+    , name_index_(0)
+    , id_index_(0)
+    , index_mask_(0)
   {
     set_subinstructions(subinstructions, subinstructions_count);
   }
@@ -702,6 +724,17 @@ struct MFAST_EXPORT aggregate_instruction_base
   /// or -1 if not found.
   int find_subinstruction_index_by_name(const char* name) const;
 
+  /// Returns the index for the subinstruction whose name is the @a len
+  /// characters at @a name, which need not be null terminated, or -1 if not found.
+  int find_subinstruction_index_by_name(const char* name, std::size_t len) const;
+
+  /// Build the hash indexes used by find_subinstruction_index_by_id() and
+  /// find_subinstruction_index_by_name() instead of scanning all subinstructions.
+  ///
+  /// The indexes are allocated from @a alloc, which must outlive this instruction, and
+  /// are discarded by set_subinstructions().
+  void build_subinstruction_index(allocator* alloc);
+
   uint32_t subinstructions_count() const
   {
     return subinstructions_count_;
@@ -723,6 +756,9 @@ struct MFAST_EXPORT aggregate_instruction_base
     subinstructions_ = subinstructions;
     subinstructions_count_ = count;
     segment_pmap_size_ = 0;
+    name_index_ = 0;
+    id_index_ = 0;
+    index_mask_ = 0;
     for (uint32_t i = 0; i < subinstructions_count_; ++i) {
       segment_pmap_size_ += subinstruction(i)->pmap_size();
     }
@@ -740,7 +776,17 @@ struct MFAST_EXPORT aggregate_instruction_base
   std::size_t segment_pmap_size_;
 
   private:
+    // An open addressing hash table slot; index is -1 for an empty slot.
+    struct index_entry
+    {
+      uint32_t key;
+      int32_t index;
+    };
+
     const const_instruction_ptr_t* subinstructions_;
+    const index_entry* name_index_;
+    const index_entry* id_index_;
+    uint32_t index_mask_;
 };
 
 
@@ -808,7 +854,8 @@ class MFAST_EXPORT sequence_field_instruction
                                uint32_t                       subinstructions_count,
                                uint32_field_instruction*      sequence_length_instruction,
                                const char*                    typeref_name="",
-                               const char*                    typeref_ns="")
+                               const char*                    typeref_ns="",
+                               uint32_t                       capacity=0)
       : group_field_instruction(field_index,
                                 optional,
                                 id,
@@ -820,6 +867,7 @@ class MFAST_EXPORT sequence_field_instruction
                                 typeref_name,
                                 typeref_ns)
       , sequence_length_instruction_(sequence_length_instruction)
+      , capacity_(capacity)
     {
       field_type_ = field_type_sequence;
       has_pmap_bit_ = segment_pmap_size() > 0 ? 1 : 0;
@@ -850,11 +898,21 @@ class MFAST_EXPORT sequence_field_instruction
       return sequence_length_instruction_;
     }
 
+    /// Returns the number of elements reserved for the sequence when it is constructed,
+    /// taken from the non-standard "capacity" attribute; 0 if none are reserved.
+    ///
+    /// Resizing the sequence to at most capacity() elements does not allocate.
+    uint32_t capacity() const
+    {
+      return capacity_;
+    }
+
   private:
 
 
     friend class dictionary_builder;
     uint32_field_instruction* sequence_length_instruction_;
+    uint32_t capacity_;
 };
 
 
@@ -996,9 +1054,11 @@ class sequence_instruction_ex
                             uint32_t                       subinstructions_count,
                             uint32_field_instruction*      sequence_length_instruction,
                             const char*                    typeref_name="",
-                            const char*                    typeref_ns="")
+                            const char*                    typeref_ns="",
+                            uint32_t                       capacity=0)
       : sequence_field_instruction(field_index, optional, id, name, ns, dictionary, subinstructions,
-                                   subinstructions_count, sequence_length_instruction, typeref_name, typeref_ns)
+                                   subinstructions_count, sequence_length_instruction, typeref_name, typeref_ns,
+                                   capacity)
     {
     }
 
@@ -1011,11 +1071,13 @@ class sequence_instruction_ex
                             const template_instruction* ref_template,
                             uint32_field_instruction*   sequence_length_instruction,
                             const char*                 typeref_name="",
-                            const char*                 typeref_ns="")
+                            const char*                 typeref_ns="",
+                            uint32_t                    capacity=0)
       : sequence_field_instruction(field_index, optional, id, name, ns, dictionary,
                                    ref_template->subinstructions(),
                                    ref_template->subinstructions_count(),
-                                   sequence_length_instruction, typeref_name, typeref_ns)
+                                   sequence_length_instruction, typeref_name, typeref_ns,
+                                   capacity)
     {
     }
 
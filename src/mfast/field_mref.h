@@ -53,6 +53,7 @@ class field_mref
     void as(const char*);
 
     void as(const decimal&);
+    void as(const fixed_decimal&);
 
     template <int SIZE>
     void as(unsigned char (&value)[SIZE]);
@@ -118,6 +119,14 @@ inline void field_mref::as(const decimal& value)
     BOOST_THROW_EXCEPTION(incompatible_type_conversion_error("decimal", this->instruction()->field_type_name()));
 }
 
+inline void field_mref::as(const fixed_decimal& value)
+{
+  if (this->instruction()->field_type() == field_type_decimal)
+    static_cast<decimal_mref>(*this).as(value);
+  else
+    BOOST_THROW_EXCEPTION(incompatible_type_conversion_error("decimal", this->instruction()->field_type_name()));
+}
+
 template <int SIZE>
 void field_mref::as(unsigned char (&value)[SIZE])
 {
@@ -46,12 +46,59 @@ class field_accessor_adaptor
     {
     }
 
+    // Dispatch on field_instruction::field_type() instead of the virtual
+    // field_instruction::accept(). The switch compiles into a jump table and the
+    // qualified calls below are not virtual, so the visit() of the accessor
+    // can be inlined.
+    void dispatch(const field_instruction* inst, value_storage* storage)
+    {
+      switch (inst->field_type()) {
+        case field_type_int32:
+          field_accessor_adaptor::visit(static_cast<const int32_field_instruction*>(inst), storage);
+          break;
+        case field_type_uint32:
+          field_accessor_adaptor::visit(static_cast<const uint32_field_instruction*>(inst), storage);
+          break;
+        case field_type_int64:
+          field_accessor_adaptor::visit(static_cast<const int64_field_instruction*>(inst), storage);
+          break;
+        case field_type_uint64:
+          field_accessor_adaptor::visit(static_cast<const uint64_field_instruction*>(inst), storage);
+          break;
+        case field_type_decimal:
+        case field_type_exponent:
+          field_accessor_adaptor::visit(static_cast<const decimal_field_instruction*>(inst), storage);
+          break;
+        case field_type_ascii_string:
+          field_accessor_adaptor::visit(static_cast<const ascii_field_instruction*>(inst), storage);
+          break;
+        case field_type_unicode_string:
+          field_accessor_adaptor::visit(static_cast<const unicode_field_instruction*>(inst), storage);
+          break;
+        case field_type_byte_vector:
+          field_accessor_adaptor::visit(static_cast<const byte_vector_field_instruction*>(inst), storage);
+          break;
+        case field_type_group:
+          field_accessor_adaptor::visit(static_cast<const group_field_instruction*>(inst), storage);
+          break;
+        case field_type_sequence:
+          field_accessor_adaptor::visit(static_cast<const sequence_field_instruction*>(inst), storage);
+          break;
+        case field_type_templateref:
+          field_accessor_adaptor::visit(static_cast<const templateref_instruction*>(inst), storage);
+          break;
+        default:
+          inst->accept(*this, storage);
+          break;
+      }
+    }
+
     void visit(const aggregate_cref& ref)
     {
       for (std::size_t i = 0; i < ref.num_fields(); ++i) {
         field_cref r(ref[i]);
         if (r.present() || FieldAccessor::visit_absent ) {
-          r.instruction()->accept(*this, storage_ptr_of(r));
+          dispatch(r.instruction(), storage_ptr_of(r));
         }
       }
     }
@@ -153,12 +200,59 @@ class field_mutator_adaptor
     {
     }
 
+    // Dispatch on field_instruction::field_type() instead of the virtual
+    // field_instruction::accept(). The switch compiles into a jump table and the
+    // qualified calls below are not virtual, so the visit() of the mutator
+    // can be inlined.
+    void dispatch(const field_instruction* inst, value_storage* storage)
+    {
+      switch (inst->field_type()) {
+        case field_type_int32:
+          field_mutator_adaptor::visit(static_cast<const int32_field_instruction*>(inst), storage);
+          break;
+        case field_type_uint32:
+          field_mutator_adaptor::visit(static_cast<const uint32_field_instruction*>(inst), storage);
+          break;
+        case field_type_int64:
+          field_mutator_adaptor::visit(static_cast<const int64_field_instruction*>(inst), storage);
+          break;
+        case field_type_uint64:
+          field_mutator_adaptor::visit(static_cast<const uint64_field_instruction*>(inst), storage);
+          break;
+        case field_type_decimal:
+        case field_type_exponent:
+          field_mutator_adaptor::visit(static_cast<const decimal_field_instruction*>(inst), storage);
+          break;
+        case field_type_ascii_string:
+          field_mutator_adaptor::visit(static_cast<const ascii_field_instruction*>(inst), storage);
+          break;
+        case field_type_unicode_string:
+          field_mutator_adaptor::visit(static_cast<const unicode_field_instruction*>(inst), storage);
+          break;
+        case field_type_byte_vector:
+          field_mutator_adaptor::visit(static_cast<const byte_vector_field_instruction*>(inst), storage);
+          break;
+        case field_type_group:
+          field_mutator_adaptor::visit(static_cast<const group_field_instruction*>(inst), storage);
+          break;
+        case field_type_sequence:
+          field_mutator_adaptor::visit(static_cast<const sequence_field_instruction*>(inst), storage);
+          break;
+        case field_type_templateref:
+          field_mutator_adaptor::visit(static_cast<const templateref_instruction*>(inst), storage);
+          break;
+        default:
+          inst->accept(*this, storage);
+          break;
+      }
+    }
+
     void visit(const aggregate_mref& ref)
     {
       for (std::size_t i = 0; i < ref.num_fields(); ++i) {
         field_mref r(ref[i]);
         if (r.present() || FieldMutator::visit_absent ) {
-          r.instruction()->accept(*this, storage_ptr_of(r));
+          dispatch(r.instruction(), storage_ptr_of(r));
         }
       }
     }
@@ -252,7 +346,7 @@ inline void
 field_cref::accept_accessor(FieldAccessor& accessor) const
 {
   detail::field_accessor_adaptor<FieldAccessor> adaptor(accessor);
-  this->instruction()->accept(adaptor, const_cast<value_storage *>(this->storage()));
+  adaptor.dispatch(this->instruction(), const_cast<value_storage *>(this->storage()));
 }
 
 template <typename FieldMutator>
@@ -260,7 +354,7 @@ inline void
 field_mref::accept_mutator(FieldMutator& mutator) const
 {
   detail::field_mutator_adaptor<FieldMutator> adaptor(mutator, this->alloc_);
-  this->instruction()->accept(adaptor, this->storage());
+  adaptor.dispatch(this->instruction(), this->storage());
 }
 
 //////////////////////////////////////////////////////////
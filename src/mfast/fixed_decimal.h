@@ -0,0 +1,319 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef FIXED_DECIMAL_H_Q7N3WD1C
+#define FIXED_DECIMAL_H_Q7N3WD1C
+
+#include <cassert>
+#include <cmath>
+#include <ostream>
+#include <stdint.h>
+#include <boost/integer_traits.hpp>
+#include "mfast/text_format.h"
+
+namespace mfast {
+
+namespace detail {
+
+// The tables are static members of a class template so that they can be
+// defined in this header without violating the one definition rule.
+template <typename T>
+struct powers_of_ten
+{
+  // 10^0 to 10^18; 10^18 is the largest power of ten representable by int64_t
+  static const int64_t integers[19];
+  // 10^0 to 10^22; 10^22 is the largest power of ten exactly representable by double
+  static const double doubles[23];
+};
+
+template <typename T>
+const int64_t powers_of_ten<T>::integers[19] = {
+  INT64_C(1),
+  INT64_C(10),
+  INT64_C(100),
+  INT64_C(1000),
+  INT64_C(10000),
+  INT64_C(100000),
+  INT64_C(1000000),
+  INT64_C(10000000),
+  INT64_C(100000000),
+  INT64_C(1000000000),
+  INT64_C(10000000000),
+  INT64_C(100000000000),
+  INT64_C(1000000000000),
+  INT64_C(10000000000000),
+  INT64_C(100000000000000),
+  INT64_C(1000000000000000),
+  INT64_C(10000000000000000),
+  INT64_C(100000000000000000),
+  INT64_C(1000000000000000000)
+};
+
+template <typename T>
+const double powers_of_ten<T>::doubles[23] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+  1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+  1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+typedef powers_of_ten<void> pow10_table;
+
+}
+
+/// A decimal number represented as mantissa * 10^exponent, the same way as FAST encodes it.
+///
+/// All the operations use 64 bits integer arithmetic and lookup tables; no memory is allocated.
+/// Unlike decimal_cref::operator==, comparisons are numeric, i.e. 10e-1 == 1e0.
+/// The result of an addition, subtraction or multiplication whose mantissa does not fit into
+/// int64_t is undefined.
+class fixed_decimal
+{
+  public:
+    fixed_decimal()
+      : mantissa_(0)
+      , exponent_(0)
+    {
+    }
+
+    fixed_decimal(int64_t mantissa, int8_t exponent = 0)
+      : mantissa_(mantissa)
+      , exponent_(exponent)
+    {
+    }
+
+    int64_t mantissa() const
+    {
+      return mantissa_;
+    }
+
+    int8_t exponent() const
+    {
+      return exponent_;
+    }
+
+    /// Remove the trailing zeros of the mantissa; zero is represented with exponent 0.
+    ///
+    /// The exponent is not raised beyond its maximum, so the mantissa keeps the trailing zeros
+    /// which cannot be removed without overflowing it.
+    void normalize()
+    {
+      if (mantissa_ == 0) {
+        exponent_ = 0;
+        return;
+      }
+      while (mantissa_ % 10 == 0 && exponent_ < boost::integer_traits<int8_t>::const_max) {
+        mantissa_ /= 10;
+        ++exponent_;
+      }
+    }
+
+    fixed_decimal normalized() const
+    {
+      fixed_decimal r(*this);
+      r.normalize();
+      return r;
+    }
+
+    /// Convert to double.
+    ///
+    /// The result is correctly rounded when the absolute value of the mantissa is less than 2^53
+    /// and the absolute value of the exponent is not greater than 22.
+    double to_double() const
+    {
+      double m = static_cast<double>(mantissa_);
+      if (exponent_ >= 0) {
+        return exponent_ <= 22 ? m * detail::pow10_table::doubles[exponent_]
+               : m * std::pow(10.0, exponent_);
+      }
+      return exponent_ >= -22 ? m / detail::pow10_table::doubles[-exponent_]
+             : m / std::pow(10.0, -exponent_);
+    }
+
+    /// Returns the value in units of 10^tick_exponent, truncated toward zero.
+    ///
+    /// For example, fixed_decimal(12345, -2).to_ticks(-1) returns 1234.
+    /// The result is undefined if it does not fit into int64_t.
+    int64_t to_ticks(int8_t tick_exponent) const
+    {
+      int diff = exponent_ - tick_exponent;
+      if (diff >= 0) {
+        if (diff > 18) {
+          assert(mantissa_ == 0);
+          return 0;
+        }
+        return mantissa_ * detail::pow10_table::integers[diff];
+      }
+      if (diff < -18)
+        return 0;
+      return mantissa_ / detail::pow10_table::integers[-diff];
+    }
+
+    fixed_decimal operator - () const
+    {
+      return fixed_decimal(-mantissa_, exponent_);
+    }
+
+    fixed_decimal& operator += (const fixed_decimal& other)
+    {
+      add(other.mantissa_, other.exponent_);
+      return *this;
+    }
+
+    fixed_decimal& operator -= (const fixed_decimal& other)
+    {
+      add(-other.mantissa_, other.exponent_);
+      return *this;
+    }
+
+    fixed_decimal& operator *= (const fixed_decimal& other)
+    {
+      mantissa_ *= other.mantissa_;
+      exponent_ = static_cast<int8_t>(exponent_ + other.exponent_);
+      return *this;
+    }
+
+    /// Returns a negative number, zero or a positive number if lhs is less than, equal to
+    /// or greater than rhs respectively.
+    static int compare(const fixed_decimal& lhs, const fixed_decimal& rhs)
+    {
+      if (lhs.exponent_ == rhs.exponent_)
+        return cmp(lhs.mantissa_, rhs.mantissa_);
+
+      if (lhs.exponent_ > rhs.exponent_) {
+        int64_t scaled;
+        if (scale_up(lhs.mantissa_, lhs.exponent_ - rhs.exponent_, scaled))
+          return cmp(scaled, rhs.mantissa_);
+        // the magnitude of lhs exceeds any int64_t mantissa with the exponent of rhs
+        return lhs.mantissa_ > 0 ? 1 : -1;
+      }
+
+      int64_t scaled;
+      if (scale_up(rhs.mantissa_, rhs.exponent_ - lhs.exponent_, scaled))
+        return cmp(lhs.mantissa_, scaled);
+      return rhs.mantissa_ > 0 ? -1 : 1;
+    }
+
+  private:
+    static int cmp(int64_t lhs, int64_t rhs)
+    {
+      return (lhs > rhs) - (lhs < rhs);
+    }
+
+    // Compute m * 10^diff; returns false if the result does not fit into int64_t.
+    static bool scale_up(int64_t m, int diff, int64_t& result)
+    {
+      if (m == 0) {
+        result = 0;
+        return true;
+      }
+      if (diff > 18)
+        return false;
+      int64_t limit = boost::integer_traits<int64_t>::const_max / detail::pow10_table::integers[diff];
+      if (m > limit || m < -limit)
+        return false;
+      result = m * detail::pow10_table::integers[diff];
+      return true;
+    }
+
+    void add(int64_t m, int8_t e)
+    {
+      if (e == exponent_) {
+        mantissa_ += m;
+      }
+      else if (e < exponent_) {
+        int64_t scaled;
+        if (scale_up(mantissa_, exponent_ - e, scaled)) {
+          mantissa_ = scaled + m;
+          exponent_ = e;
+        }
+        else {
+          // keep the exponent of this and drop the digits of m below it
+          mantissa_ += fixed_decimal(m, e).to_ticks(exponent_);
+        }
+      }
+      else {
+        int64_t scaled;
+        if (scale_up(m, e - exponent_, scaled))
+          mantissa_ += scaled;
+        else {
+          mantissa_ = m + to_ticks(e);
+          exponent_ = e;
+        }
+      }
+    }
+
+    int64_t mantissa_;
+    int8_t exponent_;
+};
+
+inline fixed_decimal operator + (fixed_decimal lhs, const fixed_decimal& rhs)
+{
+  return lhs += rhs;
+}
+
+inline fixed_decimal operator - (fixed_decimal lhs, const fixed_decimal& rhs)
+{
+  return lhs -= rhs;
+}
+
+inline fixed_decimal operator * (fixed_decimal lhs, const fixed_decimal& rhs)
+{
+  return lhs *= rhs;
+}
+
+inline bool operator == (const fixed_decimal& lhs, const fixed_decimal& rhs)
+{
+  return fixed_decimal::compare(lhs, rhs) == 0;
+}
+
+inline bool operator != (const fixed_decimal& lhs, const fixed_decimal& rhs)
+{
+  return fixed_decimal::compare(lhs, rhs) != 0;
+}
+
+inline bool operator < (const fixed_decimal& lhs, const fixed_decimal& rhs)
+{
+  return fixed_decimal::compare(lhs, rhs) < 0;
+}
+
+inline bool operator <= (const fixed_decimal& lhs, const fixed_decimal& rhs)
+{
+  return fixed_decimal::compare(lhs, rhs) <= 0;
+}
+
+inline bool operator > (const fixed_decimal& lhs, const fixed_decimal& rhs)
+{
+  return fixed_decimal::compare(lhs, rhs) > 0;
+}
+
+inline bool operator >= (const fixed_decimal& lhs, const fixed_decimal& rhs)
+{
+  return fixed_decimal::compare(lhs, rhs) >= 0;
+}
+
+/// Write the value in plain decimal notation without an exponent, e.g. "-0.05" or "1200".
+inline std::ostream& operator << (std::ostream& os, const fixed_decimal& value)
+{
+  char buf[max_decimal_text_size];
+  os.write(buf, format_decimal(value.mantissa(), value.exponent(), buf));
+  return os;
+}
+
+}
+
+#endif /* end of include guard: FIXED_DECIMAL_H_Q7N3WD1C */
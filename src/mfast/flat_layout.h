@@ -0,0 +1,190 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef FLAT_LAYOUT_H_3RKX0WZE
+#define FLAT_LAYOUT_H_3RKX0WZE
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <stdint.h>
+#include <exception>
+#include <boost/exception/all.hpp>
+#include "mfast/mfast_export.h"
+
+namespace mfast {
+
+struct flat_layout;
+
+/// Describes where the value of a field is stored in a flat struct generated by fast_type_gen.
+struct flat_field_layout
+{
+  /// The byte offset of the value, flat_string or flat_sequence from the start of the struct.
+  std::size_t offset;
+  /// The capacity of a flat_string in bytes or of a flat_sequence in elements; 0 otherwise.
+  std::size_t capacity;
+  /// The layout of a group or of a sequence element; 0 otherwise.
+  const flat_layout* element;
+};
+
+/// Describes a flat struct generated by fast_type_gen for a template, group or sequence element.
+///
+/// The fields are listed in the same order as the subinstructions of the corresponding
+/// instruction. Each field has a presence bit in the byte array at @a presence_offset.
+struct flat_layout
+{
+  /// The template id; 0 for groups and sequence elements.
+  uint32_t id;
+  /// The size of the struct in bytes.
+  std::size_t size;
+  /// The byte offset of the presence bits.
+  std::size_t presence_offset;
+  /// The number of elements in @a fields.
+  std::size_t num_fields;
+  const flat_field_layout* fields;
+};
+
+/// Thrown when a string, byte vector or sequence does not fit into the capacity of its flat field.
+class MFAST_EXPORT flat_capacity_error
+  : public virtual boost::exception, public virtual std::exception
+{
+  public:
+    virtual const char* what() const throw()
+    {
+      return "value exceeds the capacity of the flat field";
+    }
+
+};
+
+/// Thrown when the decoded template does not match the flat struct to be filled.
+class MFAST_EXPORT flat_layout_mismatch_error
+  : public virtual boost::exception, public virtual std::exception
+{
+  public:
+    virtual const char* what() const throw()
+    {
+      return "template id does not match the flat layout";
+    }
+
+};
+
+/// The value of a decimal field in a flat struct.
+struct flat_decimal
+{
+  int64_t mantissa;
+  int8_t exponent;
+};
+
+/// A string or byte vector stored inline in a flat struct.
+template <std::size_t N>
+struct flat_string
+{
+  // len_ must be the first member so that the decoder and encoder can
+  // locate the content without knowing N.
+  uint32_t len_;
+  char data_[N];
+
+  enum {
+    capacity = N
+  };
+
+  std::size_t size() const
+  {
+    return len_;
+  }
+
+  const char* data() const
+  {
+    return data_;
+  }
+
+  std::string str() const
+  {
+    return std::string(data_, len_);
+  }
+
+  /// Assign the content; throws flat_capacity_error if @a n is larger than N.
+  void assign(const char* s, std::size_t n)
+  {
+    if (n > N)
+      BOOST_THROW_EXCEPTION(flat_capacity_error());
+    std::memcpy(data_, s, n);
+    len_ = static_cast<uint32_t>(n);
+  }
+
+  void assign(const char* s)
+  {
+    assign(s, std::strlen(s));
+  }
+};
+
+/// A sequence stored inline in a flat struct.
+template <typename Element, std::size_t N>
+struct flat_sequence
+{
+  Element elements_[N];
+  // len_ follows the elements so that its offset is N*sizeof(Element)
+  // regardless of the alignment of Element.
+  uint32_t len_;
+
+  enum {
+    capacity = N
+  };
+
+  std::size_t size() const
+  {
+    return len_;
+  }
+
+  /// Set the number of elements; throws flat_capacity_error if @a n is larger than N.
+  void resize(std::size_t n)
+  {
+    if (n > N)
+      BOOST_THROW_EXCEPTION(flat_capacity_error());
+    len_ = static_cast<uint32_t>(n);
+  }
+
+  Element& operator[](std::size_t index)
+  {
+    return elements_[index];
+  }
+
+  const Element& operator[](std::size_t index) const
+  {
+    return elements_[index];
+  }
+};
+
+/// Returns whether the field at @a index of a flat struct is present.
+inline bool flat_is_present(const uint8_t* presence, std::size_t index)
+{
+  return (presence[index/8] >> (index%8)) & 1;
+}
+
+/// Set whether the field at @a index of a flat struct is present.
+inline void flat_present(uint8_t* presence, std::size_t index, bool v)
+{
+  if (v)
+    presence[index/8] |= static_cast<uint8_t>(1 << (index%8));
+  else
+    presence[index/8] &= static_cast<uint8_t>(~(1 << (index%8)));
+}
+
+}
+
+#endif /* end of include guard: FLAT_LAYOUT_H_3RKX0WZE */
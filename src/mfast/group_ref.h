@@ -63,12 +63,18 @@ class group_cref
 
     field_cref operator[](size_t index) const;
 
+    field_cref operator[](const field_handle& handle) const;
+
     /// return -1 if no such field is found
     int field_index_with_id(size_t id) const;
 
     /// return -1 if no such field is found
     int field_index_with_name(const char* name) const;
 
+    field_handle field_handle_with_id(size_t id) const;
+
+    field_handle field_handle_with_name(const char* name) const;
+
     const group_field_instruction* instruction() const
     {
       return static_cast<const group_field_instruction*>(instruction_);
@@ -122,6 +128,8 @@ class make_group_mref
 
     field_mref operator[](size_t index) const;
 
+    field_mref operator[](const field_handle& handle) const;
+
     operator aggregate_mref() const;
 
     template <typename FieldMutator>
@@ -153,6 +161,12 @@ group_cref::operator[](std::size_t index) const
   return aggregate_cref(*this)[index];
 }
 
+inline field_cref
+group_cref::operator[](const field_handle& handle) const
+{
+  return aggregate_cref(*this)[handle];
+}
+
 /// return -1 if no such field is found
 inline int
 group_cref::field_index_with_id(std::size_t id) const
@@ -166,6 +180,18 @@ group_cref::field_index_with_name(const char* name) const
   return aggregate_cref(*this).field_index_with_name(name);
 }
 
+inline field_handle
+group_cref::field_handle_with_id(std::size_t id) const
+{
+  return aggregate_cref(*this).field_handle_with_id(id);
+}
+
+inline field_handle
+group_cref::field_handle_with_name(const char* name) const
+{
+  return aggregate_cref(*this).field_handle_with_name(name);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 template <typename ConstGroupRef>
@@ -179,6 +205,13 @@ make_group_mref<ConstGroupRef>::operator[](size_t index)  const
   return aggregate_mref(*this)[index];
 }
 
+template <typename ConstGroupRef>
+inline field_mref
+make_group_mref<ConstGroupRef>::operator[](const field_handle& handle)  const
+{
+  return aggregate_mref(*this)[handle];
+}
+
 // template <typename ConstGroupRef>
 // inline void
 // make_group_mref<ConstGroupRef>::ensure_valid() const
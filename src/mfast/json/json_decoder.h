@@ -1,6 +1,574 @@
 #ifndef JSON_DECODER_H_RRQN6243
 #define JSON_DECODER_H_RRQN6243
 
+#include <mfast.h>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <boost/exception/all.hpp>
 
+namespace mfast {
+namespace json {
+
+struct tag_json_offset;
+typedef boost::error_info<tag_json_offset, std::size_t> json_offset_info;
+
+/// Thrown when the input is not valid JSON or does not fit the template of the message.
+///
+/// The offset of the offending character from the start of the input is attached as
+/// json_offset_info.
+class json_decode_error
+  : public virtual boost::exception, public virtual std::exception
+{
+  public:
+    json_decode_error(const char* reason)
+      : reason_(reason)
+    {
+    }
+
+    virtual const char* what() const throw()
+    {
+      return reason_;
+    }
+
+  private:
+    const char* reason_;
+};
+
+/// Fills messages from JSON objects in the format written by json::encode().
+///
+/// The decoder parses the input in a single pass and writes the values straight into the
+/// value_storage of the message: integers are range checked against the field type and
+/// decimals are converted to mantissa and exponent without going through floating point.
+/// Members are first matched to the field after the previous member and then looked up with
+/// aggregate_instruction_base::find_subinstruction_index_by_name(), which uses the hash index
+/// of the template when it has been built. Decoding into a reused message does not allocate
+/// except to grow strings and sequences.
+///
+/// Optional fields missing from an object become absent and members with no matching field
+/// are skipped; mandatory fields missing from an object keep their current value. A JSON
+/// null makes an optional field absent. A dynamic templateRef can only be decoded into when
+/// its target template has been set, e.g. with nested_message_mref::as().
+class json_decoder
+{
+  public:
+    json_decoder()
+      : first_(0)
+      , cur_(0)
+      , last_(0)
+    {
+    }
+
+    /// Decode the JSON object in [@a first, @a last) into @a msg.
+    ///
+    /// @returns The position after the object and the whitespace following it.
+    /// @throws json_decode_error if the input does not fit the template of @a msg.
+    const char* decode(const char* first, const char* last, const aggregate_mref& msg)
+    {
+      first_ = first;
+      cur_ = first;
+      last_ = last;
+      parse_aggregate(msg.instruction(),
+                      msg.allocator(),
+                      const_cast<value_storage*>(static_cast<const aggregate_cref&>(msg).field_storage(0)));
+      skip_whitespace();
+      return cur_;
+    }
+
+  private:
+    // return -1 if no field has the name; the field at @a hint is tried before the index
+    // lookup, which hits when the members appear in the order of the fields.
+    static int find_field(const group_field_instruction* instruction,
+                          const char*                    name,
+                          std::size_t                    len,
+                          std::size_t                    hint)
+    {
+      if (hint < instruction->subinstructions_count()) {
+        const char* field_name = instruction->subinstruction(hint)->name();
+        if (std::strncmp(field_name, name, len) == 0 && field_name[len] == '\0')
+          return static_cast<int>(hint);
+      }
+      return instruction->find_subinstruction_index_by_name(name, len);
+    }
+
+    void fail(const char* reason) const
+    {
+      BOOST_THROW_EXCEPTION(json_decode_error(reason) << json_offset_info(cur_ - first_));
+    }
+
+    void skip_whitespace()
+    {
+      while (cur_ < last_ && (*cur_ == ' ' || *cur_ == '\n' || *cur_ == '\r' || *cur_ == '\t'))
+        ++cur_;
+    }
+
+    // skip the whitespace and return the next character, or 0 at the end of the input
+    char peek()
+    {
+      skip_whitespace();
+      return cur_ < last_ ? *cur_ : 0;
+    }
+
+    void expect(char c)
+    {
+      if (peek() != c)
+        fail("unexpected character");
+      ++cur_;
+    }
+
+    bool literal(const char* text, std::size_t len)
+    {
+      if (static_cast<std::size_t>(last_ - cur_) >= len && std::memcmp(cur_, text, len) == 0) {
+        cur_ += len;
+        return true;
+      }
+      return false;
+    }
+
+    // The fields of a group or sequence element which only holds a templateRef are written
+    // as the members of the nested message.
+    void parse_aggregate(const group_field_instruction* instruction, allocator* alloc, value_storage* fields)
+    {
+      if (instruction->subinstructions_count() == 1 &&
+          instruction->subinstruction(0)->field_type() == field_type_templateref) {
+        parse_nested_message(alloc, fields);
+      }
+      else {
+        parse_object(instruction, alloc, fields);
+      }
+    }
+
+    void parse_object(const group_field_instruction* instruction, allocator* alloc, value_storage* fields)
+    {
+      expect('{');
+
+      for (std::size_t i = 0; i < instruction->subinstructions_count(); ++i) {
+        const field_instruction* subinstruction = instruction->subinstruction(i);
+        if (subinstruction->optional() && subinstruction->field_type() != field_type_templateref)
+          fields[i].present(false);
+      }
+
+      if (peek() == '}') {
+        ++cur_;
+        return;
+      }
+
+      std::size_t hint = 0;
+      for (;;) {
+        expect('"');
+        const char* name = cur_;
+        while (cur_ < last_ && *cur_ != '"') {
+          if (*cur_ == '\\' && cur_ + 1 < last_)
+            ++cur_;
+          ++cur_;
+        }
+        if (cur_ >= last_)
+          fail("unterminated member name");
+        std::size_t len = cur_ - name;
+        ++cur_;
+        expect(':');
+
+        int field_index = find_field(instruction, name, len, hint);
+        if (field_index < 0) {
+          skip_value(0);
+        }
+        else {
+          parse_field(instruction, field_index, alloc, fields);
+          hint = field_index + 1;
+        }
+
+        char c = peek();
+        ++cur_;
+        if (c == '}')
+          return;
+        if (c != ',')
+          fail("expected ',' or '}'");
+      }
+    }
+
+    void parse_field(const group_field_instruction* instruction, std::size_t field_index, allocator* alloc, value_storage* fields)
+    {
+      const field_instruction* inst = instruction->subinstruction(field_index);
+      value_storage& storage = fields[field_index];
+
+      if (peek() == 'n' && literal("null", 4)) {
+        if (!inst->optional() || inst->field_type() == field_type_templateref)
+          fail("null for a mandatory field");
+        storage.present(false);
+        return;
+      }
+
+      switch (inst->field_type()) {
+        case field_type_int32:
+          storage.set<int32_t>(static_cast<int32_t>(parse_signed(std::numeric_limits<int32_t>::max())));
+          storage.present(true);
+          break;
+        case field_type_uint32:
+          storage.set<uint32_t>(static_cast<uint32_t>(parse_unsigned(std::numeric_limits<uint32_t>::max())));
+          storage.present(true);
+          break;
+        case field_type_int64:
+          storage.set<int64_t>(parse_signed(std::numeric_limits<int64_t>::max()));
+          storage.present(true);
+          break;
+        case field_type_uint64:
+          storage.set<uint64_t>(parse_unsigned(std::numeric_limits<uint64_t>::max()));
+          storage.present(true);
+          break;
+        case field_type_decimal:
+        case field_type_exponent:
+          parse_decimal(storage);
+          break;
+        case field_type_ascii_string:
+          parse_string(ascii_string_mref(alloc, &storage, static_cast<const ascii_field_instruction*>(inst)));
+          break;
+        case field_type_unicode_string:
+          parse_string(unicode_string_mref(alloc, &storage, static_cast<const unicode_field_instruction*>(inst)));
+          break;
+        case field_type_byte_vector:
+          // json doesn't have byte vector, it is written as a string
+          parse_string(byte_vector_mref(alloc, &storage, static_cast<const byte_vector_field_instruction*>(inst)));
+          break;
+        case field_type_group:
+          storage.present(true);
+          parse_aggregate(static_cast<const group_field_instruction*>(inst), alloc, storage.of_group.content_);
+          break;
+        case field_type_sequence:
+          parse_sequence(alloc, storage, static_cast<const sequence_field_instruction*>(inst));
+          break;
+        case field_type_templateref:
+          parse_nested_message(alloc, &storage);
+          break;
+        default:
+          fail("unsupported field type");
+      }
+    }
+
+    void parse_sequence(allocator*                        alloc,
+                        value_storage&                    storage,
+                        const sequence_field_instruction* inst)
+    {
+      expect('[');
+      sequence_mref sequence(alloc, &storage, inst);
+      sequence.resize(0);
+      if (peek() == ']') {
+        ++cur_;
+        return;
+      }
+
+      const std::size_t num_fields = inst->subinstructions_count();
+      for (std::size_t n = 0;; ++n) {
+        // grow geometrically instead of reallocating for every element
+        if (n >= storage.of_array.capacity_)
+          sequence.reserve(n ? 2 * n : 4);
+        sequence.resize(n + 1);
+        value_storage* element = static_cast<value_storage*>(storage.of_array.content_) + n * num_fields;
+
+        // an element with a single field is written as the value of the field
+        if (num_fields == 1)
+          parse_field(inst, 0, alloc, element);
+        else
+          parse_aggregate(inst, alloc, element);
+
+        char c = peek();
+        ++cur_;
+        if (c == ']')
+          return;
+        if (c != ',')
+          fail("expected ',' or ']'");
+      }
+    }
+
+    void parse_nested_message(allocator* alloc, value_storage* storage)
+    {
+      const template_instruction* target = storage->of_templateref.of_instruction.instruction_;
+      if (target == 0)
+        fail("the target template of the templateRef is not set");
+      parse_aggregate(target, alloc, storage->of_templateref.content_);
+    }
+
+    // Parse the digits of an integer; the magnitude must not exceed max_value.
+    uint64_t parse_digits(uint64_t max_value)
+    {
+      if (cur_ >= last_ || *cur_ < '0' || *cur_ > '9')
+        fail("expected a number");
+      uint64_t value = 0;
+      for (; cur_ < last_ && *cur_ >= '0' && *cur_ <= '9'; ++cur_) {
+        unsigned digit = *cur_ - '0';
+        if (value > (max_value - digit) / 10)
+          fail("integer out of range");
+        value = value * 10 + digit;
+      }
+      if (cur_ < last_ && (*cur_ == '.' || *cur_ == 'e' || *cur_ == 'E'))
+        fail("expected an integer");
+      return value;
+    }
+
+    uint64_t parse_unsigned(uint64_t max_value)
+    {
+      skip_whitespace();
+      if (cur_ < last_ && *cur_ == '-')
+        fail("negative value for an unsigned field");
+      return parse_digits(max_value);
+    }
+
+    int64_t parse_signed(int64_t max_value)
+    {
+      skip_whitespace();
+      if (cur_ < last_ && *cur_ == '-') {
+        ++cur_;
+        // the magnitude of the minimum value is max_value + 1
+        uint64_t magnitude = parse_digits(static_cast<uint64_t>(max_value) + 1);
+        return static_cast<int64_t>(0 - magnitude);
+      }
+      return static_cast<int64_t>(parse_digits(static_cast<uint64_t>(max_value)));
+    }
+
+    // Parse a number into a mantissa and a base 10 exponent. Digits which do not fit in the
+    // mantissa are only accepted when they are trailing zeros.
+    void parse_decimal(value_storage& storage)
+    {
+      skip_whitespace();
+      bool negative = false;
+      if (cur_ < last_ && *cur_ == '-') {
+        negative = true;
+        ++cur_;
+      }
+      if (cur_ >= last_ || *cur_ < '0' || *cur_ > '9')
+        fail("expected a number");
+
+      const uint64_t max_magnitude = static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) + negative;
+      uint64_t mantissa = 0;
+      int exponent = 0;
+      bool truncated = false;
+      bool in_fraction = false;
+      for (; cur_ < last_; ++cur_) {
+        char c = *cur_;
+        if (c == '.' && !in_fraction) {
+          in_fraction = true;
+          continue;
+        }
+        if (c < '0' || c > '9')
+          break;
+        unsigned digit = c - '0';
+        if (!truncated && mantissa <= (max_magnitude - digit) / 10) {
+          mantissa = mantissa * 10 + digit;
+          exponent -= in_fraction;
+        }
+        else if (digit == 0) {
+          truncated = true;
+          exponent += !in_fraction;
+        }
+        else {
+          fail("decimal mantissa out of range");
+        }
+      }
+
+      if (cur_ < last_ && (*cur_ == 'e' || *cur_ == 'E')) {
+        ++cur_;
+        bool negative_exponent = false;
+        if (cur_ < last_ && (*cur_ == '+' || *cur_ == '-'))
+          negative_exponent = (*cur_++ == '-');
+        int e = static_cast<int>(parse_digits(1000));
+        exponent += negative_exponent ? -e : e;
+      }
+
+      // bring the exponent into the range of a FAST decimal without changing the value
+      while (exponent > 63 && mantissa <= max_magnitude / 10) {
+        mantissa *= 10;
+        --exponent;
+      }
+      while (exponent < -63 && mantissa % 10 == 0 && mantissa) {
+        mantissa /= 10;
+        ++exponent;
+      }
+      if (mantissa == 0)
+        exponent = 0;
+      if (exponent > 63 || exponent < -63)
+        fail("decimal exponent out of range");
+
+      storage.of_decimal.mantissa_ = negative ? static_cast<int64_t>(0 - mantissa) : static_cast<int64_t>(mantissa);
+      storage.of_decimal.exponent_ = static_cast<int8_t>(exponent);
+      storage.present(true);
+    }
+
+    static int hex_value(char c)
+    {
+      if (c >= '0' && c <= '9')
+        return c - '0';
+      if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+      if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+      return -1;
+    }
+
+    uint32_t parse_hex4()
+    {
+      if (last_ - cur_ < 4)
+        fail("invalid unicode escape");
+      uint32_t value = 0;
+      for (int i = 0; i < 4; ++i) {
+        int h = hex_value(*cur_++);
+        if (h < 0)
+          fail("invalid unicode escape");
+        value = (value << 4) | h;
+      }
+      return value;
+    }
+
+    static char* put_utf8(uint32_t code_point, char* out)
+    {
+      if (code_point < 0x80) {
+        *out++ = static_cast<char>(code_point);
+      }
+      else if (code_point < 0x800) {
+        *out++ = static_cast<char>(0xC0 | (code_point >> 6));
+        *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+      }
+      else if (code_point < 0x10000) {
+        *out++ = static_cast<char>(0xE0 | (code_point >> 12));
+        *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+      }
+      else {
+        *out++ = static_cast<char>(0xF0 | (code_point >> 18));
+        *out++ = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+      }
+      return out;
+    }
+
+    // Strings without escapes are copied with a single assign(); otherwise they are
+    // unescaped in place into the buffer of the field, which the decoded text never outgrows.
+    template <typename VectorMref>
+    void parse_string(const VectorMref& ref)
+    {
+      expect('"');
+      const char* start = cur_;
+      bool escaped = false;
+      for (; cur_ < last_ && *cur_ != '"'; ++cur_) {
+        if (static_cast<unsigned char>(*cur_) < 0x20)
+          fail("control character in a string");
+        if (*cur_ == '\\') {
+          escaped = true;
+          if (++cur_ == last_)
+            break;
+        }
+      }
+      if (cur_ >= last_)
+        fail("unterminated string");
+      const char* end = cur_++;
+
+      if (!escaped) {
+        ref.assign(start, end);
+        return;
+      }
+
+      ref.resize(end - start);
+      char* out = reinterpret_cast<char*>(ref.data());
+      char* out_start = out;
+      for (cur_ = start; cur_ < end; ) {
+        char c = *cur_++;
+        if (c != '\\') {
+          *out++ = c;
+          continue;
+        }
+        c = *cur_++;
+        switch (c) {
+          case '"': *out++ = '"'; break;
+          case '\\': *out++ = '\\'; break;
+          case '/': *out++ = '/'; break;
+          case 'b': *out++ = '\b'; break;
+          case 'f': *out++ = '\f'; break;
+          case 'n': *out++ = '\n'; break;
+          case 'r': *out++ = '\r'; break;
+          case 't': *out++ = '\t'; break;
+          case 'u': {
+            uint32_t code_point = parse_hex4();
+            if (code_point >= 0xD800 && code_point < 0xDC00) {
+              if (end - cur_ < 6 || cur_[0] != '\\' || cur_[1] != 'u')
+                fail("unpaired surrogate in a unicode escape");
+              cur_ += 2;
+              uint32_t low = parse_hex4();
+              if (low < 0xDC00 || low >= 0xE000)
+                fail("unpaired surrogate in a unicode escape");
+              code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+            }
+            // the longest encoding takes 4 bytes for an escape of at least 6 characters
+            out = put_utf8(code_point, out);
+            break;
+          }
+          default:
+            fail("invalid escape in a string");
+        }
+      }
+      ref.resize(out - out_start);
+      cur_ = end + 1;
+    }
+
+    // skip a value of a member which has no matching field
+    void skip_value(int depth)
+    {
+      if (depth > 256)
+        fail("too deeply nested value");
+
+      char c = peek();
+      if (c == '"') {
+        for (++cur_; cur_ < last_ && *cur_ != '"'; ++cur_) {
+          if (*cur_ == '\\')
+            ++cur_;
+        }
+        if (cur_ >= last_)
+          fail("unterminated string");
+        ++cur_;
+      }
+      else if (c == '{' || c == '[') {
+        char close = (c == '{') ? '}' : ']';
+        ++cur_;
+        if (peek() == close) {
+          ++cur_;
+          return;
+        }
+        for (;;) {
+          if (c == '{') {
+            skip_value(depth + 1);
+            expect(':');
+          }
+          skip_value(depth + 1);
+          char next = peek();
+          ++cur_;
+          if (next == close)
+            return;
+          if (next != ',')
+            fail("expected ',' in an object or array");
+        }
+      }
+      else if (c == '-' || (c >= '0' && c <= '9')) {
+        ++cur_;
+        while (cur_ < last_ && ((*cur_ >= '0' && *cur_ <= '9') || *cur_ == '.' ||
+                                *cur_ == 'e' || *cur_ == 'E' || *cur_ == '+' || *cur_ == '-'))
+          ++cur_;
+      }
+      else if (!literal("true", 4) && !literal("false", 5) && !literal("null", 4)) {
+        fail("invalid value");
+      }
+    }
+
+    const char* first_;
+    const char* cur_;
+    const char* last_;
+};
+
+/// Decode the JSON object in [@a first, @a last) into @a msg.
+inline const char* decode(const char* first, const char* last, const mfast::aggregate_mref& msg)
+{
+  json_decoder decoder;
+  return decoder.decode(first, last, msg);
+}
+
+} // namespace json
+} // namespace mfast
 
 #endif /* end of include guard: JSON_DECODER_H_RRQN6243 */
@@ -2,41 +2,222 @@
 #define JSON_ENCODER_H_DHG4BF3O
 
 #include <mfast.h>
+#include <mfast/text_format.h>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <vector>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define MFAST_JSON_SSE2_ESCAPE
+#endif
 
 namespace mfast {
 namespace json {
 namespace encode_detail {
 
-struct quoted_string {
-  quoted_string(const char* str)
-    : str_(str)
-  {
-  }
-
-  const char* str_;
-};
-
+// characters which must be escaped in a json string: '"', '\\' and the control characters
+inline bool needs_escape(unsigned char c)
+{
+  return c < 0x20 || c == '"' || c == '\\';
+}
 
-std::ostream& operator << (std::ostream& os, quoted_string str)
+// return the first character in [first, last) which must be escaped, or last
+inline const char* find_escape(const char* first, const char* last)
 {
-  os.put('"');
-  const char* ptr = str.str_;
-  while (*ptr != '\x0') {
-    if (*ptr == '\\' || *ptr == '"')
-      os.put('\\');
-    os.put(*ptr++);
+#ifdef MFAST_JSON_SSE2_ESCAPE
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i max_control = _mm_set1_epi8(0x1F);
+  for (; last - first >= 16; first += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    // unsigned chunk <= 0x1F, i.e. min(chunk, 0x1F) == chunk
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(chunk, max_control), chunk);
+    __m128i special = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash));
+    int mask = _mm_movemask_epi8(_mm_or_si128(control, special));
+    if (mask)
+      return first + __builtin_ctz(mask);
   }
-  os.put('"');
-  return os;
+#endif
+  while (first < last && !needs_escape(static_cast<unsigned char>(*first)))
+    ++first;
+  return first;
 }
 
+// The output of json_writer: either a growable buffer owned by the writer or a fixed
+// buffer supplied by the caller, which stops accepting characters once it is full. With a
+// stream, the fixed buffer is written to the stream whenever it is full instead.
+class output_buffer
+{
+  public:
+    output_buffer(std::size_t initial_capacity)
+      : storage_(initial_capacity ? initial_capacity : 1)
+      , first_(&storage_[0])
+      , cur_(first_)
+      , last_(first_ + storage_.size())
+      , overflow_(false)
+      , os_(0)
+    {
+    }
+
+    output_buffer(char* buf, std::size_t size, std::ostream* os = 0)
+      : first_(buf)
+      , cur_(buf)
+      , last_(buf + size)
+      , overflow_(false)
+      , os_(os)
+    {
+    }
+
+    const char* data() const
+    {
+      return first_;
+    }
+
+    std::size_t size() const
+    {
+      return cur_ - first_;
+    }
+
+    bool overflow() const
+    {
+      return overflow_;
+    }
+
+    // discard the characters written after the first @a n
+    void truncate(std::size_t n)
+    {
+      cur_ = first_ + n;
+      overflow_ = false;
+    }
+
+    // write the buffered characters to the stream, if any
+    void flush()
+    {
+      if (os_ && cur_ != first_) {
+        os_->write(first_, cur_ - first_);
+        cur_ = first_;
+      }
+    }
+
+    // return the position to write @a n characters to, or 0 if a fixed buffer is full or
+    // if @a n characters do not fit in the buffer of a stream
+    char* reserve(std::size_t n)
+    {
+      if (static_cast<std::size_t>(last_ - cur_) >= n)
+        return cur_;
+      if (os_) {
+        flush();
+        return static_cast<std::size_t>(last_ - cur_) >= n ? cur_ : 0;
+      }
+      if (overflow_ || storage_.empty()) {
+        overflow_ = true;
+        return 0;
+      }
+      std::size_t len = size();
+      storage_.resize((std::max)(storage_.size() * 2, len + n));
+      first_ = &storage_[0];
+      cur_ = first_ + len;
+      last_ = first_ + storage_.size();
+      return cur_;
+    }
+
+    // like reserve(), but a fixed buffer without room for @a n characters is not marked as
+    // full, so that the caller can retry with the actual number of characters
+    char* room(std::size_t n)
+    {
+      if (storage_.empty() && os_ == 0 && static_cast<std::size_t>(last_ - cur_) < n)
+        return 0;
+      return reserve(n);
+    }
+
+    void commit(char* end)
+    {
+      cur_ = end;
+    }
+
+    void put(char c)
+    {
+      if (char* out = reserve(1)) {
+        *out = c;
+        commit(out + 1);
+      }
+    }
+
+    void write(const char* str, std::size_t n)
+    {
+      if (char* out = reserve(n)) {
+        std::memcpy(out, str, n);
+        commit(out + n);
+      }
+      else if (os_) {
+        os_->write(str, n);
+      }
+    }
+
+    void write_quoted(const char* str, std::size_t n)
+    {
+      static const char hex_digits[] = "0123456789abcdef";
+
+      put('"');
+      const char* last = str + n;
+      while (str < last) {
+        const char* escape = find_escape(str, last);
+        write(str, escape - str);
+        if (escape == last)
+          break;
+
+        unsigned char c = static_cast<unsigned char>(*escape);
+        char buf[6] = { '\\', static_cast<char>(c), 0, 0, 0, 0 };
+        std::size_t len = 2;
+        switch (c) {
+          case '"':
+          case '\\':
+            break;
+          case '\b': buf[1] = 'b'; break;
+          case '\f': buf[1] = 'f'; break;
+          case '\n': buf[1] = 'n'; break;
+          case '\r': buf[1] = 'r'; break;
+          case '\t': buf[1] = 't'; break;
+          default:
+            buf[1] = 'u';
+            buf[2] = '0';
+            buf[3] = '0';
+            buf[4] = hex_digits[c >> 4];
+            buf[5] = hex_digits[c & 0xF];
+            len = 6;
+        }
+        write(buf, len);
+        str = escape + 1;
+      }
+      put('"');
+    }
+
+  private:
+    output_buffer(const output_buffer&);
+    output_buffer& operator = (const output_buffer&);
+
+    std::vector<char> storage_;
+    char* first_;
+    char* cur_;
+    char* last_;
+    bool overflow_;
+    std::ostream* os_;
+};
+
 
 class json_visitor
 {
   private:
-    std::ostream& strm_;
-    char separator_[2];
+    output_buffer& buf_;
+    char separator_;
+
+    void put_separator()
+    {
+      if (separator_)
+        buf_.put(separator_);
+    }
 
   public:
 
@@ -44,32 +225,53 @@ class json_visitor
       visit_absent = 0
     };
 
-    json_visitor(std::ostream& strm)
-      : strm_(strm)
+    json_visitor(output_buffer& buf)
+      : buf_(buf)
+      , separator_(0)
+    {
+    }
+
+    template <typename IntegerTypeRef>
+    void visit(const IntegerTypeRef& ref)
     {
-      separator_[0] = 0;
-      separator_[1] = 0;
+      put_separator();
+      if (char* out = buf_.room(mfast::max_integer_text_size)) {
+        buf_.commit(out + mfast::format_integer(ref.value(), out));
+      }
+      else {
+        char text[mfast::max_integer_text_size];
+        buf_.write(text, mfast::format_integer(ref.value(), text));
+      }
     }
 
-    template <typename NumericTypeRef>
-    void visit(const NumericTypeRef& ref)
+    void visit(const mfast::decimal_cref& ref)
     {
-      strm_ <<  separator_ << ref.value();
+      put_separator();
+      if (char* out = buf_.room(mfast::max_decimal_text_size)) {
+        buf_.commit(out + mfast::format_decimal(ref.mantissa(), ref.exponent(), out));
+      }
+      else {
+        char text[mfast::max_decimal_text_size];
+        buf_.write(text, mfast::format_decimal(ref.mantissa(), ref.exponent(), text));
+      }
     }
 
     void visit(const mfast::ascii_string_cref& ref)
     {
-      strm_ <<  separator_ << quoted_string(ref.c_str());
+      put_separator();
+      buf_.write_quoted(ref.data(), ref.size());
     }
 
     void visit(const mfast::unicode_string_cref& ref)
     {
-      strm_ <<  separator_ << quoted_string(ref.c_str());
+      put_separator();
+      buf_.write_quoted(ref.data(), ref.size());
     }
 
     void visit(const mfast::byte_vector_cref& ref)
     { // json doesn't have byte vector, treat it as string now
-      strm_ <<  separator_ << quoted_string(reinterpret_cast<const char*>(ref.data()));
+      put_separator();
+      buf_.write_quoted(reinterpret_cast<const char*>(ref.data()), ref.size());
     }
 
     void visit(const mfast::aggregate_cref& ref, int)
@@ -82,30 +284,35 @@ class json_visitor
           return;
         }
       }
-      
-      strm_ << separator_ <<  "{";
-      separator_[0] = '\0';
-      
+
+      put_separator();
+      buf_.put('{');
+      separator_ = 0;
+
       for (std::size_t i = 0; i < ref.num_fields(); ++i) {
-        if (ref[i].present()) {          
-          strm_ << separator_ << quoted_string(ref[i].name()) << ":";
-          separator_[0] = '\0';
+        if (ref[i].present()) {
+          put_separator();
+          const char* name = ref[i].name();
+          buf_.write_quoted(name, std::strlen(name));
+          buf_.put(':');
+          separator_ = 0;
           ref[i].accept_accessor(*this);
+          separator_ = ',';
         }
-        separator_[0] = ',';
       }
 
-      strm_ << "}";
+      buf_.put('}');
     }
 
     void visit(const mfast::sequence_cref& ref, int)
     {
-      strm_ << separator_  << "[";
+      put_separator();
+      buf_.put('[');
       if (ref.size()) {
-        separator_[0] = '\0';
-        ref.accept_accessor(*this);        
+        separator_ = 0;
+        ref.accept_accessor(*this);
       }
-      strm_ << "]";
+      buf_.put(']');
     }
 
     void visit(const mfast::sequence_element_cref& ref, int)
@@ -116,7 +323,7 @@ class json_visitor
       else {
         this->visit(mfast::aggregate_cref(ref), 0);
       }
-      separator_[0] = ',';
+      separator_ = ',';
     }
 
     void visit(const mfast::nested_message_cref& ref, int)
@@ -128,10 +335,82 @@ class json_visitor
 
 } // namspace encode_detail
 
+/// Writes messages as JSON objects into a byte buffer.
+///
+/// The buffer is either owned by the writer and grows as needed, or supplied by the caller
+/// with a fixed size. Strings are escaped by scanning 16 bytes at a time with SSE2 where it
+/// is available, and numbers are formatted directly into the buffer, so writing into a
+/// buffer which has reached its working size does not allocate.
+///
+/// Successive messages are appended to the buffer; with @a newline_delimited, each one is
+/// followed by '\n' as in NDJSON.
+class json_writer
+{
+  public:
+    /// Write into a buffer owned by the writer.
+    explicit json_writer(bool newline_delimited = false, std::size_t initial_capacity = 4096)
+      : buf_(initial_capacity)
+      , newline_delimited_(newline_delimited)
+    {
+    }
+
+    /// Write into the @a size bytes at @a buf.
+    json_writer(char* buf, std::size_t size, bool newline_delimited = false)
+      : buf_(buf, size)
+      , newline_delimited_(newline_delimited)
+    {
+    }
+
+    /// Append @a msg to the buffer.
+    ///
+    /// @returns false if @a msg does not fit in a fixed buffer; the buffer then keeps
+    ///          only the messages written before.
+    bool write(const aggregate_cref& msg)
+    {
+      std::size_t len = buf_.size();
+      encode_detail::json_visitor visitor(buf_);
+      visitor.visit(msg, 0);
+      if (newline_delimited_)
+        buf_.put('\n');
+      if (buf_.overflow()) {
+        buf_.truncate(len);
+        return false;
+      }
+      return true;
+    }
+
+    const char* data() const
+    {
+      return buf_.data();
+    }
+
+    std::size_t size() const
+    {
+      return buf_.size();
+    }
+
+    /// Discard the content of the buffer; a growable buffer keeps its capacity.
+    void clear()
+    {
+      buf_.truncate(0);
+    }
+
+  private:
+    encode_detail::output_buffer buf_;
+    bool newline_delimited_;
+};
+
+/// Write @a msg to @a os as a JSON object.
+///
+/// The text is streamed through a buffer on the stack; use a json_writer to collect many
+/// messages in memory.
 inline bool encode(std::ostream& os, const mfast::aggregate_cref& msg)
 {
-  encode_detail::json_visitor visitor(os);
+  char buf[1024];
+  encode_detail::output_buffer out(buf, sizeof(buf), &os);
+  encode_detail::json_visitor visitor(out);
   visitor.visit(msg, 0);
+  out.flush();
   return os.good();
 }
 
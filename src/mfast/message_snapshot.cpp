@@ -0,0 +1,288 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cstring>
+#include <boost/static_assert.hpp>
+#include <boost/integer_traits.hpp>
+#include "mfast/message_snapshot.h"
+
+namespace mfast {
+
+BOOST_STATIC_ASSERT(sizeof(value_storage) == 16);
+BOOST_STATIC_ASSERT(sizeof(snapshot_header) == 16);
+
+namespace {
+
+// Writes a snapshot into a buffer, or only computes its size when the buffer is 0.
+class snapshot_writer
+{
+  public:
+    snapshot_writer(char* buffer, std::size_t buffer_size)
+      : base_(buffer)
+      , capacity_(buffer_size)
+      , pos_(0)
+    {
+    }
+
+    std::size_t write(const message_cref& message)
+    {
+      const template_instruction* instruction = message.instruction();
+      std::size_t header_offset = reserve(sizeof(snapshot_header));
+      std::size_t fields_offset = reserve(instruction->subinstructions_count()*sizeof(value_storage));
+      write_aggregate(instruction, message.field_storage(0), fields_offset);
+
+      if (base_) {
+        snapshot_header* header = reinterpret_cast<snapshot_header*>(base_ + header_offset);
+        header->template_id = instruction->id();
+        header->num_fields = instruction->subinstructions_count();
+        header->size = pos_;
+      }
+      return pos_;
+    }
+
+  private:
+    // Reserve @a n bytes rounded up to the alignment of value_storage; returns their offset.
+    std::size_t reserve(std::size_t n)
+    {
+      std::size_t offset = pos_;
+      std::size_t aligned = (n + 7) & ~static_cast<std::size_t>(7);
+      if (aligned > capacity_ - pos_)
+        BOOST_THROW_EXCEPTION(snapshot_overflow_error());
+      pos_ += aligned;
+      return offset;
+    }
+
+    // In the sizing pass, the entries are written into a scratch storage.
+    value_storage* entry(std::size_t offset)
+    {
+      return base_ ? reinterpret_cast<value_storage*>(base_ + offset) : &scratch_;
+    }
+
+    void write_string(const value_storage& src, value_storage* dest)
+    {
+      dest->of_array.len_ = src.of_array.len_;
+      dest->of_array.capacity_ = 0;
+      dest->of_array.defined_bit_ = src.of_array.defined_bit_;
+      dest->of_uint.content_ = 0;
+
+      if (src.of_array.len_ > 0) {
+        std::size_t n = src.array_length();
+        std::size_t offset = reserve(n+1);
+        if (base_) {
+          std::memcpy(base_ + offset, src.of_array.content_, n);
+          base_[offset + n] = '\0';
+        }
+        dest->of_uint.content_ = offset;
+      }
+    }
+
+    void write_aggregate(const group_field_instruction* instruction,
+                         const value_storage*           src_array,
+                         std::size_t                    dest_offset)
+    {
+      for (uint32_t i = 0; i < instruction->subinstructions_count(); ++i) {
+        const field_instruction* subinstruction = instruction->subinstruction(i);
+        const value_storage& src = src_array[i];
+        std::size_t entry_offset = dest_offset + i*sizeof(value_storage);
+
+        switch (subinstruction->field_type()) {
+          case field_type_int32:
+          case field_type_uint32:
+          case field_type_int64:
+          case field_type_uint64:
+          case field_type_decimal:
+          case field_type_exponent:
+            *entry(entry_offset) = src;
+            break;
+          case field_type_ascii_string:
+          case field_type_unicode_string:
+          case field_type_byte_vector:
+            write_string(src, entry(entry_offset));
+            break;
+          case field_type_group:
+            {
+              const group_field_instruction* group_inst = static_cast<const group_field_instruction*>(subinstruction);
+              std::size_t content_offset = 0;
+              if (src.of_group.present_ && src.of_group.content_) {
+                content_offset = reserve(group_inst->subinstructions_count()*sizeof(value_storage));
+                write_aggregate(group_inst, src.of_group.content_, content_offset);
+              }
+              value_storage* dest = entry(entry_offset);
+              dest->of_group.present_ = src.of_group.present_;
+              dest->of_group.own_content_ = 0;
+              dest->of_group.padding_ = 0;
+              dest->of_group.defined_bit_ = src.of_group.defined_bit_;
+              dest->of_uint.content_ = content_offset;
+            }
+            break;
+          case field_type_sequence:
+            {
+              const sequence_field_instruction* seq_inst = static_cast<const sequence_field_instruction*>(subinstruction);
+              std::size_t length = src.array_length();
+              std::size_t element_size = seq_inst->subinstructions_count()*sizeof(value_storage);
+              std::size_t elements_offset = 0;
+              if (length > 0) {
+                elements_offset = reserve(length*element_size);
+                const value_storage* elements = static_cast<const value_storage*>(src.of_array.content_);
+                for (std::size_t j = 0; j < length; ++j) {
+                  write_aggregate(seq_inst,
+                                  elements + j*seq_inst->subinstructions_count(),
+                                  elements_offset + j*element_size);
+                }
+              }
+              value_storage* dest = entry(entry_offset);
+              dest->of_array.len_ = src.of_array.len_;
+              dest->of_array.capacity_ = 0;
+              dest->of_array.defined_bit_ = src.of_array.defined_bit_;
+              dest->of_uint.content_ = elements_offset;
+            }
+            break;
+          case field_type_templateref:
+            {
+              const template_instruction* target = src.of_templateref.of_instruction.instruction_;
+              std::size_t content_offset = 0;
+              if (target && src.of_templateref.content_) {
+                content_offset = reserve(target->subinstructions_count()*sizeof(value_storage));
+                write_aggregate(target, src.of_templateref.content_, content_offset);
+              }
+              value_storage* dest = entry(entry_offset);
+              dest->of_templateref.of_instruction.dummy_ = (target && content_offset) ? target->id() : 0;
+              dest->of_uint.content_ = content_offset;
+            }
+            break;
+          default:
+            *entry(entry_offset) = value_storage();
+            break;
+        }
+      }
+    }
+
+    char* base_;
+    std::size_t capacity_;
+    std::size_t pos_;
+    value_storage scratch_;
+};
+
+// Replaces the offsets of a snapshot with pointers into the snapshot.
+class snapshot_rebaser
+{
+  public:
+    snapshot_rebaser(char* base, const templates_description* templates)
+      : base_(base)
+      , templates_(templates)
+    {
+    }
+
+    void rebase_aggregate(const group_field_instruction* instruction, value_storage* array)
+    {
+      for (uint32_t i = 0; i < instruction->subinstructions_count(); ++i) {
+        const field_instruction* subinstruction = instruction->subinstruction(i);
+        value_storage& entry = array[i];
+        std::size_t offset = static_cast<std::size_t>(entry.of_uint.content_);
+
+        switch (subinstruction->field_type()) {
+          case field_type_ascii_string:
+          case field_type_unicode_string:
+          case field_type_byte_vector:
+            entry.of_array.content_ = entry.of_array.len_ ? base_ + offset : 0;
+            break;
+          case field_type_group:
+            {
+              const group_field_instruction* group_inst = static_cast<const group_field_instruction*>(subinstruction);
+              entry.of_group.content_ = offset ? storage_at(offset) : 0;
+              if (entry.of_group.content_)
+                rebase_aggregate(group_inst, entry.of_group.content_);
+            }
+            break;
+          case field_type_sequence:
+            {
+              const sequence_field_instruction* seq_inst = static_cast<const sequence_field_instruction*>(subinstruction);
+              std::size_t length = entry.array_length();
+              value_storage* elements = length ? storage_at(offset) : 0;
+              entry.of_array.content_ = elements;
+              for (std::size_t j = 0; j < length; ++j)
+                rebase_aggregate(seq_inst, elements + j*seq_inst->subinstructions_count());
+            }
+            break;
+          case field_type_templateref:
+            {
+              const templateref_instruction* ref_inst = static_cast<const templateref_instruction*>(subinstruction);
+              uint32_t id = static_cast<uint32_t>(entry.of_templateref.of_instruction.dummy_);
+              const template_instruction* target = 0;
+              if (id && offset) {
+                if (ref_inst->is_static())
+                  target = ref_inst->target();
+                else if (templates_)
+                  target = templates_->instruction_with_id(id);
+              }
+              entry.of_templateref.of_instruction.dummy_ = 0;
+              entry.of_templateref.of_instruction.instruction_ = target;
+              entry.of_templateref.content_ = target ? storage_at(offset) : 0;
+              if (target)
+                rebase_aggregate(target, entry.of_templateref.content_);
+            }
+            break;
+          default:
+            break;
+        }
+      }
+    }
+
+  private:
+    value_storage* storage_at(std::size_t offset)
+    {
+      return reinterpret_cast<value_storage*>(base_ + offset);
+    }
+
+    char* base_;
+    const templates_description* templates_;
+};
+
+}
+
+std::size_t flattened_size(const message_cref& message)
+{
+  snapshot_writer writer(0, boost::integer_traits<std::size_t>::const_max);
+  return writer.write(message);
+}
+
+std::size_t flatten(const message_cref& message, char* buffer, std::size_t buffer_size)
+{
+  snapshot_writer writer(buffer, buffer_size);
+  return writer.write(message);
+}
+
+void flatten(const message_cref& message, std::vector<char>& buffer)
+{
+  std::size_t size = flattened_size(message);
+  buffer.resize(size);
+  flatten(message, &buffer[0], size);
+}
+
+message_cref unflatten(void*                        block,
+                       const template_instruction*  instruction,
+                       const templates_description* templates)
+{
+  assert(snapshot_message_cref::template_id(block) == instruction->id());
+  char* base = static_cast<char*>(block);
+  value_storage* storage_array = reinterpret_cast<value_storage*>(base + sizeof(snapshot_header));
+  snapshot_rebaser(base, templates).rebase_aggregate(instruction, storage_array);
+  return message_cref(storage_array, instruction);
+}
+
+}
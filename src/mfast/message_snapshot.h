@@ -0,0 +1,355 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef MESSAGE_SNAPSHOT_H_B8TQ2MZR
+#define MESSAGE_SNAPSHOT_H_B8TQ2MZR
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+#include <exception>
+#include <boost/exception/all.hpp>
+#include "mfast/mfast_export.h"
+#include "mfast/field_instruction.h"
+#include "mfast/message_ref.h"
+#include "mfast/fixed_decimal.h"
+
+namespace mfast {
+
+/// Thrown by flatten() when the buffer is too small for the snapshot.
+class MFAST_EXPORT snapshot_overflow_error
+  : public virtual boost::exception, public virtual std::exception
+{
+  public:
+    virtual const char* what() const throw()
+    {
+      return "buffer too small for the message snapshot";
+    }
+
+};
+
+/// The header at the beginning of a message snapshot.
+///
+/// A snapshot is a contiguous block which starts with this header followed by the values of
+/// the top level fields. It uses the value_storage layout of a message, except that every
+/// pointer to strings, group contents, sequence elements and nested messages is replaced by
+/// its offset from the beginning of the block, and a nested message keeps the id of its
+/// template instead of the template instruction. Therefore, a snapshot can be copied with
+/// memcpy and read in place at any address which is aligned to 8 bytes, including shared
+/// memory mapped by other processes.
+struct snapshot_header
+{
+  uint32_t template_id;
+  uint32_t num_fields;
+  uint64_t size;
+};
+
+/// Returns the number of bytes flatten() writes for @a message.
+MFAST_EXPORT std::size_t flattened_size(const message_cref& message);
+
+/// Serialize @a message into a snapshot in @a buffer without memory allocation.
+///
+/// @param[out] buffer The destination; must be aligned to 8 bytes.
+/// @param[in] buffer_size The capacity of @a buffer.
+/// @returns The size of the snapshot.
+/// @throws snapshot_overflow_error if the snapshot is larger than @a buffer_size.
+MFAST_EXPORT std::size_t flatten(const message_cref& message, char* buffer, std::size_t buffer_size);
+
+/// Serialize @a message into a snapshot which replaces the content of @a buffer.
+MFAST_EXPORT void flatten(const message_cref& message, std::vector<char>& buffer);
+
+/// Turn the snapshot in @a block into the storage of a message in place and return it.
+///
+/// The offsets of the snapshot are replaced with pointers into @a block, so the returned
+/// message can be used wherever a message_cref is expected, e.g. with field visitors,
+/// comparators, generated _cref types or json::encode(), for as long as @a block is neither
+/// moved nor modified. @a block can no longer be read as a snapshot afterwards, except for
+/// its header.
+///
+/// @param block The snapshot; must be aligned to 8 bytes.
+/// @param instruction The template of the snapshot; see snapshot_message_cref.
+/// @param templates The templates which the ids of dynamic nested messages are resolved with;
+///        a nested message whose template is not found is left unbound.
+MFAST_EXPORT message_cref unflatten(void*                        block,
+                                    const template_instruction*  instruction,
+                                    const templates_description* templates = 0);
+
+class snapshot_aggregate_cref;
+class snapshot_sequence_cref;
+class snapshot_message_cref;
+
+/// Read only access to a field of a message snapshot.
+class snapshot_field_cref
+{
+  public:
+    snapshot_field_cref(const char*              base,
+                        const value_storage*     storage,
+                        const field_instruction* instruction)
+      : base_(base)
+      , storage_(storage)
+      , instruction_(instruction)
+    {
+    }
+
+    bool absent() const
+    {
+      return instruction_->optional() && storage_->is_empty();
+    }
+
+    bool present() const
+    {
+      return !absent();
+    }
+
+    const field_instruction* instruction() const
+    {
+      return instruction_;
+    }
+
+    field_type_enum_t field_type() const
+    {
+      return instruction_->field_type();
+    }
+
+    uint32_t id() const
+    {
+      return instruction_->id();
+    }
+
+    const char* name() const
+    {
+      return instruction_->name();
+    }
+
+    /// The value of an integer field.
+    template <typename IntType>
+    IntType int_value() const
+    {
+      return storage_->get<IntType>();
+    }
+
+    int64_t mantissa() const
+    {
+      return storage_->of_decimal.mantissa_;
+    }
+
+    int8_t exponent() const
+    {
+      return storage_->of_decimal.exponent_;
+    }
+
+    fixed_decimal decimal_value() const
+    {
+      return fixed_decimal(mantissa(), exponent());
+    }
+
+    /// The content of a string or byte vector field.
+    const char* data() const
+    {
+      return base_ + storage_->of_uint.content_;
+    }
+
+    std::size_t size() const
+    {
+      return storage_->array_length();
+    }
+
+    /// The content of a string field; flatten() null terminates it.
+    const char* c_str() const
+    {
+      return data();
+    }
+
+    snapshot_aggregate_cref group() const;
+
+    snapshot_sequence_cref sequence() const;
+
+    /// The template id of a nested message; 0 if it is not bound to a template.
+    uint32_t nested_template_id() const
+    {
+      return static_cast<uint32_t>(storage_->of_templateref.of_instruction.dummy_);
+    }
+
+    /// The nested message; @a instruction must be the template with nested_template_id().
+    snapshot_message_cref nested_message(const template_instruction* instruction) const;
+
+  private:
+    const char* base_;
+    const value_storage* storage_;
+    const field_instruction* instruction_;
+};
+
+/// Read only access to the fields of a message, group or sequence element of a snapshot.
+class snapshot_aggregate_cref
+{
+  public:
+    snapshot_aggregate_cref(const char*                    base,
+                            const value_storage*           storage_array,
+                            const group_field_instruction* instruction)
+      : base_(base)
+      , storage_array_(storage_array)
+      , instruction_(instruction)
+    {
+    }
+
+    std::size_t num_fields() const
+    {
+      return instruction_->subinstructions_count();
+    }
+
+    snapshot_field_cref operator[](std::size_t index) const
+    {
+      return snapshot_field_cref(base_, &storage_array_[index], instruction_->subinstruction(index));
+    }
+
+    /// Returns the field resolved by @a handle from the instruction of this aggregate.
+    snapshot_field_cref operator[](const field_handle& handle) const
+    {
+      assert(handle.instruction() == instruction_);
+      return (*this)[handle.index()];
+    }
+
+    /// return -1 if no such field is found
+    int field_index_with_id(std::size_t id) const
+    {
+      return instruction_->find_subinstruction_index_by_id(static_cast<uint32_t>(id));
+    }
+
+    /// return -1 if no such field is found
+    int field_index_with_name(const char* name) const
+    {
+      return instruction_->find_subinstruction_index_by_name(name);
+    }
+
+    const group_field_instruction* instruction() const
+    {
+      return instruction_;
+    }
+
+  protected:
+    const char* base_;
+    const value_storage* storage_array_;
+    const group_field_instruction* instruction_;
+};
+
+/// Read only access to the elements of a sequence of a snapshot.
+class snapshot_sequence_cref
+{
+  public:
+    snapshot_sequence_cref(const char*                       base,
+                           const value_storage*              storage,
+                           const sequence_field_instruction* instruction)
+      : base_(base)
+      , storage_(storage)
+      , instruction_(instruction)
+    {
+    }
+
+    std::size_t size() const
+    {
+      return storage_->array_length();
+    }
+
+    snapshot_aggregate_cref operator[](std::size_t index) const
+    {
+      assert(index < size());
+      const value_storage* elements = reinterpret_cast<const value_storage*>(base_ + storage_->of_uint.content_);
+      return snapshot_aggregate_cref(base_,
+                                     elements + index*instruction_->subinstructions_count(),
+                                     instruction_);
+    }
+
+    const sequence_field_instruction* instruction() const
+    {
+      return instruction_;
+    }
+
+  private:
+    const char* base_;
+    const value_storage* storage_;
+    const sequence_field_instruction* instruction_;
+};
+
+/// Read only access to a message snapshot produced by flatten().
+class snapshot_message_cref
+  : public snapshot_aggregate_cref
+{
+  public:
+    /// @param block The snapshot; must be aligned to 8 bytes.
+    /// @param instruction The template of the snapshot, which may come from another
+    ///        templates_description than the one of the flattened message as long as
+    ///        they are generated from the same template definition.
+    snapshot_message_cref(const void* block, const template_instruction* instruction)
+      : snapshot_aggregate_cref(static_cast<const char*>(block),
+                                reinterpret_cast<const value_storage*>(static_cast<const char*>(block) + sizeof(snapshot_header)),
+                                instruction)
+    {
+      assert(template_id(block) == instruction->id());
+    }
+
+    snapshot_message_cref(const char*                 base,
+                          const value_storage*        storage_array,
+                          const template_instruction* instruction)
+      : snapshot_aggregate_cref(base, storage_array, instruction)
+    {
+    }
+
+    uint32_t id() const
+    {
+      return instruction_->id();
+    }
+
+    /// Returns the template id of the snapshot in @a block.
+    static uint32_t template_id(const void* block)
+    {
+      return static_cast<const snapshot_header*>(block)->template_id;
+    }
+
+    /// Returns the size of the snapshot in @a block.
+    static std::size_t size(const void* block)
+    {
+      return static_cast<std::size_t>(static_cast<const snapshot_header*>(block)->size);
+    }
+};
+
+inline snapshot_aggregate_cref
+snapshot_field_cref::group() const
+{
+  return snapshot_aggregate_cref(base_,
+                                 reinterpret_cast<const value_storage*>(base_ + storage_->of_uint.content_),
+                                 static_cast<const group_field_instruction*>(instruction_));
+}
+
+inline snapshot_sequence_cref
+snapshot_field_cref::sequence() const
+{
+  return snapshot_sequence_cref(base_, storage_, static_cast<const sequence_field_instruction*>(instruction_));
+}
+
+inline snapshot_message_cref
+snapshot_field_cref::nested_message(const template_instruction* instruction) const
+{
+  assert(nested_template_id() == instruction->id());
+  return snapshot_message_cref(base_,
+                               reinterpret_cast<const value_storage*>(base_ + storage_->of_uint.content_),
+                               instruction);
+}
+
+}
+
+#endif /* end of include guard: MESSAGE_SNAPSHOT_H_B8TQ2MZR */
@@ -22,6 +22,7 @@
 #include "int_ref.h"
 #include "string_ref.h"
 #include "decimal_ref.h"
+#include "text_format.h"
 #include <iostream>
 #include <iomanip>
 #include <boost/io/ios_state.hpp>
@@ -29,25 +30,29 @@
 namespace mfast {
 inline std::ostream& operator << (std::ostream& os, const int32_cref& cref)
 {
-  os << cref.value();
+  char buf[max_integer_text_size];
+  os.write(buf, format_integer(cref.value(), buf));
   return os;
 }
 
 inline std::ostream& operator << (std::ostream& os, const uint32_cref& cref)
 {
-  os << cref.value();
+  char buf[max_integer_text_size];
+  os.write(buf, format_integer(cref.value(), buf));
   return os;
 }
 
 inline std::ostream& operator << (std::ostream& os, const int64_cref& cref)
 {
-  os << cref.value();
+  char buf[max_integer_text_size];
+  os.write(buf, format_integer(cref.value(), buf));
   return os;
 }
 
 inline std::ostream& operator << (std::ostream& os, const uint64_cref& cref)
 {
-  os << cref.value();
+  char buf[max_integer_text_size];
+  os.write(buf, format_integer(cref.value(), buf));
   return os;
 }
 
@@ -76,7 +81,8 @@ inline std::ostream& operator << (std::ostream& os, const byte_vector_cref& cref
 
 inline std::ostream& operator << (std::ostream& os, const decimal_cref& cref)
 {
-  os << cref.value();
+  char buf[max_decimal_text_size];
+  os.write(buf, format_decimal(cref.mantissa(), cref.exponent(), buf));
   return os;
 }
 }
@@ -0,0 +1,373 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "pool_allocator.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+namespace mfast {
+
+namespace {
+
+const std::size_t size_class_bytes[pool_allocator::num_size_classes] = {
+  16, 32, 48, 64, 80, 96, 112, 128, 144, 160, 176, 192, 208, 224, 240, 256,
+  384, 512, 768, 1024, 1536, 2048, 3072, 4096
+};
+
+// the size of memory requested from the system each time a size class runs out of blocks
+const std::size_t slab_size = 64*1024;
+
+inline unsigned size_class_of(std::size_t n)
+{
+  if (n <= 256)
+    return n == 0 ? 0 : static_cast<unsigned>((n + 15)/16 - 1);
+  unsigned i = 16;
+  while (size_class_bytes[i] < n)
+    ++i;
+  return i;
+}
+
+// the number of blocks moved between a thread cache and the shared free list at once
+inline unsigned batch_size_of(unsigned size_class)
+{
+  std::size_t n = 4096/size_class_bytes[size_class];
+  return static_cast<unsigned>(std::max<std::size_t>(std::min<std::size_t>(n, 64), 4));
+}
+
+struct free_block
+{
+  free_block* next_;
+};
+
+#ifdef _WIN32
+
+class mutex
+{
+  public:
+    mutex()  { InitializeCriticalSection(&cs_); }
+    ~mutex() { DeleteCriticalSection(&cs_); }
+    void lock()   { EnterCriticalSection(&cs_); }
+    void unlock() { LeaveCriticalSection(&cs_); }
+
+  private:
+    CRITICAL_SECTION cs_;
+};
+
+class thread_specific_ptr
+{
+  public:
+    thread_specific_ptr(void (NTAPI *cleanup)(void*)) : key_(FlsAlloc(cleanup)) {}
+    ~thread_specific_ptr() { release(); }
+    void* get() const      { return FlsGetValue(key_); }
+    void set(void* p)      { FlsSetValue(key_, p); }
+
+    // FlsFree() runs the cleanup function on the values which are still set
+    void release()
+    {
+      if (key_ != FLS_OUT_OF_INDEXES) {
+        FlsFree(key_);
+        key_ = FLS_OUT_OF_INDEXES;
+      }
+    }
+
+  private:
+    DWORD key_;
+};
+
+#define MFAST_THREAD_CLEANUP NTAPI
+
+#else
+
+class mutex
+{
+  public:
+    mutex()  { pthread_mutex_init(&mutex_, 0); }
+    ~mutex() { pthread_mutex_destroy(&mutex_); }
+    void lock()   { pthread_mutex_lock(&mutex_); }
+    void unlock() { pthread_mutex_unlock(&mutex_); }
+
+  private:
+    pthread_mutex_t mutex_;
+};
+
+class thread_specific_ptr
+{
+  public:
+    thread_specific_ptr(void (*cleanup)(void*)) : released_(false) { pthread_key_create(&key_, cleanup); }
+    ~thread_specific_ptr() { release(); }
+    void* get() const      { return pthread_getspecific(key_); }
+    void set(void* p)      { pthread_setspecific(key_, p); }
+
+    // unlike FlsFree(), pthread_key_delete() does not run the cleanup function
+    void release()
+    {
+      if (!released_) {
+        pthread_key_delete(key_);
+        released_ = true;
+      }
+    }
+
+  private:
+    pthread_key_t key_;
+    bool released_;
+};
+
+#define MFAST_THREAD_CLEANUP
+
+#endif
+
+class scoped_lock
+{
+  public:
+    scoped_lock(mutex& m) : mutex_(m) { mutex_.lock(); }
+    ~scoped_lock() { mutex_.unlock(); }
+
+  private:
+    mutex& mutex_;
+};
+
+}
+
+struct pool_thread_cache
+{
+  pool_allocator_impl* owner_;
+  pool_thread_cache*   next_;
+  free_block*          heads_[pool_allocator::num_size_classes];
+  unsigned             counts_[pool_allocator::num_size_classes];
+};
+
+extern "C" void MFAST_THREAD_CLEANUP mfast_pool_thread_exit(void* cache);
+
+struct pool_allocator_impl
+{
+  pool_allocator_impl()
+    : caches_(0)
+    , slabs_(0)
+    , tls_(&mfast_pool_thread_exit)
+  {
+    std::memset(shared_, 0, sizeof(shared_));
+  }
+
+  ~pool_allocator_impl()
+  {
+    // the index must be freed while the caches are alive, since on Windows this runs
+    // thread_exit() on the caches of the threads which are still running
+    tls_.release();
+    while (caches_) {
+      pool_thread_cache* tmp = caches_->next_;
+      delete caches_;
+      caches_ = tmp;
+    }
+    while (slabs_) {
+      free_block* tmp = slabs_->next_;
+      std::free(slabs_);
+      slabs_ = tmp;
+    }
+  }
+
+  pool_thread_cache* thread_cache()
+  {
+    pool_thread_cache* cache = static_cast<pool_thread_cache*>(tls_.get());
+    if (cache == 0) {
+      cache = new pool_thread_cache;
+      std::memset(cache, 0, sizeof(pool_thread_cache));
+      cache->owner_ = this;
+      tls_.set(cache);
+      scoped_lock guard(mutex_);
+      cache->next_ = caches_;
+      caches_ = cache;
+    }
+    return cache;
+  }
+
+  // Moves a batch of free blocks from the shared free list to the cache, carving a new slab
+  // when the shared free list is empty.
+  void refill(pool_thread_cache* cache, unsigned c)
+  {
+    unsigned n = batch_size_of(c);
+    scoped_lock guard(mutex_);
+
+    if (shared_[c] == 0) {
+      free_block* slab = static_cast<free_block*>(std::malloc(slab_size));
+      if (slab == 0)
+        throw std::bad_alloc();
+      slab->next_ = slabs_;
+      slabs_ = slab;
+
+      // the first 16 bytes of a slab link the slabs together
+      const std::size_t bytes = size_class_bytes[c];
+      char* first = reinterpret_cast<char*>(slab) + 16;
+      char* last = reinterpret_cast<char*>(slab) + slab_size - bytes;
+      for (char* p = first; p <= last; p += bytes) {
+        free_block* block = reinterpret_cast<free_block*>(p);
+        block->next_ = shared_[c];
+        shared_[c] = block;
+      }
+    }
+
+    while (n-- && shared_[c]) {
+      free_block* block = shared_[c];
+      shared_[c] = block->next_;
+      block->next_ = cache->heads_[c];
+      cache->heads_[c] = block;
+      ++cache->counts_[c];
+    }
+  }
+
+  // Moves n blocks from the cache to the shared free list.
+  void flush(pool_thread_cache* cache, unsigned c, unsigned n)
+  {
+    free_block* first = cache->heads_[c];
+    free_block* last = first;
+    for (unsigned i = 1; i < n; ++i)
+      last = last->next_;
+    cache->heads_[c] = last->next_;
+    cache->counts_[c] -= n;
+
+    scoped_lock guard(mutex_);
+    last->next_ = shared_[c];
+    shared_[c] = first;
+  }
+
+  void thread_exit(pool_thread_cache* cache)
+  {
+    for (unsigned c = 0; c < pool_allocator::num_size_classes; ++c) {
+      if (cache->counts_[c])
+        flush(cache, c, cache->counts_[c]);
+    }
+
+    {
+      scoped_lock guard(mutex_);
+      pool_thread_cache** p = &caches_;
+      while (*p != cache)
+        p = &(*p)->next_;
+      *p = cache->next_;
+    }
+    delete cache;
+  }
+
+  mutex mutex_;
+  free_block* shared_[pool_allocator::num_size_classes];
+  pool_thread_cache* caches_;
+  free_block* slabs_;
+  thread_specific_ptr tls_;
+};
+
+extern "C" void MFAST_THREAD_CLEANUP mfast_pool_thread_exit(void* cache)
+{
+  if (cache) {
+    pool_thread_cache* tc = static_cast<pool_thread_cache*>(cache);
+    tc->owner_->thread_exit(tc);
+  }
+}
+
+pool_allocator::pool_allocator()
+  : impl_(new pool_allocator_impl)
+{
+}
+
+pool_allocator::~pool_allocator()
+{
+  delete impl_;
+}
+
+std::size_t
+pool_allocator::block_size(std::size_t n)
+{
+  if (n > max_block_size)
+    return n;
+  return size_class_bytes[size_class_of(n)];
+}
+
+void*
+pool_allocator::allocate(std::size_t n)
+{
+  if (n > max_block_size) {
+    void* pointer = std::malloc(n);
+    if (pointer == 0) throw std::bad_alloc();
+    return pointer;
+  }
+
+  unsigned c = size_class_of(n);
+  pool_thread_cache* cache = impl_->thread_cache();
+  if (cache->heads_[c] == 0)
+    impl_->refill(cache, c);
+
+  free_block* block = cache->heads_[c];
+  cache->heads_[c] = block->next_;
+  --cache->counts_[c];
+  return block;
+}
+
+std::size_t
+pool_allocator::reallocate(void*& pointer, std::size_t old_size, std::size_t new_size)
+{
+  // make the new_size at least 64 bytes
+  new_size = block_size(std::max<std::size_t>(2*new_size, 64));
+
+  if (new_size > max_block_size && old_size > max_block_size) {
+    void* old_ptr = pointer;
+    pointer = std::realloc(pointer, new_size);
+    if (pointer == 0) {
+      std::free(old_ptr);
+      throw std::bad_alloc();
+    }
+    return new_size;
+  }
+
+  void* old_ptr = pointer;
+  pointer = this->allocate(new_size);
+  if (old_ptr) {
+    std::memcpy(pointer, old_ptr, old_size);
+    this->deallocate(old_ptr, old_size);
+  }
+  return new_size;
+}
+
+void
+pool_allocator::deallocate(void* pointer, std::size_t n)
+{
+  if (pointer == 0)
+    return;
+
+  if (n > max_block_size) {
+    std::free(pointer);
+    return;
+  }
+
+  unsigned c = size_class_of(n);
+  pool_thread_cache* cache = impl_->thread_cache();
+  free_block* block = static_cast<free_block*>(pointer);
+  block->next_ = cache->heads_[c];
+  cache->heads_[c] = block;
+
+  // keep at most two batches in the cache; blocks deallocated by a thread which never
+  // allocates from this size class eventually go back to the shared free list
+  unsigned n_batch = batch_size_of(c);
+  if (++cache->counts_[c] > 2*n_batch)
+    impl_->flush(cache, c, n_batch);
+}
+
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef POOL_ALLOCATOR_H_K2VQ8N5D
+#define POOL_ALLOCATOR_H_K2VQ8N5D
+
+#include "allocator.h"
+#include <cstddef>
+
+namespace mfast {
+
+struct pool_allocator_impl;
+
+/// A thread safe allocator which serves small memory blocks from a fixed set of size classes.
+///
+/// The size classes are multiples of sizeof(value_storage) up to 256 bytes, which covers the
+/// field arrays of most groups and sequence elements, followed by a few coarser classes up to
+/// max_block_size. Each thread keeps a cache of free blocks for every size class, so that
+/// allocate() and deallocate() normally need no synchronization. Blocks move between the thread
+/// caches and a shared free list in batches; therefore a block can be deallocated by a thread
+/// other than the one that allocated it. Requests larger than max_block_size are forwarded to
+/// malloc().
+///
+/// Memory used by the size classes is only returned to the system when the allocator is destroyed.
+/// The allocator must outlive all threads which have used it.
+class MFAST_EXPORT pool_allocator
+  : public allocator
+{
+  public:
+    pool_allocator();
+    ~pool_allocator();
+
+    virtual void* allocate(std::size_t n);
+    virtual std::size_t reallocate(void*& pointer, std::size_t old_size, std::size_t new_size);
+    virtual void deallocate(void* pointer, std::size_t n);
+
+    /// Returns the number of bytes actually reserved for a request of @a n bytes.
+    static std::size_t block_size(std::size_t n);
+
+    enum {
+      num_size_classes = 24,
+      max_block_size = 4096
+    };
+
+  private:
+    pool_allocator(const pool_allocator&);
+    pool_allocator& operator = (const pool_allocator&);
+
+    pool_allocator_impl* impl_;
+};
+
+}
+
+#endif /* end of include guard: POOL_ALLOCATOR_H_K2VQ8N5D */
@@ -17,7 +17,7 @@
 //     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include "mfast/sequence_ref.h"
-#include "mfast/allocator.h"
+#include "mfast/allocator_policy.h"
 
 namespace mfast {
 namespace detail {
@@ -33,9 +33,10 @@ void sequence_mref_helper::reserve(const sequence_field_instruction* instruction
     std::size_t reserve_size = n*element_size;
     
     std::size_t new_capacity_ = 
-      alloc->reallocate (storage->of_array.content_,
-                         storage->of_array.capacity_ * element_size,
-                         reserve_size)/element_size;
+      default_allocator_policy::reallocate(alloc,
+                                           storage->of_array.content_,
+                                           storage->of_array.capacity_ * element_size,
+                                           reserve_size)/element_size;
                          
     instruction->construct_sequence_elements (*storage, 
                                               storage->of_array.capacity_, 
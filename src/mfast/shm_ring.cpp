@@ -0,0 +1,349 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <boost/atomic.hpp>
+#include <boost/static_assert.hpp>
+#include "mfast/shm_ring.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define MFAST_HAS_SHM_RING
+#endif
+
+namespace mfast {
+
+namespace detail {
+
+// The ring is laid out as the header followed by slot_count slots of slot_stride bytes.
+// Each slot starts with a shm_slot_header followed by the snapshot.
+//
+// The sequence of a slot is 0 before its first use, 2n+1 while message n is being written
+// and 2n+2 after message n is completely written. The writer bumps write_sequence to n+1
+// after it completes message n.
+struct shm_ring_header
+{
+  boost::atomic<uint64_t> magic;
+  uint32_t version;
+  uint32_t slot_count;
+  uint64_t slot_size;
+  uint64_t slot_stride;
+  char padding1[32];
+  // keep the cursor, which is written for every message, on its own cache line
+  boost::atomic<uint64_t> write_sequence;
+  char padding2[56];
+};
+
+struct shm_slot_header
+{
+  boost::atomic<uint64_t> sequence;
+  boost::atomic<uint64_t> size;
+};
+
+}
+
+#ifdef MFAST_HAS_SHM_RING
+
+using detail::shm_ring_header;
+using detail::shm_slot_header;
+
+// The atomics are shared between processes, which only works if they do not use a lock.
+BOOST_STATIC_ASSERT(BOOST_ATOMIC_INT64_LOCK_FREE == 2);
+BOOST_STATIC_ASSERT(sizeof(shm_ring_header) == 128);
+
+namespace {
+
+const uint64_t ring_magic = UINT64_C(0x6D46415354524E47); // "mFASTRNG"
+const uint32_t ring_version = 1;
+const std::size_t cache_line_size = 64;
+
+inline std::size_t round_up(std::size_t n, std::size_t x)
+{
+  return (n + x - 1) & ~(x - 1);
+}
+
+void throw_system_error(const char* reason, const char* api)
+{
+  int error = errno;
+  BOOST_THROW_EXCEPTION(shm_ring_error(reason)
+                        << boost::errinfo_api_function(api)
+                        << boost::errinfo_errno(error));
+}
+
+inline shm_slot_header* slot_at(shm_ring_header* header, uint64_t sequence)
+{
+  char* slots = reinterpret_cast<char*>(header + 1);
+  return reinterpret_cast<shm_slot_header*>(slots + (sequence & (header->slot_count - 1)) * header->slot_stride);
+}
+
+inline const shm_slot_header* slot_at(const shm_ring_header* header, uint64_t sequence)
+{
+  return slot_at(const_cast<shm_ring_header*>(header), sequence);
+}
+
+inline char* slot_data(shm_slot_header* slot)
+{
+  return reinterpret_cast<char*>(slot + 1);
+}
+
+inline const char* slot_data(const shm_slot_header* slot)
+{
+  return reinterpret_cast<const char*>(slot + 1);
+}
+
+}
+
+shm_publisher::shm_publisher(const char* name, std::size_t slot_count, std::size_t slot_size)
+  : name_(name)
+  , header_(0)
+  , mapped_size_(0)
+{
+  if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0 || slot_count > 0xFFFFFFFFU)
+    BOOST_THROW_EXCEPTION(shm_ring_error("the slot count of a shared memory ring must be a power of two"));
+  if (slot_size < sizeof(snapshot_header))
+    BOOST_THROW_EXCEPTION(shm_ring_error("the slot size of a shared memory ring is too small"));
+
+  slot_size = round_up(slot_size, 8);
+  std::size_t stride = round_up(sizeof(shm_slot_header) + slot_size, cache_line_size);
+  mapped_size_ = sizeof(shm_ring_header) + slot_count * stride;
+
+  int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (fd == -1)
+    throw_system_error("unable to create the shared memory ring", "shm_open");
+
+  if (ftruncate(fd, static_cast<off_t>(mapped_size_)) == -1) {
+    int error = errno;
+    close(fd);
+    shm_unlink(name);
+    errno = error;
+    throw_system_error("unable to resize the shared memory ring", "ftruncate");
+  }
+
+  void* addr = mmap(0, mapped_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    int error = errno;
+    shm_unlink(name);
+    errno = error;
+    throw_system_error("unable to map the shared memory ring", "mmap");
+  }
+
+  // ftruncate() zero fills the object, so every slot starts with sequence 0
+  header_ = static_cast<shm_ring_header*>(addr);
+  header_->version = ring_version;
+  header_->slot_count = static_cast<uint32_t>(slot_count);
+  header_->slot_size = slot_size;
+  header_->slot_stride = stride;
+  header_->write_sequence.store(0, boost::memory_order_relaxed);
+  // readers only look at the rest of the header after they see the magic number
+  header_->magic.store(ring_magic, boost::memory_order_release);
+}
+
+shm_publisher::~shm_publisher()
+{
+  munmap(header_, mapped_size_);
+  shm_unlink(name_.c_str());
+}
+
+uint64_t shm_publisher::publish(const message_cref& message)
+{
+  uint64_t seq = header_->write_sequence.load(boost::memory_order_relaxed);
+  shm_slot_header* slot = slot_at(header_, seq);
+
+  slot->sequence.store(2*seq + 1, boost::memory_order_relaxed);
+  // the odd sequence must be visible before any byte of the new snapshot
+  boost::atomic_thread_fence(boost::memory_order_release);
+
+  std::size_t size = flatten(message, slot_data(slot), static_cast<std::size_t>(header_->slot_size));
+  slot->size.store(size, boost::memory_order_relaxed);
+
+  slot->sequence.store(2*seq + 2, boost::memory_order_release);
+  header_->write_sequence.store(seq + 1, boost::memory_order_release);
+  return seq;
+}
+
+uint64_t shm_publisher::published() const
+{
+  return header_->write_sequence.load(boost::memory_order_relaxed);
+}
+
+std::size_t shm_publisher::slot_count() const
+{
+  return header_->slot_count;
+}
+
+std::size_t shm_publisher::slot_size() const
+{
+  return static_cast<std::size_t>(header_->slot_size);
+}
+
+shm_subscriber::shm_subscriber(const char* name, bool replay)
+  : header_(0)
+  , mapped_size_(0)
+  , next_(0)
+  , current_(0)
+  , lost_(0)
+  , unflattened_(false)
+{
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd == -1)
+    throw_system_error("unable to open the shared memory ring", "shm_open");
+
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    throw_system_error("unable to open the shared memory ring", "fstat");
+  }
+
+  mapped_size_ = static_cast<std::size_t>(st.st_size);
+  if (mapped_size_ < sizeof(shm_ring_header)) {
+    close(fd);
+    BOOST_THROW_EXCEPTION(shm_ring_error("the shared memory object is not an initialized ring"));
+  }
+
+  void* addr = mmap(0, mapped_size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED)
+    throw_system_error("unable to map the shared memory ring", "mmap");
+
+  header_ = static_cast<const shm_ring_header*>(addr);
+  if (header_->magic.load(boost::memory_order_acquire) != ring_magic ||
+      header_->version != ring_version ||
+      mapped_size_ < sizeof(shm_ring_header) + header_->slot_count * header_->slot_stride)
+  {
+    munmap(addr, mapped_size_);
+    BOOST_THROW_EXCEPTION(shm_ring_error("the shared memory object is not an initialized ring"));
+  }
+
+  buffer_.resize(static_cast<std::size_t>(header_->slot_size / sizeof(uint64_t)));
+
+  next_ = header_->write_sequence.load(boost::memory_order_acquire);
+  if (replay)
+    next_ = next_ > header_->slot_count ? next_ - header_->slot_count : 0;
+}
+
+shm_subscriber::~shm_subscriber()
+{
+  munmap(const_cast<shm_ring_header*>(header_), mapped_size_);
+}
+
+bool shm_subscriber::next()
+{
+  const uint64_t slot_count = header_->slot_count;
+  const std::size_t slot_size = static_cast<std::size_t>(header_->slot_size);
+
+  for (;;) {
+    uint64_t written = header_->write_sequence.load(boost::memory_order_acquire);
+    if (next_ >= written)
+      return false;
+
+    if (written - next_ > slot_count) {
+      // the messages before written - slot_count are already overwritten
+      lost_ += written - slot_count - next_;
+      next_ = written - slot_count;
+    }
+
+    const shm_slot_header* slot = slot_at(header_, next_);
+    uint64_t expected = 2*next_ + 2;
+    if (slot->sequence.load(boost::memory_order_acquire) != expected) {
+      // the publisher has moved on to a later message in this slot
+      ++lost_;
+      ++next_;
+      continue;
+    }
+
+    std::size_t size = static_cast<std::size_t>(slot->size.load(boost::memory_order_relaxed));
+    std::memcpy(&buffer_[0], slot_data(slot), size < slot_size ? size : slot_size);
+    unflattened_ = false;
+
+    // the copy is only valid if the slot was not reused while it was copied
+    boost::atomic_thread_fence(boost::memory_order_acquire);
+    if (slot->sequence.load(boost::memory_order_relaxed) != expected) {
+      ++lost_;
+      ++next_;
+      continue;
+    }
+
+    current_ = next_++;
+    return true;
+  }
+}
+
+#else
+
+shm_publisher::shm_publisher(const char*, std::size_t, std::size_t)
+  : header_(0)
+  , mapped_size_(0)
+{
+  BOOST_THROW_EXCEPTION(shm_ring_error("shared memory rings are not supported on this platform"));
+}
+
+shm_publisher::~shm_publisher()
+{
+}
+
+uint64_t shm_publisher::publish(const message_cref&)
+{
+  return 0;
+}
+
+uint64_t shm_publisher::published() const
+{
+  return 0;
+}
+
+std::size_t shm_publisher::slot_count() const
+{
+  return 0;
+}
+
+std::size_t shm_publisher::slot_size() const
+{
+  return 0;
+}
+
+shm_subscriber::shm_subscriber(const char*, bool)
+  : header_(0)
+  , mapped_size_(0)
+  , next_(0)
+  , current_(0)
+  , lost_(0)
+  , unflattened_(false)
+{
+  BOOST_THROW_EXCEPTION(shm_ring_error("shared memory rings are not supported on this platform"));
+}
+
+shm_subscriber::~shm_subscriber()
+{
+}
+
+bool shm_subscriber::next()
+{
+  return false;
+}
+
+#endif
+
+}
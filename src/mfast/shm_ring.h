@@ -0,0 +1,193 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef SHM_RING_H_K5RW9PXD
+#define SHM_RING_H_K5RW9PXD
+
+#include <cassert>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <exception>
+#include <boost/exception/all.hpp>
+#include "mfast/mfast_export.h"
+#include "mfast/message_ref.h"
+#include "mfast/message_snapshot.h"
+
+namespace mfast {
+
+/// Thrown when a shared memory ring cannot be created or attached.
+///
+/// The failing system call and errno are attached as boost::errinfo_api_function and
+/// boost::errinfo_errno when available.
+class MFAST_EXPORT shm_ring_error
+  : public virtual boost::exception, public virtual std::exception
+{
+  public:
+    shm_ring_error(const char* reason)
+      : reason_(reason)
+    {
+    }
+
+    virtual const char* what() const throw()
+    {
+      return reason_;
+    }
+
+  private:
+    const char* reason_;
+};
+
+namespace detail {
+struct shm_ring_header;
+}
+
+/// Publishes messages to other processes through a POSIX shared memory ring.
+///
+/// Each message is written with flatten() into the next one of a fixed number of slots, so
+/// readers see it in the relocatable snapshot layout without decoding. There is a single
+/// writer, which never waits for readers: when the ring wraps around, the oldest message is
+/// overwritten. Every slot is guarded by a sequence lock, so a reader which falls behind
+/// detects the overwritten messages instead of reading torn data.
+///
+/// The class is only available on POSIX systems.
+class MFAST_EXPORT shm_publisher
+{
+  public:
+    /// Create the shared memory object @a name and map it.
+    ///
+    /// @param name The name passed to shm_open(), e.g. "/mfast_feed".
+    /// @param slot_count The number of messages kept in the ring; must be a power of two.
+    /// @param slot_size The maximum size of a message snapshot in bytes.
+    /// @throws shm_ring_error if the shared memory object cannot be created.
+    shm_publisher(const char* name, std::size_t slot_count, std::size_t slot_size);
+
+    /// Unmap and unlink the shared memory object; attached readers keep their mappings.
+    ~shm_publisher();
+
+    /// Write @a message into the next slot and make it visible to the readers.
+    ///
+    /// @returns The sequence number of the message, starting from 0.
+    /// @throws snapshot_overflow_error if the snapshot of @a message is larger than the slot
+    ///         size. The slot of the oldest message in the ring is discarded in this case.
+    uint64_t publish(const message_cref& message);
+
+    /// The number of messages published so far.
+    uint64_t published() const;
+
+    std::size_t slot_count() const;
+    std::size_t slot_size() const;
+
+  private:
+    shm_publisher(const shm_publisher&);
+    shm_publisher& operator = (const shm_publisher&);
+
+    std::string name_;
+    detail::shm_ring_header* header_;
+    std::size_t mapped_size_;
+};
+
+/// Reads the messages of a shm_publisher from another process.
+///
+/// A subscriber copies each message out of the ring into a private buffer and validates the
+/// copy against the sequence lock of the slot, so the message stays readable after the
+/// publisher reuses the slot. No memory is allocated after construction.
+class MFAST_EXPORT shm_subscriber
+{
+  public:
+    /// Attach to the ring created by a shm_publisher with the same @a name.
+    ///
+    /// @param replay If true, start with the oldest message still in the ring; otherwise
+    ///        start with the next message to be published.
+    /// @throws shm_ring_error if the shared memory object does not exist or is not a ring.
+    shm_subscriber(const char* name, bool replay = false);
+    ~shm_subscriber();
+
+    /// Move to the next message.
+    ///
+    /// @returns false if no new message has been published yet.
+    bool next();
+
+    /// The sequence number of the current message.
+    uint64_t sequence() const
+    {
+      return current_;
+    }
+
+    /// The template id of the current message.
+    uint32_t template_id() const
+    {
+      return snapshot_message_cref::template_id(snapshot());
+    }
+
+    /// The snapshot of the current message, which stays valid until next() or message() is
+    /// called.
+    const void* snapshot() const
+    {
+      return &buffer_[0];
+    }
+
+    /// The current message as a snapshot; @a instruction must be the template with
+    /// template_id(). Must not be called after message() for the same message.
+    snapshot_message_cref snapshot_message(const template_instruction* instruction) const
+    {
+      assert(!unflattened_);
+      return snapshot_message_cref(snapshot(), instruction);
+    }
+
+    /// The current message, which stays valid until next() is called.
+    ///
+    /// The first call for a message turns the copy of its snapshot into the storage of the
+    /// message in place with unflatten(); no memory is allocated.
+    ///
+    /// @param instruction The template with template_id().
+    /// @param templates The templates of the dynamic nested messages, if any.
+    message_cref message(const template_instruction*  instruction,
+                         const templates_description* templates = 0)
+    {
+      void* block = &buffer_[0];
+      if (unflattened_)
+        return message_cref(reinterpret_cast<const value_storage*>(static_cast<char*>(block) + sizeof(snapshot_header)),
+                            instruction);
+      unflattened_ = true;
+      return unflatten(block, instruction, templates);
+    }
+
+    /// The number of messages which were overwritten before this subscriber could read them.
+    uint64_t lost() const
+    {
+      return lost_;
+    }
+
+  private:
+    shm_subscriber(const shm_subscriber&);
+    shm_subscriber& operator = (const shm_subscriber&);
+
+    const detail::shm_ring_header* header_;
+    std::size_t mapped_size_;
+    uint64_t next_;
+    uint64_t current_;
+    uint64_t lost_;
+    bool unflattened_;  // message() has rebased buffer_
+    // uint64_t elements keep the copied snapshot aligned to 8 bytes
+    std::vector<uint64_t> buffer_;
+};
+
+}
+
+#endif /* end of include guard: SHM_RING_H_K5RW9PXD */
@@ -0,0 +1,168 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef TEXT_FORMAT_H_X4PZ7HAE
+#define TEXT_FORMAT_H_X4PZ7HAE
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+
+namespace mfast {
+
+/// The maximum number of characters written by format_integer().
+const std::size_t max_integer_text_size = 20;
+
+/// The maximum number of characters written by format_decimal().
+///
+/// The value is reached by a negative 19 digits mantissa with exponent 127.
+const std::size_t max_decimal_text_size = 147;
+
+namespace detail {
+
+// Defined as a static member of a class template so that it can be
+// defined in this header without violating the one definition rule.
+template <typename T>
+struct digit_pairs
+{
+  static const char table[201];
+};
+
+template <typename T>
+const char digit_pairs<T>::table[201] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+// Write the digits of v so that they end right before last; returns the position of the first digit.
+inline char* format_digits_backward(uint64_t v, char* last)
+{
+  const char* table = digit_pairs<void>::table;
+  while (v >= 100) {
+    std::size_t index = static_cast<std::size_t>(v % 100) * 2;
+    v /= 100;
+    *--last = table[index+1];
+    *--last = table[index];
+  }
+  if (v >= 10) {
+    std::size_t index = static_cast<std::size_t>(v) * 2;
+    *--last = table[index+1];
+    *--last = table[index];
+  }
+  else {
+    *--last = static_cast<char>('0' + v);
+  }
+  return last;
+}
+
+// The magnitude is computed in unsigned arithmetic so that the minimum value of int64_t is handled.
+inline uint64_t magnitude(int64_t v)
+{
+  return v < 0 ? 0 - static_cast<uint64_t>(v) : static_cast<uint64_t>(v);
+}
+
+}
+
+/// Write the decimal text of @a value into @a buf without a terminating null.
+///
+/// @param[out] buf The destination; it must have room for max_integer_text_size characters.
+/// @returns The number of characters written.
+inline std::size_t format_integer(uint64_t value, char* buf)
+{
+  char digits[max_integer_text_size];
+  char* end = digits + max_integer_text_size;
+  char* first = detail::format_digits_backward(value, end);
+  std::size_t len = end - first;
+  std::memcpy(buf, first, len);
+  return len;
+}
+
+inline std::size_t format_integer(int64_t value, char* buf)
+{
+  std::size_t sign = 0;
+  if (value < 0)
+    buf[sign++] = '-';
+  return sign + format_integer(detail::magnitude(value), buf + sign);
+}
+
+inline std::size_t format_integer(uint32_t value, char* buf)
+{
+  return format_integer(static_cast<uint64_t>(value), buf);
+}
+
+inline std::size_t format_integer(int32_t value, char* buf)
+{
+  return format_integer(static_cast<int64_t>(value), buf);
+}
+
+/// Write the exact value of mantissa * 10^exponent in plain decimal notation, e.g. "-0.05"
+/// or "1200", into @a buf without a terminating null.
+///
+/// @param[out] buf The destination; it must have room for max_decimal_text_size characters.
+/// @returns The number of characters written.
+inline std::size_t format_decimal(int64_t mantissa, int8_t exponent, char* buf)
+{
+  char digits[max_integer_text_size];
+  char* end = digits + max_integer_text_size;
+  char* first = detail::format_digits_backward(detail::magnitude(mantissa), end);
+  std::size_t num_digits = end - first;
+
+  char* out = buf;
+  if (mantissa < 0)
+    *out++ = '-';
+
+  if (exponent >= 0) {
+    std::memcpy(out, first, num_digits);
+    out += num_digits;
+    if (mantissa != 0) {
+      std::memset(out, '0', exponent);
+      out += exponent;
+    }
+  }
+  else {
+    std::size_t scale = -exponent;
+    if (num_digits > scale) {
+      std::size_t int_digits = num_digits - scale;
+      std::memcpy(out, first, int_digits);
+      out += int_digits;
+      *out++ = '.';
+      std::memcpy(out, first + int_digits, scale);
+      out += scale;
+    }
+    else {
+      *out++ = '0';
+      *out++ = '.';
+      std::memset(out, '0', scale - num_digits);
+      out += scale - num_digits;
+      std::memcpy(out, first, num_digits);
+      out += num_digits;
+    }
+  }
+  return out - buf;
+}
+
+}
+
+#endif /* end of include guard: TEXT_FORMAT_H_X4PZ7HAE */
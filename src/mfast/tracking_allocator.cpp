@@ -0,0 +1,174 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "tracking_allocator.h"
+#include "field_instruction.h"
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+namespace mfast {
+
+tracking_allocator::counters::counters()
+  : allocate_calls(0)
+  , allocate_bytes(0)
+  , reallocate_calls(0)
+  , reallocate_bytes(0)
+  , deallocate_calls(0)
+  , deallocate_bytes(0)
+{
+}
+
+tracking_allocator::counters&
+tracking_allocator::counters::operator += (const counters& other)
+{
+  allocate_calls += other.allocate_calls;
+  allocate_bytes += other.allocate_bytes;
+  reallocate_calls += other.reallocate_calls;
+  reallocate_bytes += other.reallocate_bytes;
+  deallocate_calls += other.deallocate_calls;
+  deallocate_bytes += other.deallocate_bytes;
+  return *this;
+}
+
+tracking_allocator::tracking_allocator(allocator* underlying)
+  : underlying_(underlying)
+  , context_(static_cast<const template_instruction*>(0), static_cast<const field_instruction*>(0))
+  , current_(0)
+{
+}
+
+tracking_allocator::counters&
+tracking_allocator::current()
+{
+  // the lookup is done on the first request after a context change rather than in
+  // context(), which is called far more often than the allocator
+  if (current_ == 0)
+    current_ = &counters_[context_];
+  return *current_;
+}
+
+void*
+tracking_allocator::allocate(std::size_t n)
+{
+  void* result = underlying_->allocate(n);
+  counters& c = current();
+  ++c.allocate_calls;
+  c.allocate_bytes += n;
+  return result;
+}
+
+std::size_t
+tracking_allocator::reallocate(void*& pointer, std::size_t old_size, std::size_t new_size)
+{
+  std::size_t result = underlying_->reallocate(pointer, old_size, new_size);
+  counters& c = current();
+  ++c.reallocate_calls;
+  c.reallocate_bytes += result;
+  return result;
+}
+
+void
+tracking_allocator::deallocate(void* pointer, std::size_t n)
+{
+  underlying_->deallocate(pointer, n);
+  counters& c = current();
+  ++c.deallocate_calls;
+  c.deallocate_bytes += n;
+}
+
+bool
+tracking_allocator::reset()
+{
+  return underlying_->reset();
+}
+
+tracking_allocator::counters
+tracking_allocator::total() const
+{
+  counters result;
+  counters_map::const_iterator itr;
+  for (itr = counters_.begin(); itr != counters_.end(); ++itr)
+    result += itr->second;
+  return result;
+}
+
+void
+tracking_allocator::clear()
+{
+  counters_.clear();
+  current_ = 0;
+}
+
+namespace {
+
+bool more_reallocations(const tracking_allocator::counters_map::value_type* lhs,
+                        const tracking_allocator::counters_map::value_type* rhs)
+{
+  if (lhs->second.reallocate_calls != rhs->second.reallocate_calls)
+    return lhs->second.reallocate_calls > rhs->second.reallocate_calls;
+  return lhs->second.allocate_calls > rhs->second.allocate_calls;
+}
+
+void report_row(std::ostream&                      os,
+                const char*                        template_name,
+                const char*                        field_name,
+                const tracking_allocator::counters& c)
+{
+  os << std::left  << std::setw(24) << template_name << ' '
+     << std::setw(24) << field_name
+     << std::right << std::setw(12) << c.allocate_calls
+     << std::setw(14) << c.allocate_bytes
+     << std::setw(12) << c.reallocate_calls
+     << std::setw(14) << c.reallocate_bytes
+     << std::setw(12) << c.deallocate_calls
+     << std::setw(14) << c.deallocate_bytes << '\n';
+}
+
+}
+
+void
+tracking_allocator::report(std::ostream& os) const
+{
+  std::vector<const counters_map::value_type*> rows;
+  counters_map::const_iterator itr;
+  for (itr = counters_.begin(); itr != counters_.end(); ++itr)
+    rows.push_back(&*itr);
+  std::stable_sort(rows.begin(), rows.end(), more_reallocations);
+
+  os << std::left  << std::setw(24) << "template" << ' '
+     << std::setw(24) << "field"
+     << std::right << std::setw(12) << "allocate"
+     << std::setw(14) << "bytes"
+     << std::setw(12) << "reallocate"
+     << std::setw(14) << "bytes"
+     << std::setw(12) << "deallocate"
+     << std::setw(14) << "bytes" << '\n';
+
+  for (std::size_t i = 0; i < rows.size(); ++i) {
+    const context_type& ctx = rows[i]->first;
+    report_row(os,
+               ctx.first ? ctx.first->name() : "-",
+               ctx.second ? ctx.second->name() : "-",
+               rows[i]->second);
+  }
+  report_row(os, "total", "", total());
+}
+
+}
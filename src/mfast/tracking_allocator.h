@@ -0,0 +1,110 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef TRACKING_ALLOCATOR_H_W6C3ZR1M
+#define TRACKING_ALLOCATOR_H_W6C3ZR1M
+
+#include "allocator.h"
+#include <map>
+#include <iosfwd>
+#include <stdint.h>
+
+namespace mfast {
+
+class field_instruction;
+class template_instruction;
+
+/// An allocator which forwards every request to another allocator and keeps count of them.
+///
+/// The counts are attributed to the template and field set by context(), which is normally
+/// updated by fast_decoder through an allocation_tracking_hook. This makes it possible to find
+/// the fields whose vectors or sequences keep growing with reallocate().
+///
+/// This class is not thread safe.
+class MFAST_EXPORT tracking_allocator
+  : public allocator
+{
+  public:
+    struct counters
+    {
+      uint64_t allocate_calls;
+      uint64_t allocate_bytes;
+      uint64_t reallocate_calls;
+      uint64_t reallocate_bytes;
+      uint64_t deallocate_calls;
+      uint64_t deallocate_bytes;
+
+      counters();
+      counters& operator += (const counters& other);
+    };
+
+    typedef std::pair<const template_instruction*, const field_instruction*> context_type;
+    typedef std::map<context_type, counters> counters_map;
+
+    /// @param underlying The allocator which actually serves the memory requests.
+    explicit tracking_allocator(allocator* underlying);
+
+    virtual void* allocate(std::size_t n);
+    virtual std::size_t reallocate(void*& pointer, std::size_t old_size, std::size_t new_size);
+    virtual void deallocate(void* pointer, std::size_t n);
+    virtual bool reset();
+
+    /// Set the template and field subsequent requests are attributed to; either can be 0.
+    void context(const template_instruction* templ, const field_instruction* field);
+
+    /// Returns the counters of every template and field which has made a request.
+    const counters_map& per_context() const;
+
+    /// Returns the sum of all counters.
+    counters total() const;
+
+    /// Write the counters as a table sorted by the number of reallocate() calls.
+    ///
+    /// The template and field names are read from the recorded instructions; therefore,
+    /// this must be called before the decoder owning those instructions is destroyed.
+    void report(std::ostream& os) const;
+
+    /// Discard all counters.
+    void clear();
+
+  private:
+    counters& current();
+
+    allocator* underlying_;
+    context_type context_;
+    counters_map counters_;
+    counters* current_;
+};
+
+inline void
+tracking_allocator::context(const template_instruction* templ, const field_instruction* field)
+{
+  context_.first = templ;
+  context_.second = field;
+  current_ = 0;
+}
+
+inline const tracking_allocator::counters_map&
+tracking_allocator::per_context() const
+{
+  return counters_;
+}
+
+}
+
+#endif /* end of include guard: TRACKING_ALLOCATOR_H_W6C3ZR1M */
@@ -24,7 +24,7 @@
 #include <vector>
 #include <limits>
 #include "mfast/field_ref.h"
-#include "mfast/allocator.h"
+#include "mfast/allocator_policy.h"
 namespace mfast {
 
 namespace detail {
@@ -425,13 +425,13 @@ const
 
   if (capacity() > 0) {
     this->storage()->of_array.capacity_
-      = this->alloc_->reallocate(this->storage()->of_array.content_, capacity(), reserve_size);
+      = default_allocator_policy::reallocate(this->alloc_, this->storage()->of_array.content_, capacity(), reserve_size);
   }
   else {
     void* old_addr = this->storage()->of_array.content_;
     this->storage()->of_array.content_ = 0;
     this->storage()->of_array.capacity_
-      = this->alloc_->reallocate(this->storage()->of_array.content_, 0, reserve_size);
+      = default_allocator_policy::reallocate(this->alloc_, this->storage()->of_array.content_, 0, reserve_size);
     // Copy the old content to the new buffer.
     // In the case when the this->capacity == 0 && this->size() > 0,
     // reserve() could be invoked with n < this->size(). Thus, we can
@@ -17,6 +17,8 @@
 //     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <mfast/arena_allocator.h>
+#include <mfast/allocator_policy.h>
+#include <mfast/malloc_allocator.h>
 #define BOOST_TEST_DYN_LINK
 #include <boost/test/test_tools.hpp>
 #include <boost/test/unit_test.hpp>
@@ -58,4 +60,84 @@ BOOST_AUTO_TEST_CASE(arena_allocatore_test)
   memset(block7, 0, 3*arena_allocator::default_chunk_size);
 }
 
+BOOST_AUTO_TEST_CASE(arena_allocator_config_test)
+{
+  arena_allocator alloc(64*1024, 256*1024);
+
+  arena_allocator::statistics stats = alloc.stats();
+  BOOST_CHECK_EQUAL(stats.num_chunks, 1U);
+  BOOST_CHECK_EQUAL(stats.reserved_bytes, 256U*1024);
+
+  // the initial reservation is used before any new chunk is obtained
+  void* block1 = alloc.allocate(200*1024);
+  memset(block1, 0, 200*1024);
+  BOOST_CHECK_EQUAL(alloc.stats().num_chunks, 1U);
+
+  alloc.allocate(100*1024);
+  stats = alloc.stats();
+  BOOST_CHECK_EQUAL(stats.num_chunks, 2U);
+  BOOST_CHECK_EQUAL(stats.reserved_bytes, 256U*1024 + 128*1024);
+  BOOST_CHECK_EQUAL(stats.allocated_bytes, 300U*1024);
+
+  alloc.reset();
+  alloc.allocate(1024);
+  stats = alloc.stats();
+  BOOST_CHECK_EQUAL(stats.num_resets, 1U);
+  BOOST_CHECK_EQUAL(stats.allocated_bytes, 1024U);
+  BOOST_CHECK_EQUAL(stats.peak_allocated_bytes, 300U*1024);
+}
+
+BOOST_AUTO_TEST_CASE(arena_allocator_huge_pages_test)
+{
+  // falls back to regular pages when huge pages are not available
+  arena_allocator alloc(arena_allocator::default_chunk_size, 0, true);
+  void* block = alloc.allocate(3*arena_allocator::default_chunk_size);
+  memset(block, 0, 3*arena_allocator::default_chunk_size);
+  alloc.reset();
+  BOOST_CHECK_EQUAL(alloc.allocate(16), block);
+}
+
+BOOST_AUTO_TEST_CASE(arena_allocator_numa_test)
+{
+  // falls back to first-touch placement when the node cannot be determined or bound
+  arena_allocator alloc(64*1024, 64*1024, false, arena_allocator::numa_node_of_current_thread());
+  void* block = alloc.allocate(3*64*1024);
+  memset(block, 0, 3*64*1024);
+  BOOST_CHECK_EQUAL(alloc.stats().num_chunks, 2U);
+}
+
+BOOST_AUTO_TEST_CASE(arena_allocator_owns_test)
+{
+  arena_allocator alloc;
+  int local = 0;
+  void* block = alloc.allocate(3*arena_allocator::default_chunk_size);
+  BOOST_CHECK(alloc.owns(block));
+  BOOST_CHECK(alloc.owns(static_cast<char*>(block) + 10));
+  BOOST_CHECK(!alloc.owns(&local));
+  alloc.reset();
+  BOOST_CHECK(!alloc.owns(block));
+}
+
+BOOST_AUTO_TEST_CASE(arena_allocator_policy_test)
+{
+  arena_allocator arena;
+  allocator* alloc = &arena;
+  BOOST_CHECK(alloc->type_tag() == &arena_allocator::class_tag);
+  BOOST_CHECK(malloc_allocator::instance()->type_tag() == 0);
+
+  void* block = default_allocator_policy::allocate(alloc, 10);
+  BOOST_CHECK_EQUAL(arena.stats().allocated_bytes, 16U);
+
+  std::size_t capacity = allocator_policy<arena_allocator>::reallocate(alloc, block, 16, 100);
+  BOOST_CHECK_EQUAL(capacity, 256U);
+  BOOST_CHECK_EQUAL(arena.stats().allocated_bytes, 16U+256U);
+
+  // other allocators fall back to the virtual interface
+  alloc = malloc_allocator::instance();
+  block = allocator_policy<arena_allocator>::allocate(alloc, 10);
+  BOOST_CHECK(block != 0);
+  alloc->deallocate(block, 10);
+  BOOST_CHECK_EQUAL(arena.stats().allocated_bytes, 16U+256U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
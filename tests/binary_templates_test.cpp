@@ -0,0 +1,222 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <mfast.h>
+#include <mfast/coder/dynamic_templates_description.h>
+#include <mfast/coder/binary_templates_description.h>
+#include <mfast/coder/fast_encoder.h>
+#include <mfast/coder/fast_decoder.h>
+#include <mfast/json/json_encoder.h>
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "test2.h"
+
+using namespace mfast;
+
+namespace {
+
+const char* xml_content =
+  "<?xml version=\"1.0\"?>\n"
+  "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+  "templateNs=\"http://www.ociweb.com/ns/templates/binary\" dictionary=\"template\">\n"
+  "<template name=\"Quote\" id=\"1\" reset=\"yes\">\n"
+  "  <typeRef name=\"QuoteType\"/>\n"
+  "  <int32 name=\"i32\" id=\"10\"><copy value=\"-5\"/></int32>\n"
+  "  <uInt32 name=\"u32\"><constant value=\"7\"/></uInt32>\n"
+  "  <int64 name=\"i64\" presence=\"optional\"><delta/></int64>\n"
+  "  <uInt64 name=\"u64\"><increment key=\"counter\" dictionary=\"global\"/></uInt64>\n"
+  "  <decimal name=\"px\"><copy value=\"1.25\"/></decimal>\n"
+  "  <decimal name=\"qty\" presence=\"optional\"><exponent><copy/></exponent>"
+  "<mantissa><delta value=\"100\"/></mantissa></decimal>\n"
+  "  <string name=\"sym\" capacity=\"8\"><copy value=\"IBM\"/></string>\n"
+  "  <string name=\"text\" charset=\"unicode\"><length name=\"textLen\" id=\"20\"/></string>\n"
+  "  <byteVector name=\"data\" presence=\"optional\"/>\n"
+  "  <group name=\"grp\" presence=\"optional\"><uInt32 name=\"g1\"/></group>\n"
+  "  <sequence name=\"seq\" capacity=\"4\"><length name=\"n\" id=\"30\"/><string name=\"e1\"/></sequence>\n"
+  "</template>\n"
+  "<template name=\"Wrapper\" id=\"2\">\n"
+  "  <group name=\"quote\"><templateRef name=\"Quote\"/></group>\n"
+  "  <templateRef/>\n"
+  "</template>\n"
+  "</templates>\n";
+
+std::string binary_of(const templates_description& description)
+{
+  std::ostringstream strm;
+  write_binary_templates(strm, description);
+  return strm.str();
+}
+
+std::string json_of(const message_cref& msg)
+{
+  std::ostringstream strm;
+  json::encode(strm, msg);
+  return strm.str();
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( test_binary_templates )
+
+BOOST_AUTO_TEST_CASE(binary_templates_round_trip_test)
+{
+  dynamic_templates_description description(xml_content);
+  std::string binary = binary_of(description);
+
+  binary_templates_description loaded(binary.data(), binary.size());
+  BOOST_CHECK_EQUAL(binary_of(loaded), binary);
+
+  BOOST_CHECK_EQUAL(loaded.size(), 2U);
+  BOOST_CHECK(std::strcmp(loaded.template_ns(), "http://www.ociweb.com/ns/templates/binary") == 0);
+  BOOST_CHECK(std::strcmp(loaded.dictionary(), "template") == 0);
+
+  const template_instruction* quote = loaded.instruction_with_id(1);
+  BOOST_REQUIRE(quote);
+  BOOST_CHECK(quote->has_reset_attribute());
+  BOOST_CHECK(std::strcmp(quote->typeref_name_, "QuoteType") == 0);
+  BOOST_CHECK_EQUAL(quote->subinstructions_count(), 11U);
+
+  const int32_field_instruction* i32 = static_cast<const int32_field_instruction*>(quote->subinstruction(0));
+  BOOST_CHECK_EQUAL(i32->id(), 10U);
+  BOOST_CHECK_EQUAL(i32->field_operator(), operator_copy);
+  BOOST_CHECK_EQUAL(i32->initial_value().get<int32_t>(), -5);
+
+  const uint64_field_instruction* u64 = static_cast<const uint64_field_instruction*>(quote->subinstruction(3));
+  BOOST_REQUIRE(u64->op_context());
+  BOOST_CHECK(std::strcmp(u64->op_context()->key_, "counter") == 0);
+  BOOST_CHECK(std::strcmp(u64->op_context()->dictionary_, "global") == 0);
+
+  const decimal_field_instruction* qty = static_cast<const decimal_field_instruction*>(quote->subinstruction(5));
+  BOOST_CHECK_EQUAL(qty->field_type(), field_type_exponent);
+  BOOST_REQUIRE(qty->mantissa_instruction());
+  BOOST_CHECK_EQUAL(qty->mantissa_instruction()->field_operator(), operator_delta);
+  BOOST_CHECK_EQUAL(qty->mantissa_instruction()->initial_value().get<int64_t>(), 100);
+
+  const ascii_field_instruction* sym = static_cast<const ascii_field_instruction*>(quote->subinstruction(6));
+  BOOST_CHECK_EQUAL(sym->capacity(), 8U);
+  BOOST_CHECK_EQUAL(sym->initial_value().array_length(), 3U);
+  BOOST_CHECK(std::memcmp(sym->initial_value().of_array.content_, "IBM", 3) == 0);
+  // the strings are used in place
+  BOOST_CHECK(sym->name() >= binary.data() && sym->name() < binary.data() + binary.size());
+
+  const unicode_field_instruction* text = static_cast<const unicode_field_instruction*>(quote->subinstruction(7));
+  BOOST_CHECK_EQUAL(text->length_id(), 20U);
+  BOOST_CHECK(std::strcmp(text->length_name(), "textLen") == 0);
+
+  const sequence_field_instruction* seq = static_cast<const sequence_field_instruction*>(quote->subinstruction(10));
+  BOOST_CHECK_EQUAL(seq->capacity(), 4U);
+  BOOST_CHECK_EQUAL(seq->length_instruction()->id(), 30U);
+  BOOST_CHECK_EQUAL(seq->find_subinstruction_index_by_name("e1"), 0);
+
+  const template_instruction* wrapper = loaded.instruction_with_id(2);
+  BOOST_REQUIRE(wrapper);
+  const templateref_instruction* static_ref = static_cast<const templateref_instruction*>(
+    static_cast<const group_field_instruction*>(wrapper->subinstruction(0))->subinstruction(0));
+  BOOST_CHECK(static_ref->is_static());
+  BOOST_CHECK(!static_cast<const templateref_instruction*>(wrapper->subinstruction(1))->is_static());
+}
+
+BOOST_AUTO_TEST_CASE(binary_templates_coding_test)
+{
+  dynamic_templates_description description(xml_content);
+  std::string binary = binary_of(description);
+  binary_templates_description loaded(binary.data(), binary.size());
+
+  fast_encoder encoder;
+  const templates_description* xml_descriptions[] = { &description };
+  encoder.include(xml_descriptions);
+
+  fast_decoder decoder;
+  const templates_description* binary_descriptions[] = { &loaded };
+  decoder.include(binary_descriptions);
+
+  message_type msg(malloc_allocator::instance(), encoder.template_with_id(1));
+  message_mref mref = msg.mref();
+  mref[0].as(11);
+  mref[2].as(-3);
+  mref[3].as(1);
+  decimal_mref(mref[4]).as(125, -2);
+  decimal_mref(mref[5]).as(300, -2);
+  ascii_string_mref(mref[6]).as("MSFT");
+  unicode_string_mref(mref[7]).as("abc");
+  sequence_mref seq(mref[10]);
+  seq.resize(2);
+  ascii_string_mref(seq[0][0]).as("A");
+  ascii_string_mref(seq[1][0]).as("B");
+
+  char buffer[256];
+  std::size_t encoded_size = encoder.encode(mref, buffer, sizeof(buffer), true);
+
+  const char* first = buffer;
+  message_cref decoded = decoder.decode(first, buffer + encoded_size, true);
+  BOOST_CHECK_EQUAL(first, buffer + encoded_size);
+  BOOST_CHECK_EQUAL(json_of(decoded), json_of(msg.cref()));
+}
+
+BOOST_AUTO_TEST_CASE(binary_templates_generated_test)
+{
+  // generated descriptions, with static templateRefs bound to their targets
+  std::string binary = binary_of(*test2::description());
+  binary_templates_description loaded(binary.data(), binary.size());
+  BOOST_CHECK_EQUAL(binary_of(loaded), binary);
+}
+
+BOOST_AUTO_TEST_CASE(binary_templates_file_test)
+{
+  dynamic_templates_description description(xml_content);
+  std::string binary = binary_of(description);
+
+  const char* filename = "binary_templates_test.mft";
+  {
+    std::ofstream output(filename, std::ios::binary);
+    output.write(binary.data(), binary.size());
+  }
+
+  {
+    binary_templates_description loaded(filename);
+    BOOST_CHECK_EQUAL(binary_of(loaded), binary);
+  }
+  std::remove(filename);
+
+  BOOST_CHECK_THROW(binary_templates_description("no_such_file.mft"), binary_templates_error);
+}
+
+BOOST_AUTO_TEST_CASE(binary_templates_error_test)
+{
+  dynamic_templates_description description(xml_content);
+  std::string binary = binary_of(description);
+
+  BOOST_CHECK_THROW(binary_templates_description(binary.data(), binary.size() - 1), binary_templates_error);
+  BOOST_CHECK_THROW(binary_templates_description(binary.data(), 4), binary_templates_error);
+
+  std::string bad_magic = binary;
+  bad_magic[0] = 'X';
+  BOOST_CHECK_THROW(binary_templates_description(bad_magic.data(), bad_magic.size()), binary_templates_error);
+
+  std::string trailing = binary + '\0';
+  BOOST_CHECK_THROW(binary_templates_description(trailing.data(), trailing.size()), binary_templates_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
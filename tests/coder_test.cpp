@@ -21,6 +21,7 @@
 #include <mfast/coder/dynamic_templates_description.h>
 #include <mfast/coder/fast_encoder.h>
 #include <mfast/coder/fast_decoder.h>
+#include <mfast/coder/common/exceptions.h>
 
 #define BOOST_TEST_DYN_LINK
 #include <boost/test/test_tools.hpp>
@@ -335,4 +336,454 @@ BOOST_AUTO_TEST_CASE(auto_reset_coder_test)
 }
 
 
+BOOST_AUTO_TEST_CASE(generation_decoder_test)
+{
+  dynamic_templates_description description(
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<uInt32 name=\"field2\" id=\"12\"><copy/></uInt32>\n"
+    "<uInt32 name=\"field3\" id=\"13\"><copy/></uInt32>\n"
+    "</template>\n"
+    "</templates>\n");
+
+  const templates_description* descriptions[] = { &description };
+  fast_decoder decoder;
+  decoder.use_generations(2);
+  decoder.include(descriptions);
+
+  const char stream[] = "\xB8\x81\x82\x83\xB8\x84\x85\x86\x80";
+  const char* first = stream;
+  const char* last = stream + sizeof(stream) - 1;
+
+  fast_decoder::generation_handle handle1, handle2, handle3;
+  message_cref msg1 = decoder.decode(first, last, false, handle1);
+  message_cref msg2 = decoder.decode(first, last, false, handle2);
+  BOOST_CHECK_NE(handle1, handle2);
+  BOOST_CHECK_EQUAL(decoder.free_generations(), 0U);
+
+  // both messages are still valid
+  BOOST_CHECK_EQUAL(uint32_cref(msg1[0]).value(), 1U);
+  BOOST_CHECK_EQUAL(uint32_cref(msg2[0]).value(), 4U);
+
+  const char* saved = first;
+  BOOST_CHECK_THROW(decoder.decode(first, last, false, handle3), generation_unavailable_error);
+  BOOST_CHECK(first == saved);
+
+  decoder.release(handle1);
+  message_cref msg3 = decoder.decode(first, last, false, handle3);
+  BOOST_CHECK_EQUAL(handle3, handle1);
+  BOOST_CHECK_EQUAL(uint32_cref(msg3[2]).value(), 6U);
+  BOOST_CHECK_EQUAL(uint32_cref(msg2[2]).value(), 6U);
+  BOOST_CHECK(first == last);
+}
+
+BOOST_AUTO_TEST_CASE(generation_dictionary_test)
+{
+  dynamic_templates_description description(
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test1\" id=\"1\">\n"
+    "<string name=\"field1\" id=\"11\"><copy/></string>\n"
+    "</template>\n"
+    "<template name=\"Test2\" id=\"2\">\n"
+    "<string name=\"field2\" id=\"12\"><copy/></string>\n"
+    "</template>\n"
+    "</templates>\n");
+
+  const templates_description* descriptions[] = { &description };
+  fast_encoder encoder;
+  encoder.include(descriptions);
+
+  // field1 of the last message is copied from the first message, whose generation
+  // has been reused by the messages in between.
+  std::vector<char> buffer;
+  for (int i = 0; i < 6; ++i) {
+    uint32_t id = (i == 0 || i == 5) ? 1 : 2;
+    message_type message(malloc_allocator::instance(), encoder.template_with_id(id));
+    ascii_string_mref(message.mref()[0]).as(id == 1 ? "a fairly long string value"
+                                                    : "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX");
+    encoder.encode(message.cref(), buffer, i == 0);
+  }
+
+  fast_decoder decoder;
+  decoder.use_generations(2);
+  decoder.include(descriptions);
+
+  const char* first = &buffer[0];
+  const char* last = first + buffer.size();
+  for (int i = 0; i < 6; ++i) {
+    fast_decoder::generation_handle handle;
+    message_cref msg = decoder.decode(first, last, false, handle);
+    if (i == 5) {
+      BOOST_CHECK_EQUAL(msg.id(), 1U);
+      BOOST_CHECK_EQUAL(std::string(ascii_string_cref(msg[0]).c_str()), std::string("a fairly long string value"));
+    }
+    decoder.release(handle);
+  }
+  BOOST_CHECK(first == last);
+}
+
+BOOST_AUTO_TEST_CASE(deferred_build_decoder_test)
+{
+  dynamic_templates_description description(
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<uInt32 name=\"field2\" id=\"12\"><copy/></uInt32>\n"
+    "<uInt32 name=\"field3\" id=\"13\"><copy/></uInt32>\n"
+    "</template>\n"
+    "</templates>\n");
+
+  const templates_description* descriptions[] = { &description };
+  fast_decoder decoder;
+  decoder.defer_build(true);
+  decoder.include(descriptions);
+
+  const char stream[] = "\xB8\x81\x82\x83";
+  const char* first = stream;
+  message_cref msg = decoder.decode(first, stream + sizeof(stream) - 1);
+  BOOST_CHECK_EQUAL(uint32_cref(msg[0]).value(), 1U);
+  BOOST_CHECK_EQUAL(uint32_cref(msg[2]).value(), 3U);
+}
+
+BOOST_AUTO_TEST_CASE(numa_node_decoder_test)
+{
+  dynamic_templates_description description(
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<uInt32 name=\"field2\" id=\"12\"><copy/></uInt32>\n"
+    "<uInt32 name=\"field3\" id=\"13\"><copy/></uInt32>\n"
+    "</template>\n"
+    "</templates>\n");
+
+  int node = arena_allocator::numa_node_of_current_thread();
+
+  const templates_description* descriptions[] = { &description };
+  fast_decoder decoder;
+  decoder.numa_node(node < 0 ? 0 : node);
+  decoder.use_generations(2);
+  decoder.include(descriptions);
+
+  const char stream[] = "\xB8\x81\x82\x83";
+  const char* first = stream;
+  fast_decoder::generation_handle handle;
+  message_cref msg = decoder.decode(first, stream + sizeof(stream) - 1, false, handle);
+  BOOST_CHECK_EQUAL(uint32_cref(msg[0]).value(), 1U);
+  BOOST_CHECK_EQUAL(uint32_cref(msg[2]).value(), 3U);
+  decoder.release(handle);
+}
+
+BOOST_AUTO_TEST_CASE(template_update_test)
+{
+  dynamic_templates_description description1(
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<string name=\"field2\" id=\"12\"><copy/></string>\n"
+    "</template>\n"
+    "</templates>\n");
+
+  // Test is unchanged and Other is added
+  dynamic_templates_description description2(
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<string name=\"field2\" id=\"12\"><copy/></string>\n"
+    "</template>\n"
+    "<template name=\"Other\" id=\"2\">\n"
+    "<uInt32 name=\"field3\" id=\"13\"><copy/></uInt32>\n"
+    "</template>\n"
+    "</templates>\n");
+
+  const templates_description* descriptions1[] = { &description1 };
+  const templates_description* descriptions2[] = { &description2 };
+
+  fast_encoder encoder;
+  encoder.include(descriptions1);
+  fast_decoder decoder;
+  decoder.include(descriptions1);
+
+  std::vector<char> buffer;
+  {
+    message_type message(malloc_allocator::instance(), encoder.template_with_id(1));
+    message.mref()[0].as(1);
+    ascii_string_mref(message.mref()[1]).as("abc");
+    encoder.encode(message.cref(), buffer);
+  }
+  BOOST_CHECK_EQUAL(encoder.template_with_id(2), (const template_instruction*)0);
+
+  const char* first = &buffer[0];
+  decoder.decode(first, first + buffer.size());
+
+  encoder.update(descriptions2);
+  decoder.update(descriptions2);
+
+  // the dictionary values of Test are carried over; both fields are copied
+  buffer.clear();
+  {
+    message_type message(malloc_allocator::instance(), encoder.template_with_id(1));
+    message.mref()[0].as(1);
+    ascii_string_mref(message.mref()[1]).as("abc");
+    encoder.encode(message.cref(), buffer);
+  }
+  BOOST_CHECK_EQUAL(buffer.size(), 1U);
+  BOOST_CHECK(encoder.template_with_id(2));
+
+  std::size_t offset = buffer.size();
+  {
+    message_type message(malloc_allocator::instance(), encoder.template_with_id(2));
+    message.mref()[0].as(7);
+    encoder.encode(message.cref(), buffer);
+  }
+
+  first = &buffer[0];
+  const char* last = first + buffer.size();
+  message_cref msg = decoder.decode(first, last);
+  BOOST_CHECK_EQUAL(first, &buffer[0] + offset);
+  BOOST_CHECK_EQUAL(msg.id(), 1U);
+  BOOST_CHECK_EQUAL(uint32_cref(msg[0]).value(), 1U);
+  BOOST_CHECK_EQUAL(std::string(ascii_string_cref(msg[1]).c_str()), std::string("abc"));
+
+  message_cref other = decoder.decode(first, last);
+  BOOST_CHECK_EQUAL(other.id(), 2U);
+  BOOST_CHECK_EQUAL(uint32_cref(other[0]).value(), 7U);
+  BOOST_CHECK(first == last);
+
+  // a message built before an update stays valid after the switch; the templates between
+  // the ones in effect and the newest are freed without ever being used
+  {
+    message_type message(malloc_allocator::instance(), encoder.template_with_id(2));
+    message.mref()[0].as(8);
+    encoder.update(descriptions1);
+    encoder.update(descriptions2);
+    BOOST_CHECK(encoder.template_with_id(2));
+    BOOST_CHECK_EQUAL(uint32_cref(message.cref()[0]).value(), 8U);
+  }
+  encoder.update(descriptions1);
+  BOOST_CHECK_EQUAL(encoder.template_with_id(2), (const template_instruction*)0);
+
+  // Test has a different layout
+  dynamic_templates_description description3(
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<string name=\"field2\" id=\"12\"><copy/></string>\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<uInt32 name=\"field4\" id=\"14\"><copy/></uInt32>\n"
+    "</template>\n"
+    "</templates>\n");
+  const templates_description* descriptions3[] = { &description3 };
+
+  // a message built before an update can be encoded as long as the layout of its template
+  // is unchanged, and is rejected otherwise
+  {
+    message_type message(malloc_allocator::instance(), encoder.template_with_id(1));
+    message.mref()[0].as(2);
+    ascii_string_mref(message.mref()[1]).as("def");
+    encoder.update(descriptions2);
+    buffer.clear();
+    BOOST_CHECK_NO_THROW(encoder.encode(message.cref(), buffer));
+    BOOST_CHECK(!buffer.empty());
+  }
+  {
+    message_type message(malloc_allocator::instance(), encoder.template_with_id(1));
+    message.mref()[0].as(2);
+    ascii_string_mref(message.mref()[1]).as("def");
+    encoder.update(descriptions3);
+    buffer.clear();
+    BOOST_CHECK_THROW(encoder.encode(message.cref(), buffer), fast_dynamic_error);
+  }
+  {
+    message_type message(malloc_allocator::instance(), encoder.template_with_id(1));
+    ascii_string_mref(message.mref()[0]).as("ghi");
+    message.mref()[1].as(3);
+    message.mref()[2].as(4);
+    buffer.clear();
+    BOOST_CHECK_NO_THROW(encoder.encode(message.cref(), buffer));
+    BOOST_CHECK(!buffer.empty());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(generation_template_update_test)
+{
+  dynamic_templates_description description1(
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<string name=\"field1\" id=\"11\"><copy/></string>\n"
+    "</template>\n"
+    "</templates>\n");
+
+  dynamic_templates_description description2(
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<string name=\"field1\" id=\"11\"><copy/></string>\n"
+    "</template>\n"
+    "<template name=\"Other\" id=\"2\">\n"
+    "<string name=\"field2\" id=\"12\"><copy/></string>\n"
+    "</template>\n"
+    "</templates>\n");
+
+  const templates_description* descriptions1[] = { &description1 };
+  const templates_description* descriptions2[] = { &description2 };
+
+  fast_encoder encoder;
+  encoder.include(descriptions2);
+
+  std::vector<char> buffer;
+  const uint32_t ids[] = { 1, 1, 2, 1 };
+  for (int i = 0; i < 4; ++i) {
+    message_type message(malloc_allocator::instance(), encoder.template_with_id(ids[i]));
+    ascii_string_mref(message.mref()[0]).as(ids[i] == 1 ? "copied value" : "other");
+    encoder.encode(message.cref(), buffer);
+  }
+
+  fast_decoder decoder;
+  decoder.use_generations(2);
+  decoder.include(descriptions1);
+
+  const char* first = &buffer[0];
+  const char* last = first + buffer.size();
+  fast_decoder::generation_handle handle1, handle2;
+  message_cref msg1 = decoder.decode(first, last, false, handle1);
+
+  decoder.update(descriptions2);
+
+  // the message decoded before the update is still valid while its generation is held
+  message_cref msg2 = decoder.decode(first, last, false, handle2);
+  BOOST_CHECK_EQUAL(std::string(ascii_string_cref(msg1[0]).c_str()), std::string("copied value"));
+  BOOST_CHECK_EQUAL(std::string(ascii_string_cref(msg2[0]).c_str()), std::string("copied value"));
+  decoder.release(handle1);
+  decoder.release(handle2);
+
+  for (int i = 2; i < 4; ++i) {
+    fast_decoder::generation_handle handle;
+    message_cref msg = decoder.decode(first, last, false, handle);
+    BOOST_CHECK_EQUAL(msg.id(), ids[i]);
+    BOOST_CHECK_EQUAL(std::string(ascii_string_cref(msg[0]).c_str()),
+                      std::string(ids[i] == 1 ? "copied value" : "other"));
+    decoder.release(handle);
+  }
+  BOOST_CHECK(first == last);
+}
+
+
+namespace {
+
+class counting_hook
+  : public decoder_hook
+{
+  public:
+    counting_hook()
+      : fields_(0)
+    {
+    }
+
+    virtual void template_begin(const template_instruction*)
+    {
+    }
+
+    virtual void field_begin(const field_instruction*)
+    {
+      ++fields_;
+    }
+
+    std::size_t fields_;
+};
+
+}
+
+BOOST_AUTO_TEST_CASE(compiled_template_decoder_test)
+{
+  dynamic_templates_description description(
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<int64 name=\"field2\" id=\"12\"><delta/></int64>\n"
+    "<decimal name=\"field3\" id=\"13\"><copy/></decimal>\n"
+    "<string name=\"field4\" id=\"14\"><delta/></string>\n"
+    "<group name=\"group1\" presence=\"optional\">\n"
+    "<uInt32 name=\"field5\" id=\"15\"><increment/></uInt32>\n"
+    "</group>\n"
+    "<sequence name=\"sequence1\">\n"
+    "<byteVector name=\"field6\" id=\"16\"/>\n"
+    "<int32 name=\"field7\" id=\"17\"><default value=\"5\"/></int32>\n"
+    "</sequence>\n"
+    "</template>\n"
+    "</templates>\n");
+
+  const templates_description* descriptions[] = { &description };
+  fast_encoder encoder;
+  encoder.include(descriptions);
+
+  std::vector<message_type*> messages;
+  std::vector<char> buffer;
+  for (int i = 0; i < 3; ++i) {
+    message_type* message = new message_type(malloc_allocator::instance(), encoder.template_with_id(1));
+    message_mref mref = message->mref();
+    mref[0].as(10);
+    mref[1].as(-1000 + i);
+    decimal_mref(mref[2]).as(125 + i, -2);
+    ascii_string_mref(mref[3]).as(i == 1 ? "abcd" : "abc");
+    group_mref group(mref[4]);
+    if (i != 1) {
+      group.as_present();
+      group[0].as(i);
+    }
+    else {
+      group.as_absent();
+    }
+    sequence_mref seq(mref[5]);
+    seq.resize(i);
+    for (int j = 0; j < i; ++j) {
+      const unsigned char bytes[] = { 1, 2, 3 };
+      byte_vector_mref(seq[j][0]).assign(bytes, bytes + j + 1);
+      seq[j][1].as(j == 0 ? 5 : j);
+    }
+    encoder.encode(message->cref(), buffer);
+    messages.push_back(message);
+  }
+
+  // a decoder with a hook decodes with the field visitor instead of the compiled templates
+  fast_decoder compiled;
+  compiled.include(descriptions);
+  fast_decoder visited;
+  visited.include(descriptions);
+  counting_hook hook;
+  visited.hook(&hook);
+
+  const char* first = &buffer[0];
+  const char* visited_first = &buffer[0];
+  const char* last = first + buffer.size();
+  for (std::size_t i = 0; i < messages.size(); ++i) {
+    message_cref msg = compiled.decode(first, last);
+    message_cref expected = visited.decode(visited_first, last);
+    BOOST_CHECK_EQUAL(first, visited_first);
+    BOOST_CHECK(msg == expected);
+    BOOST_CHECK(msg == messages[i]->cref());
+    delete messages[i];
+  }
+  BOOST_CHECK(first == last);
+  BOOST_CHECK(hook.fields_ > 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
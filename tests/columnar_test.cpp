@@ -0,0 +1,146 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <mfast.h>
+#include <mfast/columnar.h>
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "debug_allocator.h"
+
+using namespace mfast;
+
+BOOST_AUTO_TEST_SUITE( columnar_test_suite )
+
+BOOST_AUTO_TEST_CASE(sequence_columns_test)
+{
+  debug_allocator alloc;
+
+  uint32_field_instruction seq_num_inst(0, operator_none, presence_mandatory, 1, "MsgSeqNum", "", 0, int_value_storage<uint32_t>());
+
+  ascii_field_instruction symbol_inst(0, operator_none, presence_mandatory, 3, "Symbol", "", 0, string_value_storage());
+  decimal_field_instruction px_inst(1, operator_none, presence_optional, 4, "MDEntryPx", "", 0, decimal_value_storage());
+  int32_field_instruction size_inst(2, operator_none, presence_optional, 5, "MDEntrySize", "", 0, int_value_storage<int32_t>());
+  uint32_field_instruction length_inst(0, operator_none, presence_mandatory, 6, "NoMDEntries", "", 0, int_value_storage<uint32_t>());
+  const field_instruction* entry_instructions[] = { &symbol_inst, &px_inst, &size_inst };
+  sequence_field_instruction entries_inst(1, presence_mandatory, 2, "MDEntries", "", "", entry_instructions, 3, &length_inst);
+
+  const field_instruction* instructions[] = { &seq_num_inst, &entries_inst };
+  template_instruction templ(10, "MDIncRefresh", "", "", "", instructions, 2, false);
+
+  message_type message(&alloc, &templ);
+  message_mref mref = message.mref();
+  sequence_mref entries(mref[1]);
+  entries.resize(3);
+  for (uint32_t i = 0; i < 3; ++i) {
+    ascii_string_mref(entries[i][0]).as(i == 1 ? "IBM" : "MSFT");
+    if (i != 1)
+      decimal_mref(entries[i][1]).as(2500 + i, -2);
+    int32_mref(entries[i][2]).as(100 * (i+1));
+  }
+
+  column_batch entry_batch(&entries_inst);
+  BOOST_CHECK_EQUAL(entry_batch.num_columns(), 3U);
+  entry_batch.append(sequence_cref(entries));
+  entry_batch.append(sequence_cref(entries));
+  BOOST_CHECK_EQUAL(entry_batch.num_rows(), 6U);
+
+  BOOST_CHECK_EQUAL(entry_batch.column_index_with_name("MDEntryPx"), 1);
+  const column& px = entry_batch[1];
+  BOOST_CHECK_EQUAL(px.size(), 6U);
+  BOOST_CHECK_EQUAL(px.null_count(), 2U);
+  BOOST_CHECK(!px.is_null(0));
+  BOOST_CHECK(px.is_null(1));
+  BOOST_CHECK(px.is_null(4));
+  BOOST_CHECK_EQUAL(px.null_bitmap()[0], 0x2D); // rows 0, 2, 3 and 5
+  BOOST_CHECK_EQUAL(px.mantissas()[2], 2502);
+  BOOST_CHECK_EQUAL(px.exponents()[2], -2);
+  BOOST_CHECK_EQUAL(px.mantissas()[1], 0);
+  BOOST_CHECK(px.decimal_value(3) == fixed_decimal(25, 0));
+
+  // aggregation over a column is a contiguous loop
+  const column& size = entry_batch[2];
+  const int32_t* sizes = size.values<int32_t>();
+  int64_t total = 0;
+  for (std::size_t i = 0; i < size.size(); ++i)
+    total += sizes[i];
+  BOOST_CHECK_EQUAL(total, 1200);
+  BOOST_CHECK_EQUAL(size.null_count(), 0U);
+
+  const column& symbol = entry_batch[0];
+  BOOST_CHECK_EQUAL(symbol.offsets()[0], 0U);
+  BOOST_CHECK_EQUAL(symbol.offsets()[1], 4U);
+  BOOST_CHECK_EQUAL(symbol.offsets()[2], 7U);
+  BOOST_CHECK_EQUAL(std::string(symbol.chars() + symbol.offsets()[1], symbol.chars() + symbol.offsets()[2]), "IBM");
+  BOOST_CHECK_EQUAL(symbol.offsets()[6], 22U);
+
+  // messages become rows, and a sequence column records the number of elements of each row
+  column_batch message_batch(&templ);
+  uint32_mref(mref[0]).as(7);
+  message_batch.append(message.cref());
+  uint32_mref(mref[0]).as(8);
+  entries.resize(1);
+  message_batch.append(message.cref());
+  BOOST_CHECK_EQUAL(message_batch.num_rows(), 2U);
+  BOOST_CHECK_EQUAL(message_batch[0].values<uint32_t>()[1], 8U);
+  BOOST_CHECK_EQUAL(message_batch[1].values<uint32_t>()[0], 3U);
+  BOOST_CHECK_EQUAL(message_batch[1].values<uint32_t>()[1], 1U);
+
+  // a cleared batch keeps its columns and can be refilled
+  entry_batch.clear();
+  BOOST_CHECK_EQUAL(entry_batch.num_rows(), 0U);
+  BOOST_CHECK_EQUAL(entry_batch[1].null_count(), 0U);
+  entry_batch.append(sequence_cref(entries));
+  BOOST_CHECK_EQUAL(entry_batch.num_rows(), 1U);
+  BOOST_CHECK_EQUAL(entry_batch[0].offsets()[1], 4U);
+}
+
+BOOST_AUTO_TEST_CASE(split_decimal_column_test)
+{
+  debug_allocator alloc;
+
+  // a decimal with separate exponent and mantissa operators has field_type_exponent
+  mantissa_field_instruction mantissa_inst(operator_delta, 0, int_value_storage<int64_t>());
+  decimal_field_instruction px_inst(0, operator_copy, presence_optional, 1, "MDEntryPx", "", 0, &mantissa_inst);
+  BOOST_CHECK_EQUAL(px_inst.field_type(), field_type_exponent);
+
+  const field_instruction* instructions[] = { &px_inst };
+  template_instruction templ(10, "Price", "", "", "", instructions, 1, false);
+
+  message_type message(&alloc, &templ);
+  message_mref mref = message.mref();
+  column_batch batch(&templ);
+  decimal_mref(mref[0]).as(12345, -2);
+  batch.append(message.cref());
+  decimal_mref(mref[0]).as_absent();
+  batch.append(message.cref());
+  decimal_mref(mref[0]).as(7, 1);
+  batch.append(message.cref());
+
+  const column& px = batch[0];
+  BOOST_CHECK_EQUAL(px.size(), 3U);
+  BOOST_CHECK_EQUAL(px.null_count(), 1U);
+  BOOST_CHECK(px.is_null(1));
+  BOOST_CHECK_EQUAL(px.mantissas()[0], 12345);
+  BOOST_CHECK_EQUAL(px.exponents()[0], -2);
+  BOOST_CHECK_EQUAL(px.mantissas()[1], 0);
+  BOOST_CHECK(px.decimal_value(2) == fixed_decimal(70, 0));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,279 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <mfast.h>
+#include <mfast/columnar_writer.h>
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "debug_allocator.h"
+
+using namespace mfast;
+
+namespace {
+
+// Reads the records of a columnar file.
+class columnar_file_reader
+{
+  public:
+    columnar_file_reader(const std::string& path)
+      : pos_(0)
+    {
+      std::ifstream file(path.c_str(), std::ios::binary);
+      data_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    bool empty() const
+    {
+      return data_.empty();
+    }
+
+    std::string bytes(std::size_t n)
+    {
+      std::string result(&data_[pos_], n);
+      pos_ += n;
+      return result;
+    }
+
+    uint32_t u32()
+    {
+      uint32_t v;
+      std::memcpy(&v, &data_[pos_], sizeof(v));
+      pos_ += sizeof(v);
+      return v;
+    }
+
+    uint64_t u64()
+    {
+      uint64_t v;
+      std::memcpy(&v, &data_[pos_], sizeof(v));
+      pos_ += sizeof(v);
+      return v;
+    }
+
+    // returns the content of a buffer and skips its padding
+    std::string buffer()
+    {
+      std::size_t n = static_cast<std::size_t>(u64());
+      std::string result = bytes(n);
+      pos_ += (8 - (n & 7)) & 7;
+      return result;
+    }
+
+    bool at_end() const
+    {
+      return pos_ == data_.size();
+    }
+
+  private:
+    std::vector<char> data_;
+    std::size_t pos_;
+};
+
+}
+
+BOOST_AUTO_TEST_SUITE( columnar_writer_test_suite )
+
+BOOST_AUTO_TEST_CASE(columnar_exporter_test)
+{
+  debug_allocator alloc;
+
+  uint32_field_instruction seq_num_inst(0, operator_none, presence_mandatory, 1, "MsgSeqNum", "", 0, int_value_storage<uint32_t>());
+  ascii_field_instruction symbol_inst(0, operator_none, presence_mandatory, 3, "Symbol", "", 0, string_value_storage());
+  decimal_field_instruction px_inst(1, operator_none, presence_optional, 4, "MDEntryPx", "", 0, decimal_value_storage());
+  uint32_field_instruction length_inst(0, operator_none, presence_mandatory, 5, "NoMDEntries", "", 0, int_value_storage<uint32_t>());
+  const field_instruction* entry_instructions[] = { &symbol_inst, &px_inst };
+  sequence_field_instruction entries_inst(1, presence_mandatory, 2, "MDEntries", "", "", entry_instructions, 2, &length_inst);
+
+  const field_instruction* instructions[] = { &seq_num_inst, &entries_inst };
+  template_instruction templ(10, "MDIncRefresh", "", "", "", instructions, 2, false);
+
+  std::string prefix = "columnar_writer_test_";
+  {
+    columnar_exporter exporter(prefix, 2, 2);
+    message_type message(&alloc, &templ);
+    message_mref mref = message.mref();
+    for (uint32_t i = 0; i < 5; ++i) {
+      uint32_mref(mref[0]).as(i);
+      sequence_mref entries(mref[1]);
+      entries.resize(i % 3);
+      for (uint32_t j = 0; j < entries.size(); ++j) {
+        ascii_string_mref(entries[j][0]).as("IBM");
+        decimal_mref(entries[j][1]).as(100 * i + j, -2);
+      }
+      exporter.append(message.cref());
+    }
+    exporter.finish();
+    BOOST_CHECK_EQUAL(exporter.num_tables(), 2U);
+  }
+
+  // the parent table has 5 rows in chunks of 2, 2 and 1
+  {
+    columnar_file_reader reader(prefix + "MDIncRefresh-10.mfc");
+    BOOST_REQUIRE(!reader.empty());
+    BOOST_CHECK_EQUAL(reader.bytes(8), std::string("MFCOL1\0\0", 8));
+    BOOST_CHECK_EQUAL(reader.buffer(), "MDIncRefresh");
+    BOOST_CHECK_EQUAL(reader.u64(), 2U);
+    BOOST_CHECK_EQUAL(reader.u32(), static_cast<uint32_t>(field_type_uint32));
+    BOOST_CHECK_EQUAL(reader.u32(), 0U);
+    BOOST_CHECK_EQUAL(reader.buffer(), "MsgSeqNum");
+    BOOST_CHECK_EQUAL(reader.u32(), static_cast<uint32_t>(field_type_sequence));
+    BOOST_CHECK_EQUAL(reader.u32(), 0U);
+    BOOST_CHECK_EQUAL(reader.buffer(), "MDEntries");
+
+    const uint32_t expected_lengths[] = { 0, 1, 2, 0, 1 };
+    uint32_t row = 0;
+    for (int chunk = 0; chunk < 3; ++chunk) {
+      BOOST_CHECK_EQUAL(reader.bytes(4), "CHNK");
+      reader.u32();
+      std::size_t n = static_cast<std::size_t>(reader.u64());
+      BOOST_CHECK_EQUAL(n, chunk < 2 ? 2U : 1U);
+
+      reader.buffer(); // validity of MsgSeqNum
+      std::string seq_nums = reader.buffer();
+      reader.buffer(); // validity of MDEntries
+      std::string lengths = reader.buffer();
+      BOOST_REQUIRE_EQUAL(seq_nums.size(), n * 4);
+      for (std::size_t i = 0; i < n; ++i, ++row) {
+        uint32_t v;
+        std::memcpy(&v, seq_nums.data() + i * 4, 4);
+        BOOST_CHECK_EQUAL(v, row);
+        std::memcpy(&v, lengths.data() + i * 4, 4);
+        BOOST_CHECK_EQUAL(v, expected_lengths[row]);
+      }
+    }
+    BOOST_CHECK_EQUAL(reader.bytes(4), std::string("END\0", 4));
+    BOOST_CHECK_EQUAL(reader.u32(), 3U);
+    BOOST_CHECK_EQUAL(reader.u64(), 5U);
+    BOOST_CHECK(reader.at_end());
+  }
+
+  // the child table has one row per sequence element; the elements of a sequence are
+  // never split across chunks, so the first chunk holds the 3 elements of messages 1 and 2
+  {
+    columnar_file_reader reader(prefix + "MDIncRefresh-10.MDEntries.mfc");
+    BOOST_REQUIRE(!reader.empty());
+    reader.bytes(8);
+    BOOST_CHECK_EQUAL(reader.buffer(), "MDIncRefresh.MDEntries");
+    BOOST_CHECK_EQUAL(reader.u64(), 2U);
+    for (int i = 0; i < 2; ++i) {
+      reader.u32();
+      reader.u32();
+      reader.buffer();
+    }
+
+    const int64_t expected_mantissas[] = { 100, 200, 201, 400 };
+    std::size_t row = 0;
+    while (reader.bytes(4) == "CHNK") {
+      reader.u32();
+      std::size_t n = static_cast<std::size_t>(reader.u64());
+      reader.buffer(); // validity of Symbol
+      std::string offsets = reader.buffer();
+      std::string chars = reader.buffer();
+      std::string expected_chars;
+      for (std::size_t i = 0; i < n; ++i)
+        expected_chars += "IBM";
+      BOOST_CHECK_EQUAL(chars, expected_chars);
+      BOOST_CHECK_EQUAL(offsets.size(), (n + 1) * 4);
+      std::string validity = reader.buffer();
+      BOOST_CHECK_EQUAL(static_cast<unsigned char>(validity[0]), (1U << n) - 1);
+      std::string mantissas = reader.buffer();
+      std::string exponents = reader.buffer();
+      BOOST_REQUIRE_EQUAL(mantissas.size(), n * 8);
+      for (std::size_t i = 0; i < n; ++i, ++row) {
+        int64_t m;
+        std::memcpy(&m, mantissas.data() + i * 8, 8);
+        BOOST_CHECK_EQUAL(m, expected_mantissas[row]);
+        BOOST_CHECK_EQUAL(static_cast<int>(exponents[i]), -2);
+      }
+    }
+    BOOST_CHECK_EQUAL(reader.u32(), 2U);
+    BOOST_CHECK_EQUAL(reader.u64(), 4U);
+    BOOST_CHECK(reader.at_end());
+  }
+
+  std::remove((prefix + "MDIncRefresh-10.mfc").c_str());
+  std::remove((prefix + "MDIncRefresh-10.MDEntries.mfc").c_str());
+}
+
+BOOST_AUTO_TEST_CASE(columnar_exporter_template_id_test)
+{
+  debug_allocator alloc;
+
+  uint32_field_instruction seq_num_inst(0, operator_none, presence_mandatory, 1, "MsgSeqNum", "", 0, int_value_storage<uint32_t>());
+  const field_instruction* instructions[] = { &seq_num_inst };
+  template_instruction templ(10, "Quote/Trade", "", "", "", instructions, 1, false);
+  // the same template after an update of the decoder
+  template_instruction updated_templ(10, "Quote/Trade", "", "", "", instructions, 1, false);
+  // another template with the same name
+  template_instruction other_templ(11, "Quote/Trade", "", "", "", instructions, 1, false);
+
+  ascii_field_instruction symbol_inst(0, operator_none, presence_mandatory, 2, "Symbol", "", 0, string_value_storage());
+  const field_instruction* changed_instructions[] = { &symbol_inst };
+  template_instruction changed_templ(10, "Quote/Trade", "", "", "", changed_instructions, 1, false);
+
+  std::string prefix = "columnar_writer_test_";
+  {
+    columnar_exporter exporter(prefix, 1, 1);
+    const template_instruction* templates[] = { &templ, &updated_templ, &other_templ };
+    for (uint32_t i = 0; i < 3; ++i) {
+      message_type message(&alloc, templates[i]);
+      uint32_mref(message.mref()[0]).as(i);
+      exporter.append(message.cref());
+    }
+    BOOST_CHECK_EQUAL(exporter.num_tables(), 2U);
+
+    message_type changed(&alloc, &changed_templ);
+    BOOST_CHECK_THROW(exporter.append(changed.cref()), columnar_schema_error);
+    exporter.finish();
+  }
+
+  // the rows of both instructions of template 10 are in the same file
+  const char* files[] = { "Quote_Trade-10.mfc", "Quote_Trade-11.mfc" };
+  const uint64_t num_rows[] = { 2, 1 };
+  for (int i = 0; i < 2; ++i) {
+    columnar_file_reader reader(prefix + files[i]);
+    BOOST_REQUIRE(!reader.empty());
+    reader.bytes(8);
+    BOOST_CHECK_EQUAL(reader.buffer(), "Quote/Trade");
+    BOOST_CHECK_EQUAL(reader.u64(), 1U);
+    reader.u32();
+    reader.u32();
+    reader.buffer();
+    for (uint64_t r = 0; r < num_rows[i]; ++r) {
+      BOOST_CHECK_EQUAL(reader.bytes(4), "CHNK");
+      reader.u32();
+      BOOST_CHECK_EQUAL(reader.u64(), 1U);
+      reader.buffer();
+      reader.buffer();
+    }
+    BOOST_CHECK_EQUAL(reader.bytes(4), std::string("END\0", 4));
+    reader.u32();
+    BOOST_CHECK_EQUAL(reader.u64(), num_rows[i]);
+    BOOST_CHECK(reader.at_end());
+    std::remove((prefix + files[i]).c_str());
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -63,6 +63,9 @@ BOOST_AUTO_TEST_CASE(int_test)
   BOOST_CHECK(encode_integer(INT32_C(-7942755), false, "\x7c\x1b\x1b\x9d"));
   BOOST_CHECK(encode_integer(INT32_C(8193), false, "\x00\x40\x81"));
   BOOST_CHECK(encode_integer(INT32_C(-8193), false, "\x7F\x3f\xff"));
+  BOOST_CHECK(encode_integer(INT32_C(-1), false, "\xff"));
+  BOOST_CHECK(encode_integer(INT64_C(-1), true, "\xff"));
+  BOOST_CHECK(encode_integer(std::numeric_limits<int64_t>::min(), false, "\x7f\x00\x00\x00\x00\x00\x00\x00\x00\x80"));
 
   BOOST_CHECK(encode_integer(UINT32_C(0), true, "\x81"));
   BOOST_CHECK(encode_integer(UINT32_C(1), true, "\x82"));
@@ -18,10 +18,13 @@
 //
 #include "test1.h"
 #include "test2.h"
+#include "test4.h"
 #define BOOST_TEST_DYN_LINK
 #include <boost/test/test_tools.hpp>
 #include <boost/test/unit_test.hpp>
 #include "debug_allocator.h"
+#include <mfast/tracking_allocator.h>
+#include <boost/static_assert.hpp>
 
 boost::test_tools::predicate_result
 equal_string(const char* value, const char* str)
@@ -46,6 +49,80 @@ equal_string(T value, const char* str)
   return res;
 }
 
+// Records the names of the visited fields, "name{...}" for groups and "name[...]" for sequences.
+template <int VisitAbsent>
+struct field_name_recorder
+{
+  enum {
+    visit_absent = VisitAbsent
+  };
+
+  std::string names;
+
+  template <typename PrimitiveTypeRef>
+  void visit(const PrimitiveTypeRef& ref)
+  {
+    names += ref.name();
+    names += ' ';
+  }
+
+  void visit(const test4::FlatSample_cref::info_cref& ref, int)
+  {
+    names += "info{ ";
+    ref.for_each_field(*this);
+    names += "} ";
+  }
+
+  void visit(const test4::FlatSample_cref::entries_cref& ref, int)
+  {
+    names += "entries[ ";
+    for (std::size_t i = 0; i < ref.size(); ++i)
+      ref[i].for_each_field(*this);
+    names += "] ";
+  }
+};
+
+// Sets every uint32 and uint64 field to a value.
+struct integer_setter
+{
+  enum {
+    visit_absent = 1
+  };
+
+  integer_setter(uint32_t v)
+    : value(v)
+  {
+  }
+
+  uint32_t value;
+
+  void visit(const mfast::uint32_mref& ref)
+  {
+    ref.as(value);
+  }
+
+  void visit(const mfast::uint64_mref& ref)
+  {
+    ref.as(value);
+  }
+
+  template <typename PrimitiveTypeRef>
+  void visit(const PrimitiveTypeRef&)
+  {
+  }
+
+  template <typename CompositeTypeRef>
+  void visit(const CompositeTypeRef&, int)
+  {
+  }
+
+  void visit(const test4::FlatSample_mref::entries_mref& ref, int)
+  {
+    for (std::size_t i = 0; i < ref.size(); ++i)
+      ref[i].for_each_field(*this);
+  }
+};
+
 BOOST_AUTO_TEST_SUITE( fast_type_gen_test_suite )
 
 BOOST_AUTO_TEST_CASE(MDRefreshSample_test)
@@ -127,4 +204,125 @@ BOOST_AUTO_TEST_CASE(MDRefreshSample_test)
   
 }
 
+BOOST_AUTO_TEST_CASE(for_each_field_test)
+{
+  debug_allocator alloc;
+  test4::FlatSample sample(&alloc);
+  test4::FlatSample_mref mref = sample.mref();
+  mref.set_symbol().as("ABC");
+  mref.set_price().as(12345, -2);
+  mref.set_entries().resize(2);
+  mref.set_entries()[1].set_text().as("second");
+
+  field_name_recorder<0> present_fields;
+  sample.cref().for_each_field(present_fields);
+  BOOST_CHECK_EQUAL(present_fields.names, "id symbol price entries[ size size text ] ");
+
+  field_name_recorder<1> all_fields;
+  sample.cref().for_each_field(all_fields);
+  BOOST_CHECK_EQUAL(all_fields.names, "id symbol change price info{ code data } entries[ size text size text ] ");
+
+  integer_setter setter(42);
+  mref.for_each_field(setter);
+  BOOST_CHECK_EQUAL(sample.cref().get_id().value(), 42U);
+  BOOST_CHECK_EQUAL(sample.cref().get_entries()[0].get_size().value(), 42U);
+  BOOST_CHECK_EQUAL(sample.cref().get_entries()[1].get_size().value(), 42U);
+  BOOST_CHECK(!sample.cref().get_change().present());
+}
+
+BOOST_AUTO_TEST_CASE(field_constants_test)
+{
+  typedef test4::FlatSample_cref sample_cref;
+  BOOST_STATIC_ASSERT(sample_cref::id_field::index == 0);
+  BOOST_STATIC_ASSERT(sample_cref::entries_field::index == 5);
+  BOOST_STATIC_ASSERT(sample_cref::change_field::field_operator == mfast::operator_delta);
+  BOOST_STATIC_ASSERT(sample_cref::change_field::optional);
+  BOOST_STATIC_ASSERT(!sample_cref::id_field::has_initial_value);
+
+  const mfast::template_instruction* inst = test4::FlatSample::instruction();
+  const mfast::field_instruction* id_inst = inst->subinstruction(sample_cref::id_field::index);
+  BOOST_CHECK_EQUAL(id_inst->field_type(), sample_cref::id_field::field_type);
+  BOOST_CHECK_EQUAL(id_inst->field_operator(), sample_cref::id_field::field_operator);
+  BOOST_CHECK_EQUAL(inst->subinstruction(sample_cref::price_field::index)->field_type(), sample_cref::price_field::field_type);
+  BOOST_CHECK_EQUAL(inst->subinstruction(sample_cref::info_field::index)->field_type(), sample_cref::info_field::field_type);
+  BOOST_CHECK_EQUAL(inst->subinstruction(sample_cref::info_field::index)->optional(), sample_cref::info_field::optional);
+  BOOST_CHECK_EQUAL(inst->subinstruction(sample_cref::entries_field::index)->field_type(), mfast::field_type_sequence);
+  BOOST_CHECK_EQUAL(sample_cref::entries_element_cref::text_field::field_type, mfast::field_type_unicode_string);
+  BOOST_CHECK_EQUAL(sample_cref::entries_element_cref::text_field::index, 1U);
+
+  typedef test4::Defaults_cref defaults_cref;
+  BOOST_STATIC_ASSERT(defaults_cref::count_field::has_initial_value);
+  BOOST_STATIC_ASSERT(defaults_cref::count_field::initial_value == 5U);
+  BOOST_STATIC_ASSERT(defaults_cref::offset_field::initial_value == -7LL);
+  BOOST_STATIC_ASSERT(defaults_cref::offset_field::field_operator == mfast::operator_constant);
+  BOOST_CHECK_EQUAL(defaults_cref::rate_field::initial_mantissa, 125);
+  BOOST_CHECK_EQUAL(defaults_cref::rate_field::initial_exponent, -2);
+
+  debug_allocator alloc;
+  test4::Defaults defaults(&alloc);
+  BOOST_CHECK_EQUAL(defaults.cref().get_count().value(), defaults_cref::count_field::initial_value);
+  BOOST_CHECK_EQUAL(defaults.cref().get_offset().value(), defaults_cref::offset_field::initial_value);
+
+  // a decimal with separate exponent and mantissa operators
+  typedef defaults_cref::size_field size_field;
+  BOOST_STATIC_ASSERT(size_field::field_type == mfast::field_type_exponent);
+  BOOST_STATIC_ASSERT(size_field::field_operator == mfast::operator_default);
+  BOOST_STATIC_ASSERT(size_field::mantissa_operator == mfast::operator_delta);
+  BOOST_STATIC_ASSERT(size_field::has_initial_value && size_field::has_initial_mantissa);
+
+  const mfast::decimal_field_instruction* size_inst =
+    static_cast<const mfast::decimal_field_instruction*>(test4::Defaults::instruction()->subinstruction(size_field::index));
+  BOOST_CHECK_EQUAL(size_inst->field_type(), size_field::field_type);
+  BOOST_CHECK_EQUAL(size_inst->field_operator(), size_field::field_operator);
+  BOOST_CHECK_EQUAL(size_inst->mantissa_instruction()->field_operator(), size_field::mantissa_operator);
+  BOOST_CHECK_EQUAL(size_inst->initial_value().of_decimal.exponent_, size_field::initial_exponent);
+  BOOST_CHECK_EQUAL(size_inst->mantissa_instruction()->initial_value().get<int64_t>(), size_field::initial_mantissa);
+
+  typedef test2::MDRefreshSample_cref::MDEntries_element_cref entry_cref;
+  const mfast::template_instruction* refresh_inst = test2::MDRefreshSample::instruction();
+  const mfast::sequence_field_instruction* entries_inst =
+    static_cast<const mfast::sequence_field_instruction*>(refresh_inst->subinstruction(test2::MDRefreshSample_cref::MDEntries_field::index));
+  const mfast::decimal_field_instruction* entry_size_inst =
+    static_cast<const mfast::decimal_field_instruction*>(entries_inst->subinstruction(entry_cref::MDEntrySize_field::index));
+  BOOST_CHECK_EQUAL(entry_size_inst->field_type(), entry_cref::MDEntrySize_field::field_type);
+  BOOST_CHECK_EQUAL(entry_size_inst->field_operator(), entry_cref::MDEntrySize_field::field_operator);
+  BOOST_CHECK_EQUAL(entry_size_inst->mantissa_instruction()->field_operator(), entry_cref::MDEntrySize_field::mantissa_operator);
+  BOOST_CHECK(!entry_cref::MDEntrySize_field::has_initial_value);
+  BOOST_CHECK_EQUAL(entries_inst->subinstruction(entry_cref::MDEntryPx_field::index)->field_type(),
+                    entry_cref::MDEntryPx_field::field_type);
+}
+
+BOOST_AUTO_TEST_CASE(capacity_test)
+{
+  const mfast::template_instruction* inst = test4::FlatSample::instruction();
+  BOOST_CHECK_EQUAL(static_cast<const mfast::string_field_instruction*>(inst->subinstruction(1))->capacity(), 8U);
+  BOOST_CHECK_EQUAL(static_cast<const mfast::sequence_field_instruction*>(inst->subinstruction(5))->capacity(), 3U);
+
+  mfast::tracking_allocator alloc(mfast::malloc_allocator::instance());
+  test4::FlatSample sample(&alloc);
+  mfast::tracking_allocator::counters constructed = alloc.total();
+
+  test4::FlatSample_mref mref = sample.mref();
+  mref.set_symbol().as("ABCDEFGH");
+  mref.set_info().set_data().assign(reinterpret_cast<const unsigned char*>("\x01\x02\x03\x04"),
+                                    reinterpret_cast<const unsigned char*>("\x01\x02\x03\x04") + 4);
+  mref.set_entries().resize(3);
+  mref.set_entries()[2].set_size().as(7);
+
+  // values within the capacity are stored in the storage reserved at construction
+  mfast::tracking_allocator::counters assigned = alloc.total();
+  BOOST_CHECK_EQUAL(assigned.allocate_calls, constructed.allocate_calls);
+  BOOST_CHECK_EQUAL(assigned.reallocate_calls, constructed.reallocate_calls);
+  BOOST_CHECK(sample.cref().get_symbol() == "ABCDEFGH");
+  BOOST_CHECK_EQUAL(sample.cref().get_entries()[2].get_size().value(), 7U);
+
+  // longer values still grow the storage
+  std::string long_symbol(100, 'X');
+  mref.set_symbol().as(long_symbol);
+  mref.set_entries().resize(16);
+  BOOST_CHECK_EQUAL(alloc.total().reallocate_calls, assigned.reallocate_calls + 2);
+  BOOST_CHECK(sample.cref().get_symbol() == long_symbol.c_str());
+  BOOST_CHECK_EQUAL(sample.cref().get_entries()[2].get_size().value(), 7U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
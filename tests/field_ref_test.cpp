@@ -24,6 +24,7 @@
 #include <mfast/decimal_ref.h>
 #include <mfast/group_ref.h>
 #include <mfast/sequence_ref.h>
+#include <mfast/arena_allocator.h>
 #include <mfast/coder/common/codec_helper.h>
 
 #define BOOST_TEST_DYN_LINK
@@ -686,6 +687,62 @@ BOOST_AUTO_TEST_CASE(group_field_test)
 
 }
 
+BOOST_AUTO_TEST_CASE(group_field_index_test)
+{
+  debug_allocator alloc;
+  arena_allocator index_alloc;
+  value_storage storage;
+
+  uint32_field_instruction inst0(0, operator_none, presence_mandatory, 10, "field0", "", 0, int_value_storage<uint32_t>());
+  uint32_field_instruction inst1(1, operator_none, presence_mandatory, 11, "field1", "", 0, int_value_storage<uint32_t>());
+  uint32_field_instruction inst2(2, operator_none, presence_mandatory, 12, "field2", "", 0, int_value_storage<uint32_t>());
+  // duplicated id and name resolve to the first field as the linear search does
+  uint32_field_instruction inst3(3, operator_none, presence_mandatory, 11, "field0", "", 0, int_value_storage<uint32_t>());
+
+  const field_instruction* instructions[] = {
+    &inst0,&inst1,&inst2,&inst3
+  };
+
+  group_field_instruction group_inst(0, presence_mandatory,
+                                     3,
+                                     "test_group","","",
+                                     instructions,
+                                     4);
+
+  BOOST_CHECK_EQUAL(group_inst.find_subinstruction_index_by_name("field2"), 2);
+  BOOST_CHECK_EQUAL(group_inst.find_subinstruction_index_by_name("field1\"", 6), 1);
+  BOOST_CHECK_EQUAL(group_inst.find_subinstruction_index_by_id(11), 1);
+
+  group_inst.build_subinstruction_index(&index_alloc);
+
+  BOOST_CHECK_EQUAL(group_inst.find_subinstruction_index_by_name("field0"), 0);
+  BOOST_CHECK_EQUAL(group_inst.find_subinstruction_index_by_name("field1"), 1);
+  BOOST_CHECK_EQUAL(group_inst.find_subinstruction_index_by_name("field2"), 2);
+  BOOST_CHECK_EQUAL(group_inst.find_subinstruction_index_by_name("field3"), -1);
+  // a name given by pointer and length need not be null terminated
+  BOOST_CHECK_EQUAL(group_inst.find_subinstruction_index_by_name("field1\"", 6), 1);
+  BOOST_CHECK_EQUAL(group_inst.find_subinstruction_index_by_name("field12", 7), -1);
+  BOOST_CHECK_EQUAL(group_inst.find_subinstruction_index_by_name("field", 5), -1);
+  BOOST_CHECK_EQUAL(group_inst.find_subinstruction_index_by_id(10), 0);
+  BOOST_CHECK_EQUAL(group_inst.find_subinstruction_index_by_id(11), 1);
+  BOOST_CHECK_EQUAL(group_inst.find_subinstruction_index_by_id(12), 2);
+  BOOST_CHECK_EQUAL(group_inst.find_subinstruction_index_by_id(13), -1);
+
+  group_inst.construct_value(storage, &alloc);
+  {
+    group_mref ref(&alloc, &storage, &group_inst);
+    field_handle handle = ref.field_handle_with_name("field2");
+    BOOST_CHECK(handle.found());
+    BOOST_CHECK_EQUAL(handle.index(), 2U);
+    uint32_mref(ref[handle]).as(5);
+
+    group_cref cref(ref);
+    BOOST_CHECK_EQUAL(uint32_cref(cref[field_handle::with_id(&group_inst, 12)]).value(), 5U);
+    BOOST_CHECK(!cref.field_handle_with_name("field3").found());
+  }
+  group_inst.destruct_value(storage, &alloc);
+}
+
 BOOST_AUTO_TEST_CASE(sequence_field_test)
 {
   debug_allocator alloc;
@@ -0,0 +1,119 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <mfast/fixed_decimal.h>
+#include <mfast/decimal_ref.h>
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+
+using namespace mfast;
+
+namespace {
+
+std::string to_string(const fixed_decimal& value)
+{
+  std::stringstream strm;
+  strm << value;
+  return strm.str();
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( fixed_decimal_test_suite )
+
+BOOST_AUTO_TEST_CASE(fixed_decimal_conversion_test)
+{
+  fixed_decimal price(12345, -2);
+  BOOST_CHECK_EQUAL(price.to_double(), 123.45);
+  BOOST_CHECK_EQUAL(price.to_ticks(-2), 12345);
+  BOOST_CHECK_EQUAL(price.to_ticks(-4), 1234500);
+  BOOST_CHECK_EQUAL(price.to_ticks(-1), 1234);
+  BOOST_CHECK_EQUAL(price.to_ticks(1), 12);
+  BOOST_CHECK_EQUAL(price.to_ticks(20), 0);
+  BOOST_CHECK_EQUAL(fixed_decimal(-12345, -2).to_ticks(-1), -1234);
+  BOOST_CHECK_EQUAL(fixed_decimal(5, 2).to_double(), 500.0);
+
+  fixed_decimal n(120000, -3);
+  n.normalize();
+  BOOST_CHECK_EQUAL(n.mantissa(), 12);
+  BOOST_CHECK_EQUAL(n.exponent(), 1);
+  BOOST_CHECK_EQUAL(fixed_decimal(0, -5).normalized().exponent(), 0);
+  // the exponent stops at its maximum instead of wrapping around
+  fixed_decimal large = fixed_decimal(1000, 126).normalized();
+  BOOST_CHECK_EQUAL(large.mantissa(), 100);
+  BOOST_CHECK_EQUAL(large.exponent(), 127);
+
+  BOOST_CHECK_EQUAL(to_string(price), "123.45");
+  BOOST_CHECK_EQUAL(to_string(fixed_decimal(-5, -2)), "-0.05");
+  BOOST_CHECK_EQUAL(to_string(fixed_decimal(12, 2)), "1200");
+  BOOST_CHECK_EQUAL(to_string(fixed_decimal(0, 3)), "0");
+  BOOST_CHECK_EQUAL(to_string(fixed_decimal(INT64_MIN, 0)), "-9223372036854775808");
+}
+
+BOOST_AUTO_TEST_CASE(fixed_decimal_arithmetic_test)
+{
+  fixed_decimal a(15, -1);  // 1.5
+  fixed_decimal b(25, -2);  // 0.25
+
+  BOOST_CHECK(a + b == fixed_decimal(175, -2));
+  BOOST_CHECK_EQUAL((a + b).exponent(), -2);
+  BOOST_CHECK(a - b == fixed_decimal(125, -2));
+  BOOST_CHECK(b - a == fixed_decimal(-125, -2));
+  BOOST_CHECK(a * b == fixed_decimal(375, -3));
+  BOOST_CHECK(-a == fixed_decimal(-15, -1));
+
+  // aligning would overflow; the digits below the larger exponent are dropped
+  fixed_decimal big(INT64_C(1000000000000000000), 0);
+  fixed_decimal sum = big + fixed_decimal(15, -1);
+  BOOST_CHECK_EQUAL(sum.mantissa(), INT64_C(1000000000000000001));
+  BOOST_CHECK_EQUAL(sum.exponent(), 0);
+
+  BOOST_CHECK(fixed_decimal(10, -1) == fixed_decimal(1, 0));
+  BOOST_CHECK(fixed_decimal(10, -1) != fixed_decimal(11, -1));
+  BOOST_CHECK(fixed_decimal(99, -2) < fixed_decimal(1, 0));
+  BOOST_CHECK(fixed_decimal(1, 0) <= fixed_decimal(100, -2));
+  BOOST_CHECK(fixed_decimal(1, 30) > fixed_decimal(INT64_MAX, 0));
+  BOOST_CHECK(fixed_decimal(-1, 30) < fixed_decimal(INT64_MIN, 0));
+  BOOST_CHECK(fixed_decimal(0, 30) == fixed_decimal(0, -30));
+  BOOST_CHECK(fixed_decimal(-1, 0) >= fixed_decimal(-100, -2));
+}
+
+#ifndef MFAST_MULTIPRECISION_DECIMAL
+BOOST_AUTO_TEST_CASE(decimal_ref_value_test)
+{
+  decimal_field_instruction inst(0, operator_copy,
+                                 presence_mandatory,
+                                 1,
+                                 "test_decimal","",
+                                 0,
+                                 decimal_value_storage());
+  value_storage storage;
+  decimal_mref mref(0, &storage, &inst);
+  mref.as(fixed_decimal(12345, -2));
+  BOOST_CHECK_EQUAL(mref.mantissa(), 12345);
+  BOOST_CHECK_EQUAL(mref.exponent(), -2);
+
+  decimal_cref cref(mref);
+  BOOST_CHECK(cref.value() == fixed_decimal(123450, -3));
+  BOOST_CHECK_EQUAL(cref.value().to_double(), 123.45);
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
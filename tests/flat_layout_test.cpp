@@ -0,0 +1,150 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+#include "test4_flat.h"
+#include <mfast/coder/fast_decoder.h>
+#include <mfast/coder/fast_encoder.h>
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+#include <vector>
+
+using namespace mfast;
+
+BOOST_AUTO_TEST_SUITE( flat_layout_test_suite )
+
+BOOST_AUTO_TEST_CASE(flat_round_trip_test)
+{
+  const templates_description* descriptions[] = { test4::description() };
+
+  // encode two messages with the regular message types
+  fast_encoder encoder;
+  encoder.include(descriptions);
+  std::vector<char> buffer;
+
+  test4::FlatSample sample;
+  test4::FlatSample_mref mref = sample.mref();
+  mref.set_id().as(1);
+  mref.set_symbol().as("ABC");
+  mref.set_change().as(-5);
+  mref.set_info().as_present();
+  mref.set_info().set_code().as(7);
+  const unsigned char data[] = { 1, 2, 3 };
+  mref.set_info().set_data().assign(data, data+3);
+  mref.set_entries().resize(2);
+  mref.set_entries()[0].set_size().as(100);
+  mref.set_entries()[0].set_text().as("first");
+  mref.set_entries()[1].set_size().as(101);
+  encoder.encode(static_cast<message_type&>(sample).cref(), buffer, true);
+
+  test4::FlatSample sample2;
+  test4::FlatSample_mref mref2 = sample2.mref();
+  mref2.set_id().as(2);
+  mref2.set_symbol().as("ABC");
+  mref2.set_price().as(12345, -2);
+  mref2.set_entries().resize(0);
+  encoder.encode(static_cast<message_type&>(sample2).cref(), buffer);
+
+  // decode them into flat structs
+  fast_decoder decoder;
+  decoder.include(descriptions);
+  const char* first = &buffer[0];
+  const char* last = first + buffer.size();
+
+  test4::FlatSample_flat flat1;
+  std::memset(&flat1, 0, sizeof(flat1));
+  decoder.decode_flat(first, last, flat1, true);
+
+  BOOST_CHECK_EQUAL(flat1.id, 1U);
+  BOOST_CHECK_EQUAL(flat1.symbol.str(), "ABC");
+  BOOST_CHECK(flat1.has_change());
+  BOOST_CHECK_EQUAL(flat1.change, -5);
+  BOOST_CHECK(!flat1.has_price());
+  BOOST_CHECK(flat1.has_info());
+  BOOST_CHECK_EQUAL(flat1.info.code, 7);
+  BOOST_CHECK(flat1.info.has_data());
+  BOOST_CHECK_EQUAL(flat1.info.data.size(), 3U);
+  BOOST_CHECK(std::memcmp(flat1.info.data.data(), data, 3) == 0);
+  BOOST_CHECK_EQUAL(flat1.entries.size(), 2U);
+  BOOST_CHECK_EQUAL(flat1.entries[0].size, 100U);
+  BOOST_CHECK(flat1.entries[0].has_text());
+  BOOST_CHECK_EQUAL(flat1.entries[0].text.str(), "first");
+  BOOST_CHECK_EQUAL(flat1.entries[1].size, 101U);
+  BOOST_CHECK(!flat1.entries[1].has_text());
+
+  test4::FlatSample_flat flat2;
+  std::memset(&flat2, 0, sizeof(flat2));
+  decoder.decode_flat(first, last, flat2);
+  BOOST_CHECK(first == last);
+
+  BOOST_CHECK_EQUAL(flat2.id, 2U);
+  BOOST_CHECK_EQUAL(flat2.symbol.str(), "ABC");
+  BOOST_CHECK(!flat2.has_change());
+  BOOST_CHECK(flat2.has_price());
+  BOOST_CHECK_EQUAL(flat2.price.mantissa, 12345);
+  BOOST_CHECK_EQUAL(flat2.price.exponent, -2);
+  BOOST_CHECK(!flat2.has_info());
+  BOOST_CHECK_EQUAL(flat2.entries.size(), 0U);
+
+  // encoding the flat structs produces the same stream
+  fast_encoder flat_encoder;
+  flat_encoder.include(descriptions);
+  std::vector<char> flat_buffer;
+  flat_encoder.encode_flat(flat1, flat_buffer, true);
+  flat_encoder.encode_flat(flat2, flat_buffer);
+  BOOST_CHECK(buffer == flat_buffer);
+}
+
+BOOST_AUTO_TEST_CASE(flat_error_test)
+{
+  const templates_description* descriptions[] = { test4::description() };
+  fast_encoder encoder;
+  encoder.include(descriptions);
+  std::vector<char> buffer;
+
+  test4::FlatSample sample;
+  test4::FlatSample_mref mref = sample.mref();
+  mref.set_id().as(1);
+  mref.set_symbol().as("too long for a flat_string<8>");
+  mref.set_entries().resize(0);
+  encoder.encode(static_cast<message_type&>(sample).cref(), buffer, true);
+
+  test4::Heartbeat heartbeat;
+  heartbeat.mref().set_seq().as(1);
+  encoder.encode(static_cast<message_type&>(heartbeat).cref(), buffer);
+
+  fast_decoder decoder;
+  decoder.include(descriptions);
+  const char* first = &buffer[0];
+  const char* last = first + buffer.size();
+
+  test4::FlatSample_flat flat;
+  BOOST_CHECK_THROW(decoder.decode_flat(first, last, flat, true), flat_capacity_error);
+
+  first = &buffer[0];
+  decoder.decode(first, last, true);
+  BOOST_CHECK_THROW(decoder.decode_flat(first, last, flat), flat_layout_mismatch_error);
+
+  test4::FlatSample_flat::entries_element_flat element;
+  BOOST_CHECK_THROW(flat.entries.resize(4), flat_capacity_error);
+  BOOST_CHECK_THROW(element.text.assign("0123456789012345678901234567890123456789"), flat_capacity_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,5 +1,8 @@
 #include "test3.h"
+#include "test4.h"
 #include <mfast/json/json_encoder.h>
+#include <mfast/json/json_decoder.h>
+#include <cstring>
 #include <sstream>
 
 #define BOOST_TEST_DYN_LINK
@@ -87,5 +90,188 @@ BOOST_AUTO_TEST_CASE(json_encode_person_test)
   
 }
 
+BOOST_AUTO_TEST_CASE(json_decode_product_test)
+{
+  using namespace test3;
+
+  const char* input = "{\"id\":1,\"name\":\"Foo\",\"price\":123,\"tags\":[\"Bar with \\\"quote\\\"\",\"Eek with \\\\\"],\"stock\":{\"warehouse\":300,\"retail\":20}}";
+
+  Product product_holder;
+  mfast::json::json_decoder decoder;
+  const char* end = decoder.decode(input, input + std::strlen(input), product_holder.mref());
+  BOOST_CHECK(end == input + std::strlen(input));
+
+  Product_cref product_ref = product_holder.cref();
+  BOOST_CHECK_EQUAL(product_ref.get_id().value(), 1U);
+  BOOST_CHECK(product_ref.get_name() == "Foo");
+  BOOST_CHECK_EQUAL(product_ref.get_tags().size(), 2U);
+  BOOST_CHECK(product_ref.get_tags()[0] == "Bar with \"quote\"");
+  BOOST_CHECK(product_ref.get_tags()[1] == "Eek with \\");
+  BOOST_CHECK_EQUAL(product_ref.get_stock().get_retail().value(), 20U);
+
+  std::stringstream strm;
+  mfast::json::encode(strm, product_ref);
+  BOOST_CHECK_EQUAL(strm.str(), std::string(input));
+
+  // the name index is reused for the next message; missing optional fields become absent
+  const char* input2 = " { \"price\" : 7, \"id\" : 2, \"name\" : \"Bar\", \"tags\" : [ ] } ";
+  end = decoder.decode(input2, input2 + std::strlen(input2), product_holder.mref());
+  BOOST_CHECK(end == input2 + std::strlen(input2));
+  BOOST_CHECK_EQUAL(product_ref.get_id().value(), 2U);
+  BOOST_CHECK_EQUAL(product_ref.get_tags().size(), 0U);
+  BOOST_CHECK(!product_ref.get_stock().present());
+}
+
+BOOST_AUTO_TEST_CASE(json_decode_person_test)
+{
+  using namespace test3;
+
+  const char* input = "{\"firstName\":\"John\",\"lastName\":\"Smith\",\"age\":25,"
+                      "\"phoneNumbers\":[{\"type\":\"home\",\"number\":\"212 555-1234\"},{\"type\":\"fax\",\"number\":\"646 555-4567\"}],"
+                      "\"emails\":[],\"login\":{\"userName\":\"John\",\"password\":\"J0hnsm1th\"},\"bankAccounts\":[{\"number\":12345678,\"routingNumber\":87654321}]}";
+
+  // the targets of the dynamic templateRefs must be set before decoding
+  Person person_holder;
+  Person_mref person_ref = person_holder.mref();
+  person_ref.set_login().as<LoginAccount>();
+  person_ref.set_bankAccounts().resize(1);
+  person_ref.set_bankAccounts()[0].as<BankAccount>();
+
+  mfast::json::decode(input, input + std::strlen(input), person_ref);
+  BOOST_CHECK_EQUAL(person_holder.cref().get_phoneNumbers().size(), 2U);
+  BOOST_CHECK(person_holder.cref().get_phoneNumbers()[1].get_number() == "646 555-4567");
+
+  std::stringstream strm;
+  mfast::json::encode(strm, person_ref);
+  BOOST_CHECK_EQUAL(strm.str(), std::string(input));
+
+  Person unbound_holder;
+  BOOST_CHECK_THROW(mfast::json::decode(input, input + std::strlen(input), unbound_holder.mref()),
+                    mfast::json::json_decode_error);
+}
+
+BOOST_AUTO_TEST_CASE(json_decode_values_test)
+{
+  using namespace test4;
+
+  const char* input = "{\"id\":4294967295,\"symbol\":\"A\\u00e9\\/\\n\",\"change\":-9223372036854775808,"
+                      "\"unknown\":{\"a\":[1,2.5e3,true,null,\"}\"]},\"price\":-12.50,"
+                      "\"info\":{\"code\":-2147483648,\"data\":\"\\u0001b\"},"
+                      "\"entries\":[{\"size\":18446744073709551615,\"text\":\"\\ud83d\\ude00\"},{\"size\":0,\"text\":null}]}";
+
+  FlatSample sample_holder;
+  mfast::json::json_decoder decoder;
+  decoder.decode(input, input + std::strlen(input), sample_holder.mref());
+
+  FlatSample_cref sample = sample_holder.cref();
+  BOOST_CHECK_EQUAL(sample.get_id().value(), 4294967295U);
+  BOOST_CHECK(sample.get_symbol() == "A\xC3\xA9/\n");
+  BOOST_CHECK(sample.get_change().present());
+  BOOST_CHECK_EQUAL(sample.get_change().value(), (std::numeric_limits<int64_t>::min)());
+  BOOST_CHECK_EQUAL(sample.get_price().mantissa(), -1250);
+  BOOST_CHECK_EQUAL(sample.get_price().exponent(), -2);
+  BOOST_CHECK(sample.get_info().present());
+  BOOST_CHECK_EQUAL(sample.get_info().get_code().value(), (std::numeric_limits<int32_t>::min)());
+  BOOST_CHECK_EQUAL(sample.get_info().get_data().size(), 2U);
+  BOOST_CHECK_EQUAL(sample.get_info().get_data()[0], 1);
+  BOOST_CHECK_EQUAL(sample.get_entries().size(), 2U);
+  BOOST_CHECK_EQUAL(sample.get_entries()[0].get_size().value(), (std::numeric_limits<uint64_t>::max)());
+  BOOST_CHECK(sample.get_entries()[0].get_text() == "\xF0\x9F\x98\x80");
+  BOOST_CHECK(!sample.get_entries()[1].get_text().present());
+
+  // decimals keep their value without going through floating point
+  const char* decimals[] = { "{\"price\":1.5e-3}", "{\"price\":12000000000000000000000e-5}", "{\"price\":0.000}" };
+  const int64_t mantissas[] = { 15, 1200000000000000000LL, 0 };
+  const int exponents[] = { -4, -1, 0 };
+  for (int i = 0; i < 3; ++i) {
+    decoder.decode(decimals[i], decimals[i] + std::strlen(decimals[i]), sample_holder.mref());
+    BOOST_CHECK_EQUAL(sample.get_price().mantissa(), mantissas[i]);
+    BOOST_CHECK_EQUAL(sample.get_price().exponent(), exponents[i]);
+    BOOST_CHECK(!sample.get_change().present());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(json_decode_error_test)
+{
+  using namespace test4;
+
+  const char* inputs[] = {
+    "{\"id\":4294967296}",
+    "{\"id\":-1}",
+    "{\"id\":1.5}",
+    "{\"id\":null}",
+    "{\"symbol\":\"abc}",
+    "{\"symbol\":\"\\x\"}",
+    "{\"price\":1e999}",
+    "{\"id\":1",
+    "[]"
+  };
+
+  FlatSample sample_holder;
+  mfast::json::json_decoder decoder;
+  for (std::size_t i = 0; i < sizeof(inputs)/sizeof(inputs[0]); ++i) {
+    BOOST_CHECK_THROW(decoder.decode(inputs[i], inputs[i] + std::strlen(inputs[i]), sample_holder.mref()),
+                      mfast::json::json_decode_error);
+  }
+
+  try {
+    const char* input = "{\"id\":1,\"change\":x}";
+    decoder.decode(input, input + std::strlen(input), sample_holder.mref());
+    BOOST_FAIL("no exception thrown");
+  }
+  catch (mfast::json::json_decode_error& ex) {
+    const std::size_t* offset = boost::get_error_info<mfast::json::json_offset_info>(ex);
+    BOOST_REQUIRE(offset != 0);
+    BOOST_CHECK_EQUAL(*offset, 17U);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(json_writer_test)
+{
+  using namespace test4;
+
+  FlatSample sample_holder;
+  FlatSample_mref sample_ref = sample_holder.mref();
+  sample_ref.set_id().as(7);
+  sample_ref.set_symbol().as("a \"quoted\"\tname\x01 long enough for two blocks\\");
+  sample_ref.set_price().as(-125, -1);
+  sample_ref.set_entries().resize(1);
+  sample_ref.set_entries()[0].set_size().as(3);
+
+  const char* result = "{\"id\":7,\"symbol\":\"a \\\"quoted\\\"\\tname\\u0001 long enough for two blocks\\\\\","
+                       "\"price\":-12.5,\"entries\":[{\"size\":3}]}";
+
+  mfast::json::json_writer writer(true);
+  BOOST_CHECK(writer.write(sample_holder.cref()));
+  BOOST_CHECK(writer.write(sample_holder.cref()));
+  std::string line = std::string(result) + "\n";
+  BOOST_CHECK_EQUAL(std::string(writer.data(), writer.size()), line + line);
+
+  // the output can be decoded back
+  FlatSample decoded_holder;
+  mfast::json::decode(writer.data(), writer.data() + writer.size(), decoded_holder.mref());
+  BOOST_CHECK(decoded_holder.cref().get_symbol() == sample_holder.cref().get_symbol());
+
+  writer.clear();
+  BOOST_CHECK_EQUAL(writer.size(), 0U);
+
+  // a fixed buffer keeps the messages which fit
+  std::vector<char> buf(std::strlen(result) + 10);
+  mfast::json::json_writer fixed_writer(&buf[0], buf.size());
+  BOOST_CHECK(fixed_writer.write(sample_holder.cref()));
+  BOOST_CHECK(!fixed_writer.write(sample_holder.cref()));
+  BOOST_CHECK_EQUAL(std::string(fixed_writer.data(), fixed_writer.size()), std::string(result));
+
+  // a stream gets the same text when it does not fit in the buffer of encode()
+  std::string long_symbol(3000, 'x');
+  sample_ref.set_symbol().as(long_symbol.c_str());
+  sample_ref.set_entries().resize(500);
+  for (std::size_t i = 0; i < 500; ++i)
+    sample_ref.set_entries()[i].set_size().as(i);
+  writer.write(sample_holder.cref());
+  std::stringstream strm;
+  BOOST_CHECK(mfast::json::encode(strm, sample_holder.cref()));
+  BOOST_CHECK_EQUAL(strm.str() + "\n", std::string(writer.data(), writer.size()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
-  
\ No newline at end of file
@@ -0,0 +1,170 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <mfast.h>
+#include <mfast/message_snapshot.h>
+#include <mfast/field_comparator.h>
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+#include <vector>
+#include "debug_allocator.h"
+
+using namespace mfast;
+
+BOOST_AUTO_TEST_SUITE( message_snapshot_test_suite )
+
+BOOST_AUTO_TEST_CASE(flatten_test)
+{
+  debug_allocator alloc;
+
+  uint32_field_instruction id_inst(0, operator_none, presence_mandatory, 1, "id", "", 0, int_value_storage<uint32_t>());
+  ascii_field_instruction symbol_inst(1, operator_none, presence_optional, 2, "symbol", "", 0, string_value_storage());
+  decimal_field_instruction price_inst(2, operator_none, presence_mandatory, 3, "price", "", 0, decimal_value_storage());
+
+  int64_field_instruction code_inst(0, operator_none, presence_mandatory, 5, "code", "", 0, int_value_storage<int64_t>());
+  const field_instruction* info_instructions[] = { &code_inst };
+  group_field_instruction info_inst(3, presence_optional, 4, "info", "", "", info_instructions, 1);
+
+  uint32_field_instruction size_inst(0, operator_none, presence_mandatory, 7, "size", "", 0, int_value_storage<uint32_t>());
+  unicode_field_instruction text_inst(1, operator_none, presence_optional, 8, "text", "", 0, string_value_storage());
+  uint32_field_instruction length_inst(0, operator_none, presence_mandatory, 9, "", "", 0, int_value_storage<uint32_t>());
+  const field_instruction* entry_instructions[] = { &size_inst, &text_inst };
+  sequence_field_instruction entries_inst(4, presence_mandatory, 6, "entries", "", "", entry_instructions, 2, &length_inst);
+
+  const field_instruction* instructions[] = { &id_inst, &symbol_inst, &price_inst, &info_inst, &entries_inst };
+  template_instruction templ(10, "Sample", "", "", "", instructions, 5, false);
+
+  std::vector<char> buffer;
+  {
+    message_type message(&alloc, &templ);
+    message_mref mref = message.mref();
+    uint32_mref(mref[0]).as(42);
+    ascii_string_mref(mref[1]).as("ABC");
+    decimal_mref(mref[2]).as(12345, -2);
+    group_mref info(mref[3]);
+    info.as_present();
+    int64_mref(info[0]).as(-7);
+    sequence_mref entries(mref[4]);
+    entries.resize(2);
+    uint32_mref(entries[0][0]).as(100);
+    unicode_string_mref(entries[0][1]).as("first");
+    uint32_mref(entries[1][0]).as(101);
+
+    flatten(message.cref(), buffer);
+    BOOST_CHECK_EQUAL(buffer.size(), flattened_size(message.cref()));
+
+    std::vector<char> small(buffer.size() - 8);
+    BOOST_CHECK_THROW(flatten(message.cref(), &small[0], small.size()), snapshot_overflow_error);
+  }
+
+  // the snapshot remains valid after it is copied to another address and the message is destroyed
+  std::vector<char> copy(buffer);
+  std::memset(&buffer[0], 0, buffer.size());
+
+  BOOST_CHECK_EQUAL(snapshot_message_cref::template_id(&copy[0]), 10U);
+  BOOST_CHECK_EQUAL(snapshot_message_cref::size(&copy[0]), copy.size());
+
+  snapshot_message_cref snapshot(&copy[0], &templ);
+  BOOST_CHECK_EQUAL(snapshot.num_fields(), 5U);
+  BOOST_CHECK_EQUAL(snapshot[0].int_value<uint32_t>(), 42U);
+  BOOST_CHECK(snapshot[1].present());
+  BOOST_CHECK_EQUAL(snapshot[1].size(), 3U);
+  BOOST_CHECK_EQUAL(std::string(snapshot[1].c_str()), "ABC");
+  BOOST_CHECK(snapshot[2].decimal_value() == fixed_decimal(12345, -2));
+
+  snapshot_field_cref info = snapshot[snapshot.field_index_with_name("info")];
+  BOOST_CHECK(info.present());
+  BOOST_CHECK_EQUAL(info.group()[0].int_value<int64_t>(), -7);
+
+  snapshot_sequence_cref entries = snapshot[4].sequence();
+  BOOST_CHECK_EQUAL(entries.size(), 2U);
+  BOOST_CHECK_EQUAL(entries[0][0].int_value<uint32_t>(), 100U);
+  BOOST_CHECK_EQUAL(std::string(entries[0][1].data(), entries[0][1].size()), "first");
+  BOOST_CHECK_EQUAL(entries[1][0].int_value<uint32_t>(), 101U);
+  BOOST_CHECK(entries[1][1].absent());
+}
+
+BOOST_AUTO_TEST_CASE(unflatten_test)
+{
+  debug_allocator alloc;
+
+  uint32_field_instruction id_inst(0, operator_none, presence_mandatory, 1, "id", "", 0, int_value_storage<uint32_t>());
+  ascii_field_instruction symbol_inst(1, operator_none, presence_optional, 2, "symbol", "", 0, string_value_storage());
+
+  int64_field_instruction code_inst(0, operator_none, presence_mandatory, 5, "code", "", 0, int_value_storage<int64_t>());
+  const field_instruction* info_instructions[] = { &code_inst };
+  group_field_instruction info_inst(2, presence_optional, 4, "info", "", "", info_instructions, 1);
+
+  uint32_field_instruction size_inst(0, operator_none, presence_mandatory, 7, "size", "", 0, int_value_storage<uint32_t>());
+  byte_vector_field_instruction data_inst(1, operator_none, presence_optional, 8, "data", "", 0, byte_vector_value_storage());
+  uint32_field_instruction length_inst(0, operator_none, presence_mandatory, 9, "", "", 0, int_value_storage<uint32_t>());
+  const field_instruction* entry_instructions[] = { &size_inst, &data_inst };
+  sequence_field_instruction entries_inst(3, presence_mandatory, 6, "entries", "", "", entry_instructions, 2, &length_inst);
+
+  templateref_instruction nested_inst(4, presence_mandatory);
+
+  const field_instruction* instructions[] = { &id_inst, &symbol_inst, &info_inst, &entries_inst, &nested_inst };
+  template_instruction templ(10, "Sample", "", "", "", instructions, 5, false);
+
+  int32_field_instruction qty_inst(0, operator_none, presence_mandatory, 11, "qty", "", 0, int_value_storage<int32_t>());
+  const field_instruction* leg_instructions[] = { &qty_inst };
+  template_instruction leg(11, "Leg", "", "", "", leg_instructions, 1, false);
+
+  const template_instruction* nested_templates[] = { &leg };
+  templates_description description("", "", "", nested_templates);
+
+  message_type message(&alloc, &templ);
+  message_mref mref = message.mref();
+  uint32_mref(mref[0]).as(42);
+  ascii_string_mref(mref[1]).as("");
+  group_mref(mref[2]).as_present();
+  int64_mref(group_mref(mref[2])[0]).as(-7);
+  sequence_mref entries(mref[3]);
+  entries.resize(3);
+  uint32_mref(entries[0][0]).as(100);
+  byte_vector_mref(entries[0][1]).assign("\x01\x00\x02", "\x01\x00\x02" + 3);
+  uint32_mref(entries[2][0]).as(102);
+  int32_mref(nested_message_mref(mref[4]).rebind(&leg)[0]).as(-3);
+
+  std::vector<char> buffer;
+  flatten(message.cref(), buffer);
+
+  // the snapshot can be used as a message wherever it is copied to
+  std::vector<uint64_t> copy(buffer.size() / sizeof(uint64_t));
+  std::memcpy(&copy[0], &buffer[0], buffer.size());
+
+  message_cref unflattened = unflatten(&copy[0], &templ, &description);
+  BOOST_CHECK(unflattened == message.cref());
+  BOOST_CHECK_EQUAL(unflattened.id(), 10U);
+  BOOST_CHECK_EQUAL(std::string(ascii_string_cref(unflattened[1]).c_str()), "");
+  BOOST_CHECK_EQUAL(byte_vector_cref(sequence_cref(unflattened[3])[0][1]).size(), 3U);
+  BOOST_CHECK(sequence_cref(unflattened[3])[1][1].absent());
+  nested_message_cref nested(unflattened[4]);
+  BOOST_CHECK_EQUAL(nested.target_instruction(), &leg);
+  BOOST_CHECK_EQUAL(int32_cref(nested.target()[0]).value(), -3);
+
+  // a dynamic nested message is left unbound without its templates
+  std::memcpy(&copy[0], &buffer[0], buffer.size());
+  message_cref unbound = unflatten(&copy[0], &templ);
+  BOOST_CHECK_EQUAL(nested_message_cref(unbound[4]).target_instruction(), (const template_instruction*)0);
+  BOOST_CHECK_EQUAL(uint32_cref(unbound[0]).value(), 42U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,116 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <mfast/pool_allocator.h>
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+#include <vector>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+using namespace mfast;
+
+BOOST_AUTO_TEST_SUITE( pool_allocator_test_suite )
+
+BOOST_AUTO_TEST_CASE(pool_allocator_test)
+{
+  pool_allocator alloc;
+
+  BOOST_CHECK_EQUAL(pool_allocator::block_size(1), 16U);
+  BOOST_CHECK_EQUAL(pool_allocator::block_size(48), 48U);
+  BOOST_CHECK_EQUAL(pool_allocator::block_size(257), 384U);
+  BOOST_CHECK_EQUAL(pool_allocator::block_size(5000), 5000U);
+
+  void* block1 = alloc.allocate(48);
+  std::memset(block1, 0xFF, 48);
+  alloc.deallocate(block1, 48);
+
+  // the most recently deallocated block of the same size class is reused first
+  void* block2 = alloc.allocate(40);
+  BOOST_CHECK_EQUAL(block1, block2);
+  alloc.deallocate(block2, 40);
+
+  // make sure we can allocate memory far larger than the biggest size class
+  void* block3 = alloc.allocate(3*pool_allocator::max_block_size);
+  std::memset(block3, 0, 3*pool_allocator::max_block_size);
+  alloc.deallocate(block3, 3*pool_allocator::max_block_size);
+
+  void* block4 = 0;
+  std::size_t capacity = alloc.reallocate(block4, 0, 10);
+  BOOST_CHECK_GE(capacity, 10U);
+  std::memcpy(block4, "0123456789", 10);
+
+  std::size_t new_capacity = alloc.reallocate(block4, capacity, 3*pool_allocator::max_block_size);
+  BOOST_CHECK_GE(new_capacity, 3U*pool_allocator::max_block_size);
+  BOOST_CHECK(std::memcmp(block4, "0123456789", 10) == 0);
+  alloc.deallocate(block4, new_capacity);
+
+  // blocks from the same size class never overlap
+  std::vector<char*> blocks;
+  for (int i = 0; i < 1000; ++i) {
+    blocks.push_back(static_cast<char*>(alloc.allocate(64)));
+    std::memset(blocks.back(), i & 0x7F, 64);
+  }
+  for (int i = 0; i < 1000; ++i) {
+    BOOST_CHECK_EQUAL(blocks[i][0], i & 0x7F);
+    BOOST_CHECK_EQUAL(blocks[i][63], i & 0x7F);
+    alloc.deallocate(blocks[i], 64);
+  }
+}
+
+#ifndef _WIN32
+
+struct cross_thread_job
+{
+  pool_allocator* alloc_;
+  std::vector<void*>* blocks_;
+};
+
+extern "C" void* deallocate_blocks(void* arg)
+{
+  cross_thread_job* job = static_cast<cross_thread_job*>(arg);
+  for (std::size_t i = 0; i < job->blocks_->size(); ++i)
+    job->alloc_->deallocate((*job->blocks_)[i], 128);
+  return 0;
+}
+
+BOOST_AUTO_TEST_CASE(pool_allocator_cross_thread_test)
+{
+  pool_allocator alloc;
+  std::vector<void*> blocks;
+  for (int i = 0; i < 1000; ++i)
+    blocks.push_back(alloc.allocate(128));
+
+  cross_thread_job job = { &alloc, &blocks };
+  pthread_t thread;
+  BOOST_REQUIRE_EQUAL(pthread_create(&thread, 0, &deallocate_blocks, &job), 0);
+  pthread_join(thread, 0);
+
+  // the blocks freed by the other thread are returned to the shared free list on its exit
+  // and can be allocated again from this thread
+  for (int i = 0; i < 1000; ++i)
+    std::memset(alloc.allocate(128), 0, 128);
+}
+
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
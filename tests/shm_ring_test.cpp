@@ -0,0 +1,221 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <mfast.h>
+#include <mfast/shm_ring.h>
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include "debug_allocator.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace mfast;
+
+namespace {
+
+struct quote_fields
+{
+  quote_fields()
+    : seq_inst(0, operator_none, presence_mandatory, 1, "seq", "", 0, int_value_storage<uint32_t>())
+    , symbol_inst(1, operator_none, presence_mandatory, 2, "symbol", "", 0, string_value_storage())
+    , price_inst(2, operator_none, presence_mandatory, 3, "price", "", 0, decimal_value_storage())
+  {
+    instructions[0] = &seq_inst;
+    instructions[1] = &symbol_inst;
+    instructions[2] = &price_inst;
+  }
+
+  uint32_field_instruction seq_inst;
+  ascii_field_instruction symbol_inst;
+  decimal_field_instruction price_inst;
+  const field_instruction* instructions[3];
+};
+
+// the base class constructs the fields before the template which refers to them
+struct quote_template
+  : quote_fields
+{
+  quote_template()
+    : templ(20, "Quote", "", "", "", instructions, 3, false)
+  {
+  }
+
+  void set(message_mref mref, uint32_t seq)
+  {
+    char symbol[16];
+    std::sprintf(symbol, "SYM%u", seq);
+    uint32_mref(mref[0]).as(seq);
+    ascii_string_mref(mref[1]).as(symbol);
+    decimal_mref(mref[2]).as(10000 + seq, -2);
+  }
+
+  // returns true if the snapshot holds the message written by set(seq)
+  bool check(const snapshot_message_cref& snapshot, uint32_t seq) const
+  {
+    char symbol[16];
+    std::sprintf(symbol, "SYM%u", seq);
+    return snapshot[0].int_value<uint32_t>() == seq &&
+           std::strcmp(snapshot[1].c_str(), symbol) == 0 &&
+           snapshot[2].decimal_value() == fixed_decimal(10000 + seq, -2);
+  }
+
+  // returns true if the message is the one written by set(seq)
+  bool check(const message_cref& message, uint32_t seq) const
+  {
+    char symbol[16];
+    std::sprintf(symbol, "SYM%u", seq);
+    return uint32_cref(message[0]).value() == seq &&
+           std::strcmp(ascii_string_cref(message[1]).c_str(), symbol) == 0 &&
+           decimal_cref(message[2]).mantissa() == 10000 + seq &&
+           decimal_cref(message[2]).exponent() == -2;
+  }
+
+  template_instruction templ;
+};
+
+void publish(shm_publisher& publisher, quote_template& quote, allocator* alloc, uint32_t first, uint32_t last)
+{
+  message_type message(alloc, &quote.templ);
+  for (uint32_t i = first; i < last; ++i) {
+    quote.set(message.mref(), i);
+    BOOST_CHECK_EQUAL(publisher.publish(message.cref()), i);
+  }
+}
+
+// Read messages first to last-1 in a child process, which exits with 0 on success.
+pid_t read_in_child(const char* name, quote_template& quote, uint32_t first, uint32_t last)
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    int status = 1;
+    try {
+      shm_subscriber subscriber(name, true);
+      std::time_t deadline = std::time(0) + 10;
+      uint32_t expected = first;
+      while (expected < last && std::time(0) < deadline) {
+        if (!subscriber.next()) {
+          usleep(100);
+          continue;
+        }
+        if (subscriber.sequence() != expected ||
+            subscriber.template_id() != quote.templ.id() ||
+            !quote.check(subscriber.message(&quote.templ), expected))
+          break;
+        ++expected;
+      }
+      if (expected == last && subscriber.lost() == 0)
+        status = 0;
+    }
+    catch (...) {
+      status = 2;
+    }
+    _exit(status);
+  }
+
+  return pid;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( shm_ring_test_suite )
+
+BOOST_AUTO_TEST_CASE(shm_ring_multi_process_test)
+{
+  debug_allocator alloc;
+  quote_template quote;
+
+  char name[64];
+  std::sprintf(name, "/mfast_shm_ring_test_%d", static_cast<int>(getpid()));
+
+  shm_publisher publisher(name, 64, 256);
+  BOOST_CHECK_EQUAL(publisher.slot_count(), 64U);
+  BOOST_CHECK_EQUAL(publisher.slot_size(), 256U);
+
+  // the readers replay the messages published before they attach and wait for the rest
+  publish(publisher, quote, &alloc, 0, 10);
+
+  pid_t readers[3];
+  for (int i = 0; i < 3; ++i)
+    readers[i] = read_in_child(name, quote, 0, 40);
+
+  // publish slowly enough that the readers never fall a whole ring behind
+  for (uint32_t i = 10; i < 40; ++i) {
+    publish(publisher, quote, &alloc, i, i+1);
+    usleep(1000);
+  }
+  BOOST_CHECK_EQUAL(publisher.published(), 40U);
+
+  for (int i = 0; i < 3; ++i) {
+    int status = -1;
+    BOOST_CHECK_EQUAL(waitpid(readers[i], &status, 0), readers[i]);
+    BOOST_CHECK(WIFEXITED(status));
+    BOOST_CHECK_EQUAL(WEXITSTATUS(status), 0);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(shm_ring_overrun_test)
+{
+  debug_allocator alloc;
+  quote_template quote;
+
+  char name[64];
+  std::sprintf(name, "/mfast_shm_ring_overrun_%d", static_cast<int>(getpid()));
+
+  BOOST_CHECK_THROW(shm_publisher(name, 6, 256), shm_ring_error);
+  BOOST_CHECK_THROW(shm_subscriber missing(name), shm_ring_error);
+
+  shm_publisher publisher(name, 8, 96);
+  shm_subscriber subscriber(name);
+  BOOST_CHECK(!subscriber.next());
+
+  // a slow reader loses the messages which are overwritten before it reads them
+  publish(publisher, quote, &alloc, 0, 20);
+  for (uint32_t i = 12; i < 20; ++i) {
+    BOOST_REQUIRE(subscriber.next());
+    BOOST_CHECK_EQUAL(subscriber.sequence(), i);
+    BOOST_CHECK(quote.check(subscriber.snapshot_message(&quote.templ), i));
+    BOOST_CHECK(quote.check(subscriber.message(&quote.templ), i));
+    BOOST_CHECK(quote.check(subscriber.message(&quote.templ), i));
+  }
+  BOOST_CHECK(!subscriber.next());
+  BOOST_CHECK_EQUAL(subscriber.lost(), 12U);
+
+  // a message which does not fit into a slot is rejected
+  {
+    message_type message(&alloc, &quote.templ);
+    quote.set(message.mref(), 20);
+    ascii_string_mref(message.mref()[1]).as("A SYMBOL WHICH IS FAR TOO LONG FOR THE SLOT");
+    BOOST_CHECK_THROW(publisher.publish(message.cref()), snapshot_overflow_error);
+  }
+  BOOST_CHECK_EQUAL(publisher.published(), 20U);
+
+  publish(publisher, quote, &alloc, 20, 21);
+  BOOST_REQUIRE(subscriber.next());
+  BOOST_CHECK_EQUAL(subscriber.sequence(), 20U);
+  BOOST_CHECK(quote.check(subscriber.message(&quote.templ), 20));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif
@@ -0,0 +1,81 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <mfast/text_format.h>
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+#include <string>
+
+using namespace mfast;
+
+namespace {
+
+template <typename T>
+std::string integer_text(T value)
+{
+  char buf[max_integer_text_size];
+  return std::string(buf, format_integer(value, buf));
+}
+
+std::string decimal_text(int64_t mantissa, int8_t exponent)
+{
+  char buf[max_decimal_text_size];
+  return std::string(buf, format_decimal(mantissa, exponent, buf));
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( text_format_test_suite )
+
+BOOST_AUTO_TEST_CASE(format_integer_test)
+{
+  BOOST_CHECK_EQUAL(integer_text(0), "0");
+  BOOST_CHECK_EQUAL(integer_text(7), "7");
+  BOOST_CHECK_EQUAL(integer_text(42), "42");
+  BOOST_CHECK_EQUAL(integer_text(-100), "-100");
+  BOOST_CHECK_EQUAL(integer_text(12345U), "12345");
+  BOOST_CHECK_EQUAL(integer_text(INT32_MIN), "-2147483648");
+  BOOST_CHECK_EQUAL(integer_text(UINT32_MAX), "4294967295");
+  BOOST_CHECK_EQUAL(integer_text(INT64_MIN), "-9223372036854775808");
+  BOOST_CHECK_EQUAL(integer_text(INT64_MAX), "9223372036854775807");
+  BOOST_CHECK_EQUAL(integer_text(UINT64_MAX), "18446744073709551615");
+  BOOST_CHECK_EQUAL(integer_text(static_cast<int8_t>(-5)), "-5");
+}
+
+BOOST_AUTO_TEST_CASE(format_decimal_test)
+{
+  BOOST_CHECK_EQUAL(decimal_text(0, 0), "0");
+  BOOST_CHECK_EQUAL(decimal_text(0, 5), "0");
+  BOOST_CHECK_EQUAL(decimal_text(0, -2), "0.00");
+  BOOST_CHECK_EQUAL(decimal_text(123, 0), "123");
+  BOOST_CHECK_EQUAL(decimal_text(12, 2), "1200");
+  BOOST_CHECK_EQUAL(decimal_text(12345, -2), "123.45");
+  BOOST_CHECK_EQUAL(decimal_text(-12345, -5), "-0.12345");
+  BOOST_CHECK_EQUAL(decimal_text(-5, -3), "-0.005");
+  BOOST_CHECK_EQUAL(decimal_text(INT64_MIN, -19), "-0.9223372036854775808");
+
+  std::string text = decimal_text(INT64_MAX, 127);
+  BOOST_CHECK_EQUAL(text.size(), max_decimal_text_size - 1);
+  BOOST_CHECK_EQUAL(text.substr(0, 19), "9223372036854775807");
+
+  text = decimal_text(INT64_MIN, 127);
+  BOOST_CHECK_EQUAL(text.size(), max_decimal_text_size);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,104 @@
+// Copyright (c) 2013, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+//
+//     mFAST is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     mFAST is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with mFast.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <mfast.h>
+#include <mfast/tracking_allocator.h>
+#include <mfast/coder/dynamic_templates_description.h>
+#include <mfast/coder/allocation_tracking_hook.h>
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+
+using namespace mfast;
+
+BOOST_AUTO_TEST_SUITE( tracking_allocator_test_suite )
+
+BOOST_AUTO_TEST_CASE(tracking_allocator_test)
+{
+  tracking_allocator alloc(malloc_allocator::instance());
+
+  void* block1 = alloc.allocate(10);
+  std::size_t capacity = alloc.reallocate(block1, 10, 100);
+  alloc.deallocate(block1, capacity);
+
+  uint32_field_instruction field(0, operator_none, presence_mandatory, 1, "field", "", 0);
+  alloc.context(0, &field);
+  void* block2 = alloc.allocate(16);
+  alloc.deallocate(block2, 16);
+
+  tracking_allocator::counters_map::const_iterator itr =
+    alloc.per_context().find(tracking_allocator::context_type(0, &field));
+  BOOST_REQUIRE(itr != alloc.per_context().end());
+  BOOST_CHECK_EQUAL(itr->second.allocate_calls, 1U);
+  BOOST_CHECK_EQUAL(itr->second.allocate_bytes, 16U);
+  BOOST_CHECK_EQUAL(itr->second.reallocate_calls, 0U);
+
+  tracking_allocator::counters total = alloc.total();
+  BOOST_CHECK_EQUAL(total.allocate_calls, 2U);
+  BOOST_CHECK_EQUAL(total.reallocate_calls, 1U);
+  BOOST_CHECK_EQUAL(total.reallocate_bytes, capacity);
+  BOOST_CHECK_EQUAL(total.deallocate_calls, 2U);
+
+  std::stringstream strm;
+  alloc.report(strm);
+  BOOST_CHECK(strm.str().find("field") != std::string::npos);
+
+  alloc.clear();
+  BOOST_CHECK_EQUAL(alloc.total().allocate_calls, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(allocation_tracking_hook_test)
+{
+  dynamic_templates_description description(
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<string name=\"field2\" id=\"12\"></string>\n"
+    "</template>\n"
+    "</templates>\n");
+
+  tracking_allocator alloc(malloc_allocator::instance());
+  allocation_tracking_hook hook(&alloc);
+
+  const templates_description* descriptions[] = { &description };
+  fast_decoder decoder(&alloc);
+  decoder.hook(&hook);
+  decoder.include(descriptions);
+
+  // field2 = "ABC"
+  const char stream[] = "\xA0\x81\x41\x42\xC3";
+  const char* first = stream;
+  message_cref msg = decoder.decode(first, stream + sizeof(stream) - 1);
+  BOOST_CHECK_EQUAL(ascii_string_cref(msg[1]).c_str(), "ABC");
+
+  const tracking_allocator::counters_map& counters = alloc.per_context();
+  tracking_allocator::counters_map::const_iterator itr;
+  bool field2_found = false;
+  for (itr = counters.begin(); itr != counters.end(); ++itr) {
+    if (itr->first.first == msg.instruction() && itr->first.second == msg.instruction()->subinstruction(1)) {
+      field2_found = true;
+      BOOST_CHECK(itr->second.allocate_calls + itr->second.reallocate_calls > 0);
+    }
+  }
+  BOOST_CHECK(field2_found);
+}
+
+BOOST_AUTO_TEST_SUITE_END()